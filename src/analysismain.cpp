@@ -0,0 +1,198 @@
+#include "latencyanalyzer.h"
+#include "parallelanalyzer.h"
+#include "recordingfile.h"
+#include "soakfile.h"
+#include "stimulus.h"
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <cmath>
+#include <string>
+#include <filesystem>
+#include <memory>
+
+
+namespace {
+
+void printMatrix(const LatencyMatrixResult& result)
+{
+    std::cout << "Blocks: " << result.numBlocks << std::endl;
+    std::cout << "Delay in samples, rows: outputs, columns: inputs" << std::endl;
+    std::cout << std::setw(6) << "";
+    for (size_t in = 0; in < result.numInputs; in++)
+    {
+        std::cout << std::setw(10) << ("in" + std::to_string(in));
+    }
+    std::cout << std::endl;
+    for (size_t out = 0; out < result.numOutputs; out++)
+    {
+        std::cout << std::setw(6) << ("out" + std::to_string(out));
+        for (size_t in = 0; in < result.numInputs; in++)
+        {
+            const double delay = result.delay(out, in);
+            if (std::isnan(delay))
+            {
+                std::cout << std::setw(10) << "-";
+            }
+            else
+            {
+                std::cout << std::setw(10) << std::fixed << std::setprecision(2) << delay;
+            }
+        }
+        std::cout << std::endl;
+    }
+}
+
+/**
+ * @brief Stored segments of a soak recording, each analysed on its own
+ */
+void printSoak(const std::filesystem::path& filename)
+{
+    SoakReader reader(filename);
+    const auto &info = reader.info();
+    const double periodSeconds = info.period / info.sampleRate;
+    std::cout << "Device: " << info.deviceUID << std::endl;
+    std::cout << "Sample rate: " << info.sampleRate << ", stimulus: " << stimulusName(info.stimulus)
+              << ", period: " << info.period << ", buffer size: " << info.bufferSize << std::endl;
+    std::cout << "Soak recording of " << std::fixed << std::setprecision(1) << (reader.recordedFrames() / info.sampleRate)
+              << " s, " << reader.segments().size() << " stored segment(s)" << std::endl;
+
+    std::cout << std::setw(10) << "period" << std::setw(10) << "periods" << std::setw(12) << "time s"
+              << std::setw(12) << "samples" << std::setw(11) << "drift ppm" << "  anomalies" << std::endl;
+    for (size_t k = 0; k < reader.segments().size(); k++)
+    {
+        const auto &segment = reader.segments()[k];
+        std::cout << std::setw(10) << segment.firstPeriod << std::setw(10) << segment.numPeriods
+                  << std::setw(12) << std::setprecision(1) << (segment.firstPeriod * periodSeconds);
+        if (info.layout == StimulusLayout::Passthrough)
+        {
+            std::unique_ptr<LatencyAnalyzer> analyzer;
+            if (info.stimulus == StimulusType::Chirp)
+            {
+                analyzer = std::make_unique<LatencyAnalyzer>(info.period, info.sampleRate, info.numChannels, 0);
+            }
+            else
+            {
+                const auto &stimulus = StimulusSignal::get(info.stimulus, nominalStimulusPeriod(info.stimulus, info.period));
+                analyzer = std::make_unique<LatencyAnalyzer>(stimulus, info.sampleRate, info.numChannels, 0);
+            }
+            reader.decode(k, [&](uint64_t, uint32_t, const float *frames) {
+                analyzer->addSamples(frames, info.period);
+            });
+            const auto result = analyzer->result();
+            std::cout << std::setw(12) << std::setprecision(2) << result.fractionalDelay
+                      << std::setw(11) << result.driftPpm;
+        }
+        else
+        {
+            std::cout << std::setw(12) << "-" << std::setw(11) << "-";
+        }
+        std::cout << "  " << soakAnomalyNames(segment.flags) << std::endl;
+    }
+}
+
+}   // anonymous namespace
+
+
+/**
+ * Offline latency analysis of a LatencyTester result directory
+ *
+ * Usage: TestCoreAudioLatencyAnalysis [recording file or result directory] [--impulse <file>]
+ *        [--threads <n>]
+ *
+ * A passthrough recording is analysed on --threads threads, by default one per
+ * hardware thread; 1 streams it through LatencyAnalyzer instead. A soak
+ * recording is listed segment by segment, with the latency of each.
+ */
+int main(int argc, char *argv[])
+{
+    std::filesystem::path recordingFilename = ".";
+    std::filesystem::path impulseFilename;
+    size_t numThreads = 0;
+    for (int k = 1; k < argc; k++)
+    {
+        const std::string arg = argv[k];
+        if ((arg == "--impulse") && (k + 1 < argc))
+        {
+            impulseFilename = argv[++k];
+        }
+        else if ((arg == "--threads") && (k + 1 < argc))
+        {
+            numThreads = std::stoul(argv[++k]);
+        }
+        else
+        {
+            recordingFilename = arg;
+        }
+    }
+
+    try
+    {
+        if (std::filesystem::is_directory(recordingFilename))
+        {
+            const auto soakFilename = recordingFilename / "soak.tcal";
+            recordingFilename /= "recording.tcal";
+            if (!std::filesystem::exists(recordingFilename) && std::filesystem::exists(soakFilename))
+            {
+                recordingFilename = soakFilename;
+            }
+        }
+        if (SoakReader::isSoakFile(recordingFilename))
+        {
+            printSoak(recordingFilename);
+            return 0;
+        }
+
+        StimulusLayout layout;
+        {
+            RecordingReader reader(recordingFilename);
+            const auto &info = reader.info();
+            layout = info.layout;
+            std::cout << "Device: " << info.deviceUID << std::endl;
+            std::cout << "Sample rate: " << info.sampleRate << ", stimulus: " << stimulusName(info.stimulus)
+                      << ", period: " << info.period << ", buffer size: " << info.bufferSize << std::endl;
+            if (reader.recovered())
+            {
+                std::cout << "Index missing, recovered " << reader.numChunks() << " chunk(s)" << std::endl;
+            }
+            if (!reader.dropouts().empty())
+            {
+                std::cout << "Dropouts in " << reader.dropouts().size() << " period(s), which are left out" << std::endl;
+            }
+        }
+
+        if (layout == StimulusLayout::Matrix)
+        {
+            printMatrix(analyzeMatrixRecording(recordingFilename));
+            return 0;
+        }
+
+        auto result = (numThreads == 1) ? analyzeRecording(recordingFilename)
+                                        : analyzeRecordingParallel(recordingFilename, numThreads);
+        std::cout << "Peak levels: " << result.peakLevels[0] << ", " << result.peakLevels[1] << std::endl;
+        std::cout << "Blocks: " << result.numBlocks << std::endl;
+        if (result.numBlocks == 0)
+        {
+            throw std::runtime_error("Recording has no period without dropouts after the warm-up");
+        }
+        std::cout << "Delay: " << result.delay << " samples, " << result.delayMs << " msec" << std::endl;
+        std::cout << "Fractional delay: " << result.fractionalDelay << " samples, " << result.fractionalDelayMs << " msec" << std::endl;
+        std::cout << "Clock drift: " << result.driftPpm << " ppm" << std::endl;
+
+        if (!impulseFilename.empty())
+        {
+            std::ofstream file(impulseFilename);
+            for (auto x : result.impulseResponse)
+            {
+                file << x << "\n";
+            }
+        }
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << "ERROR: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
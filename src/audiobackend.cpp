@@ -0,0 +1,110 @@
+#include "audiobackend.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QTimer>
+
+
+const char* audioEventMessage(AudioEvent event)
+{
+    switch (event)
+    {
+    case AudioEvent::InvalidInputFrames:        return "Invalid number of input samples";
+    case AudioEvent::InvalidOutputFrames:       return "Invalid number of output samples";
+    case AudioEvent::InputDisabled:             return "Input streaming is disabled";
+    case AudioEvent::OutputDisabled:            return "Output streaming is disabled";
+    case AudioEvent::InvalidFrameCount:         return "Invalid number of samples";
+    case AudioEvent::UnexpectedStreamLayout:    return "Unexpected stream layout";
+    case AudioEvent::DeadlineMiss:              return "I/O cycle missed its deadline";
+    case AudioEvent::Xrun:                      return "Device sample time discontinuity";
+    default:                                    return "Unknown audio event";
+    }
+}
+
+
+AudioBackend::AudioBackend(AudioProcessor &processor, QObject *parent)
+    : QObject(parent)
+    , processor_(processor)
+{
+    if (QCoreApplication::instance() != nullptr)
+    {
+        auto timer = new QTimer(this);
+        connect(timer, &QTimer::timeout, this, &AudioBackend::pumpEvents);
+        timer->start(kPumpInterval);
+    }
+}
+
+void AudioBackend::pumpEvents()
+{
+    std::array<uint64_t, kNumEvents> counts{};
+    AudioEvent buffer[64];
+    size_t n;
+    while ((n = events_.pop(buffer, std::size(buffer))) > 0)
+    {
+        for (size_t k = 0; k < n; k++)
+        {
+            const auto code = static_cast<size_t>(buffer[k]);
+            if (code < kNumEvents)
+            {
+                counts[code]++;
+            }
+        }
+    }
+
+    const auto dropped = droppedEvents_.exchange(0, std::memory_order_relaxed);
+    if (dropped > 0)
+    {
+        qDebug() << "Audio event queue full," << dropped << "event(s) dropped";
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    const auto interval = std::chrono::milliseconds(kRepeatInterval);
+    for (size_t code = 0; code < kNumEvents; code++)
+    {
+        const auto event = static_cast<AudioEvent>(code);
+        if (isAudioError(event))
+        {
+            if (counts[code] == 0)
+            {
+                // The episode ended, re-arm
+                if (latched_[code] && (repeats_[code] > 0))
+                {
+                    qDebug() << audioEventMessage(event) << "repeated" << repeats_[code] << "time(s)";
+                }
+                latched_[code] = false;
+                repeats_[code] = 0;
+            }
+            else if (latched_[code])
+            {
+                repeats_[code] += counts[code];
+            }
+            else
+            {
+                latched_[code] = true;
+                repeats_[code] = counts[code] - 1;
+                emit error(audioEventMessage(event));
+            }
+            continue;
+        }
+
+        const bool due = (signalled_[code] == std::chrono::steady_clock::time_point()) || (now - signalled_[code] >= interval);
+        if (!due)
+        {
+            repeats_[code] += counts[code];
+            continue;
+        }
+        if (repeats_[code] > 0)
+        {
+            qDebug() << audioEventMessage(event) << "repeated" << repeats_[code] << "time(s)";
+            repeats_[code] = 0;
+        }
+        if (counts[code] == 0)
+        {
+            continue;
+        }
+
+        signalled_[code] = now;
+        repeats_[code] = counts[code] - 1;
+        emit status(audioEventMessage(event));
+    }
+}
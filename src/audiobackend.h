@@ -0,0 +1,171 @@
+#ifndef AUDIOBACKEND_H
+#define AUDIOBACKEND_H
+
+#include "callbackstats.h"
+#include "latencymodel.h"
+#include "spscringbuffer.h"
+#ifdef TCAL_RT_CHECK
+#include "rtcheck.h"
+#endif
+
+#include <QString>
+#include <QObject>
+
+#include <atomic>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+
+/**
+ * @brief Error and status codes posted from the I/O thread
+ */
+enum class AudioEvent : uint8_t
+{
+    // Errors, forwarded to AudioBackend::error()
+    InvalidInputFrames,
+    InvalidOutputFrames,
+    InputDisabled,
+    OutputDisabled,
+    InvalidFrameCount,
+    UnexpectedStreamLayout,
+    // Status, forwarded to AudioBackend::status()
+    DeadlineMiss,
+    Xrun,
+    Count
+};
+
+const char* audioEventMessage(AudioEvent event);
+
+inline bool isAudioError(AudioEvent event)
+{
+    return event < AudioEvent::DeadlineMiss;
+}
+
+
+/**
+ * @brief Real-time audio processing callback
+ *
+ * process() is called on the backend's I/O thread with interleaved float samples.
+ * inSamples/outSamples may be NULL if the corresponding direction is not streaming.
+ */
+class AudioProcessor
+{
+public:
+    virtual ~AudioProcessor() = default;
+
+    /**
+     * @brief Called by the backend's Start() before the first process(), off the I/O thread
+     *
+     * May throw std::runtime_error if the processor cannot run on this
+     * configuration; Start() then emits error() and does not start.
+     * @param maxFrames Upper bound of numSamples
+     * @param inChannels Channels process() will be called with
+     * @param outChannels
+     * @param latency Latency reported by the device as configured
+     */
+    virtual void prepare(size_t maxFrames, size_t inChannels, size_t outChannels, const LatencyModel& latency)
+    {
+        (void)maxFrames;
+        (void)inChannels;
+        (void)outChannels;
+        (void)latency;
+    }
+
+    virtual void process(size_t numSamples, const float *inSamples, size_t inChannels, float *outSamples, size_t outChannels) = 0;
+};
+
+
+/**
+ * @brief Audio device driving an AudioProcessor
+ *
+ * The I/O thread never emits signals itself: it posts AudioEvent codes into a
+ * fixed-size lock-free queue, which pumpEvents() drains on the thread owning the
+ * backend. An error code is signalled once per episode: it is latched until a
+ * pump in which it did not occur, and its repetitions are only counted and
+ * logged when the episode ends. A status code is signalled at most once per
+ * kRepeatInterval ms, its repetitions in between logged once the interval has
+ * passed. With a Qt event loop running, a timer pumps every kPumpInterval ms;
+ * otherwise the owner has to call pumpEvents() itself.
+ */
+class AudioBackend : public QObject
+{
+    Q_OBJECT
+public:
+    static constexpr int kPumpInterval = 20;
+    static constexpr int kRepeatInterval = 1000;
+    static constexpr size_t kEventCapacity = 256;
+
+    AudioBackend(AudioProcessor &processor, QObject *parent = nullptr);
+    virtual ~AudioBackend() = default;
+    virtual void Start() = 0;
+    virtual void Stop() = 0;
+
+    /**
+     * @brief Forward one I/O cycle to the processor and time it (called from the I/O thread)
+     */
+    void process(size_t numSamples, const float *inSamples, size_t inChannels, float *outSamples, size_t outChannels,
+                 const IOCycleTime &time = IOCycleTime())
+    {
+#ifdef TCAL_RT_CHECK
+        const RtCheck::Scope rtScope;
+#endif
+        const auto begin = CallbackStats::now();
+        processor_.process(numSamples, inSamples, inChannels, outSamples, outChannels);
+        const auto flags = stats_.addCycle(numSamples, time, begin, CallbackStats::now());
+        if (flags & CallbackStats::kDeadlineMiss)
+        {
+            post(AudioEvent::DeadlineMiss);
+        }
+        if (flags & CallbackStats::kDiscontinuity)
+        {
+            post(AudioEvent::Xrun);
+        }
+    }
+
+    /**
+     * @brief Queue an event (real-time safe, I/O thread only)
+     */
+    void post(AudioEvent event)
+    {
+        if (!events_.push(&event, 1))
+        {
+            droppedEvents_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * @brief Deliver queued events as signals (owner thread)
+     */
+    void pumpEvents();
+
+    /**
+     * @brief Callback timing since the last Start() (any thread)
+     */
+    CallbackStats::Snapshot callbackStats() const {return stats_.snapshot();}
+
+    /**
+     * @brief Latency components reported by the device for the current configuration
+     */
+    virtual LatencyModel latencyModel() const {return LatencyModel();}
+
+signals:
+    void error(const QString &msg);
+    void status(const QString &msg);
+
+protected:
+    AudioProcessor &processor_;
+    CallbackStats stats_;   ///< Reset by Start() of the implementation
+
+private:
+    static constexpr size_t kNumEvents = static_cast<size_t>(AudioEvent::Count);
+
+    SpscRingBuffer<AudioEvent> events_{kEventCapacity};
+    std::atomic<uint64_t> droppedEvents_{0};
+    std::array<std::chrono::steady_clock::time_point, kNumEvents> signalled_{};    ///< Last signal per code
+    std::array<uint64_t, kNumEvents> repeats_{};    ///< Suppressed repetitions since then
+    std::array<bool, kNumEvents> latched_{};        ///< Error signalled, occurred in every pump since
+};
+
+#endif // AUDIOBACKEND_H
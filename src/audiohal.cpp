@@ -0,0 +1,150 @@
+#include "audiohal.h"
+
+#include <QString>
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+
+namespace {
+
+void* clientData(AudioHAL::ListenerToken token)
+{
+    return reinterpret_cast<void*>(static_cast<uintptr_t>(token));
+}
+
+}   // anonymous namespace
+
+
+CoreAudioHAL::~CoreAudioHAL()
+{
+    std::vector<std::pair<ListenerToken, std::shared_ptr<const Registration>>> removed;
+    {
+        auto &reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        for (auto token : tokens_)
+        {
+            auto it = reg.registrations.find(token);
+            removed.emplace_back(token, std::move(it->second));
+            reg.registrations.erase(it);
+        }
+        tokens_.clear();
+    }
+    for (const auto &[token, registration] : removed)
+    {
+        AudioObjectRemovePropertyListener(registration->objectID, &registration->addr, listenerProc, clientData(token));
+    }
+}
+
+CoreAudioHAL::Registry& CoreAudioHAL::registry()
+{
+    static auto *registry = new Registry;
+    return *registry;
+}
+
+CoreAudioHAL& CoreAudioHAL::instance()
+{
+    static CoreAudioHAL hal;
+    return hal;
+}
+
+bool CoreAudioHAL::hasProperty(AudioObjectID objectID, const AudioObjectPropertyAddress& addr)
+{
+    return AudioObjectHasProperty(objectID, &addr);
+}
+
+OSStatus CoreAudioHAL::getPropertyDataSize(AudioObjectID objectID, const AudioObjectPropertyAddress& addr, UInt32 &dataSize)
+{
+    return AudioObjectGetPropertyDataSize(objectID, &addr, 0, nullptr, &dataSize);
+}
+
+OSStatus CoreAudioHAL::getPropertyData(AudioObjectID objectID, const AudioObjectPropertyAddress& addr, UInt32 &dataSize, void *data)
+{
+    return AudioObjectGetPropertyData(objectID, &addr, 0, nullptr, &dataSize, data);
+}
+
+OSStatus CoreAudioHAL::setPropertyData(AudioObjectID objectID, const AudioObjectPropertyAddress& addr, UInt32 dataSize, const void *data)
+{
+    return AudioObjectSetPropertyData(objectID, &addr, 0, nullptr, dataSize, data);
+}
+
+OSStatus CoreAudioHAL::getStringProperty(AudioObjectID objectID, const AudioObjectPropertyAddress& addr, std::string &value)
+{
+    CFStringRef str = NULL;
+    UInt32 dataSize = sizeof(str);
+    const auto status = AudioObjectGetPropertyData(objectID, &addr, 0, nullptr, &dataSize, &str);
+    if (status != noErr)
+    {
+        return status;
+    }
+    value = QString::fromCFString(str).toStdString();
+    if (str != NULL)
+    {
+        CFRelease(str);
+    }
+    return noErr;
+}
+
+AudioHAL::ListenerToken CoreAudioHAL::addListener(AudioObjectID objectID, const AudioObjectPropertyAddress& addr, Listener listener)
+{
+    auto &reg = registry();
+    ListenerToken token;
+    {
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        token = reg.nextToken++;
+    }
+
+    // The HAL is called without the lock, which the notification proc takes.
+    // A notification before the registration is stored is ignored.
+    auto registration = std::make_shared<const Registration>(Registration{objectID, addr, std::move(listener)});
+    if (AudioObjectAddPropertyListener(objectID, &addr, listenerProc, clientData(token)) != noErr)
+    {
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.registrations[token] = std::move(registration);
+    tokens_.insert(token);
+    return token;
+}
+
+void CoreAudioHAL::removeListener(ListenerToken token)
+{
+    auto &reg = registry();
+    std::shared_ptr<const Registration> registration;
+    {
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        if (tokens_.erase(token) == 0)
+        {
+            return;
+        }
+        auto it = reg.registrations.find(token);
+        registration = std::move(it->second);
+        reg.registrations.erase(it);
+    }
+    AudioObjectRemovePropertyListener(registration->objectID, &registration->addr, listenerProc, clientData(token));
+}
+
+OSStatus CoreAudioHAL::listenerProc(AudioObjectID inObjectID,
+                                    UInt32 inNumberAddresses,
+                                    const AudioObjectPropertyAddress *inAddresses,
+                                    void *inClientData)
+{
+    // Called on a HAL notification thread; the copy keeps the registration alive while it runs
+    std::shared_ptr<const Registration> registration;
+    {
+        auto &reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        auto it = reg.registrations.find(static_cast<ListenerToken>(reinterpret_cast<uintptr_t>(inClientData)));
+        if (it == reg.registrations.end())
+        {
+            return noErr;
+        }
+        registration = it->second;
+    }
+    if (registration->listener)
+    {
+        registration->listener(inObjectID, inAddresses, inNumberAddresses);
+    }
+    return noErr;
+}
@@ -0,0 +1,120 @@
+#ifndef AUDIOHAL_H
+#define AUDIOHAL_H
+
+#include "audiotypes.h"
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+
+
+/**
+ * @brief Property access to the audio object tree
+ *
+ * Mirrors the AudioObject property calls so the device registry can run on top
+ * of the real HAL or of an in-memory fake. Listeners may be called from any
+ * thread; addresses passed to addListener() may use the scope, element or
+ * selector wildcards.
+ */
+class AudioHAL
+{
+public:
+    using Listener = std::function<void(AudioObjectID objectID, const AudioObjectPropertyAddress *addresses, UInt32 numAddresses)>;
+    using ListenerToken = size_t;
+
+    virtual ~AudioHAL() = default;
+
+    virtual bool hasProperty(AudioObjectID objectID, const AudioObjectPropertyAddress& addr) = 0;
+    virtual OSStatus getPropertyDataSize(AudioObjectID objectID, const AudioObjectPropertyAddress& addr, UInt32 &dataSize) = 0;
+
+    /**
+     * @brief Read a property
+     * @param objectID
+     * @param addr
+     * @param dataSize In: capacity of data, out: bytes written
+     * @param data
+     * @return
+     */
+    virtual OSStatus getPropertyData(AudioObjectID objectID, const AudioObjectPropertyAddress& addr, UInt32 &dataSize, void *data) = 0;
+    virtual OSStatus setPropertyData(AudioObjectID objectID, const AudioObjectPropertyAddress& addr, UInt32 dataSize, const void *data) = 0;
+
+    /**
+     * @brief Read a string property as UTF-8
+     */
+    virtual OSStatus getStringProperty(AudioObjectID objectID, const AudioObjectPropertyAddress& addr, std::string &value) = 0;
+
+    /**
+     * @brief Register a property change listener
+     * @return Token for removeListener(), 0 on failure
+     */
+    virtual ListenerToken addListener(AudioObjectID objectID, const AudioObjectPropertyAddress& addr, Listener listener) = 0;
+    virtual void removeListener(ListenerToken token) = 0;
+};
+
+
+#ifdef __APPLE__
+
+/**
+ * @brief AudioHAL backed by the Core Audio AudioObject API
+ *
+ * The HAL gets a listener's token as its client data, never a pointer, and the
+ * notification proc looks the registration up and keeps it alive while it
+ * runs. A notification that races removeListener() therefore either finds
+ * nothing or finishes on the registration it found.
+ */
+class CoreAudioHAL : public AudioHAL
+{
+public:
+    CoreAudioHAL() = default;
+    ~CoreAudioHAL();
+
+    bool hasProperty(AudioObjectID objectID, const AudioObjectPropertyAddress& addr) override;
+    OSStatus getPropertyDataSize(AudioObjectID objectID, const AudioObjectPropertyAddress& addr, UInt32 &dataSize) override;
+    OSStatus getPropertyData(AudioObjectID objectID, const AudioObjectPropertyAddress& addr, UInt32 &dataSize, void *data) override;
+    OSStatus setPropertyData(AudioObjectID objectID, const AudioObjectPropertyAddress& addr, UInt32 dataSize, const void *data) override;
+    OSStatus getStringProperty(AudioObjectID objectID, const AudioObjectPropertyAddress& addr, std::string &value) override;
+    ListenerToken addListener(AudioObjectID objectID, const AudioObjectPropertyAddress& addr, Listener listener) override;
+    void removeListener(ListenerToken token) override;
+
+    /**
+     * @brief Process-wide instance
+     */
+    static CoreAudioHAL& instance();
+
+private:
+    struct Registration
+    {
+        AudioObjectID objectID;
+        AudioObjectPropertyAddress addr;
+        Listener listener;
+    };
+
+    /**
+     * @brief Registrations of all instances by token
+     */
+    struct Registry
+    {
+        std::mutex mutex;
+        std::map<ListenerToken, std::shared_ptr<const Registration>> registrations;
+        ListenerToken nextToken{1};
+    };
+
+    /**
+     * @brief Process-wide and never destroyed, so notifications during exit still find it
+     */
+    static Registry& registry();
+
+    static OSStatus listenerProc(AudioObjectID inObjectID,
+                                 UInt32 inNumberAddresses,
+                                 const AudioObjectPropertyAddress *inAddresses,
+                                 void *inClientData);
+
+    std::set<ListenerToken> tokens_;    ///< Of this instance, guarded by the registry
+};
+
+#endif // __APPLE__
+
+#endif // AUDIOHAL_H
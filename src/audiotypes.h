@@ -0,0 +1,139 @@
+#ifndef AUDIOTYPES_H
+#define AUDIOTYPES_H
+
+/*
+ * Core Audio HAL types and property constants
+ *
+ * On macOS this is the real AudioHardware.h. Elsewhere, the subset used by the
+ * property layer is declared here with the same layout and values, so the
+ * device registry and the fake HAL build and run on any host.
+ */
+
+#ifdef __APPLE__
+
+#include <AudioHardware.h>
+
+#else
+
+#include <cstdint>
+
+using UInt32 = uint32_t;
+using SInt32 = int32_t;
+using Float32 = float;
+using Float64 = double;
+using OSStatus = int32_t;
+
+using AudioObjectID = UInt32;
+using AudioObjectPropertySelector = UInt32;
+using AudioObjectPropertyScope = UInt32;
+using AudioObjectPropertyElement = UInt32;
+
+struct AudioObjectPropertyAddress
+{
+    AudioObjectPropertySelector mSelector;
+    AudioObjectPropertyScope mScope;
+    AudioObjectPropertyElement mElement;
+};
+
+struct AudioValueRange
+{
+    Float64 mMinimum;
+    Float64 mMaximum;
+};
+
+struct AudioBuffer
+{
+    UInt32 mNumberChannels;
+    UInt32 mDataByteSize;
+    void *mData;
+};
+
+struct AudioBufferList
+{
+    UInt32 mNumberBuffers;
+    AudioBuffer mBuffers[1];
+};
+
+struct AudioStreamBasicDescription
+{
+    Float64 mSampleRate;
+    UInt32 mFormatID;
+    UInt32 mFormatFlags;
+    UInt32 mBytesPerPacket;
+    UInt32 mFramesPerPacket;
+    UInt32 mBytesPerFrame;
+    UInt32 mChannelsPerFrame;
+    UInt32 mBitsPerChannel;
+    UInt32 mReserved;
+};
+
+struct AudioStreamRangedDescription
+{
+    AudioStreamBasicDescription mFormat;
+    AudioValueRange mSampleRateRange;
+};
+
+constexpr UInt32 audioFourCC(const char (&code)[5])
+{
+    return (static_cast<UInt32>(static_cast<unsigned char>(code[0])) << 24) |
+           (static_cast<UInt32>(static_cast<unsigned char>(code[1])) << 16) |
+           (static_cast<UInt32>(static_cast<unsigned char>(code[2])) << 8) |
+           static_cast<UInt32>(static_cast<unsigned char>(code[3]));
+}
+
+constexpr OSStatus noErr = 0;
+constexpr OSStatus kAudioHardwareNoError = 0;
+constexpr OSStatus kAudioHardwareUnspecifiedError = static_cast<OSStatus>(audioFourCC("what"));
+constexpr OSStatus kAudioHardwareUnknownPropertyError = static_cast<OSStatus>(audioFourCC("who?"));
+constexpr OSStatus kAudioHardwareBadPropertySizeError = static_cast<OSStatus>(audioFourCC("!siz"));
+constexpr OSStatus kAudioHardwareBadObjectError = static_cast<OSStatus>(audioFourCC("!obj"));
+
+constexpr AudioObjectID kAudioObjectUnknown = 0;
+constexpr AudioObjectID kAudioObjectSystemObject = 1;
+
+constexpr AudioObjectPropertyScope kAudioObjectPropertyScopeGlobal = audioFourCC("glob");
+constexpr AudioObjectPropertyScope kAudioObjectPropertyScopeInput = audioFourCC("inpt");
+constexpr AudioObjectPropertyScope kAudioObjectPropertyScopeOutput = audioFourCC("outp");
+constexpr AudioObjectPropertyScope kAudioObjectPropertyScopeWildcard = audioFourCC("****");
+constexpr AudioObjectPropertyElement kAudioObjectPropertyElementMain = 0;
+constexpr AudioObjectPropertyElement kAudioObjectPropertyElementWildcard = 0xFFFFFFFF;
+constexpr AudioObjectPropertySelector kAudioObjectPropertySelectorWildcard = audioFourCC("****");
+
+constexpr AudioObjectPropertySelector kAudioObjectPropertyName = audioFourCC("lnam");
+constexpr AudioObjectPropertySelector kAudioObjectPropertyManufacturer = audioFourCC("lmak");
+
+constexpr AudioObjectPropertySelector kAudioHardwarePropertyDevices = audioFourCC("dev#");
+constexpr AudioObjectPropertySelector kAudioHardwarePropertyDefaultInputDevice = audioFourCC("dIn ");
+constexpr AudioObjectPropertySelector kAudioHardwarePropertyDefaultOutputDevice = audioFourCC("dOut");
+
+constexpr AudioObjectPropertySelector kAudioDevicePropertyDeviceNameCFString = kAudioObjectPropertyName;
+constexpr AudioObjectPropertySelector kAudioDevicePropertyDeviceManufacturerCFString = kAudioObjectPropertyManufacturer;
+constexpr AudioObjectPropertySelector kAudioDevicePropertyDeviceUID = audioFourCC("uid ");
+constexpr AudioObjectPropertySelector kAudioDevicePropertyDeviceIsAlive = audioFourCC("livn");
+constexpr AudioObjectPropertySelector kAudioDevicePropertyDeviceIsRunning = audioFourCC("goin");
+constexpr AudioObjectPropertySelector kAudioDevicePropertyNominalSampleRate = audioFourCC("nsrt");
+constexpr AudioObjectPropertySelector kAudioClockDevicePropertyNominalSampleRate = audioFourCC("nsrt");
+constexpr AudioObjectPropertySelector kAudioDevicePropertyAvailableNominalSampleRates = audioFourCC("nsr#");
+constexpr AudioObjectPropertySelector kAudioDevicePropertyStreamConfiguration = audioFourCC("slay");
+constexpr AudioObjectPropertySelector kAudioDevicePropertyStreams = audioFourCC("stm#");
+constexpr AudioObjectPropertySelector kAudioDevicePropertyBufferFrameSize = audioFourCC("fsiz");
+constexpr AudioObjectPropertySelector kAudioDevicePropertyBufferFrameSizeRange = audioFourCC("fsz#");
+constexpr AudioObjectPropertySelector kAudioDevicePropertyLatency = audioFourCC("ltnc");
+constexpr AudioObjectPropertySelector kAudioDevicePropertySafetyOffset = audioFourCC("saft");
+constexpr AudioObjectPropertySelector kAudioDevicePropertyIOCycleUsage = audioFourCC("ncyc");
+constexpr AudioObjectPropertySelector kAudioStreamPropertyLatency = audioFourCC("ltnc");
+constexpr AudioObjectPropertySelector kAudioStreamPropertyVirtualFormat = audioFourCC("sfmt");
+constexpr AudioObjectPropertySelector kAudioStreamPropertyPhysicalFormat = audioFourCC("pft ");
+constexpr AudioObjectPropertySelector kAudioStreamPropertyAvailablePhysicalFormats = audioFourCC("pfta");
+
+constexpr UInt32 kAudioFormatLinearPCM = audioFourCC("lpcm");
+constexpr UInt32 kAudioFormatFlagIsFloat = 1u << 0;
+constexpr UInt32 kAudioFormatFlagIsBigEndian = 1u << 1;
+constexpr UInt32 kAudioFormatFlagIsSignedInteger = 1u << 2;
+constexpr UInt32 kAudioFormatFlagIsPacked = 1u << 3;
+constexpr UInt32 kAudioFormatFlagIsAlignedHigh = 1u << 4;
+constexpr UInt32 kAudioFormatFlagIsNonInterleaved = 1u << 5;
+
+#endif // __APPLE__
+
+#endif // AUDIOTYPES_H
@@ -0,0 +1,810 @@
+#include "chirp.h"
+#include "deviceregistry.h"
+#include "fakehal.h"
+#include "latencyanalyzer.h"
+#include "latencytester.h"
+#include "latencytracker.h"
+#include "parallelanalyzer.h"
+#include "recordingwriter.h"
+#include "sampleformat.h"
+#include "simulateddevice.h"
+#include "streamconfig.h"
+#ifdef __APPLE__
+#include "coreaudioqt.h"
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#ifndef TCAL_VERSION
+#define TCAL_VERSION "unknown"
+#endif
+
+
+namespace {
+
+struct BenchResult
+{
+    std::string name;
+    std::string param;
+    size_t repetitions{0};
+    double seconds{0};      ///< Median wall time of one repetition
+    double value{0};        ///< Throughput or cost derived from the median
+    std::string unit;
+};
+
+struct BenchConfig
+{
+    size_t repetitions{7};
+    double scale{1.0};      ///< Work per repetition, < 1 for a quick smoke run
+    std::filesystem::path workPath;
+    std::string deviceUID;  ///< Audio device for the Start/Stop cycles, none for the simulated device only
+};
+
+/**
+ * @brief Median wall time of repeated runs of body, after one warm-up run
+ */
+double measure(size_t repetitions, const std::function<void()>& body)
+{
+    using Clock = std::chrono::steady_clock;
+    body();
+    std::vector<double> times;
+    for (size_t k = 0; k < repetitions; k++)
+    {
+        const auto begin = Clock::now();
+        body();
+        times.push_back(std::chrono::duration<double>(Clock::now() - begin).count());
+    }
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+size_t scaled(const BenchConfig& config, size_t count)
+{
+    return std::max<size_t>(1, static_cast<size_t>(count * config.scale));
+}
+
+/**
+ * Two-channel loopback of the chirp, delayed by a fixed number of frames
+ */
+std::vector<float> makeLoopback(const ChirpSignal& chirp, size_t numPeriods, size_t delay)
+{
+    const size_t period = chirp.size();
+    std::vector<float> samples(numPeriods * period * 2);
+    for (size_t n = 0; n < numPeriods * period; n++)
+    {
+        samples[2 * n] = chirp.data()[n % period];
+        samples[2 * n + 1] = chirp.data()[(n + period - delay % period) % period];
+    }
+    return samples;
+}
+
+/**
+ * LatencyTester::process() at a typical buffer size, recording included
+ */
+std::vector<BenchResult> benchProcess(const BenchConfig& config)
+{
+    constexpr size_t kBufferSize = 64;
+    const size_t numCycles = scaled(config, 20000);
+
+    std::vector<BenchResult> results;
+    for (auto layout : {StimulusLayout::Passthrough, StimulusLayout::Matrix})
+    {
+        for (size_t channels : {2, 4, 8, 16})
+        {
+            RecordingInfo info;
+            info.sampleRate = 48e3;
+            info.numChannels = channels;
+            info.numOutputs = channels;
+            info.layout = layout;
+            info.period = kDefaultChirpPeriod;
+            info.bufferSize = kBufferSize;
+            info.deviceUID = "bench";
+
+            std::vector<float> in(kBufferSize * channels, 0.25f);
+            std::vector<float> out(kBufferSize * channels);
+            LatencyTester tester(info, config.workPath.string());
+            tester.prepare(kBufferSize, channels, channels, LatencyModel());
+
+            const double seconds = measure(config.repetitions, [&] {
+                for (size_t k = 0; k < numCycles; k++)
+                {
+                    tester.process(kBufferSize, in.data(), channels, out.data(), channels);
+                }
+            });
+            tester.close();
+
+            BenchResult r;
+            r.name = (layout == StimulusLayout::Passthrough) ? "process_passthrough" : "process_matrix";
+            r.param = std::to_string(channels) + "ch";
+            r.repetitions = config.repetitions;
+            r.seconds = seconds;
+            r.value = static_cast<double>(numCycles * kBufferSize) / seconds / 1e6;
+            r.unit = "Mframes/s";
+            results.push_back(r);
+        }
+    }
+    return results;
+}
+
+/**
+ * LatencyTester::process() cycle times without and with a live view polling its tap
+ *
+ * The view side polls through LiveViewData, as LiveView does, at 1 kHz, far
+ * above any display rate. Mean and 99th percentile cycle times should not
+ * change when it is on; the liveview check of TestCoreAudioLatencyCheck
+ * asserts that for the 99th percentile.
+ */
+std::vector<BenchResult> benchLiveView(const BenchConfig& config)
+{
+    using Clock = std::chrono::steady_clock;
+    constexpr size_t kBufferSize = 64;
+    constexpr size_t kChannels = 2;
+    const size_t numCycles = scaled(config, 20000);
+
+    RecordingInfo info;
+    info.sampleRate = 48e3;
+    info.numChannels = kChannels;
+    info.numOutputs = kChannels;
+    info.period = 4096;
+    info.bufferSize = kBufferSize;
+    info.deviceUID = "bench";
+
+    std::vector<BenchResult> results;
+    for (bool viewOn : {false, true})
+    {
+        const auto &chirp = ChirpSignal::get(info.period);
+        const auto loopback = makeLoopback(chirp, 1, 333);
+        std::vector<float> out(kBufferSize * kChannels);
+        LatencyTester tester(info, config.workPath.string());
+        tester.prepare(kBufferSize, kChannels, kChannels, LatencyModel());
+
+        std::atomic<bool> running{true};
+        std::thread view;
+        if (viewOn)
+        {
+            view = std::thread([&] {
+                LiveViewData data(tester.tap(), info.sampleRate);
+                while (running)
+                {
+                    data.poll();
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+            });
+        }
+
+        std::vector<double> mean, p99;
+        std::vector<double> cycles(numCycles);
+        size_t pos = 0;
+        for (size_t rep = 0; rep <= config.repetitions; rep++)
+        {
+            for (size_t k = 0; k < numCycles; k++)
+            {
+                const auto begin = Clock::now();
+                tester.process(kBufferSize, loopback.data() + pos * kChannels, kChannels, out.data(), kChannels);
+                cycles[k] = std::chrono::duration<double>(Clock::now() - begin).count();
+                pos = (pos + kBufferSize) % (info.period - kBufferSize);
+            }
+            if (rep == 0)
+            {
+                continue;   // warm-up
+            }
+            double sum = 0;
+            for (auto t : cycles)
+            {
+                sum += t;
+            }
+            mean.push_back(sum / numCycles);
+            std::nth_element(cycles.begin(), cycles.begin() + numCycles * 99 / 100, cycles.end());
+            p99.push_back(cycles[numCycles * 99 / 100]);
+        }
+        running = false;
+        if (view.joinable())
+        {
+            view.join();
+        }
+        tester.close();
+
+        for (auto [name, times] : {std::pair<const char*, std::vector<double>*>{"process_live_view_mean", &mean},
+                                   std::pair<const char*, std::vector<double>*>{"process_live_view_p99", &p99}})
+        {
+            std::sort(times->begin(), times->end());
+            BenchResult r;
+            r.name = name;
+            r.param = viewOn ? "view_on" : "view_off";
+            r.repetitions = config.repetitions;
+            r.seconds = (*times)[times->size() / 2] * numCycles;
+            r.value = (*times)[times->size() / 2] * 1e6;
+            r.unit = "us/cycle";
+            results.push_back(r);
+        }
+    }
+    return results;
+}
+
+/**
+ * Sample format conversion of device buffers, both directions per format
+ */
+std::vector<BenchResult> benchConvert(const BenchConfig& config)
+{
+    // One 8-channel buffer of 512 frames, as an I/O cycle of a larger interface
+    constexpr size_t kSamples = 512 * 8;
+    const size_t numBuffers = scaled(config, 20000);
+    std::vector<float> samples(kSamples);
+    for (size_t n = 0; n < kSamples; n++)
+    {
+        samples[n] = 0.9f * static_cast<float>(std::sin(0.01 * n));
+    }
+    std::vector<float> floats(kSamples);
+    std::vector<uint8_t> device(kSamples * sizeof(float));
+
+    std::vector<BenchResult> results;
+    for (auto format : {SampleFormat::Int16, SampleFormat::Int24, SampleFormat::Int32})
+    {
+        const double fromSeconds = measure(config.repetitions, [&] {
+            for (size_t k = 0; k < numBuffers; k++)
+            {
+                convertFromFloat(format, samples.data(), device.data(), kSamples);
+            }
+        });
+        const double toSeconds = measure(config.repetitions, [&] {
+            for (size_t k = 0; k < numBuffers; k++)
+            {
+                convertToFloat(format, device.data(), floats.data(), kSamples);
+            }
+        });
+
+        BenchResult r;
+        r.name = "convert_from_float";
+        r.param = sampleFormatName(format);
+        r.repetitions = config.repetitions;
+        r.seconds = fromSeconds;
+        r.value = static_cast<double>(numBuffers * kSamples) / fromSeconds / 1e6;
+        r.unit = "Msamples/s";
+        results.push_back(r);
+
+        r.name = "convert_to_float";
+        r.seconds = toSeconds;
+        r.value = static_cast<double>(numBuffers * kSamples) / toSeconds / 1e6;
+        results.push_back(r);
+    }
+    return results;
+}
+
+/**
+ * RecordingWriter from write() to the file closed on disk
+ */
+std::vector<BenchResult> benchWriter(const BenchConfig& config)
+{
+    constexpr size_t kChannels = 2;
+    constexpr size_t kBlock = 64 * kChannels;
+    const size_t numBlocks = scaled(config, 50000);
+    const std::vector<float> block(kBlock, 0.5f);
+    const auto filename = config.workPath / "writer.tcal";
+
+    RecordingInfo info;
+    info.sampleRate = 48e3;
+    info.numChannels = kChannels;
+    info.period = kDefaultChirpPeriod;
+    info.bufferSize = kBlock / kChannels;
+
+    uint64_t written = 0;
+    const double seconds = measure(config.repetitions, [&] {
+        RecordingWriter writer(filename, info);
+        for (size_t k = 0; k < numBlocks; k++)
+        {
+            // Retry instead of dropping, so the disk and not the queue is measured
+            while (!writer.write(block.data(), block.size()))
+            {
+                std::this_thread::yield();
+            }
+        }
+        writer.close();
+        written = writer.writtenSamples();
+    });
+    std::filesystem::remove(filename);
+
+    BenchResult r;
+    r.name = "recording_writer";
+    r.param = std::to_string(kChannels) + "ch";
+    r.repetitions = config.repetitions;
+    r.seconds = seconds;
+    r.value = static_cast<double>(written * sizeof(float)) / seconds / (1 << 20);
+    r.unit = "MiB/s";
+    return {r};
+}
+
+/**
+ * Online LatencyTracker and offline LatencyAnalyzer, per stimulus period
+ */
+std::vector<BenchResult> benchEstimators(const BenchConfig& config)
+{
+    std::vector<BenchResult> results;
+    for (size_t period : {4096, 8192, 16384})
+    {
+        const size_t numPeriods = scaled(config, 64);
+        const auto &chirp = ChirpSignal::get(period);
+        const auto samples = makeLoopback(chirp, numPeriods + 2, 333);
+
+        const double trackerSeconds = measure(config.repetitions, [&] {
+            LatencyTracker tracker(period, 48e3);
+            tracker.addSamples(samples.data(), samples.size());
+        });
+        const double analyzerSeconds = measure(config.repetitions, [&] {
+            LatencyAnalyzer analyzer(period, 48e3);
+            analyzer.addSamples(samples.data(), samples.size() / 2);
+            analyzer.result();
+        });
+
+        for (auto [name, seconds] : {std::pair<const char*, double>{"latency_tracker", trackerSeconds},
+                                     std::pair<const char*, double>{"latency_analyzer", analyzerSeconds}})
+        {
+            BenchResult r;
+            r.name = name;
+            r.param = std::to_string(period);
+            r.repetitions = config.repetitions;
+            r.seconds = seconds;
+            r.value = seconds / static_cast<double>(numPeriods) * 1e6;
+            r.unit = "us/period";
+            results.push_back(r);
+        }
+    }
+    return results;
+}
+
+/**
+ * Offline analysis of a recording file, streamed and on 1..N threads
+ */
+std::vector<BenchResult> benchAnalysis(const BenchConfig& config)
+{
+    constexpr size_t kPeriod = 8192;
+    const size_t numPeriods = scaled(config, 1024);
+    const auto &chirp = ChirpSignal::get(kPeriod);
+    const auto filename = config.workPath / "analysis.tcal";
+    {
+        RecordingInfo info;
+        info.sampleRate = 48e3;
+        info.numChannels = 2;
+        info.period = kPeriod;
+        const auto samples = makeLoopback(chirp, numPeriods + 2, 333);
+        RecordingFileWriter writer(filename, info);
+        writer.write(samples.data(), samples.size());
+        writer.close();
+    }
+
+    std::vector<std::pair<std::string, std::function<void()>>> runs = {
+        {"streamed", [&] {analyzeRecording(filename);}},
+    };
+    const size_t maxThreads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    for (size_t threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        runs.emplace_back(std::to_string(threads) + "t", [&filename, threads] {analyzeRecordingParallel(filename, threads);});
+    }
+    if ((maxThreads & (maxThreads - 1)) != 0)
+    {
+        runs.emplace_back(std::to_string(maxThreads) + "t", [&filename, maxThreads] {analyzeRecordingParallel(filename, maxThreads);});
+    }
+
+    std::vector<BenchResult> results;
+    for (const auto &[param, body] : runs)
+    {
+        BenchResult r;
+        r.name = "recording_analysis";
+        r.param = param;
+        r.repetitions = config.repetitions;
+        r.seconds = measure(config.repetitions, body);
+        r.value = r.seconds / static_cast<double>(numPeriods) * 1e6;
+        r.unit = "us/period";
+        results.push_back(r);
+    }
+    std::filesystem::remove(filename);
+    return results;
+}
+
+/**
+ * DeviceRegistry::devices() against a FakeHAL modelling the HAL round trip
+ */
+std::vector<BenchResult> benchEnumeration(const BenchConfig& config)
+{
+    constexpr auto kCallCost = std::chrono::microseconds(20);
+
+    std::vector<BenchResult> results;
+    for (size_t numDevices : {4, 16, 64})
+    {
+        FakeHAL hal;
+        FakeDeviceSpec spec;
+        spec.inputStreams = {2, 2};
+        spec.outputStreams = {2, 2};
+        for (size_t k = 0; k < numDevices; k++)
+        {
+            hal.addDevice(spec);
+        }
+        hal.setCallCost(kCallCost);
+
+        uint64_t coldCalls = 0;
+        const double cold = measure(config.repetitions, [&] {
+            DeviceRegistry registry(hal);
+            hal.resetCalls();
+            registry.devices();
+            coldCalls = hal.numCalls();
+        });
+
+        DeviceRegistry registry(hal);
+        registry.devices();
+        const size_t numWarm = scaled(config, 100);
+        const double warm = measure(config.repetitions, [&] {
+            for (size_t k = 0; k < numWarm; k++)
+            {
+                registry.devices();
+            }
+        }) / static_cast<double>(numWarm);
+
+        BenchResult r;
+        r.name = "enumerate_cold";
+        r.param = std::to_string(numDevices) + "dev";
+        r.repetitions = config.repetitions;
+        r.seconds = cold;
+        r.value = cold * 1e6;
+        r.unit = "us";
+        results.push_back(r);
+
+        r.name = "enumerate_cold_calls";
+        r.value = static_cast<double>(coldCalls);
+        r.unit = "calls";
+        results.push_back(r);
+
+        r.name = "enumerate_warm";
+        r.seconds = warm;
+        r.value = warm * 1e6;
+        r.unit = "us";
+        results.push_back(r);
+    }
+    return results;
+}
+
+/**
+ * Counts callbacks and keeps the time of the first one since arm()
+ */
+class CallbackProbe : public AudioProcessor
+{
+public:
+    void arm()
+    {
+        count_.store(0, std::memory_order_relaxed);
+        first_.store(0, std::memory_order_release);
+    }
+
+    void process(size_t numSamples, const float *inSamples, size_t inChannels, float *outSamples, size_t outChannels) override
+    {
+        (void)numSamples;
+        (void)inSamples;
+        (void)inChannels;
+        (void)outSamples;
+        (void)outChannels;
+        if (count_.fetch_add(1, std::memory_order_relaxed) == 0)
+        {
+            first_.store(CallbackStats::now(), std::memory_order_release);
+        }
+    }
+
+    uint64_t count() const {return count_.load(std::memory_order_relaxed);}
+    uint64_t first() const {return first_.load(std::memory_order_acquire);}
+
+private:
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> first_{0};
+};
+
+/**
+ * Start() to the first callback and Stop() until it returned, over many cycles
+ *
+ * Each cycle runs for a few callbacks. Callbacks arriving after Stop() returned
+ * are counted as late; there should be none.
+ */
+std::vector<BenchResult> benchCycles(AudioBackend& backend, CallbackProbe& probe, const std::string& device, size_t numCycles)
+{
+    constexpr uint64_t kCallbacksPerCycle = 4;
+    constexpr auto kTimeout = std::chrono::seconds(2);
+    using Clock = std::chrono::steady_clock;
+
+    std::string error;
+    QObject::connect(&backend, &AudioBackend::error, [&](const QString& msg) {
+        error = msg.toStdString();
+    });
+
+    std::vector<double> startTimes;
+    std::vector<double> stopTimes;
+    uint64_t late = 0;
+    for (size_t k = 0; k < numCycles; k++)
+    {
+        probe.arm();
+        const auto begin = CallbackStats::now();
+        backend.Start();
+        const auto deadline = Clock::now() + kTimeout;
+        while ((probe.count() < kCallbacksPerCycle) && error.empty())
+        {
+            if (Clock::now() > deadline)
+            {
+                throw std::runtime_error("No callbacks after Start() on " + device);
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        if (!error.empty())
+        {
+            throw std::runtime_error(device + ": " + error);
+        }
+        startTimes.push_back(static_cast<double>(probe.first() - begin) * 1e-9);
+
+        const auto stopBegin = CallbackStats::now();
+        backend.Stop();
+        stopTimes.push_back(static_cast<double>(CallbackStats::now() - stopBegin) * 1e-9);
+        const uint64_t stopped = probe.count();
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        late += probe.count() - stopped;
+        backend.pumpEvents();
+    }
+
+    std::vector<BenchResult> results;
+    const auto add = [&](const char *name, std::vector<double>& times) {
+        std::sort(times.begin(), times.end());
+        for (const auto& [label, q] : {std::make_pair("p50", 0.5), std::make_pair("p99", 0.99)})
+        {
+            BenchResult r;
+            r.name = name;
+            r.param = device + "_" + label;
+            r.repetitions = numCycles;
+            r.seconds = times[std::min(times.size() - 1, static_cast<size_t>(q * times.size()))];
+            r.value = r.seconds * 1e6;
+            r.unit = "us";
+            results.push_back(r);
+        }
+    };
+    add("start_first_callback", startTimes);
+    add("stop_quiescent", stopTimes);
+
+    BenchResult r;
+    r.name = "stop_late_callbacks";
+    r.param = device;
+    r.repetitions = numCycles;
+    r.value = static_cast<double>(late);
+    r.unit = "callbacks";
+    results.push_back(r);
+    return results;
+}
+
+/**
+ * Start/Stop cycles of the simulated device and, with --device, of a real one,
+ * and StreamConfigurator on a FakeHAL with 20 us per call: first configuration
+ * with a cold registry, restart with the same configuration, and restart with
+ * the buffer size changing every time
+ */
+std::vector<BenchResult> benchStartStop(const BenchConfig& config)
+{
+    constexpr auto kCallCost = std::chrono::microseconds(20);
+    const size_t numCycles = scaled(config, 200);
+
+    CallbackProbe probe;
+    SimulatedDeviceConfig sim;
+    SimulatedDevice device(probe, sim);
+    auto results = benchCycles(device, probe, "sim", numCycles);
+
+#ifdef __APPLE__
+    if (!config.deviceUID.empty())
+    {
+        const auto devices = getDevices();
+        auto it = std::find_if(devices.begin(), devices.end(), [&config](const DeviceInfo& dev) {
+            return dev.deviceUID.toStdString() == config.deviceUID;
+        });
+        if (it == devices.end())
+        {
+            throw std::runtime_error("Device not found: " + config.deviceUID);
+        }
+        CoreAudioQt backend(probe, it->id, it->sampleRate);
+        const auto r = benchCycles(backend, probe, "hw", numCycles);
+        results.insert(results.end(), r.begin(), r.end());
+    }
+#endif
+
+    FakeHAL hal;
+    FakeDeviceSpec spec;
+    spec.inputStreams = {2, 2};
+    spec.outputStreams = {2, 2};
+    const auto deviceID = hal.addDevice(spec);
+    hal.setCallCost(kCallCost);
+    StreamRequest request;
+    request.sampleRate = spec.sampleRate;
+    request.bufferSize = 64;
+
+    uint64_t coldCalls = 0;
+    const double cold = measure(config.repetitions, [&] {
+        DeviceRegistry registry(hal);
+        StreamConfigurator configurator(registry, deviceID);
+        hal.resetCalls();
+        configurator.apply(request);
+        coldCalls = hal.numCalls();
+    });
+
+    DeviceRegistry registry(hal);
+    StreamConfigurator configurator(registry, deviceID);
+    configurator.apply(request);
+    const size_t numRestarts = scaled(config, 100);
+    hal.resetCalls();
+    const double restart = measure(config.repetitions, [&] {
+        for (size_t k = 0; k < numRestarts; k++)
+        {
+            configurator.apply(request);
+        }
+    }) / static_cast<double>(numRestarts);
+    const double restartCalls = static_cast<double>(hal.numCalls()) / static_cast<double>((config.repetitions + 1) * numRestarts);
+
+    const size_t numChanges = scaled(config, 20);
+    hal.resetCalls();
+    const double change = measure(config.repetitions, [&] {
+        for (size_t k = 0; k < numChanges; k++)
+        {
+            request.bufferSize = (request.bufferSize == 64) ? 128 : 64;
+            configurator.apply(request);
+        }
+    }) / static_cast<double>(numChanges);
+    const double changeCalls = static_cast<double>(hal.numCalls()) / static_cast<double>((config.repetitions + 1) * numChanges);
+
+    for (const auto& [name, seconds, calls] : {std::make_tuple("configure_cold", cold, static_cast<double>(coldCalls)),
+                                               std::make_tuple("configure_restart", restart, restartCalls),
+                                               std::make_tuple("configure_change", change, changeCalls)})
+    {
+        BenchResult r;
+        r.name = name;
+        r.param = "fake";
+        r.repetitions = config.repetitions;
+        r.seconds = seconds;
+        r.value = seconds * 1e6;
+        r.unit = "us";
+        results.push_back(r);
+
+        r.name = std::string(name) + "_calls";
+        r.value = calls;
+        r.unit = "calls";
+        results.push_back(r);
+    }
+    return results;
+}
+
+void printTable(std::ostream& os, const std::vector<BenchResult>& results)
+{
+    os << std::left << std::setw(24) << "benchmark"
+       << std::setw(10) << "param"
+       << std::right << std::setw(14) << "value"
+       << "  unit" << std::endl;
+    for (const auto& r : results)
+    {
+        os << std::left << std::setw(24) << r.name
+           << std::setw(10) << r.param
+           << std::right << std::fixed << std::setprecision(3) << std::setw(14) << r.value
+           << "  " << r.unit << std::endl;
+    }
+}
+
+void printCsv(std::ostream& os, const std::vector<BenchResult>& results)
+{
+    os << "version,benchmark,param,repetitions,median_seconds,value,unit" << std::endl;
+    for (const auto& r : results)
+    {
+        os << std::defaultfloat << std::setprecision(10)
+           << TCAL_VERSION << ','
+           << r.name << ','
+           << r.param << ','
+           << r.repetitions << ','
+           << r.seconds << ','
+           << r.value << ','
+           << r.unit << std::endl;
+    }
+}
+
+}   // anonymous namespace
+
+
+/**
+ * Micro and macro benchmarks of the measurement pipeline
+ *
+ * Usage: TestCoreAudioLatencyBench [--filter <substring>] [--repetitions <n>] [--quick]
+ *        [--work <dir>] [--device <UID>] [--csv <file>]
+ *
+ * Every benchmark reports the median of its repetitions. --quick cuts the work
+ * per repetition to a tenth for a smoke run. The CSV carries the tool version
+ * in every row so results of several releases can be concatenated. --device adds
+ * Start/Stop cycles of that audio device to the startstop benchmark (macOS).
+ */
+int main(int argc, char *argv[])
+{
+    BenchConfig config;
+    config.workPath = std::filesystem::temp_directory_path() / "tcal_bench";
+    std::string filter;
+    std::filesystem::path csvFilename;
+
+    try
+    {
+        for (int k = 1; k < argc; k++)
+        {
+            const std::string arg = argv[k];
+            const bool hasValue = (k + 1 < argc);
+            if (arg == "--quick")
+            {
+                config.scale = 0.1;
+            }
+            else if ((arg == "--filter") && hasValue)
+            {
+                filter = argv[++k];
+            }
+            else if ((arg == "--repetitions") && hasValue)
+            {
+                config.repetitions = std::max<size_t>(1, std::stoul(argv[++k]));
+            }
+            else if ((arg == "--work") && hasValue)
+            {
+                config.workPath = argv[++k];
+            }
+            else if ((arg == "--device") && hasValue)
+            {
+                config.deviceUID = argv[++k];
+            }
+            else if ((arg == "--csv") && hasValue)
+            {
+                csvFilename = argv[++k];
+            }
+            else
+            {
+                throw std::invalid_argument("Unknown argument: " + arg);
+            }
+        }
+        std::filesystem::create_directories(config.workPath);
+
+        const std::pair<const char*, std::function<std::vector<BenchResult>(const BenchConfig&)>> benchmarks[] = {
+            {"process", benchProcess},
+            {"liveview", benchLiveView},
+            {"convert", benchConvert},
+            {"writer", benchWriter},
+            {"estimator", benchEstimators},
+            {"analysis", benchAnalysis},
+            {"enumerate", benchEnumeration},
+            {"startstop", benchStartStop},
+        };
+
+        std::vector<BenchResult> results;
+        for (const auto& [name, bench] : benchmarks)
+        {
+            if (!filter.empty() && (std::string(name).find(filter) == std::string::npos))
+            {
+                continue;
+            }
+            std::cerr << "Running " << name << std::endl;
+            const auto r = bench(config);
+            results.insert(results.end(), r.begin(), r.end());
+        }
+
+        std::cout << "Version: " << TCAL_VERSION << std::endl;
+        printTable(std::cout, results);
+        if (!csvFilename.empty())
+        {
+            std::ofstream file(csvFilename);
+            printCsv(file, results);
+        }
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << "ERROR: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
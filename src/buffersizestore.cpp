@@ -0,0 +1,87 @@
+#include "buffersizestore.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+
+BufferSizeStore::BufferSizeStore(std::filesystem::path filename)
+    : filename_(std::move(filename))
+{
+    std::ifstream file(filename_);
+    std::string line;
+    while (std::getline(file, line))
+    {
+        const auto tab1 = line.find('\t');
+        const auto tab2 = (tab1 == std::string::npos) ? std::string::npos : line.find('\t', tab1 + 1);
+        if ((tab1 == 0) || (tab2 == std::string::npos))
+        {
+            continue;
+        }
+        std::istringstream rate(line.substr(tab1 + 1, tab2 - tab1 - 1));
+        std::istringstream size(line.substr(tab2 + 1));
+        double sampleRate = 0;
+        size_t bufferSize = 0;
+        if ((rate >> sampleRate) && (size >> bufferSize) && (sampleRate > 0) && (bufferSize > 0))
+        {
+            sizes_[key(line.substr(0, tab1), sampleRate)] = bufferSize;
+        }
+    }
+}
+
+std::filesystem::path BufferSizeStore::defaultPath()
+{
+    const char *home = std::getenv("HOME");
+#ifdef __APPLE__
+    const std::filesystem::path base = home ? std::filesystem::path(home) / "Library" / "Application Support" : std::filesystem::path();
+#else
+    const char *config = std::getenv("XDG_CONFIG_HOME");
+    const std::filesystem::path base = (config && *config) ? std::filesystem::path(config) :
+        (home ? std::filesystem::path(home) / ".config" : std::filesystem::path());
+#endif
+    return base / "TestCoreAudioLatency" / "buffersizes.txt";
+}
+
+size_t BufferSizeStore::find(const std::string& deviceUID, double sampleRate) const
+{
+    const auto it = sizes_.find(key(deviceUID, sampleRate));
+    return (it != sizes_.end()) ? it->second : 0;
+}
+
+void BufferSizeStore::set(const std::string& deviceUID, double sampleRate, size_t bufferSize)
+{
+    if (deviceUID.empty() || (deviceUID.find_first_of("\t\n") != std::string::npos))
+    {
+        throw std::invalid_argument("BufferSizeStore: invalid device UID");
+    }
+    sizes_[key(deviceUID, sampleRate)] = bufferSize;
+}
+
+void BufferSizeStore::save() const
+{
+    if (filename_.has_parent_path())
+    {
+        std::filesystem::create_directories(filename_.parent_path());
+    }
+    auto temp = filename_;
+    temp += ".tmp";
+    {
+        std::ofstream file(temp);
+        for (const auto &entry : sizes_)
+        {
+            file << entry.first.first << '\t' << entry.first.second << '\t' << entry.second << '\n';
+        }
+        if (!file.flush())
+        {
+            throw std::runtime_error("Cannot write " + temp.string());
+        }
+    }
+    std::filesystem::rename(temp, filename_);
+}
+
+BufferSizeStore::Key BufferSizeStore::key(const std::string& deviceUID, double sampleRate)
+{
+    return {deviceUID, std::lround(sampleRate)};
+}
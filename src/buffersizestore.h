@@ -0,0 +1,52 @@
+#ifndef BUFFERSIZESTORE_H
+#define BUFFERSIZESTORE_H
+
+#include <filesystem>
+#include <map>
+#include <string>
+#include <utility>
+#include <cstddef>
+
+
+/**
+ * @brief Tuned buffer size per device UID and sample rate, kept in a text file
+ *
+ * One line per entry with the device UID, the sample rate in Hz and the buffer
+ * size in frames, separated by tabs. A missing file is an empty store; lines
+ * that do not parse are skipped. save() replaces the file as a whole, so a
+ * crash never leaves it half written.
+ */
+class BufferSizeStore
+{
+public:
+    explicit BufferSizeStore(std::filesystem::path filename = defaultPath());
+
+    /**
+     * @brief Per-user location: $XDG_CONFIG_HOME or ~/.config on Linux, ~/Library/Application Support on macOS
+     */
+    static std::filesystem::path defaultPath();
+
+    const std::filesystem::path& filename() const {return filename_;}
+
+    /**
+     * @return Stored buffer size, 0 if the device was not tuned at this rate
+     */
+    size_t find(const std::string& deviceUID, double sampleRate) const;
+
+    void set(const std::string& deviceUID, double sampleRate, size_t bufferSize);
+
+    /**
+     * @brief Write all entries, creating the directory if needed
+     */
+    void save() const;
+
+private:
+    using Key = std::pair<std::string, long>;
+
+    static Key key(const std::string& deviceUID, double sampleRate);
+
+    const std::filesystem::path filename_;
+    std::map<Key, size_t> sizes_;
+};
+
+#endif // BUFFERSIZESTORE_H
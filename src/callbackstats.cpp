@@ -0,0 +1,260 @@
+#include "callbackstats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <iomanip>
+#include <limits>
+#include <stdexcept>
+
+
+double HistogramSnapshot::binUpperEdge(size_t bin) const
+{
+    const size_t numBins = counts.size() - 2;
+    if (bin == 0)
+    {
+        return minValue;
+    }
+    if (bin > numBins)
+    {
+        return max;
+    }
+    if (logarithmic)
+    {
+        return minValue * std::pow(maxValue / minValue, static_cast<double>(bin) / numBins);
+    }
+    return minValue + (maxValue - minValue) * bin / numBins;
+}
+
+double HistogramSnapshot::percentile(double q) const
+{
+    if (count == 0)
+    {
+        return 0.0;
+    }
+    const double target = std::clamp(q, 0.0, 1.0) * count;
+    uint64_t cumulative = 0;
+    for (size_t bin = 0; bin < counts.size(); bin++)
+    {
+        cumulative += counts[bin];
+        if ((cumulative > 0) && (cumulative >= target))
+        {
+            return std::min(binUpperEdge(bin), max);
+        }
+    }
+    return max;
+}
+
+HistogramSnapshot HistogramSnapshot::since(const HistogramSnapshot& earlier) const
+{
+    HistogramSnapshot delta = *this;
+    if (earlier.counts.size() != counts.size())
+    {
+        return delta;
+    }
+    for (size_t bin = 0; bin < counts.size(); bin++)
+    {
+        delta.counts[bin] -= std::min(counts[bin], earlier.counts[bin]);
+    }
+    delta.count -= std::min(count, earlier.count);
+    delta.sum -= earlier.sum;
+    return delta;
+}
+
+
+AtomicHistogram::AtomicHistogram(double minValue, double maxValue, size_t numBins, bool logarithmic)
+    : minValue_(minValue)
+    , maxValue_(maxValue)
+    , numBins_(numBins)
+    , logarithmic_(logarithmic)
+    , scale_(logarithmic ? (numBins / std::log(maxValue / minValue)) : (numBins / (maxValue - minValue)))
+    , bins_(new std::atomic<uint64_t>[numBins + 2])
+{
+    if ((numBins == 0) || (maxValue <= minValue) || (logarithmic && (minValue <= 0)))
+    {
+        throw std::invalid_argument("AtomicHistogram: invalid range");
+    }
+    reset();
+}
+
+size_t AtomicHistogram::binIndex(double value) const
+{
+    if (!(value >= minValue_))
+    {
+        return 0;
+    }
+    if (value >= maxValue_)
+    {
+        return numBins_ + 1;
+    }
+    const double pos = logarithmic_ ? (std::log(value / minValue_) * scale_) : ((value - minValue_) * scale_);
+    return std::min(static_cast<size_t>(pos), numBins_ - 1) + 1;
+}
+
+void AtomicHistogram::add(double value)
+{
+    bins_[binIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    // Single writer, so load + store is enough
+    sum_.store(sum_.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    if ((count_.load(std::memory_order_relaxed) == 0) || (value > max_.load(std::memory_order_relaxed)))
+    {
+        max_.store(value, std::memory_order_relaxed);
+    }
+    count_.fetch_add(1, std::memory_order_release);
+}
+
+HistogramSnapshot AtomicHistogram::snapshot() const
+{
+    HistogramSnapshot s;
+    s.minValue = minValue_;
+    s.maxValue = maxValue_;
+    s.logarithmic = logarithmic_;
+    s.count = count_.load(std::memory_order_acquire);
+    s.sum = sum_.load(std::memory_order_relaxed);
+    s.max = max_.load(std::memory_order_relaxed);
+    s.counts.resize(numBins_ + 2);
+    for (size_t k = 0; k < s.counts.size(); k++)
+    {
+        s.counts[k] = bins_[k].load(std::memory_order_relaxed);
+    }
+    return s;
+}
+
+void AtomicHistogram::reset()
+{
+    for (size_t k = 0; k < numBins_ + 2; k++)
+    {
+        bins_[k].store(0, std::memory_order_relaxed);
+    }
+    count_.store(0, std::memory_order_relaxed);
+    sum_.store(0, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+}
+
+
+CallbackStats::CallbackStats()
+    : interval_(1.0, 1e6, 96, true)      // 1 us .. 1 s
+    , duration_(0.1, 1e6, 112, true)     // 100 ns .. 1 s
+    , budget_(0.0, 200.0, 100, false)    // 2 % bins
+{
+}
+
+void CallbackStats::reset(double sampleRate)
+{
+    sampleRate_.store(sampleRate, std::memory_order_relaxed);
+    numCycles_.store(0, std::memory_order_relaxed);
+    deadlineMisses_.store(0, std::memory_order_relaxed);
+    discontinuities_.store(0, std::memory_order_relaxed);
+    missedFrames_.store(0, std::memory_order_relaxed);
+    ioSpanCount_.store(0, std::memory_order_relaxed);
+    ioSpanSum_.store(0, std::memory_order_relaxed);
+    ioSpanMin_.store(0, std::memory_order_relaxed);
+    ioSpanMax_.store(0, std::memory_order_relaxed);
+    interval_.reset();
+    duration_.reset();
+    budget_.reset();
+    lastHostTime_ = 0;
+    nextSampleTime_ = -1;
+}
+
+unsigned CallbackStats::addCycle(size_t numFrames, const IOCycleTime &time, uint64_t beginNs, uint64_t endNs)
+{
+    unsigned flags = 0;
+    const uint64_t hostTime = (time.hostTime != 0) ? time.hostTime : beginNs;
+    if ((lastHostTime_ != 0) && (hostTime > lastHostTime_))
+    {
+        interval_.add((hostTime - lastHostTime_) * 1e-3);
+    }
+    lastHostTime_ = hostTime;
+
+    const double durationUs = (endNs - beginNs) * 1e-3;
+    duration_.add(durationUs);
+
+    const double sampleRate = sampleRate_.load(std::memory_order_relaxed);
+    if ((sampleRate > 0) && (numFrames > 0))
+    {
+        const double budget = durationUs * 1e-4 * sampleRate / numFrames;
+        budget_.add(budget);
+        if (budget > 100.0)
+        {
+            deadlineMisses_.fetch_add(1, std::memory_order_relaxed);
+            flags |= kDeadlineMiss;
+        }
+    }
+
+    const double sampleTime = (time.inputSampleTime >= 0) ? time.inputSampleTime :
+                              (time.outputSampleTime >= 0) ? time.outputSampleTime : time.nowSampleTime;
+    if (sampleTime >= 0)
+    {
+        if ((nextSampleTime_ >= 0) && (std::abs(sampleTime - nextSampleTime_) >= 0.5))
+        {
+            discontinuities_.fetch_add(1, std::memory_order_relaxed);
+            flags |= kDiscontinuity;
+            missedFrames_.store(missedFrames_.load(std::memory_order_relaxed) + std::abs(sampleTime - nextSampleTime_), std::memory_order_relaxed);
+        }
+        nextSampleTime_ = sampleTime + numFrames;
+    }
+
+    if ((time.inputSampleTime >= 0) && (time.outputSampleTime >= 0))
+    {
+        const double span = time.outputSampleTime - time.inputSampleTime;
+        const uint64_t count = ioSpanCount_.load(std::memory_order_relaxed);
+        if ((count == 0) || (span < ioSpanMin_.load(std::memory_order_relaxed)))
+        {
+            ioSpanMin_.store(span, std::memory_order_relaxed);
+        }
+        if ((count == 0) || (span > ioSpanMax_.load(std::memory_order_relaxed)))
+        {
+            ioSpanMax_.store(span, std::memory_order_relaxed);
+        }
+        ioSpanSum_.store(ioSpanSum_.load(std::memory_order_relaxed) + span, std::memory_order_relaxed);
+        ioSpanCount_.store(count + 1, std::memory_order_release);
+    }
+
+    numCycles_.fetch_add(1, std::memory_order_release);
+    return flags;
+}
+
+CallbackStats::Snapshot CallbackStats::snapshot() const
+{
+    Snapshot s;
+    s.numCycles = numCycles_.load(std::memory_order_acquire);
+    s.sampleRate = sampleRate_.load(std::memory_order_relaxed);
+    s.deadlineMisses = deadlineMisses_.load(std::memory_order_relaxed);
+    s.discontinuities = discontinuities_.load(std::memory_order_relaxed);
+    s.missedFrames = missedFrames_.load(std::memory_order_relaxed);
+    const uint64_t spans = ioSpanCount_.load(std::memory_order_acquire);
+    s.ioSpan = (spans > 0) ? (ioSpanSum_.load(std::memory_order_relaxed) / spans) : std::numeric_limits<double>::quiet_NaN();
+    s.ioSpanMin = ioSpanMin_.load(std::memory_order_relaxed);
+    s.ioSpanMax = ioSpanMax_.load(std::memory_order_relaxed);
+    s.interval = interval_.snapshot();
+    s.duration = duration_.snapshot();
+    s.budget = budget_.snapshot();
+    return s;
+}
+
+std::string CallbackStats::Snapshot::summary() const
+{
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(1)
+       << "cycles " << numCycles
+       << ", interval mean " << interval.mean() << " us, p99 " << interval.percentile(0.99) << " us, max " << interval.max << " us"
+       << ", duration mean " << duration.mean() << " us, p99 " << duration.percentile(0.99) << " us, max " << duration.max << " us"
+       << ", budget p99 " << budget.percentile(0.99) << " %, max " << budget.max << " %"
+       << ", deadline misses " << deadlineMisses
+       << ", xruns " << discontinuities << " (" << missedFrames << " frames)";
+    return ss.str();
+}
+
+CallbackStats::Snapshot CallbackStats::Snapshot::since(const Snapshot& earlier) const
+{
+    Snapshot s = *this;
+    s.numCycles -= std::min(numCycles, earlier.numCycles);
+    s.deadlineMisses -= std::min(deadlineMisses, earlier.deadlineMisses);
+    s.discontinuities -= std::min(discontinuities, earlier.discontinuities);
+    s.missedFrames -= earlier.missedFrames;
+    s.interval = interval.since(earlier.interval);
+    s.duration = duration.since(earlier.duration);
+    s.budget = budget.since(earlier.budget);
+    return s;
+}
@@ -0,0 +1,182 @@
+#ifndef CALLBACKSTATS_H
+#define CALLBACKSTATS_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+
+/**
+ * @brief Timestamps of one I/O cycle as reported by the device
+ *
+ * Sample times are in frames on the device clock and negative if unknown.
+ */
+struct IOCycleTime
+{
+    uint64_t hostTime{0};           ///< Wake-up time of the cycle in nanoseconds, 0 if unknown
+    double nowSampleTime{-1};
+    double inputSampleTime{-1};     ///< Capture time of the first input frame
+    double outputSampleTime{-1};    ///< Presentation time of the first output frame
+};
+
+
+struct HistogramSnapshot
+{
+    double minValue{0};
+    double maxValue{0};
+    bool logarithmic{false};
+    std::vector<uint64_t> counts;   ///< Bin 0 collects underflow, the last bin overflow
+    uint64_t count{0};
+    double sum{0};
+    double max{0};
+
+    double mean() const {return (count > 0) ? (sum / count) : 0.0;}
+
+    /**
+     * @brief Upper edge of the bin holding the q-quantile, 0 <= q <= 1
+     */
+    double percentile(double q) const;
+    double binUpperEdge(size_t bin) const;
+
+    /**
+     * @brief Values added after the earlier snapshot of the same histogram; max stays the overall maximum
+     */
+    HistogramSnapshot since(const HistogramSnapshot& earlier) const;
+};
+
+
+/**
+ * @brief Fixed-bin histogram with a single wait-free writer
+ *
+ * add() only does relaxed atomic stores and increments, so it is safe on the
+ * audio I/O thread while any other thread takes snapshots. A snapshot taken
+ * during an update may be off by that one value.
+ */
+class AtomicHistogram
+{
+public:
+    /**
+     * @brief Constructor
+     * @param minValue Lower edge of the first regular bin, > 0 if logarithmic
+     * @param maxValue Upper edge of the last regular bin
+     * @param numBins Number of regular bins, plus one underflow and one overflow bin
+     * @param logarithmic Space bins evenly in log(value)
+     */
+    AtomicHistogram(double minValue, double maxValue, size_t numBins, bool logarithmic);
+
+    void add(double value);
+    HistogramSnapshot snapshot() const;
+
+    /**
+     * @brief Zero all bins, not concurrently with add()
+     */
+    void reset();
+
+private:
+    size_t binIndex(double value) const;
+
+    const double minValue_;
+    const double maxValue_;
+    const size_t numBins_;
+    const bool logarithmic_;
+    const double scale_;
+    std::unique_ptr<std::atomic<uint64_t>[]> bins_;
+    std::atomic<uint64_t> count_{0};
+    std::atomic<double> sum_{0};
+    std::atomic<double> max_{0};
+};
+
+
+/**
+ * @brief Timing of the audio I/O callbacks
+ *
+ * Records, per cycle, the host-time interval since the previous cycle, the time
+ * spent in the processor, that time as a percentage of the buffer period and
+ * jumps of the device sample time, which mean the device skipped or repeated
+ * frames (an xrun). A cycle using more than its whole buffer period counts as a
+ * deadline miss. The span between output and input sample time, the buffering
+ * the HAL schedules between capture and presentation, is averaged for the
+ * latency model. addCycle() is called from the I/O thread only; snapshot() from
+ * any other thread.
+ */
+class CallbackStats
+{
+public:
+    struct Snapshot
+    {
+        double sampleRate{0};
+        uint64_t numCycles{0};
+        uint64_t deadlineMisses{0};     ///< Cycles with a budget above 100 %
+        uint64_t discontinuities{0};    ///< Sample time jumps
+        double missedFrames{0};         ///< Sum of the sample time jumps
+        double ioSpan{0};               ///< Mean output minus input sample time, NaN if not reported
+        double ioSpanMin{0};
+        double ioSpanMax{0};
+        HistogramSnapshot interval;     ///< Microseconds between cycle wake-ups
+        HistogramSnapshot duration;     ///< Microseconds spent in the processor
+        HistogramSnapshot budget;       ///< Duration in percent of the buffer period
+
+        std::string summary() const;
+
+        /**
+         * @brief Cycles after the earlier snapshot; ioSpan and the maxima stay overall figures
+         */
+        Snapshot since(const Snapshot& earlier) const;
+    };
+
+    // Flags returned by addCycle()
+    static constexpr unsigned kDeadlineMiss = 1;
+    static constexpr unsigned kDiscontinuity = 2;
+
+    CallbackStats();
+
+    /**
+     * @brief Clear all counters, call before the device starts
+     */
+    void reset(double sampleRate);
+
+    /**
+     * @brief Account one I/O cycle
+     * @param numFrames
+     * @param time Device timestamps of the cycle
+     * @param beginNs now() before the processor was called
+     * @param endNs now() after it returned
+     * @return kDeadlineMiss and/or kDiscontinuity if the cycle was one
+     */
+    unsigned addCycle(size_t numFrames, const IOCycleTime &time, uint64_t beginNs, uint64_t endNs);
+
+    Snapshot snapshot() const;
+
+    /**
+     * @brief Monotonic time in nanoseconds
+     */
+    static uint64_t now()
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+private:
+    std::atomic<double> sampleRate_{0};
+    std::atomic<uint64_t> numCycles_{0};
+    std::atomic<uint64_t> deadlineMisses_{0};
+    std::atomic<uint64_t> discontinuities_{0};
+    std::atomic<double> missedFrames_{0};
+    std::atomic<uint64_t> ioSpanCount_{0};
+    std::atomic<double> ioSpanSum_{0};
+    std::atomic<double> ioSpanMin_{0};
+    std::atomic<double> ioSpanMax_{0};
+    AtomicHistogram interval_;
+    AtomicHistogram duration_;
+    AtomicHistogram budget_;
+
+    // Touched by the I/O thread only
+    uint64_t lastHostTime_{0};
+    double nextSampleTime_{-1};
+};
+
+#endif // CALLBACKSTATS_H
@@ -0,0 +1,628 @@
+#include "chirp.h"
+#include "deviceregistry.h"
+#include "fakehal.h"
+#include "fft.h"
+#include "latencyanalyzer.h"
+#include "latencytester.h"
+#include "latencytracker.h"
+#include "parallelanalyzer.h"
+#include "recordingfile.h"
+#include "recordingwriter.h"
+#include "workerpool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+
+namespace {
+
+/**
+ * Collects the failed expectations of one check
+ */
+class Checker
+{
+public:
+    explicit Checker(double seconds)
+        : seconds_{seconds}
+    {
+    }
+
+    void expect(bool condition, const std::string& what)
+    {
+        if (!condition)
+        {
+            failures_.push_back(what);
+        }
+    }
+
+    /**
+     * @brief Run time of the timed scenarios
+     */
+    double seconds() const {return seconds_;}
+
+    const std::vector<std::string>& failures() const {return failures_;}
+
+private:
+    const double seconds_;
+    std::vector<std::string> failures_;
+};
+
+template<typename T>
+std::string str(const T& value)
+{
+    std::ostringstream ss;
+    ss << value;
+    return ss.str();
+}
+
+
+/**
+ * Keeps everything the writer drains, optionally stalling like a slow disk
+ */
+class CaptureSink : public RecordingSink
+{
+public:
+    CaptureSink(std::vector<float>& samples, std::vector<size_t>& dropouts, std::chrono::microseconds stall)
+        : samples_(samples)
+        , dropouts_(dropouts)
+        , stall_(stall)
+    {
+    }
+
+    void write(const float *samples, size_t count) override
+    {
+        samples_.insert(samples_.end(), samples, samples + count);
+        if (stall_.count() > 0)
+        {
+            std::this_thread::sleep_for(stall_);
+        }
+    }
+
+    void markDropout() override
+    {
+        dropouts_.push_back(samples_.size());
+    }
+
+    void close() override
+    {
+    }
+
+private:
+    std::vector<float> &samples_;
+    std::vector<size_t> &dropouts_;
+    const std::chrono::microseconds stall_;
+};
+
+/**
+ * Push 32-frame stereo blocks at 48 kHz into a RecordingWriter and compare
+ * what its sink received with what was accepted
+ *
+ * Every sample carries its running index, so the sink must see exactly the
+ * accepted blocks in order. The writer's overrun count must equal the
+ * rejected write() calls, and every run of rejected blocks must have been
+ * reported to the sink exactly once, between the samples around it.
+ */
+void ringBufferScenario(Checker& checker, const std::string& name, std::chrono::microseconds stall, size_t capacity,
+                        bool usePool, bool expectOverruns)
+{
+    constexpr size_t kFrames = 32;
+    constexpr size_t kChannels = 2;
+    constexpr size_t kBlock = kFrames * kChannels;
+    constexpr double kSampleRate = 48e3;
+    // Indices stay exact in float up to 2^24
+    constexpr size_t kMaxSamples = size_t(1) << 24;
+    using Clock = std::chrono::steady_clock;
+
+    const size_t numBlocks = std::min(static_cast<size_t>(checker.seconds() * kSampleRate / kFrames), kMaxSamples / kBlock);
+    std::vector<float> received;
+    std::vector<size_t> dropouts;
+    received.reserve(numBlocks * kBlock);
+    std::vector<bool> accepted(numBlocks, false);
+    uint64_t rejected = 0;
+
+    std::unique_ptr<WorkerPool> pool;
+    if (usePool)
+    {
+        pool = std::make_unique<WorkerPool>(1);
+    }
+    RecordingWriter writer(std::make_unique<CaptureSink>(received, dropouts, stall), RecordingWriter::Listener(),
+                           capacity, pool.get());
+
+    // The producer runs on its own thread, paced by the sample clock like an I/O thread
+    std::thread producer([&] {
+        std::vector<float> block(kBlock);
+        const auto period = std::chrono::duration<double>(kFrames / kSampleRate);
+        const auto start = Clock::now();
+        for (size_t b = 0; b < numBlocks; b++)
+        {
+            std::this_thread::sleep_until(start + std::chrono::duration_cast<Clock::duration>(period * b));
+            for (size_t k = 0; k < kBlock; k++)
+            {
+                block[k] = static_cast<float>(b * kBlock + k);
+            }
+            accepted[b] = writer.write(block.data(), block.size());
+            rejected += accepted[b] ? 0 : 1;
+        }
+    });
+    producer.join();
+    writer.close();
+
+    const std::string prefix = name + ": ";
+    checker.expect(writer.overruns() == rejected, prefix + "overruns " + str(writer.overruns()) + ", rejected writes " + str(rejected));
+    checker.expect(writer.droppedSamples() == rejected * kBlock, prefix + "dropped samples " + str(writer.droppedSamples()));
+    checker.expect(writer.writtenSamples() == received.size(), prefix + "written samples " + str(writer.writtenSamples())
+                   + ", received " + str(received.size()));
+    checker.expect(expectOverruns ? (rejected > 0) : (rejected == 0), prefix + str(rejected) + " overrun(s) with a "
+                   + (expectOverruns ? "stalled" : "fast") + " consumer");
+
+    // Sample integrity, and one dropout mark right after the last sample before every gap
+    size_t pos = 0;
+    size_t gaps = 0;
+    bool gap = false;
+    bool intact = true;
+    const auto expectMark = [&](const std::string& where) {
+        const bool marked = (gaps < dropouts.size()) && (dropouts[gaps] == pos);
+        checker.expect(marked, prefix + "gap " + where + " marked at "
+                       + ((gaps < dropouts.size()) ? str(dropouts[gaps]) : std::string("none")) + " instead of " + str(pos));
+        gaps++;
+        gap = false;
+    };
+    for (size_t b = 0; (b < numBlocks) && intact; b++)
+    {
+        if (!accepted[b])
+        {
+            gap = true;
+            continue;
+        }
+        if (gap)
+        {
+            expectMark("before block " + str(b));
+        }
+        for (size_t k = 0; (k < kBlock) && intact; k++, pos++)
+        {
+            intact = (pos < received.size()) && (received[pos] == static_cast<float>(b * kBlock + k));
+        }
+        checker.expect(intact, prefix + "sample mismatch in block " + str(b));
+    }
+    checker.expect(pos == received.size(), prefix + str(received.size() - std::min(pos, received.size())) + " unexpected trailing sample(s)");
+    if (gap && intact)
+    {
+        expectMark("at the end");
+    }
+    checker.expect(!intact || (dropouts.size() == gaps), prefix + str(dropouts.size()) + " dropout marks for " + str(gaps) + " gaps");
+    std::cout << "    " << name << ": " << numBlocks << " blocks, " << rejected << " overrun(s), " << gaps << " gap(s)" << std::endl;
+}
+
+void checkRingBuffer(Checker& checker)
+{
+    // A 1 M sample ring absorbs any scheduling hiccup of the fast consumer
+    ringBufferScenario(checker, "fast_thread", std::chrono::microseconds(0), 1 << 20, false, false);
+    ringBufferScenario(checker, "fast_pool", std::chrono::microseconds(0), 1 << 20, true, false);
+    // 4096 samples hold 43 ms; stalling 30 ms per 1024-sample batch (11 ms of audio) must overrun
+    ringBufferScenario(checker, "stalled_thread", std::chrono::microseconds(30000), 4096, false, true);
+    ringBufferScenario(checker, "stalled_pool", std::chrono::microseconds(30000), 4096, true, true);
+}
+
+
+/**
+ * Interleaved chirp and its loopback, delayed by a fractional number of samples
+ * and scaled by gain, over numPeriods periods
+ */
+std::vector<float> makeLoopback(const ChirpSignal& chirp, size_t numPeriods, double delay, float gain)
+{
+    constexpr double twoPI = 6.283185307179586;
+    const size_t period = chirp.size();
+    const size_t NF = period / 2;
+
+    // Out[k] = gain * Sig[k] * exp(-i 2 pi k delay / N), Hermitian extension as in ChirpSignal
+    std::vector<float> re(period), im(period);
+    for (size_t k = 0; k <= NF; k++)
+    {
+        const double angle = -twoPI * static_cast<double>(k) * delay / static_cast<double>(period);
+        const double c = std::cos(angle);
+        const double s = std::sin(angle);
+        re[k] = static_cast<float>(gain * (chirp.spectrumRe()[k] * c - chirp.spectrumIm()[k] * s));
+        im[k] = static_cast<float>(gain * (chirp.spectrumRe()[k] * s + chirp.spectrumIm()[k] * c));
+    }
+    im[0] = 0;
+    im[NF] = 0;
+    for (size_t k = NF + 1; k < period; k++)
+    {
+        re[k] = re[period - k];
+        im[k] = -im[period - k];
+    }
+    FFT(period).inverse(re.data(), im.data());
+
+    std::vector<float> samples(numPeriods * period * 2);
+    for (size_t n = 0; n < numPeriods * period; n++)
+    {
+        samples[2 * n] = chirp.data()[n % period];
+        samples[2 * n + 1] = re[n % period];
+    }
+    return samples;
+}
+
+/**
+ * The sub-sample delay of an inverted loopback must match the non-inverted one
+ *
+ * Runs LatencyAnalyzer (block and averaged estimates) and LatencyTracker on
+ * synthetic loopbacks with both polarities at fractional delays.
+ */
+void checkPolarity(Checker& checker)
+{
+    constexpr size_t kPeriods = 6;
+    constexpr double kTolerance = 0.05;
+    const auto &chirp = ChirpSignal::get();
+
+    for (double delay : {100.3, 1234.7, 4000.5})
+    {
+        for (float gain : {1.0f, -1.0f, -0.25f})
+        {
+            const std::string prefix = "delay " + str(delay) + ", gain " + str(gain) + ": ";
+            const auto samples = makeLoopback(chirp, kPeriods, delay, gain);
+
+            LatencyAnalyzer analyzer(chirp.size(), 48e3);
+            analyzer.addSamples(samples.data(), samples.size() / 2);
+            const auto result = analyzer.result();
+            checker.expect(std::abs(result.fractionalDelay - delay) < kTolerance,
+                           prefix + "analyzer delay " + str(result.fractionalDelay));
+
+            LatencyTracker tracker(chirp.size(), 48e3);
+            tracker.addSamples(samples.data(), samples.size());
+            const auto estimate = tracker.latest();
+            checker.expect(std::abs(estimate.fractionalDelay - delay) < kTolerance,
+                           prefix + "tracker delay " + str(estimate.fractionalDelay));
+        }
+    }
+}
+
+
+/**
+ * Write a loopback to a recording file in 64-frame blocks like RecordingWriter,
+ * leaving out the given [begin, end) frame ranges and marking a dropout at each
+ * @return Frame positions of the dropouts in the file
+ */
+std::vector<uint64_t> writeWithGaps(const std::filesystem::path& filename, const RecordingInfo& info, const std::vector<float>& samples,
+                                    const std::vector<std::pair<size_t, size_t>>& gaps)
+{
+    constexpr size_t kBlockFrames = 64;
+    RecordingFileWriter file(filename, info, 4);
+    std::vector<uint64_t> positions;
+    uint64_t written = 0;
+    auto gap = gaps.begin();
+    for (size_t frame = 0; frame < samples.size() / 2; frame += kBlockFrames)
+    {
+        if ((gap != gaps.end()) && (frame >= gap->first))
+        {
+            if (frame + kBlockFrames >= gap->second)
+            {
+                positions.push_back(written);
+                file.markDropout();
+                ++gap;
+            }
+            continue;
+        }
+        const size_t count = std::min(kBlockFrames, samples.size() / 2 - frame);
+        file.write(samples.data() + frame * 2, count * 2);
+        written += count;
+    }
+    file.close();
+    return positions;
+}
+
+/**
+ * Dropouts survive the recording file, and both analyzers leave out the periods
+ * with one and still measure the delay, also against a stimulus that they
+ * realign after every gap
+ */
+void checkDropouts(Checker& checker)
+{
+    constexpr size_t kPeriods = 12;
+    constexpr double kTolerance = 0.05;
+    // One gap inside period 3, one inside period 8 of the file; 11 full periods remain,
+    // of which 7 follow the warm-up without a dropout
+    const std::vector<std::pair<size_t, size_t>> gaps = {{29952, 31232}, {70016, 70400}};
+    constexpr size_t kBlocks = 7;
+    const auto filename = std::filesystem::temp_directory_path() / ("TestCoreAudioLatencyCheck-" + str(::getpid()) + ".tcal");
+
+    // With level > 0, the averaged impulse response must peak at it, as it does unless the periods are misaligned
+    const auto check = [&](const std::string& prefix, const RecordingInfo& info, const std::vector<float>& samples, double delay,
+                           float level) {
+        const auto expected = writeWithGaps(filename, info, samples, gaps);
+        {
+            RecordingReader reader(filename);
+            checker.expect(reader.dropouts() == expected, prefix + str(reader.dropouts().size()) + " dropouts read back");
+        }
+        const auto serial = analyzeRecording(filename);
+        const auto parallel = analyzeRecordingParallel(filename, 3);
+        checker.expect(serial.numBlocks == kBlocks, prefix + "analyzer used " + str(serial.numBlocks) + " blocks");
+        checker.expect(parallel.numBlocks == kBlocks, prefix + "parallel analyzer used " + str(parallel.numBlocks) + " blocks");
+        checker.expect(std::abs(serial.fractionalDelay - delay) < kTolerance, prefix + "analyzer delay " + str(serial.fractionalDelay));
+        checker.expect(std::abs(parallel.fractionalDelay - delay) < kTolerance,
+                       prefix + "parallel analyzer delay " + str(parallel.fractionalDelay));
+        if (level > 0)
+        {
+            for (const auto *result : {&serial, &parallel})
+            {
+                const auto &h = result->impulseResponse;
+                const float peak = std::abs(h[findPeak(h.data(), h.size())]);
+                checker.expect(std::abs(peak - level) < 0.05f * level, prefix + "impulse response peaks at " + str(peak));
+            }
+        }
+        std::filesystem::remove(filename);
+    };
+
+    RecordingInfo info;
+    info.sampleRate = 48e3;
+    info.numChannels = 2;
+
+    const auto &chirp = ChirpSignal::get();
+    info.period = chirp.size();
+    info.stimulus = StimulusType::Chirp;
+    check("chirp: ", info, makeLoopback(chirp, kPeriods, 1234.7, 1.0f), 1234.7, 0.0f);
+
+    // The reference input lags the stimulus too, so a gap moves both impulse responses
+    const auto &mls = StimulusSignal::get(StimulusType::Mls);
+    const size_t period = mls.size();
+    std::vector<float> samples(kPeriods * period * 2);
+    for (size_t n = 0; n < kPeriods * period; n++)
+    {
+        samples[2 * n] = mls.data()[(n + period - 50) % period];
+        samples[2 * n + 1] = 0.5f * mls.data()[(n + period - 350) % period];
+    }
+    info.period = period;
+    info.stimulus = StimulusType::Mls;
+    check("mls: ", info, samples, 300.0, 0.5f);
+}
+
+
+/**
+ * DeviceRegistry on a FakeHAL: a cache hit makes no HAL call, and both an
+ * explicit invalidate() and a property change notification cause a refetch
+ */
+void checkRegistry(Checker& checker)
+{
+    FakeHAL hal;
+    FakeDeviceSpec spec;
+    spec.outputStreams = {2, 2};
+    spec.outputLatency = 24;
+    spec.ioCycleUsage = 0.75f;
+    const auto deviceID = hal.addDevice(spec);
+    DeviceRegistry registry(hal);
+
+    const AudioObjectPropertyAddress bufferSize{kAudioDevicePropertyBufferFrameSize, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain};
+    const AudioObjectPropertyAddress ioCycleUsage{kAudioDevicePropertyIOCycleUsage, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain};
+    const auto enumerate = [&] {
+        registry.devices();
+        registry.streamFormats(deviceID, kAudioObjectPropertyScopeOutput);
+        return registry.latencyModel(deviceID);
+    };
+
+    const auto cold = enumerate();
+    checker.expect(hal.numCalls() > 0, "cold enumeration made no HAL call");
+    checker.expect((cold.output.device == spec.outputLatency) && (cold.output.ioCycleUsage == spec.ioCycleUsage),
+                   "latency model does not match the device");
+
+    hal.resetCalls();
+    const uint64_t hits = registry.hits();
+    enumerate();
+    checker.expect(hal.numCalls() == 0, "cache hit made " + str(hal.numCalls()) + " HAL call(s)");
+    checker.expect(registry.hits() > hits, "cache hit not counted");
+
+    // One call per scope the buffer size was read in
+    registry.invalidate(deviceID, kAudioDevicePropertyBufferFrameSize);
+    hal.resetCalls();
+    checker.expect(enumerate().output.bufferFrames == spec.bufferFrameSize, "buffer size after invalidate()");
+    checker.expect(hal.numCalls() == 2, str(hal.numCalls()) + " HAL call(s) after invalidate(), expected 2");
+    hal.resetCalls();
+    enumerate();
+    checker.expect(hal.numCalls() == 0, "refetched value not cached, " + str(hal.numCalls()) + " HAL call(s)");
+
+    // A change notification from the HAL
+    hal.setProperty(deviceID, bufferSize, UInt32(128));
+    hal.setProperty(deviceID, ioCycleUsage, Float32(0.5f));
+    hal.resetCalls();
+    const auto changed = registry.latencyModel(deviceID);
+    checker.expect(hal.numCalls() > 0, "no refetch after a change notification");
+    checker.expect((changed.output.bufferFrames == 128) && (changed.input.bufferFrames == 128),
+                   "buffer size " + str(changed.output.bufferFrames) + " after a change notification");
+    checker.expect(changed.output.ioCycleUsage == 0.5f, "I/O cycle usage " + str(changed.output.ioCycleUsage) + " after a change notification");
+    hal.resetCalls();
+    registry.latencyModel(deviceID);
+    checker.expect(hal.numCalls() == 0, "refetched value not cached, " + str(hal.numCalls()) + " HAL call(s)");
+
+    std::cout << "    " << registry.hits() << " hit(s), " << registry.misses() << " miss(es)" << std::endl;
+}
+
+
+/**
+ * 99th percentile of LatencyTester::process() over a chirp loopback, with or
+ * without a view thread polling its tap like LiveView at 1 kHz
+ */
+double liveViewP99(bool viewOn, size_t numCycles, size_t& numPolls)
+{
+    using Clock = std::chrono::steady_clock;
+    constexpr size_t kBufferSize = 64;
+    constexpr size_t kChannels = 2;
+
+    RecordingInfo info;
+    info.sampleRate = 48e3;
+    info.numChannels = kChannels;
+    info.numOutputs = kChannels;
+    info.period = 4096;
+    info.bufferSize = kBufferSize;
+    info.deviceUID = "check";
+
+    const auto &chirp = ChirpSignal::get(info.period);
+    const auto loopback = makeLoopback(chirp, 2, 333, 1.0f);
+    std::vector<float> out(kBufferSize * kChannels);
+    const auto workPath = std::filesystem::temp_directory_path() / "TestCoreAudioLatencyCheck";
+    std::filesystem::create_directories(workPath);
+    LatencyTester tester(info, workPath.string());
+    tester.prepare(kBufferSize, kChannels, kChannels, LatencyModel());
+
+    std::atomic<bool> running{true};
+    std::thread view;
+    numPolls = 0;
+    if (viewOn)
+    {
+        view = std::thread([&] {
+            LiveViewData data(tester.tap(), info.sampleRate);
+            while (running)
+            {
+                numPolls += data.poll() ? 1 : 0;
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        });
+    }
+
+    // Paced by the sample clock, so the tracker and the view keep up as on a device
+    std::vector<double> cycles(numCycles);
+    size_t pos = 0;
+    const auto period = std::chrono::duration<double>(kBufferSize / info.sampleRate);
+    const auto start = Clock::now();
+    for (size_t k = 0; k < numCycles; k++)
+    {
+        std::this_thread::sleep_until(start + std::chrono::duration_cast<Clock::duration>(period * k));
+        const auto begin = Clock::now();
+        tester.process(kBufferSize, loopback.data() + pos * kChannels, kChannels, out.data(), kChannels);
+        cycles[k] = std::chrono::duration<double>(Clock::now() - begin).count();
+        pos = (pos + kBufferSize) % info.period;
+    }
+    running = false;
+    if (view.joinable())
+    {
+        view.join();
+    }
+    tester.close();
+
+    std::nth_element(cycles.begin(), cycles.begin() + numCycles * 99 / 100, cycles.end());
+    return cycles[numCycles * 99 / 100];
+}
+
+/**
+ * A live view polling the tap must not slow down the audio callback
+ *
+ * Alternates runs without and with the view and compares the median of their
+ * 99th percentile callback times.
+ */
+void checkLiveView(Checker& checker)
+{
+    constexpr size_t kRuns = 3;
+    constexpr double kToleranceUs = 20;
+    const auto numCycles = std::max<size_t>(1000, static_cast<size_t>(checker.seconds() * 48e3 / 64 / kRuns));
+
+    std::vector<double> off, on;
+    size_t numPolls = 0;
+    for (size_t run = 0; run < kRuns; run++)
+    {
+        size_t polls;
+        off.push_back(liveViewP99(false, numCycles, polls) * 1e6);
+        on.push_back(liveViewP99(true, numCycles, polls) * 1e6);
+        numPolls += polls;
+    }
+    std::sort(off.begin(), off.end());
+    std::sort(on.begin(), on.end());
+    const double p99Off = off[kRuns / 2];
+    const double p99On = on[kRuns / 2];
+
+    checker.expect(numPolls > 0, "the view received no snapshot");
+    checker.expect(p99On <= p99Off + kToleranceUs, "p99 " + str(p99On) + " us with the view, " + str(p99Off)
+                   + " us without, tolerance " + str(kToleranceUs) + " us");
+    std::cout << "    p99 " << p99Off << " us without the view, " << p99On << " us with it, " << numPolls << " snapshot(s)" << std::endl;
+}
+
+}   // anonymous namespace
+
+
+/**
+ * Functional and stress checks that need no audio hardware
+ *
+ * Usage: TestCoreAudioLatencyCheck [--filter <substring>] [--seconds <s>]
+ *
+ * ringbuffer  drives RecordingWriter at audio rate against a fast and a
+ *             deliberately stalled consumer, checking sample integrity and
+ *             the overrun count
+ * polarity    measures fractional delays of normal and inverted synthetic
+ *             loopbacks
+ * dropouts    writes loopback recordings with gaps and analyses them serially
+ *             and in parallel
+ * registry    counts the calls DeviceRegistry makes to a fake HAL on cache
+ *             hits, after invalidate() and after a change notification
+ * liveview    compares the 99th percentile of LatencyTester::process() with
+ *             and without a view polling its tap through LiveViewData
+ *
+ * Timed scenarios run for the given time each (default 2 s). Every failed
+ * expectation is listed; the exit code is 1 if any check failed.
+ */
+int main(int argc, char *argv[])
+{
+    std::string filter;
+    double seconds = 2.0;
+
+    try
+    {
+        for (int k = 1; k < argc; k++)
+        {
+            const std::string arg = argv[k];
+            const bool hasValue = (k + 1 < argc);
+            if ((arg == "--filter") && hasValue)
+            {
+                filter = argv[++k];
+            }
+            else if ((arg == "--seconds") && hasValue)
+            {
+                seconds = std::stod(argv[++k]);
+            }
+            else
+            {
+                throw std::invalid_argument("Unknown argument: " + arg);
+            }
+        }
+
+        const std::pair<const char*, std::function<void(Checker&)>> checks[] = {
+            {"ringbuffer", checkRingBuffer},
+            {"polarity", checkPolarity},
+            {"dropouts", checkDropouts},
+            {"registry", checkRegistry},
+            {"liveview", checkLiveView},
+        };
+
+        bool passed = true;
+        for (const auto& [name, check] : checks)
+        {
+            if (!filter.empty() && (std::string(name).find(filter) == std::string::npos))
+            {
+                continue;
+            }
+            std::cout << name << std::endl;
+            Checker checker(seconds);
+            check(checker);
+            for (const auto &failure : checker.failures())
+            {
+                std::cout << "    FAIL " << failure << std::endl;
+            }
+            std::cout << "    " << (checker.failures().empty() ? "ok" : "FAILED") << std::endl;
+            passed = passed && checker.failures().empty();
+        }
+        return passed ? 0 : 1;
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << "ERROR: " << e.what() << std::endl;
+        return 1;
+    }
+}
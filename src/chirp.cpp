@@ -0,0 +1,61 @@
+#include "chirp.h"
+#include "fft.h"
+
+#include <cmath>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+
+
+ChirpSignal::ChirpSignal(size_t period, double dutyCycle)
+    : dutyCycle_{dutyCycle}
+{
+    if ((dutyCycle <= 0) || (dutyCycle > 1))
+    {
+        throw std::invalid_argument("ChirpSignal: duty cycle must be in (0, 1]");
+    }
+    FFT fft(period);
+
+    constexpr double twoPI = 6.283185307179586;
+    const size_t NF = period / 2;
+    const double beta = twoPI * dutyCycle / static_cast<double>(period);
+    double alpha = std::ceil((beta * NF * NF) / twoPI);
+    alpha = (alpha * twoPI / NF) - (beta * NF);
+
+    spectrumRe_.resize(NF + 1);
+    spectrumIm_.resize(NF + 1);
+    for (size_t k = 0; k <= NF; k++)
+    {
+        const double kk = static_cast<double>(k);
+        const double phase = -(alpha * kk + beta * kk * kk);
+        spectrumRe_[k] = static_cast<float>(std::cos(phase));
+        spectrumIm_[k] = static_cast<float>(std::sin(phase));
+    }
+
+    // Hermitian extension, then sig = real(ifft(Sig))
+    samples_.resize(period);
+    std::vector<float> im(period);
+    for (size_t k = 0; k < period; k++)
+    {
+        const size_t n = (k <= NF) ? k : (period - k);
+        samples_[k] = spectrumRe_[n];
+        im[k] = (k <= NF) ? spectrumIm_[n] : -spectrumIm_[n];
+    }
+    fft.inverse(samples_.data(), im.data());
+}
+
+const ChirpSignal& ChirpSignal::get(size_t period, double dutyCycle)
+{
+    static std::mutex mutex;
+    static std::map<std::pair<size_t, double>, std::unique_ptr<ChirpSignal>> cache;
+
+    std::scoped_lock<std::mutex> lock(mutex);
+    auto &entry = cache[{period, dutyCycle}];
+    if (!entry)
+    {
+        entry = std::make_unique<ChirpSignal>(period, dutyCycle);
+    }
+    return *entry;
+}
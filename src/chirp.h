@@ -0,0 +1,62 @@
+#ifndef CHIRP_H
+#define CHIRP_H
+
+#include <vector>
+#include <cstddef>
+
+
+constexpr size_t kDefaultChirpPeriod = 8192;
+constexpr double kDefaultChirpDutyCycle = 0.9;
+
+/**
+ * @brief Delay between the stimulus copies of adjacent outputs in the matrix layout
+ *
+ * Every output-to-input latency must stay below this to be attributed correctly.
+ */
+constexpr size_t matrixOutputShift(size_t period, size_t numOutputs)
+{
+    return (numOutputs > 0) ? (period / numOutputs) : period;
+}
+
+
+/**
+ * @brief Periodic linear chirp stimulus
+ *
+ * Built in the frequency domain with a flat magnitude and quadratic phase,
+ * Sig[k] = exp(-i (alpha k + beta k^2)), so the sweep occupies dutyCycle of the
+ * period and every bin is excited. The spectrum is kept next to the samples.
+ */
+class ChirpSignal
+{
+public:
+    /**
+     * @brief Generate a chirp
+     * @param period Power of two
+     * @param dutyCycle Fraction of the period covered by the sweep, in (0, 1]
+     */
+    ChirpSignal(size_t period, double dutyCycle = kDefaultChirpDutyCycle);
+
+    /**
+     * @brief Shared instance, generated on first use
+     */
+    static const ChirpSignal& get(size_t period = kDefaultChirpPeriod, double dutyCycle = kDefaultChirpDutyCycle);
+
+    size_t size() const {return samples_.size();}
+    double dutyCycle() const {return dutyCycle_;}
+    const float* data() const {return samples_.data();}
+    const std::vector<float>& samples() const {return samples_;}
+
+    /**
+     * @brief First size()/2 + 1 bins of fft(samples())
+     */
+    const std::vector<float>& spectrumRe() const {return spectrumRe_;}
+    const std::vector<float>& spectrumIm() const {return spectrumIm_;}
+
+private:
+    double dutyCycle_{0};
+    std::vector<float> samples_;
+    std::vector<float> spectrumRe_;
+    std::vector<float> spectrumIm_;
+};
+
+#endif // CHIRP_H
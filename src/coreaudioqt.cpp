@@ -1,7 +1,13 @@
 #include "coreaudioqt.h"
+#include "interleave.h"
+
+#include <HostTime.h>
 
 #include <QDebug>
 
+#include <algorithm>
+#include <cstring>
+
 
 void setCAProperty(AudioObjectID objectID, const AudioObjectPropertyAddress& addr, const void *data, UInt32 dataSize)
 {
@@ -55,248 +61,407 @@ void setIOProcStreamUsage(AudioObjectID deviceID, AudioObjectPropertyScope scope
 }
 
 
-std::vector<DeviceInfo> getDevices()
+DeviceRegistry& systemDeviceRegistry()
 {
-    std::vector<AudioObjectID> IDs;
-    AudioObjectPropertyAddress addr{kAudioHardwarePropertyDevices, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain};
-    getCAProperties(kAudioObjectSystemObject, addr, IDs);
-
-    size_t numDevices = IDs.size();
-    std::vector<DeviceInfo> devices(numDevices);
-    for (size_t devIdx = 0; devIdx < numDevices; devIdx++)
-    {
-        auto &dev = devices[devIdx];
-        auto id = IDs[devIdx];
-
-        dev.id = id;
-
-        addr.mScope = kAudioObjectPropertyScopeGlobal;
+    static DeviceRegistry registry(CoreAudioHAL::instance());
+    return registry;
+}
 
-        addr.mSelector = kAudioDevicePropertyDeviceNameCFString;
-        getCAProperty(id, addr, dev.name);
+UInt32 getNumChannels(AudioObjectID deviceID, AudioObjectPropertyScope scope)
+{
+    return systemDeviceRegistry().numChannels(deviceID, scope);
+}
 
-        addr.mSelector = kAudioDevicePropertyDeviceManufacturerCFString;
-        getCAProperty(id, addr, dev.manufacturer);
+std::vector<DeviceInfo> getDevices()
+{
+    return systemDeviceRegistry().devices();
+}
 
-        addr.mSelector = kAudioDevicePropertyDeviceUID;
-        getCAProperty(id, addr, dev.deviceUID);
+AudioObjectID getDefaultInputDeviceID()
+{
+    return systemDeviceRegistry().defaultInputDevice();
+}
 
-        addr.mSelector = kAudioDevicePropertyDeviceIsAlive;
-        getCAProperty(id, addr, dev.alive);
+AudioObjectID getDefaultOutputDeviceID()
+{
+    return systemDeviceRegistry().defaultOutputDevice();
+}
 
-        addr.mSelector = kAudioDevicePropertyDeviceIsRunning;
-        getCAProperty(id, addr, dev.running);
 
-        addr.mSelector = kAudioClockDevicePropertyNominalSampleRate;
-        getCAProperty(id, addr, dev.sampleRate);
+namespace {
 
-        addr.mSelector = kAudioDevicePropertyAvailableNominalSampleRates;
-        getCAProperties(id, addr, dev.availSampleRates);
+bool allFloat(const std::vector<SampleFormat>& formats)
+{
+    return std::all_of(formats.begin(), formats.end(), [](SampleFormat format) {return format == SampleFormat::Float32;});
+}
 
-        addr.mSelector = kAudioDevicePropertyStreamConfiguration;
-        addr.mScope = kAudioObjectPropertyScopeOutput;
-        auto list = getCAProperty<AudioBufferList>(id, addr);
-        if (list->mNumberBuffers == 1)
+/**
+ * @brief Frames per buffer and total channels of a buffer list
+ * @param list
+ * @param formats Sample format of every buffer
+ * @param numSamples Frames of the enabled buffers, left unchanged if none is enabled
+ * @param numChannels
+ * @param enabled True if at least one buffer carries data
+ * @return false if the buffer sizes are inconsistent
+ */
+bool getBufferLayout(const AudioBufferList *list, const std::vector<SampleFormat> &formats, size_t &numSamples, size_t &numChannels, bool &enabled)
+{
+    numChannels = 0;
+    enabled = false;
+    for (UInt32 k = 0; k < list->mNumberBuffers; k++)
+    {
+        const auto &buffer = list->mBuffers[k];
+        if (buffer.mNumberChannels == 0)
         {
-            dev.numOutputs = list->mBuffers[0].mNumberChannels;
+            continue;
         }
+        numChannels += buffer.mNumberChannels;
+        enabled = enabled || (buffer.mData != nullptr);
 
-        addr.mScope = kAudioObjectPropertyScopeInput;
-        list = getCAProperty<AudioBufferList>(id, addr);
-        if (list->mNumberBuffers == 1)
+        const size_t bytesPerFrame = sampleFormatBytes(formats[k]) * buffer.mNumberChannels;
+        const size_t frames = buffer.mDataByteSize / bytesPerFrame;
+        if ((frames * bytesPerFrame) != buffer.mDataByteSize)
+        {
+            return false;
+        }
+        if ((buffer.mData != nullptr) && (numSamples != 0) && (frames != numSamples))
+        {
+            return false;
+        }
+        if (buffer.mData != nullptr)
         {
-            dev.numInputs = list->mBuffers[0].mNumberChannels;
+            numSamples = frames;
         }
     }
-
-    return devices;
+    return true;
 }
 
-AudioObjectID getDefaultInputDeviceID()
+/**
+ * @brief Zero every output buffer of a cycle that is not processed, whatever its format
+ */
+void silence(AudioBufferList *list)
 {
-    AudioObjectPropertyAddress addr{kAudioHardwarePropertyDefaultInputDevice, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain};
-    AudioObjectID id;
-    getCAProperty(kAudioObjectSystemObject, addr, id);
-    return id;
+    for (UInt32 k = 0; k < list->mNumberBuffers; k++)
+    {
+        auto &buffer = list->mBuffers[k];
+        if (buffer.mData != nullptr)
+        {
+            std::memset(buffer.mData, 0, buffer.mDataByteSize);
+        }
+    }
 }
 
-AudioObjectID getDefaultOutputDeviceID()
+}   // anonymous namespace
+
+OSStatus CoreAudioQt::audioIOProc(AudioObjectID inDevice,
+                                  const AudioTimeStamp* inNow,
+                                  const AudioBufferList* inInputData,
+                                  const AudioTimeStamp* inInputTime,
+                                  AudioBufferList* outOutputData,
+                                  const AudioTimeStamp* inOutputTime,
+                                  void* __nullable inClientData)
 {
-    AudioObjectPropertyAddress addr{kAudioHardwarePropertyDefaultOutputDevice, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain};
-    AudioObjectID id;
-    getCAProperty(kAudioObjectSystemObject, addr, id);
-    return id;
-}
+    if (inClientData == nullptr)
+    {
+        return noErr;
+    }
 
+    IOCycleTime time;
+    if ((inNow != nullptr) && (inNow->mFlags & kAudioTimeStampHostTimeValid))
+    {
+        time.hostTime = AudioConvertHostTimeToNanos(inNow->mHostTime);
+    }
+    if ((inNow != nullptr) && (inNow->mFlags & kAudioTimeStampSampleTimeValid))
+    {
+        time.nowSampleTime = inNow->mSampleTime;
+    }
+    if ((inInputTime != nullptr) && (inInputTime->mFlags & kAudioTimeStampSampleTimeValid))
+    {
+        time.inputSampleTime = inInputTime->mSampleTime;
+    }
+    if ((inOutputTime != nullptr) && (inOutputTime->mFlags & kAudioTimeStampSampleTimeValid))
+    {
+        time.outputSampleTime = inOutputTime->mSampleTime;
+    }
 
-namespace {
+    reinterpret_cast<CoreAudioQt*>(inClientData)->ioCycle(inInputData, outOutputData, time);
+    return noErr;
+}
 
-OSStatus audioIOProc(AudioObjectID inDevice,
-                    const AudioTimeStamp* inNow,
-                    const AudioBufferList* inInputData,
-                    const AudioTimeStamp* inInputTime,
-                    AudioBufferList* outOutputData,
-                    const AudioTimeStamp* inOutputTime,
-                    void* __nullable inClientData)
+void CoreAudioQt::ioCycle(const AudioBufferList *inInputData, AudioBufferList *outOutputData, const IOCycleTime &time)
 {
-    if (inClientData == nullptr)
+    size_t numSamples = 0;
+    size_t numInputs = 0;
+    size_t numOutputs = 0;
+    bool inEnabled = false;
+    bool outEnabled = false;
+
+    if ((inInputData->mNumberBuffers != inFormats_.size()) || (outOutputData->mNumberBuffers != outFormats_.size()))
     {
-        return noErr;
+        post(AudioEvent::UnexpectedStreamLayout);
+        silence(outOutputData);
+        return;
+    }
+    if (!getBufferLayout(inInputData, inFormats_, numSamples, numInputs, inEnabled))
+    {
+        post(AudioEvent::InvalidInputFrames);
+        silence(outOutputData);
+        return;
+    }
+    if (!getBufferLayout(outOutputData, outFormats_, numSamples, numOutputs, outEnabled))
+    {
+        post(AudioEvent::InvalidOutputFrames);
+        silence(outOutputData);
+        return;
+    }
+    if ((numInputs > 0) && !inEnabled)
+    {
+        post(AudioEvent::InputDisabled);
+        silence(outOutputData);
+        return;
+    }
+    if ((numOutputs > 0) && !outEnabled)
+    {
+        post(AudioEvent::OutputDisabled);
+        silence(outOutputData);
+        return;
+    }
+    if (numSamples == 0)
+    {
+        post(AudioEvent::InvalidFrameCount);
+        silence(outOutputData);
+        return;
+    }
+    if ((numSamples > maxFrames_) || (numInputs > inPlanes_.size()) || (numOutputs > outPlanes_.size()))
+    {
+        post(AudioEvent::UnexpectedStreamLayout);
+        silence(outOutputData);
+        return;
     }
-    auto hdl = reinterpret_cast<CoreAudioQt*>(inClientData);
 
+    // A single interleaved float stream per direction is passed through without copying
+    const bool inDirect = (inInputData->mNumberBuffers == 1) && (inFormats_[0] == SampleFormat::Float32);
+    const bool outDirect = (outOutputData->mNumberBuffers == 1) && (outFormats_[0] == SampleFormat::Float32);
     const float *inSamples = nullptr;
     float *outSamples = nullptr;
-    size_t numInputs = 0;
-    size_t numOutputs = 0;
-    size_t numSamples = 0;
 
-    if (inInputData->mNumberBuffers == 1)
+    if (numInputs > 0)
     {
-        const auto &buffer = inInputData->mBuffers[0];
-        numInputs = buffer.mNumberChannels;
+        if (inDirect)
+        {
+            inSamples = static_cast<const float*>(inInputData->mBuffers[0].mData);
+        }
+        else
+        {
+            gatherInput(inInputData, numSamples, numInputs);
+            inSamples = inScratch_.data();
+        }
+    }
 
-        numSamples = buffer.mDataByteSize / (sizeof(float) * numInputs);
-        if ((numSamples == 0) || ((numSamples * sizeof(float) * numInputs) != buffer.mDataByteSize))
+    if (numOutputs > 0)
+    {
+        if (outDirect)
+        {
+            outSamples = static_cast<float*>(outOutputData->mBuffers[0].mData);
+        }
+        else
         {
-            emit hdl->error("Invalid number of input samples");
-            return noErr;
+            std::fill_n(outScratch_.begin(), numSamples * numOutputs, 0.0f);
+            outSamples = outScratch_.data();
         }
+    }
+
+    process(numSamples, inSamples, numInputs, outSamples, numOutputs, time);
+
+    if ((numOutputs > 0) && !outDirect)
+    {
+        scatterOutput(outOutputData, numSamples, numOutputs);
+    }
+}
 
-        inSamples = reinterpret_cast<const float*>(buffer.mData);
-        if (inSamples == NULL)
+void CoreAudioQt::gatherInput(const AudioBufferList *list, size_t numSamples, size_t numChannels)
+{
+    if (list->mNumberBuffers == 1)
+    {
+        convertToFloat(inFormats_[0], list->mBuffers[0].mData, inScratch_.data(), numSamples * numChannels);
+        return;
+    }
+
+    // Consecutive mono (non-interleaved) streams are interleaved as one run
+    size_t ch = 0;
+    size_t run = 0;
+    auto flush = [&]() {
+        if (run > 0)
+        {
+            interleave(inPlanes_.data(), run, inScratch_.data() + ch - run, numChannels, numSamples);
+            run = 0;
+        }
+    };
+
+    for (UInt32 k = 0; k < list->mNumberBuffers; k++)
+    {
+        const auto &buffer = list->mBuffers[k];
+        auto data = static_cast<const float*>(buffer.mData);
+        if ((data != nullptr) && (inFormats_[k] != SampleFormat::Float32))
+        {
+            float *converted = inConverted_.data() + ch * maxFrames_;
+            convertToFloat(inFormats_[k], buffer.mData, converted, numSamples * buffer.mNumberChannels);
+            data = converted;
+        }
+        if ((buffer.mNumberChannels == 1) && (data != nullptr))
         {
-            emit hdl->error("Input streaming is disabled");
-            return noErr;
+            inPlanes_[run++] = data;
+            ch++;
+            continue;
         }
+
+        flush();
+        if (data != nullptr)
+        {
+            copyChannels(data, buffer.mNumberChannels, inScratch_.data() + ch, numChannels, buffer.mNumberChannels, numSamples);
+        }
+        else
+        {
+            for (size_t n = 0; n < numSamples; n++)
+            {
+                std::fill_n(inScratch_.begin() + n * numChannels + ch, buffer.mNumberChannels, 0.0f);
+            }
+        }
+        ch += buffer.mNumberChannels;
     }
+    flush();
+}
 
-    if (outOutputData->mNumberBuffers == 1)
+void CoreAudioQt::scatterOutput(AudioBufferList *list, size_t numSamples, size_t numChannels)
+{
+    if (list->mNumberBuffers == 1)
     {
-        auto &buffer = outOutputData->mBuffers[0];
-        numOutputs = buffer.mNumberChannels;
+        convertFromFloat(outFormats_[0], outScratch_.data(), list->mBuffers[0].mData, numSamples * numChannels);
+        return;
+    }
+
+    size_t ch = 0;
+    size_t run = 0;
+    auto flush = [&]() {
+        if (run > 0)
+        {
+            deinterleave(outScratch_.data() + ch - run, numChannels, outPlanes_.data(), run, numSamples);
+            run = 0;
+        }
+    };
 
-        if (numSamples == 0)
+    for (UInt32 k = 0; k < list->mNumberBuffers; k++)
+    {
+        auto &buffer = list->mBuffers[k];
+        auto data = static_cast<float*>(buffer.mData);
+        if ((data != nullptr) && (outFormats_[k] != SampleFormat::Float32))
         {
-            numSamples = buffer.mDataByteSize / (sizeof(float) * numOutputs);
+            data = outConverted_.data() + ch * maxFrames_;
         }
-        if ((numSamples == 0) || ((numSamples * sizeof(float) * numOutputs) != buffer.mDataByteSize))
+        if ((buffer.mNumberChannels == 1) && (data != nullptr))
         {
-            emit hdl->error("Invalid number of output samples");
-            return noErr;
+            outPlanes_[run++] = data;
+            ch++;
+            continue;
         }
 
-        outSamples = reinterpret_cast<float*>(buffer.mData);
-        if (outSamples == NULL)
+        flush();
+        if (data != nullptr)
         {
-            emit hdl->error("Output streaming is disabled");
-            return noErr;
+            copyChannels(outScratch_.data() + ch, numChannels, data, buffer.mNumberChannels, buffer.mNumberChannels, numSamples);
         }
+        ch += buffer.mNumberChannels;
     }
+    flush();
 
-    hdl->process(numSamples, inSamples, numInputs, outSamples, numOutputs);
+    if (outConverted_.empty())
+    {
+        return;
+    }
+    // Integer streams were filled through their float regions
+    ch = 0;
+    for (UInt32 k = 0; k < list->mNumberBuffers; k++)
+    {
+        auto &buffer = list->mBuffers[k];
+        if ((buffer.mData != nullptr) && (outFormats_[k] != SampleFormat::Float32))
+        {
+            convertFromFloat(outFormats_[k], outConverted_.data() + ch * maxFrames_, buffer.mData, numSamples * buffer.mNumberChannels);
+        }
+        ch += buffer.mNumberChannels;
+    }
+}
 
-    return noErr;
+CoreAudioQt::CoreAudioQt(AudioProcessor &processor, AudioObjectID deviceID, double sampleRate, UInt32 bufferSize, QObject *parent)
+    : AudioBackend(processor, parent)
+    , deviceID_{deviceID}
+    , configurator_(systemDeviceRegistry(), deviceID)
+{
+    request_.sampleRate = sampleRate;
+    request_.bufferSize = bufferSize;
 }
 
-void printStreamConfig(const AudioStreamBasicDescription& desc)
+LatencyModel CoreAudioQt::latencyModel() const
 {
-    qDebug() << "Sample rate: " << desc.mSampleRate;
-    auto id = reinterpret_cast<const char*>(&desc.mFormatID);
-    qDebug() << "Format ID: " << id[0] << id[1] << id[2] << id[3];
-    qDebug() << "Format flags: " << desc.mFormatFlags;
-    qDebug() << "Bytes per packet: " << desc.mBytesPerPacket;
-    qDebug() << "Frames per packet: " << desc.mFramesPerPacket;
-    qDebug() << "Bytes per frame: " << desc.mBytesPerFrame;
-    qDebug() << "Channels per frame: " << desc.mChannelsPerFrame;
-    qDebug() << "Bits per channel: " << desc.mBitsPerChannel;
+    return latencyModel_;
 }
 
-}   // anonymous namespace
+void CoreAudioQt::setPhysicalFormat(SampleFormat format)
+{
+    request_.selectPhysicalFormat = true;
+    request_.physicalFormat = format;
+}
 
-CoreAudioQt::CoreAudioQt(AudioObjectID deviceID, double sampleRate, QObject *parent)
-    : QObject(parent)
-    , deviceID_{deviceID}
-    , sampleRate_{sampleRate}
+void CoreAudioQt::reconfigure(double sampleRate, UInt32 bufferSize)
 {
+    request_.sampleRate = sampleRate;
+    request_.bufferSize = bufferSize;
 }
 
 CoreAudioQt::~CoreAudioQt()
 {
     Stop();
+    if (procID_ != nullptr)
+    {
+        AudioDeviceDestroyIOProcID(deviceID_, procID_);
+    }
 }
 
 void CoreAudioQt::Start()
 {
-    if (procID_ != nullptr)
+    if (running_)
     {
         emit error("Audio processing already started");
         return;
     }
 
-    AudioObjectPropertyAddress addr{kAudioClockDevicePropertyNominalSampleRate, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain};
-    setCAProperty(deviceID_, addr, sampleRate_);
-
-    Float64 sampleRate = 0;
-    getCAProperty(deviceID_, addr, sampleRate);
-    if (std::abs(sampleRate - sampleRate_) > 1e-3)
+    try
+    {
+        const auto &setup = configurator_.apply(request_);
+        inFormats_ = setup.inFormats;
+        outFormats_ = setup.outFormats;
+        latencyModel_ = setup.latencyModel;
+        maxFrames_ = setup.maxFrames;
+
+        // Scratch space for multi-stream layouts, sized for the largest possible I/O cycle
+        inScratch_.assign(maxFrames_ * setup.numInputs, 0.0f);
+        outScratch_.assign(maxFrames_ * setup.numOutputs, 0.0f);
+        inPlanes_.assign(setup.numInputs, nullptr);
+        outPlanes_.assign(setup.numOutputs, nullptr);
+        inConverted_.assign(allFloat(inFormats_) ? 0 : maxFrames_ * setup.numInputs, 0.0f);
+        outConverted_.assign(allFloat(outFormats_) ? 0 : maxFrames_ * setup.numOutputs, 0.0f);
+        processor_.prepare(maxFrames_, setup.numInputs, setup.numOutputs, latencyModel_);
+    }
+    catch (const std::exception& e)
     {
-        qDebug() << "Sample rate: " << sampleRate;
-        emit error("Cannot set the sample rate");
+        emit error(e.what());
         return;
     }
+    stats_.reset(request_.sampleRate);
 
-#if 1
-    addr.mSelector = kAudioDevicePropertyBufferFrameSize;
-    UInt32 bufSize = 32;
-    setCAProperty(deviceID_, addr, bufSize);
-
-    bufSize = 0;
-    addr.mScope = kAudioObjectPropertyScopeInput;
-    getCAProperty(deviceID_, addr, bufSize);
-    qDebug() << "Input buffer size: " << bufSize;
-
-    bufSize = 0;
-    addr.mScope = kAudioObjectPropertyScopeOutput;
-    getCAProperty(deviceID_, addr, bufSize);
-    qDebug() << "Output buffer size: " << bufSize;
-
-    UInt32 latency = 0;
-    addr.mSelector = kAudioDevicePropertyLatency;
-    addr.mScope = kAudioObjectPropertyScopeInput;
-    getCAProperty(deviceID_, addr, latency);
-    qDebug() << "Input device latency: " << latency;
-
-    latency = 0;
-    addr.mScope = kAudioObjectPropertyScopeOutput;
-    getCAProperty(deviceID_, addr, latency);
-    qDebug() << "Output device latency: " << latency;
-
-    addr.mSelector = kAudioDevicePropertyStreams;
-    addr.mScope = kAudioObjectPropertyScopeInput;
-    std::vector<UInt32> inStreamIDs;
-    getCAProperties(deviceID_, addr, inStreamIDs);
-
-    addr.mScope = kAudioObjectPropertyScopeOutput;
-    std::vector<UInt32> outStreamIDs;
-    getCAProperties(deviceID_, addr, outStreamIDs);
-
-    if ((inStreamIDs.size() != 1) || (outStreamIDs.size() != 1))
-        throw std::runtime_error("Invalid number of input/output streams");
-
-    addr.mSelector = kAudioStreamPropertyLatency;
-    addr.mScope = kAudioObjectPropertyScopeGlobal;
-    UInt32 inLatency = 0;
-    getCAProperty(inStreamIDs[0], addr, inLatency);
-    qDebug() << "Input stream latency: " << inLatency;
-
-    UInt32 outLatency = 0;
-    getCAProperty(outStreamIDs[0], addr, outLatency);
-    qDebug() << "Output stream latency: " << outLatency;
-#endif
-
-    if (AudioDeviceCreateIOProcID(deviceID_, audioIOProc, this, &procID_) != noErr)
+    // The IOProc stays registered from one Start() to the next
+    if ((procID_ == nullptr) && (AudioDeviceCreateIOProcID(deviceID_, audioIOProc, this, &procID_) != noErr))
     {
+        procID_ = nullptr;
         emit error("AudioDeviceCreateIOProcID() failed");
         return;
     }
@@ -306,14 +471,15 @@ void CoreAudioQt::Start()
         emit error("AudioDeviceStart() failed");
         return;
     }
+    running_ = true;
 }
 
 void CoreAudioQt::Stop()
 {
-    if (procID_ != nullptr)
+    if (running_)
     {
-        AudioDeviceStop(deviceID_, nullptr);
-        AudioDeviceDestroyIOProcID(deviceID_, procID_);
-        procID_ = nullptr;
+        // Only our IOProc; others on the device keep running
+        AudioDeviceStop(deviceID_, procID_);
+        running_ = false;
     }
 }
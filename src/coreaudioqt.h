@@ -1,6 +1,11 @@
 #ifndef COREAUDIOQT_H
 #define COREAUDIOQT_H
 
+#include "audiobackend.h"
+#include "deviceregistry.h"
+#include "sampleformat.h"
+#include "streamconfig.h"
+
 #include <AudioHardware.h>
 
 #include <QString>
@@ -140,19 +145,18 @@ std::vector<UInt32> getIOProcStreamUsage(AudioObjectID deviceID, AudioObjectProp
 void setIOProcStreamUsage(AudioObjectID deviceID, AudioObjectPropertyScope scope, AudioDeviceIOProcID procID, const std::vector<UInt32>& usages);
 
 
-struct DeviceInfo
-{
-    AudioObjectID id{0};
-    QString name;
-    QString manufacturer;
-    QString deviceUID;
-    UInt32 alive{0};
-    UInt32 running{0};
-    UInt32 numInputs{0};
-    UInt32 numOutputs{0};
-    Float64 sampleRate{0};
-    std::vector<AudioValueRange> availSampleRates;
-};
+/**
+ * @brief Cached view of the Core Audio device tree shared by the functions below
+ */
+DeviceRegistry& systemDeviceRegistry();
+
+/**
+ * @brief Total number of channels over all streams in one direction
+ * @param deviceID
+ * @param scope kAudioObjectPropertyScopeInput or kAudioObjectPropertyScopeOutput
+ * @return
+ */
+UInt32 getNumChannels(AudioObjectID deviceID, AudioObjectPropertyScope scope);
 
 std::vector<DeviceInfo> getDevices();
 
@@ -161,23 +165,67 @@ AudioObjectID getDefaultInputDeviceID();
 AudioObjectID getDefaultOutputDeviceID();
 
 
-class CoreAudioQt : public QObject
+class CoreAudioQt : public AudioBackend
 {
     Q_OBJECT
 public:
-    CoreAudioQt(AudioObjectID deviceID, double sampleRate,  QObject *parent = nullptr);
+    CoreAudioQt(AudioProcessor &processor, AudioObjectID deviceID, double sampleRate, UInt32 bufferSize = 32, QObject *parent = nullptr);
     virtual ~CoreAudioQt();
-    void Start();
-    void Stop();
-    virtual void process(size_t numSamples, const float *inSamples, size_t inChannels, float *outSamples, size_t outChannels) = 0;
-
-signals:
-    void error(const QString &msg);
+    void Start() override;
+    void Stop() override;
+    LatencyModel latencyModel() const override;
+
+    /**
+     * @brief Switch the hardware side of all streams to a sample format on the next Start()
+     *
+     * Some interfaces reach their lowest latency only with an integer physical
+     * format. Integer IOProc buffers are converted to and from float in the
+     * I/O cycle.
+     */
+    void setPhysicalFormat(SampleFormat format);
+
+    /**
+     * @brief Use another sample rate and buffer size from the next Start()
+     *
+     * Start() writes only the device properties that differ from their current
+     * values and keeps the IOProc registered, so a restart with an unchanged
+     * configuration writes nothing and reads nearly everything from the cache.
+     */
+    void reconfigure(double sampleRate, UInt32 bufferSize);
 
 private:
+    static OSStatus audioIOProc(AudioObjectID inDevice,
+                                const AudioTimeStamp* inNow,
+                                const AudioBufferList* inInputData,
+                                const AudioTimeStamp* inInputTime,
+                                AudioBufferList* outOutputData,
+                                const AudioTimeStamp* inOutputTime,
+                                void* __nullable inClientData);
+    void ioCycle(const AudioBufferList *inInputData, AudioBufferList *outOutputData, const IOCycleTime &time);
+    void gatherInput(const AudioBufferList *list, size_t numSamples, size_t numChannels);
+    void scatterOutput(AudioBufferList *list, size_t numSamples, size_t numChannels);
+
     const AudioObjectID deviceID_;
-    const Float64 sampleRate_;
-    AudioDeviceIOProcID procID_{nullptr};
+    StreamRequest request_;
+    StreamConfigurator configurator_;
+    AudioDeviceIOProcID procID_{nullptr};   ///< Created by the first Start(), destroyed with the backend
+    bool running_{false};
+    LatencyModel latencyModel_;
+
+    // IOProc buffer format of every stream, read in Start()
+    std::vector<SampleFormat> inFormats_;
+    std::vector<SampleFormat> outFormats_;
+
+    // Interleaved scratch for devices with several streams, allocated in Start()
+    size_t maxFrames_{0};
+    std::vector<float> inScratch_;
+    std::vector<float> outScratch_;
+    std::vector<const float*> inPlanes_;
+    std::vector<float*> outPlanes_;
+
+    // Float copies of integer streams, maxFrames_ frames per channel at each stream's channel offset
+    std::vector<float> inConverted_;
+    std::vector<float> outConverted_;
 };
 
 #endif // COREAUDIOQT_H
@@ -0,0 +1,389 @@
+#include "deviceregistry.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <tuple>
+
+
+bool DeviceRegistry::Key::operator<(const Key& other) const
+{
+    return std::tie(objectID, selector, scope, element) < std::tie(other.objectID, other.selector, other.scope, other.element);
+}
+
+DeviceRegistry::DeviceRegistry(AudioHAL &hal)
+    : hal_(hal)
+{
+}
+
+DeviceRegistry::~DeviceRegistry()
+{
+    // Not under the lock: a listener may be waiting for it
+    std::vector<AudioHAL::ListenerToken> tokens;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto &watch : watches_)
+        {
+            tokens.push_back(watch.second);
+        }
+        watches_.clear();
+    }
+    for (auto token : tokens)
+    {
+        hal_.removeListener(token);
+    }
+}
+
+std::vector<AudioObjectID> DeviceRegistry::deviceIDs()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return fetchDeviceIDs();
+}
+
+std::vector<DeviceInfo> DeviceRegistry::devices()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto IDs = fetchDeviceIDs();
+    std::vector<DeviceInfo> devices;
+    devices.reserve(IDs.size());
+    for (auto id : IDs)
+    {
+        devices.push_back(fetchDeviceInfo(id));
+    }
+    return devices;
+}
+
+DeviceInfo DeviceRegistry::deviceInfo(AudioObjectID deviceID)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return fetchDeviceInfo(deviceID);
+}
+
+AudioObjectID DeviceRegistry::defaultInputDevice()
+{
+    return get<AudioObjectID>(kAudioObjectSystemObject, {kAudioHardwarePropertyDefaultInputDevice, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain});
+}
+
+AudioObjectID DeviceRegistry::defaultOutputDevice()
+{
+    return get<AudioObjectID>(kAudioObjectSystemObject, {kAudioHardwarePropertyDefaultOutputDevice, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain});
+}
+
+UInt32 DeviceRegistry::numChannels(AudioObjectID deviceID, AudioObjectPropertyScope scope)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return fetchNumChannels(deviceID, scope);
+}
+
+LatencyModel DeviceRegistry::latencyModel(AudioObjectID deviceID)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    LatencyModel model;
+    model.sampleRate = fetchValue<Float64>(deviceID, {kAudioDevicePropertyNominalSampleRate, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain});
+    model.input = fetchLatency(deviceID, kAudioObjectPropertyScopeInput);
+    model.output = fetchLatency(deviceID, kAudioObjectPropertyScopeOutput);
+    return model;
+}
+
+std::vector<AudioObjectID> DeviceRegistry::streams(AudioObjectID deviceID, AudioObjectPropertyScope scope)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return fetchStreams(deviceID, scope);
+}
+
+std::vector<AudioStreamBasicDescription> DeviceRegistry::streamFormats(AudioObjectID deviceID, AudioObjectPropertyScope scope, bool physical)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    const AudioObjectPropertyAddress addr{physical ? kAudioStreamPropertyPhysicalFormat : kAudioStreamPropertyVirtualFormat,
+                                          kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain};
+    std::vector<AudioStreamBasicDescription> formats;
+    for (auto id : fetchStreams(deviceID, scope))
+    {
+        formats.push_back(fetchValue<AudioStreamBasicDescription>(id, addr));
+    }
+    return formats;
+}
+
+std::vector<uint8_t> DeviceRegistry::getRaw(AudioObjectID objectID, const AudioObjectPropertyAddress& addr)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return fetch(objectID, addr, 0).data;
+}
+
+std::string DeviceRegistry::getString(AudioObjectID objectID, const AudioObjectPropertyAddress& addr)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return fetchString(objectID, addr).str;
+}
+
+void DeviceRegistry::read(AudioObjectID objectID, const AudioObjectPropertyAddress& addr, void *data, UInt32 dataSize)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto &entry = fetch(objectID, addr, dataSize);
+    if (entry.data.size() != dataSize)
+    {
+        throw std::runtime_error("Invalid number of elements returned from AudioObjectGetPropertyData()");
+    }
+    std::memcpy(data, entry.data.data(), dataSize);
+}
+
+void DeviceRegistry::write(AudioObjectID objectID, const AudioObjectPropertyAddress& addr, const void *data, UInt32 dataSize)
+{
+    if (hal_.setPropertyData(objectID, addr, dataSize, data) != 0)
+    {
+        throw std::runtime_error("AudioObjectSetPropertyData() failed");
+    }
+    // The HAL may notify asynchronously, do not serve the old value meanwhile
+    invalidate(objectID, addr.mSelector);
+}
+
+void DeviceRegistry::invalidate(AudioObjectID objectID, AudioObjectPropertySelector selector)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = cache_.lower_bound(Key{objectID, selector, 0, 0});
+    while ((it != cache_.end()) && (it->first.objectID == objectID) && (it->first.selector == selector))
+    {
+        it = cache_.erase(it);
+    }
+    auto presentIt = present_.lower_bound(Key{objectID, selector, 0, 0});
+    while ((presentIt != present_.end()) && (presentIt->first.objectID == objectID) && (presentIt->first.selector == selector))
+    {
+        presentIt = present_.erase(presentIt);
+    }
+}
+
+void DeviceRegistry::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    cache_.clear();
+    present_.clear();
+}
+
+uint64_t DeviceRegistry::hits() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return hits_;
+}
+
+uint64_t DeviceRegistry::misses() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return misses_;
+}
+
+const DeviceRegistry::Entry& DeviceRegistry::fetch(AudioObjectID objectID, const AudioObjectPropertyAddress& addr, UInt32 fixedSize)
+{
+    const Key key{objectID, addr.mSelector, addr.mScope, addr.mElement};
+    auto it = cache_.find(key);
+    if (it != cache_.end())
+    {
+        hits_++;
+        return it->second;
+    }
+    misses_++;
+    watch(objectID, addr.mSelector);
+
+    Entry entry;
+    UInt32 dataSize = fixedSize;
+    if (dataSize == 0)
+    {
+        if (hal_.getPropertyDataSize(objectID, addr, dataSize) != 0)
+        {
+            throw std::runtime_error("AudioObjectGetPropertyDataSize() failed");
+        }
+    }
+    entry.data.resize(dataSize);
+    if (dataSize > 0)
+    {
+        if (hal_.getPropertyData(objectID, addr, dataSize, entry.data.data()) != 0)
+        {
+            throw std::runtime_error("AudioObjectGetPropertyData() failed");
+        }
+        entry.data.resize(dataSize);
+    }
+    return cache_.emplace(key, std::move(entry)).first->second;
+}
+
+const DeviceRegistry::Entry& DeviceRegistry::fetchString(AudioObjectID objectID, const AudioObjectPropertyAddress& addr)
+{
+    const Key key{objectID, addr.mSelector, addr.mScope, addr.mElement};
+    auto it = cache_.find(key);
+    if (it != cache_.end())
+    {
+        hits_++;
+        return it->second;
+    }
+    misses_++;
+    watch(objectID, addr.mSelector);
+
+    Entry entry;
+    if (hal_.getStringProperty(objectID, addr, entry.str) != 0)
+    {
+        throw std::runtime_error("AudioObjectGetPropertyData() failed");
+    }
+    return cache_.emplace(key, std::move(entry)).first->second;
+}
+
+template<typename T>
+T DeviceRegistry::fetchValue(AudioObjectID objectID, const AudioObjectPropertyAddress& addr)
+{
+    const auto &entry = fetch(objectID, addr, static_cast<UInt32>(sizeof(T)));
+    if (entry.data.size() != sizeof(T))
+    {
+        throw std::runtime_error("Invalid number of elements returned from AudioObjectGetPropertyData()");
+    }
+    T value;
+    std::memcpy(&value, entry.data.data(), sizeof(T));
+    return value;
+}
+
+bool DeviceRegistry::fetchHasProperty(AudioObjectID objectID, const AudioObjectPropertyAddress& addr)
+{
+    const Key key{objectID, addr.mSelector, addr.mScope, addr.mElement};
+    auto it = present_.find(key);
+    if (it != present_.end())
+    {
+        hits_++;
+        return it->second;
+    }
+    misses_++;
+    watch(objectID, addr.mSelector);
+    return present_.emplace(key, hal_.hasProperty(objectID, addr)).first->second;
+}
+
+std::vector<AudioObjectID> DeviceRegistry::fetchDeviceIDs()
+{
+    const auto &entry = fetch(kAudioObjectSystemObject, {kAudioHardwarePropertyDevices, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain}, 0);
+    std::vector<AudioObjectID> IDs(entry.data.size() / sizeof(AudioObjectID));
+    if (!IDs.empty())
+    {
+        std::memcpy(IDs.data(), entry.data.data(), IDs.size() * sizeof(AudioObjectID));
+    }
+    return IDs;
+}
+
+DeviceInfo DeviceRegistry::fetchDeviceInfo(AudioObjectID id)
+{
+    DeviceInfo dev;
+    dev.id = id;
+
+    AudioObjectPropertyAddress addr{kAudioDevicePropertyDeviceNameCFString, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain};
+    dev.name = QString::fromStdString(fetchString(id, addr).str);
+
+    addr.mSelector = kAudioDevicePropertyDeviceManufacturerCFString;
+    dev.manufacturer = QString::fromStdString(fetchString(id, addr).str);
+
+    addr.mSelector = kAudioDevicePropertyDeviceUID;
+    dev.deviceUID = QString::fromStdString(fetchString(id, addr).str);
+
+    addr.mSelector = kAudioDevicePropertyDeviceIsAlive;
+    dev.alive = fetchValue<UInt32>(id, addr);
+
+    addr.mSelector = kAudioDevicePropertyDeviceIsRunning;
+    dev.running = fetchValue<UInt32>(id, addr);
+
+    addr.mSelector = kAudioClockDevicePropertyNominalSampleRate;
+    dev.sampleRate = fetchValue<Float64>(id, addr);
+
+    addr.mSelector = kAudioDevicePropertyAvailableNominalSampleRates;
+    const auto &rates = fetch(id, addr, 0).data;
+    dev.availSampleRates.resize(rates.size() / sizeof(AudioValueRange));
+    if (!dev.availSampleRates.empty())
+    {
+        std::memcpy(dev.availSampleRates.data(), rates.data(), dev.availSampleRates.size() * sizeof(AudioValueRange));
+    }
+
+    dev.numOutputs = fetchNumChannels(id, kAudioObjectPropertyScopeOutput);
+    dev.numInputs = fetchNumChannels(id, kAudioObjectPropertyScopeInput);
+    return dev;
+}
+
+UInt32 DeviceRegistry::fetchNumChannels(AudioObjectID deviceID, AudioObjectPropertyScope scope)
+{
+    const auto &data = fetch(deviceID, {kAudioDevicePropertyStreamConfiguration, scope, kAudioObjectPropertyElementMain}, 0).data;
+    if (data.size() < sizeof(UInt32))
+    {
+        return 0;
+    }
+    auto list = reinterpret_cast<const AudioBufferList*>(data.data());
+    const size_t maxBuffers = (data.size() - offsetof(AudioBufferList, mBuffers)) / sizeof(AudioBuffer);
+    if (list->mNumberBuffers > maxBuffers)
+    {
+        throw std::runtime_error("Invalid stream configuration");
+    }
+    UInt32 numChannels = 0;
+    for (UInt32 k = 0; k < list->mNumberBuffers; k++)
+    {
+        numChannels += list->mBuffers[k].mNumberChannels;
+    }
+    return numChannels;
+}
+
+LatencyComponents DeviceRegistry::fetchLatency(AudioObjectID deviceID, AudioObjectPropertyScope scope)
+{
+    LatencyComponents c;
+    AudioObjectPropertyAddress addr{kAudioDevicePropertyLatency, scope, kAudioObjectPropertyElementMain};
+    c.device = fetchValue<UInt32>(deviceID, addr);
+
+    addr.mSelector = kAudioDevicePropertySafetyOffset;
+    c.safetyOffset = fetchValue<UInt32>(deviceID, addr);
+
+    addr.mSelector = kAudioDevicePropertyBufferFrameSize;
+    c.bufferFrames = fetchValue<UInt32>(deviceID, addr);
+
+    // Optional on older drivers
+    addr.mSelector = kAudioDevicePropertyIOCycleUsage;
+    addr.mScope = kAudioObjectPropertyScopeGlobal;
+    if ((scope == kAudioObjectPropertyScopeOutput) && fetchHasProperty(deviceID, addr))
+    {
+        c.ioCycleUsage = fetchValue<Float32>(deviceID, addr);
+    }
+
+    addr = AudioObjectPropertyAddress{kAudioStreamPropertyLatency, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain};
+    for (auto id : fetchStreams(deviceID, scope))
+    {
+        c.stream = std::max<uint32_t>(c.stream, fetchValue<UInt32>(id, addr));
+    }
+    return c;
+}
+
+std::vector<AudioObjectID> DeviceRegistry::fetchStreams(AudioObjectID deviceID, AudioObjectPropertyScope scope)
+{
+    const auto &ids = fetch(deviceID, {kAudioDevicePropertyStreams, scope, kAudioObjectPropertyElementMain}, 0).data;
+    std::vector<AudioObjectID> streamIDs(ids.size() / sizeof(AudioObjectID));
+    if (!streamIDs.empty())
+    {
+        std::memcpy(streamIDs.data(), ids.data(), streamIDs.size() * sizeof(AudioObjectID));
+    }
+    return streamIDs;
+}
+
+void DeviceRegistry::watch(AudioObjectID objectID, AudioObjectPropertySelector selector)
+{
+    const auto id = std::make_pair(objectID, selector);
+    if (watches_.count(id) > 0)
+    {
+        return;
+    }
+    const AudioObjectPropertyAddress addr{selector, kAudioObjectPropertyScopeWildcard, kAudioObjectPropertyElementWildcard};
+    const auto token = hal_.addListener(objectID, addr, [this](AudioObjectID objectID, const AudioObjectPropertyAddress *addresses, UInt32 numAddresses) {
+        onChange(objectID, addresses, numAddresses);
+    });
+    if (token == 0)
+    {
+        throw std::runtime_error("AudioObjectAddPropertyListener() failed");
+    }
+    watches_[id] = token;
+}
+
+void DeviceRegistry::onChange(AudioObjectID objectID, const AudioObjectPropertyAddress *addresses, UInt32 numAddresses)
+{
+    for (UInt32 k = 0; k < numAddresses; k++)
+    {
+        if ((objectID == kAudioObjectSystemObject) && (addresses[k].mSelector == kAudioHardwarePropertyDevices))
+        {
+            clear();
+            return;
+        }
+        invalidate(objectID, addresses[k].mSelector);
+    }
+}
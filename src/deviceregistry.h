@@ -0,0 +1,189 @@
+#ifndef DEVICEREGISTRY_H
+#define DEVICEREGISTRY_H
+
+#include "audiohal.h"
+#include "latencymodel.h"
+
+#include <QString>
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+
+struct DeviceInfo
+{
+    AudioObjectID id{0};
+    QString name;
+    QString manufacturer;
+    QString deviceUID;
+    UInt32 alive{0};
+    UInt32 running{0};
+    UInt32 numInputs{0};
+    UInt32 numOutputs{0};
+    Float64 sampleRate{0};
+    std::vector<AudioValueRange> availSampleRates;
+};
+
+
+/**
+ * @brief Caching property layer over an AudioHAL
+ *
+ * Every property is fetched from the HAL once and kept until the HAL reports a
+ * change: the first read of a selector on an object registers one listener for
+ * it (all scopes and elements), which drops the cached values on notification.
+ * Fixed-size values are read with a single call, variable-length ones into a
+ * cached byte buffer, so repeated enumeration neither calls the HAL nor allocates
+ * temporary property buffers. A change of the device list drops the whole cache.
+ *
+ * All methods are thread-safe and throw std::runtime_error if the HAL fails.
+ * Writes go straight to the HAL; the cached value follows its notification.
+ */
+class DeviceRegistry
+{
+public:
+    explicit DeviceRegistry(AudioHAL &hal);
+    ~DeviceRegistry();
+
+    DeviceRegistry(const DeviceRegistry&) = delete;
+    DeviceRegistry& operator=(const DeviceRegistry&) = delete;
+
+    AudioHAL& hal() {return hal_;}
+
+    std::vector<AudioObjectID> deviceIDs();
+
+    /**
+     * @brief Describe all devices in one pass under a single lock
+     */
+    std::vector<DeviceInfo> devices();
+    DeviceInfo deviceInfo(AudioObjectID deviceID);
+
+    AudioObjectID defaultInputDevice();
+    AudioObjectID defaultOutputDevice();
+
+    /**
+     * @brief Total number of channels over all streams in one direction
+     * @param deviceID
+     * @param scope kAudioObjectPropertyScopeInput or kAudioObjectPropertyScopeOutput
+     */
+    UInt32 numChannels(AudioObjectID deviceID, AudioObjectPropertyScope scope);
+
+    /**
+     * @brief Reported latency components of both directions
+     */
+    LatencyModel latencyModel(AudioObjectID deviceID);
+
+    /**
+     * @brief Stream objects of one direction, in I/O buffer order
+     */
+    std::vector<AudioObjectID> streams(AudioObjectID deviceID, AudioObjectPropertyScope scope);
+
+    /**
+     * @brief Current format of every stream of one direction
+     * @param deviceID
+     * @param scope
+     * @param physical The format on the hardware side instead of the one seen by an IOProc
+     */
+    std::vector<AudioStreamBasicDescription> streamFormats(AudioObjectID deviceID, AudioObjectPropertyScope scope, bool physical = false);
+
+    /**
+     * @brief Read a constant-length property
+     */
+    template<typename T>
+    T get(AudioObjectID objectID, const AudioObjectPropertyAddress& addr)
+    {
+        T value;
+        read(objectID, addr, &value, static_cast<UInt32>(sizeof(T)));
+        return value;
+    }
+
+    /**
+     * @brief Read a vector of constant-length property elements
+     */
+    template<typename T>
+    std::vector<T> getArray(AudioObjectID objectID, const AudioObjectPropertyAddress& addr)
+    {
+        const auto bytes = getRaw(objectID, addr);
+        if ((bytes.size() % sizeof(T)) != 0)
+        {
+            throw std::runtime_error("Invalid number of elements returned from AudioObjectGetPropertyData()");
+        }
+        std::vector<T> values(bytes.size() / sizeof(T));
+        if (!values.empty())
+        {
+            std::memcpy(values.data(), bytes.data(), bytes.size());
+        }
+        return values;
+    }
+
+    /**
+     * @brief Read a variable-length property
+     */
+    std::vector<uint8_t> getRaw(AudioObjectID objectID, const AudioObjectPropertyAddress& addr);
+    std::string getString(AudioObjectID objectID, const AudioObjectPropertyAddress& addr);
+
+    template<typename T>
+    void set(AudioObjectID objectID, const AudioObjectPropertyAddress& addr, const T& value)
+    {
+        write(objectID, addr, &value, static_cast<UInt32>(sizeof(T)));
+    }
+
+    /**
+     * @brief Drop the cached values of one selector on one object
+     */
+    void invalidate(AudioObjectID objectID, AudioObjectPropertySelector selector);
+    void clear();
+
+    uint64_t hits() const;
+    uint64_t misses() const;
+
+private:
+    struct Key
+    {
+        AudioObjectID objectID;
+        AudioObjectPropertySelector selector;
+        AudioObjectPropertyScope scope;
+        AudioObjectPropertyElement element;
+
+        bool operator<(const Key& other) const;
+    };
+
+    struct Entry
+    {
+        std::vector<uint8_t> data;
+        std::string str;
+    };
+
+    void read(AudioObjectID objectID, const AudioObjectPropertyAddress& addr, void *data, UInt32 dataSize);
+    void write(AudioObjectID objectID, const AudioObjectPropertyAddress& addr, const void *data, UInt32 dataSize);
+
+    // Called with mutex_ held
+    const Entry& fetch(AudioObjectID objectID, const AudioObjectPropertyAddress& addr, UInt32 fixedSize);
+    const Entry& fetchString(AudioObjectID objectID, const AudioObjectPropertyAddress& addr);
+    template<typename T>
+    T fetchValue(AudioObjectID objectID, const AudioObjectPropertyAddress& addr);
+    bool fetchHasProperty(AudioObjectID objectID, const AudioObjectPropertyAddress& addr);
+    std::vector<AudioObjectID> fetchDeviceIDs();
+    DeviceInfo fetchDeviceInfo(AudioObjectID deviceID);
+    UInt32 fetchNumChannels(AudioObjectID deviceID, AudioObjectPropertyScope scope);
+    LatencyComponents fetchLatency(AudioObjectID deviceID, AudioObjectPropertyScope scope);
+    std::vector<AudioObjectID> fetchStreams(AudioObjectID deviceID, AudioObjectPropertyScope scope);
+    void watch(AudioObjectID objectID, AudioObjectPropertySelector selector);
+
+    void onChange(AudioObjectID objectID, const AudioObjectPropertyAddress *addresses, UInt32 numAddresses);
+
+    AudioHAL &hal_;
+    mutable std::mutex mutex_;
+    std::map<Key, Entry> cache_;
+    std::map<Key, bool> present_;       ///< Cached hasProperty() of optional properties
+    std::map<std::pair<AudioObjectID, AudioObjectPropertySelector>, AudioHAL::ListenerToken> watches_;
+    uint64_t hits_{0};
+    uint64_t misses_{0};
+};
+
+#endif // DEVICEREGISTRY_H
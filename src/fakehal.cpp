@@ -0,0 +1,370 @@
+#include "fakehal.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <tuple>
+
+
+namespace {
+
+bool matches(AudioObjectID objectID, const AudioObjectPropertyAddress& changed,
+             AudioObjectID listenID, const AudioObjectPropertyAddress& listen)
+{
+    return (objectID == listenID) &&
+           ((listen.mSelector == kAudioObjectPropertySelectorWildcard) || (listen.mSelector == changed.mSelector)) &&
+           ((listen.mScope == kAudioObjectPropertyScopeWildcard) || (listen.mScope == changed.mScope)) &&
+           ((listen.mElement == kAudioObjectPropertyElementWildcard) || (listen.mElement == changed.mElement));
+}
+
+std::vector<uint8_t> makeStreamConfiguration(const std::vector<UInt32>& streams)
+{
+    const size_t size = std::max(sizeof(AudioBufferList), offsetof(AudioBufferList, mBuffers) + streams.size() * sizeof(AudioBuffer));
+    std::vector<uint8_t> data(size, 0);
+    auto list = reinterpret_cast<AudioBufferList*>(data.data());
+    list->mNumberBuffers = static_cast<UInt32>(streams.size());
+    for (size_t k = 0; k < streams.size(); k++)
+    {
+        list->mBuffers[k].mNumberChannels = streams[k];
+    }
+    return data;
+}
+
+}   // anonymous namespace
+
+
+bool FakeHAL::Key::operator<(const Key& other) const
+{
+    return std::tie(objectID, selector, scope, element) < std::tie(other.objectID, other.selector, other.scope, other.element);
+}
+
+FakeHAL::FakeHAL()
+{
+    updateDeviceList();
+    setDefaultDevices(kAudioObjectUnknown, kAudioObjectUnknown);
+}
+
+AudioObjectID FakeHAL::addDevice(const FakeDeviceSpec& spec)
+{
+    AudioObjectID deviceID;
+    std::vector<AudioObjectID> inStreams;
+    std::vector<AudioObjectID> outStreams;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        deviceID = nextID_++;
+        for (size_t k = 0; k < spec.inputStreams.size(); k++)
+        {
+            inStreams.push_back(nextID_++);
+        }
+        for (size_t k = 0; k < spec.outputStreams.size(); k++)
+        {
+            outStreams.push_back(nextID_++);
+        }
+        devices_.push_back(deviceID);
+        auto &streams = streams_[deviceID];
+        streams = inStreams;
+        streams.insert(streams.end(), outStreams.begin(), outStreams.end());
+
+        AudioObjectPropertyAddress addr{kAudioObjectPropertyName, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain};
+        strings_[Key{deviceID, addr.mSelector, addr.mScope, addr.mElement}] = spec.name;
+        addr.mSelector = kAudioObjectPropertyManufacturer;
+        strings_[Key{deviceID, addr.mSelector, addr.mScope, addr.mElement}] = spec.manufacturer;
+        addr.mSelector = kAudioDevicePropertyDeviceUID;
+        strings_[Key{deviceID, addr.mSelector, addr.mScope, addr.mElement}] = spec.uid.empty() ? ("FakeDevice" + std::to_string(deviceID)) : spec.uid;
+
+        const UInt32 alive = 1;
+        const UInt32 running = 0;
+        addr.mSelector = kAudioDevicePropertyDeviceIsAlive;
+        store(deviceID, addr, &alive, sizeof(alive));
+        addr.mSelector = kAudioDevicePropertyDeviceIsRunning;
+        store(deviceID, addr, &running, sizeof(running));
+        addr.mSelector = kAudioDevicePropertyNominalSampleRate;
+        store(deviceID, addr, &spec.sampleRate, sizeof(spec.sampleRate));
+        addr.mSelector = kAudioDevicePropertyBufferFrameSize;
+        store(deviceID, addr, &spec.bufferFrameSize, sizeof(spec.bufferFrameSize));
+        addr.mSelector = kAudioDevicePropertyBufferFrameSizeRange;
+        store(deviceID, addr, &spec.bufferFrameSizeRange, sizeof(spec.bufferFrameSizeRange));
+        addr.mSelector = kAudioDevicePropertyIOCycleUsage;
+        store(deviceID, addr, &spec.ioCycleUsage, sizeof(spec.ioCycleUsage));
+
+        std::vector<AudioValueRange> rates;
+        for (auto rate : spec.availSampleRates)
+        {
+            rates.push_back(AudioValueRange{rate, rate});
+        }
+        addr.mSelector = kAudioDevicePropertyAvailableNominalSampleRates;
+        store(deviceID, addr, rates.data(), static_cast<UInt32>(rates.size() * sizeof(AudioValueRange)));
+
+        const struct
+        {
+            AudioObjectPropertyScope scope;
+            const std::vector<UInt32> &channels;
+            const std::vector<AudioObjectID> &ids;
+            UInt32 latency;
+            UInt32 safetyOffset;
+        } directions[] = {
+            {kAudioObjectPropertyScopeInput, spec.inputStreams, inStreams, spec.inputLatency, spec.inputSafetyOffset},
+            {kAudioObjectPropertyScopeOutput, spec.outputStreams, outStreams, spec.outputLatency, spec.outputSafetyOffset},
+        };
+        for (const auto &dir : directions)
+        {
+            addr.mScope = dir.scope;
+            const auto config = makeStreamConfiguration(dir.channels);
+            addr.mSelector = kAudioDevicePropertyStreamConfiguration;
+            store(deviceID, addr, config.data(), static_cast<UInt32>(config.size()));
+            addr.mSelector = kAudioDevicePropertyStreams;
+            store(deviceID, addr, dir.ids.data(), static_cast<UInt32>(dir.ids.size() * sizeof(AudioObjectID)));
+            addr.mSelector = kAudioDevicePropertyLatency;
+            store(deviceID, addr, &dir.latency, sizeof(dir.latency));
+            addr.mSelector = kAudioDevicePropertySafetyOffset;
+            store(deviceID, addr, &dir.safetyOffset, sizeof(dir.safetyOffset));
+        }
+
+        addr = AudioObjectPropertyAddress{kAudioStreamPropertyLatency, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain};
+        for (auto id : streams)
+        {
+            store(id, addr, &spec.streamLatency, sizeof(spec.streamLatency));
+        }
+
+        // Stream formats follow the channels of each stream and the current sample rate
+        for (const auto &dir : directions)
+        {
+            for (size_t k = 0; k < dir.ids.size(); k++)
+            {
+                addr.mSelector = kAudioStreamPropertyVirtualFormat;
+                const auto virtualFormat = makeStreamDescription(spec.virtualFormat, spec.sampleRate, dir.channels[k]);
+                store(dir.ids[k], addr, &virtualFormat, sizeof(virtualFormat));
+
+                std::vector<AudioStreamRangedDescription> available;
+                for (auto format : spec.physicalFormats)
+                {
+                    for (auto rate : spec.availSampleRates)
+                    {
+                        available.push_back(AudioStreamRangedDescription{makeStreamDescription(format, rate, dir.channels[k]), {rate, rate}});
+                    }
+                }
+                addr.mSelector = kAudioStreamPropertyAvailablePhysicalFormats;
+                store(dir.ids[k], addr, available.data(), static_cast<UInt32>(available.size() * sizeof(AudioStreamRangedDescription)));
+                if (!spec.physicalFormats.empty())
+                {
+                    addr.mSelector = kAudioStreamPropertyPhysicalFormat;
+                    const auto physicalFormat = makeStreamDescription(spec.physicalFormats.front(), spec.sampleRate, dir.channels[k]);
+                    store(dir.ids[k], addr, &physicalFormat, sizeof(physicalFormat));
+                }
+            }
+        }
+    }
+    updateDeviceList();
+    return deviceID;
+}
+
+void FakeHAL::removeDevice(AudioObjectID deviceID)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = std::find(devices_.begin(), devices_.end(), deviceID);
+        if (it == devices_.end())
+        {
+            return;
+        }
+        devices_.erase(it);
+
+        std::vector<AudioObjectID> objects = streams_[deviceID];
+        objects.push_back(deviceID);
+        streams_.erase(deviceID);
+        auto removeObjects = [&objects](auto &map) {
+            for (auto entry = map.begin(); entry != map.end(); )
+            {
+                if (std::find(objects.begin(), objects.end(), entry->first.objectID) != objects.end())
+                {
+                    entry = map.erase(entry);
+                }
+                else
+                {
+                    ++entry;
+                }
+            }
+        };
+        removeObjects(properties_);
+        removeObjects(strings_);
+    }
+    updateDeviceList();
+}
+
+void FakeHAL::setDefaultDevices(AudioObjectID inputID, AudioObjectID outputID)
+{
+    setProperty(kAudioObjectSystemObject, {kAudioHardwarePropertyDefaultInputDevice, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain}, inputID);
+    setProperty(kAudioObjectSystemObject, {kAudioHardwarePropertyDefaultOutputDevice, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain}, outputID);
+}
+
+void FakeHAL::updateDeviceList()
+{
+    std::vector<AudioObjectID> devices;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        devices = devices_;
+    }
+    setProperties(kAudioObjectSystemObject, {kAudioHardwarePropertyDevices, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain}, devices);
+}
+
+void FakeHAL::setProperty(AudioObjectID objectID, const AudioObjectPropertyAddress& addr, const void *data, UInt32 dataSize)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        store(objectID, addr, data, dataSize);
+    }
+    notify(objectID, addr);
+}
+
+void FakeHAL::setString(AudioObjectID objectID, const AudioObjectPropertyAddress& addr, const std::string& value)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        strings_[Key{objectID, addr.mSelector, addr.mScope, addr.mElement}] = value;
+    }
+    notify(objectID, addr);
+}
+
+void FakeHAL::store(AudioObjectID objectID, const AudioObjectPropertyAddress& addr, const void *data, UInt32 dataSize)
+{
+    auto bytes = static_cast<const uint8_t*>(data);
+    properties_[Key{objectID, addr.mSelector, addr.mScope, addr.mElement}].assign(bytes, bytes + dataSize);
+}
+
+const std::vector<uint8_t>* FakeHAL::find(AudioObjectID objectID, const AudioObjectPropertyAddress& addr) const
+{
+    auto it = properties_.find(Key{objectID, addr.mSelector, addr.mScope, addr.mElement});
+    if ((it == properties_.end()) && (addr.mScope != kAudioObjectPropertyScopeGlobal))
+    {
+        it = properties_.find(Key{objectID, addr.mSelector, kAudioObjectPropertyScopeGlobal, addr.mElement});
+    }
+    return (it != properties_.end()) ? &it->second : nullptr;
+}
+
+const std::string* FakeHAL::findString(AudioObjectID objectID, const AudioObjectPropertyAddress& addr) const
+{
+    auto it = strings_.find(Key{objectID, addr.mSelector, addr.mScope, addr.mElement});
+    if ((it == strings_.end()) && (addr.mScope != kAudioObjectPropertyScopeGlobal))
+    {
+        it = strings_.find(Key{objectID, addr.mSelector, kAudioObjectPropertyScopeGlobal, addr.mElement});
+    }
+    return (it != strings_.end()) ? &it->second : nullptr;
+}
+
+void FakeHAL::notify(AudioObjectID objectID, const AudioObjectPropertyAddress& addr)
+{
+    std::vector<Listener> listeners;
+    {
+        std::lock_guard<std::mutex> lock(listenerMutex_);
+        for (const auto &entry : listeners_)
+        {
+            if (matches(objectID, addr, entry.second.objectID, entry.second.addr))
+            {
+                listeners.push_back(entry.second.listener);
+            }
+        }
+    }
+    for (const auto &listener : listeners)
+    {
+        listener(objectID, &addr, 1);
+    }
+}
+
+void FakeHAL::call()
+{
+    numCalls_.fetch_add(1, std::memory_order_relaxed);
+    if (callCost_.count() > 0)
+    {
+        const auto until = std::chrono::steady_clock::now() + callCost_;
+        while (std::chrono::steady_clock::now() < until)
+        {
+        }
+    }
+}
+
+bool FakeHAL::hasProperty(AudioObjectID objectID, const AudioObjectPropertyAddress& addr)
+{
+    call();
+    std::lock_guard<std::mutex> lock(mutex_);
+    return (find(objectID, addr) != nullptr) || (findString(objectID, addr) != nullptr);
+}
+
+OSStatus FakeHAL::getPropertyDataSize(AudioObjectID objectID, const AudioObjectPropertyAddress& addr, UInt32 &dataSize)
+{
+    call();
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto data = find(objectID, addr);
+    if (data == nullptr)
+    {
+        return kAudioHardwareUnknownPropertyError;
+    }
+    dataSize = static_cast<UInt32>(data->size());
+    return kAudioHardwareNoError;
+}
+
+OSStatus FakeHAL::getPropertyData(AudioObjectID objectID, const AudioObjectPropertyAddress& addr, UInt32 &dataSize, void *data)
+{
+    call();
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto value = find(objectID, addr);
+    if (value == nullptr)
+    {
+        return kAudioHardwareUnknownPropertyError;
+    }
+    if (dataSize < value->size())
+    {
+        return kAudioHardwareBadPropertySizeError;
+    }
+    dataSize = static_cast<UInt32>(value->size());
+    std::memcpy(data, value->data(), value->size());
+    return kAudioHardwareNoError;
+}
+
+OSStatus FakeHAL::setPropertyData(AudioObjectID objectID, const AudioObjectPropertyAddress& addr, UInt32 dataSize, const void *data)
+{
+    call();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const auto value = find(objectID, addr);
+        if (value == nullptr)
+        {
+            return kAudioHardwareUnknownPropertyError;
+        }
+        if (dataSize != value->size())
+        {
+            return kAudioHardwareBadPropertySizeError;
+        }
+        store(objectID, addr, data, dataSize);
+    }
+    notify(objectID, addr);
+    return kAudioHardwareNoError;
+}
+
+OSStatus FakeHAL::getStringProperty(AudioObjectID objectID, const AudioObjectPropertyAddress& addr, std::string &value)
+{
+    call();
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto str = findString(objectID, addr);
+    if (str == nullptr)
+    {
+        return kAudioHardwareUnknownPropertyError;
+    }
+    value = *str;
+    return kAudioHardwareNoError;
+}
+
+AudioHAL::ListenerToken FakeHAL::addListener(AudioObjectID objectID, const AudioObjectPropertyAddress& addr, Listener listener)
+{
+    call();
+    std::lock_guard<std::mutex> lock(listenerMutex_);
+    const auto token = nextToken_++;
+    listeners_[token] = Registration{objectID, addr, std::move(listener)};
+    return token;
+}
+
+void FakeHAL::removeListener(ListenerToken token)
+{
+    call();
+    std::lock_guard<std::mutex> lock(listenerMutex_);
+    listeners_.erase(token);
+}
@@ -0,0 +1,136 @@
+#ifndef FAKEHAL_H
+#define FAKEHAL_H
+
+#include "audiohal.h"
+#include "sampleformat.h"
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+
+struct FakeDeviceSpec
+{
+    std::string name{"Fake Device"};
+    std::string manufacturer{"Fake"};
+    std::string uid;                            ///< Generated from the object ID if empty
+    std::vector<UInt32> inputStreams{2};        ///< Channels per input stream
+    std::vector<UInt32> outputStreams{2};       ///< Channels per output stream
+    Float64 sampleRate{48e3};
+    std::vector<Float64> availSampleRates{44.1e3, 48e3, 96e3};
+    UInt32 bufferFrameSize{512};
+    AudioValueRange bufferFrameSizeRange{15, 4096};
+    UInt32 inputLatency{0};                     ///< Device latency in frames
+    UInt32 outputLatency{0};
+    UInt32 inputSafetyOffset{0};
+    UInt32 outputSafetyOffset{0};
+    UInt32 streamLatency{0};                    ///< Latency of every stream in frames
+    Float32 ioCycleUsage{1.0f};
+    SampleFormat virtualFormat{SampleFormat::Float32};     ///< Format of the IOProc buffers
+    std::vector<SampleFormat> physicalFormats{SampleFormat::Int24, SampleFormat::Int16, SampleFormat::Int32};    ///< The first one is current
+};
+
+
+/**
+ * @brief In-memory audio object tree
+ *
+ * Holds the system object and any number of devices with their streams, so code
+ * on top of AudioHAL can be exercised and benchmarked without audio hardware.
+ * Every call is counted and can be given an artificial cost to model the IPC
+ * round trip of the real HAL. Changing a property notifies matching listeners
+ * synchronously on the calling thread.
+ *
+ * Properties not found in a directional scope fall back to the global scope,
+ * as most device properties do on the real HAL.
+ */
+class FakeHAL : public AudioHAL
+{
+public:
+    FakeHAL();
+
+    AudioObjectID addDevice(const FakeDeviceSpec& spec);
+    void removeDevice(AudioObjectID deviceID);
+    void setDefaultDevices(AudioObjectID inputID, AudioObjectID outputID);
+
+    /**
+     * @brief Change or create a property, as if done by the hardware
+     */
+    void setProperty(AudioObjectID objectID, const AudioObjectPropertyAddress& addr, const void *data, UInt32 dataSize);
+    void setString(AudioObjectID objectID, const AudioObjectPropertyAddress& addr, const std::string& value);
+
+    template<typename T>
+    void setProperty(AudioObjectID objectID, const AudioObjectPropertyAddress& addr, const T& value)
+    {
+        setProperty(objectID, addr, &value, static_cast<UInt32>(sizeof(T)));
+    }
+
+    template<typename T>
+    void setProperties(AudioObjectID objectID, const AudioObjectPropertyAddress& addr, const std::vector<T>& values)
+    {
+        setProperty(objectID, addr, values.data(), static_cast<UInt32>(values.size() * sizeof(T)));
+    }
+
+    /**
+     * @brief Number of AudioHAL calls since construction or resetCalls()
+     */
+    uint64_t numCalls() const {return numCalls_.load(std::memory_order_relaxed);}
+    void resetCalls() {numCalls_.store(0, std::memory_order_relaxed);}
+
+    /**
+     * @brief Busy time added to every AudioHAL call
+     */
+    void setCallCost(std::chrono::nanoseconds cost) {callCost_ = cost;}
+
+    bool hasProperty(AudioObjectID objectID, const AudioObjectPropertyAddress& addr) override;
+    OSStatus getPropertyDataSize(AudioObjectID objectID, const AudioObjectPropertyAddress& addr, UInt32 &dataSize) override;
+    OSStatus getPropertyData(AudioObjectID objectID, const AudioObjectPropertyAddress& addr, UInt32 &dataSize, void *data) override;
+    OSStatus setPropertyData(AudioObjectID objectID, const AudioObjectPropertyAddress& addr, UInt32 dataSize, const void *data) override;
+    OSStatus getStringProperty(AudioObjectID objectID, const AudioObjectPropertyAddress& addr, std::string &value) override;
+    ListenerToken addListener(AudioObjectID objectID, const AudioObjectPropertyAddress& addr, Listener listener) override;
+    void removeListener(ListenerToken token) override;
+
+private:
+    struct Key
+    {
+        AudioObjectID objectID;
+        AudioObjectPropertySelector selector;
+        AudioObjectPropertyScope scope;
+        AudioObjectPropertyElement element;
+
+        bool operator<(const Key& other) const;
+    };
+
+    struct Registration
+    {
+        AudioObjectID objectID;
+        AudioObjectPropertyAddress addr;
+        Listener listener;
+    };
+
+    void call();
+    const std::vector<uint8_t>* find(AudioObjectID objectID, const AudioObjectPropertyAddress& addr) const;
+    const std::string* findString(AudioObjectID objectID, const AudioObjectPropertyAddress& addr) const;
+    void store(AudioObjectID objectID, const AudioObjectPropertyAddress& addr, const void *data, UInt32 dataSize);
+    void notify(AudioObjectID objectID, const AudioObjectPropertyAddress& addr);
+    void updateDeviceList();
+
+    mutable std::mutex mutex_;
+    std::map<Key, std::vector<uint8_t>> properties_;
+    std::map<Key, std::string> strings_;
+    std::vector<AudioObjectID> devices_;
+    std::map<AudioObjectID, std::vector<AudioObjectID>> streams_;
+    AudioObjectID nextID_{kAudioObjectSystemObject + 1};
+
+    std::mutex listenerMutex_;
+    std::map<ListenerToken, Registration> listeners_;
+    ListenerToken nextToken_{1};
+
+    std::atomic<uint64_t> numCalls_{0};
+    std::chrono::nanoseconds callCost_{0};
+};
+
+#endif // FAKEHAL_H
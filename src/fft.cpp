@@ -0,0 +1,147 @@
+#include "fft.h"
+#include "simd.h"
+
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+
+FFT::FFT(size_t size)
+    : size_(size)
+{
+    if ((size < 8) || ((size & (size - 1)) != 0))
+    {
+        throw std::invalid_argument("FFT size must be a power of two >= 8");
+    }
+
+    size_t numBits = 0;
+    while ((size_t(1) << numBits) < size)
+    {
+        numBits++;
+    }
+    bitReverse_.resize(size);
+    for (size_t k = 0; k < size; k++)
+    {
+        uint32_t r = 0;
+        for (size_t b = 0; b < numBits; b++)
+        {
+            r |= ((k >> b) & 1) << (numBits - 1 - b);
+        }
+        bitReverse_[k] = r;
+    }
+
+    // Twiddles of the stage with half-length m start at offset m - 1
+    constexpr double twoPI = 6.283185307179586;
+    twiddleRe_.resize(size - 1);
+    twiddleIm_.resize(size - 1);
+    for (size_t m = 1; m < size; m <<= 1)
+    {
+        for (size_t j = 0; j < m; j++)
+        {
+            const double angle = -twoPI * static_cast<double>(j) / static_cast<double>(2 * m);
+            twiddleRe_[m - 1 + j] = static_cast<float>(std::cos(angle));
+            twiddleIm_[m - 1 + j] = static_cast<float>(std::sin(angle));
+        }
+    }
+
+    scratchRe_.resize(size);
+    scratchIm_.resize(size);
+}
+
+void FFT::permute(float *re, float *im) const
+{
+    for (size_t k = 0; k < size_; k++)
+    {
+        const size_t r = bitReverse_[k];
+        if (r > k)
+        {
+            std::swap(re[k], re[r]);
+            std::swap(im[k], im[r]);
+        }
+    }
+}
+
+void FFT::forward(float *re, float *im) const
+{
+    permute(re, im);
+
+    // First two stages as scalar radix-4 butterflies
+    for (size_t k = 0; k < size_; k += 4)
+    {
+        const float r0 = re[k] + re[k + 1], i0 = im[k] + im[k + 1];
+        const float r1 = re[k] - re[k + 1], i1 = im[k] - im[k + 1];
+        const float r2 = re[k + 2] + re[k + 3], i2 = im[k + 2] + im[k + 3];
+        const float r3 = re[k + 2] - re[k + 3], i3 = im[k + 2] - im[k + 3];
+
+        // Twiddle -i for the odd element of the second stage
+        re[k] = r0 + r2;        im[k] = i0 + i2;
+        re[k + 2] = r0 - r2;    im[k + 2] = i0 - i2;
+        re[k + 1] = r1 + i3;    im[k + 1] = i1 - r3;
+        re[k + 3] = r1 - i3;    im[k + 3] = i1 + r3;
+    }
+
+    for (size_t m = 4; m < size_; m <<= 1)
+    {
+        const float *wRe = twiddleRe_.data() + m - 1;
+        const float *wIm = twiddleIm_.data() + m - 1;
+        for (size_t k = 0; k < size_; k += 2 * m)
+        {
+            float *aRe = re + k;
+            float *aIm = im + k;
+            float *bRe = aRe + m;
+            float *bIm = aIm + m;
+            for (size_t j = 0; j < m; j += simd::kWidth)
+            {
+                const auto wr = simd::load(wRe + j);
+                const auto wi = simd::load(wIm + j);
+                const auto br = simd::load(bRe + j);
+                const auto bi = simd::load(bIm + j);
+                const auto tr = simd::sub(simd::mul(br, wr), simd::mul(bi, wi));
+                const auto ti = simd::add(simd::mul(br, wi), simd::mul(bi, wr));
+                const auto ar = simd::load(aRe + j);
+                const auto ai = simd::load(aIm + j);
+                simd::store(aRe + j, simd::add(ar, tr));
+                simd::store(aIm + j, simd::add(ai, ti));
+                simd::store(bRe + j, simd::sub(ar, tr));
+                simd::store(bIm + j, simd::sub(ai, ti));
+            }
+        }
+    }
+}
+
+void FFT::inverse(float *re, float *im) const
+{
+    // ifft(x) = conj(fft(conj(x))) / N
+    for (size_t k = 0; k < size_; k++)
+    {
+        im[k] = -im[k];
+    }
+    forward(re, im);
+
+    const float scale = 1.0f / static_cast<float>(size_);
+    for (size_t k = 0; k < size_; k++)
+    {
+        re[k] *= scale;
+        im[k] *= -scale;
+    }
+}
+
+void FFT::forwardReal2(const float *x, const float *y, float *xRe, float *xIm, float *yRe, float *yIm)
+{
+    // Z = FFT(x + iy), X[k] = (Z[k] + conj(Z[N-k])) / 2, Y[k] = (Z[k] - conj(Z[N-k])) / 2i
+    std::copy(x, x + size_, scratchRe_.begin());
+    std::copy(y, y + size_, scratchIm_.begin());
+    forward(scratchRe_.data(), scratchIm_.data());
+
+    const size_t half = size_ / 2;
+    for (size_t k = 0; k <= half; k++)
+    {
+        const size_t n = (size_ - k) & (size_ - 1);
+        const float zr = scratchRe_[k], zi = scratchIm_[k];
+        const float cr = scratchRe_[n], ci = -scratchIm_[n];
+        xRe[k] = 0.5f * (zr + cr);
+        xIm[k] = 0.5f * (zi + ci);
+        yRe[k] = 0.5f * (zi - ci);
+        yIm[k] = -0.5f * (zr - cr);
+    }
+}
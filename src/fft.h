@@ -0,0 +1,62 @@
+#ifndef FFT_H
+#define FFT_H
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+
+/**
+ * @brief In-place radix-2 complex FFT on split real/imaginary arrays
+ *
+ * The plan (bit-reversal table and per-stage contiguous twiddles) is built once
+ * for a fixed power-of-two size, e.g. the chirp period. All stages with at least
+ * four butterflies per group run on 4-lane SIMD vectors.
+ */
+class FFT
+{
+public:
+    explicit FFT(size_t size);
+
+    size_t size() const {return size_;}
+
+    /**
+     * @brief Forward transform, X[k] = sum x[n] exp(-2 pi i k n / N)
+     * @param re
+     * @param im
+     */
+    void forward(float *re, float *im) const;
+
+    /**
+     * @brief Inverse transform, scaled by 1/N
+     * @param re
+     * @param im
+     */
+    void inverse(float *re, float *im) const;
+
+    /**
+     * @brief Transform two real signals with one complex FFT
+     *
+     * Outputs the first size()/2 + 1 bins of each spectrum; the remaining bins
+     * are their complex conjugates.
+     * @param x First real input
+     * @param y Second real input
+     * @param xRe
+     * @param xIm
+     * @param yRe
+     * @param yIm
+     */
+    void forwardReal2(const float *x, const float *y, float *xRe, float *xIm, float *yRe, float *yIm);
+
+private:
+    void permute(float *re, float *im) const;
+
+    size_t size_{0};
+    std::vector<uint32_t> bitReverse_;
+    std::vector<float> twiddleRe_;
+    std::vector<float> twiddleIm_;
+    std::vector<float> scratchRe_;
+    std::vector<float> scratchIm_;
+};
+
+#endif // FFT_H
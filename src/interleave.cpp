@@ -0,0 +1,111 @@
+#include "interleave.h"
+#include "simd.h"
+
+#include <algorithm>
+
+
+namespace {
+
+void interleave4(const float *s0, const float *s1, const float *s2, const float *s3, float *dst, size_t dstStride, size_t numFrames)
+{
+    size_t k = 0;
+    for (; k + simd::kWidth <= numFrames; k += simd::kWidth)
+    {
+        auto a = simd::load(s0 + k);
+        auto b = simd::load(s1 + k);
+        auto c = simd::load(s2 + k);
+        auto d = simd::load(s3 + k);
+        simd::transpose4(a, b, c, d);
+        float *frame = dst + k * dstStride;
+        simd::store(frame, a);
+        simd::store(frame + dstStride, b);
+        simd::store(frame + 2 * dstStride, c);
+        simd::store(frame + 3 * dstStride, d);
+    }
+    for (; k < numFrames; k++)
+    {
+        float *frame = dst + k * dstStride;
+        frame[0] = s0[k];
+        frame[1] = s1[k];
+        frame[2] = s2[k];
+        frame[3] = s3[k];
+    }
+}
+
+void deinterleave4(const float *src, size_t srcStride, float *d0, float *d1, float *d2, float *d3, size_t numFrames)
+{
+    size_t k = 0;
+    for (; k + simd::kWidth <= numFrames; k += simd::kWidth)
+    {
+        const float *frame = src + k * srcStride;
+        auto a = simd::load(frame);
+        auto b = simd::load(frame + srcStride);
+        auto c = simd::load(frame + 2 * srcStride);
+        auto d = simd::load(frame + 3 * srcStride);
+        simd::transpose4(a, b, c, d);
+        simd::store(d0 + k, a);
+        simd::store(d1 + k, b);
+        simd::store(d2 + k, c);
+        simd::store(d3 + k, d);
+    }
+    for (; k < numFrames; k++)
+    {
+        const float *frame = src + k * srcStride;
+        d0[k] = frame[0];
+        d1[k] = frame[1];
+        d2[k] = frame[2];
+        d3[k] = frame[3];
+    }
+}
+
+}   // anonymous namespace
+
+
+void interleave(const float *const *src, size_t numChannels, float *dst, size_t dstStride, size_t numFrames)
+{
+    size_t ch = 0;
+    for (; ch + 4 <= numChannels; ch += 4)
+    {
+        interleave4(src[ch], src[ch + 1], src[ch + 2], src[ch + 3], dst + ch, dstStride, numFrames);
+    }
+    for (; ch < numChannels; ch++)
+    {
+        const float *s = src[ch];
+        float *d = dst + ch;
+        for (size_t k = 0; k < numFrames; k++)
+        {
+            d[k * dstStride] = s[k];
+        }
+    }
+}
+
+void deinterleave(const float *src, size_t srcStride, float *const *dst, size_t numChannels, size_t numFrames)
+{
+    size_t ch = 0;
+    for (; ch + 4 <= numChannels; ch += 4)
+    {
+        deinterleave4(src + ch, srcStride, dst[ch], dst[ch + 1], dst[ch + 2], dst[ch + 3], numFrames);
+    }
+    for (; ch < numChannels; ch++)
+    {
+        const float *s = src + ch;
+        float *d = dst[ch];
+        for (size_t k = 0; k < numFrames; k++)
+        {
+            d[k] = s[k * srcStride];
+        }
+    }
+}
+
+void copyChannels(const float *src, size_t srcStride, float *dst, size_t dstStride, size_t numChannels, size_t numFrames)
+{
+    if ((srcStride == numChannels) && (dstStride == numChannels))
+    {
+        std::copy(src, src + numFrames * numChannels, dst);
+        return;
+    }
+    for (size_t k = 0; k < numFrames; k++)
+    {
+        std::copy(src + k * srcStride, src + k * srcStride + numChannels, dst + k * dstStride);
+    }
+}
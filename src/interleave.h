@@ -0,0 +1,47 @@
+#ifndef INTERLEAVE_H
+#define INTERLEAVE_H
+
+#include <cstddef>
+
+
+/**
+ * Channel layout kernels between mono planes and interleaved frames
+ *
+ * Groups of four channels are transposed 4x4 on SIMD registers, remaining
+ * channels are copied with a stride. dstStride/srcStride is the number of channels per interleaved
+ * frame, so a run of planes can be written into any channel offset of a wider
+ * frame.
+ */
+
+/**
+ * @brief Interleave numChannels mono planes into frames of dstStride channels
+ * @param src Plane pointers
+ * @param numChannels
+ * @param dst First channel of the destination run
+ * @param dstStride
+ * @param numFrames
+ */
+void interleave(const float *const *src, size_t numChannels, float *dst, size_t dstStride, size_t numFrames);
+
+/**
+ * @brief Split numChannels channels of frames with srcStride channels into mono planes
+ * @param src First channel of the source run
+ * @param srcStride
+ * @param dst Plane pointers
+ * @param numChannels
+ * @param numFrames
+ */
+void deinterleave(const float *src, size_t srcStride, float *const *dst, size_t numChannels, size_t numFrames);
+
+/**
+ * @brief Copy numChannels adjacent channels between interleaved buffers of different widths
+ * @param src
+ * @param srcStride
+ * @param dst
+ * @param dstStride
+ * @param numChannels
+ * @param numFrames
+ */
+void copyChannels(const float *src, size_t srcStride, float *dst, size_t dstStride, size_t numChannels, size_t numFrames);
+
+#endif // INTERLEAVE_H
@@ -0,0 +1,525 @@
+#include "latencyanalyzer.h"
+#include "recordingfile.h"
+#include "chirp.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+
+namespace {
+
+/**
+ * Feed all chunks of a recording and mark its dropouts between the frames around them
+ */
+template <typename Analyzer>
+void addRecording(const RecordingReader& reader, Analyzer& analyzer)
+{
+    const size_t numChannels = reader.info().numChannels;
+    const auto &dropouts = reader.dropouts();
+    auto next = dropouts.begin();
+    uint64_t chunkFirst = 0;
+    for (size_t k = 0; k < reader.numChunks(); k++)
+    {
+        const float *data = reader.chunkData(k);
+        const uint64_t chunkEnd = chunkFirst + reader.chunkFrames(k);
+        uint64_t frame = chunkFirst;
+        while (frame < chunkEnd)
+        {
+            if ((next != dropouts.end()) && (*next == frame))
+            {
+                analyzer.markDropout();
+                ++next;
+                continue;
+            }
+            const uint64_t end = ((next != dropouts.end()) && (*next < chunkEnd)) ? *next : chunkEnd;
+            analyzer.addSamples(data + (frame - chunkFirst) * numChannels, static_cast<size_t>(end - frame));
+            frame = end;
+        }
+        chunkFirst = chunkEnd;
+    }
+}
+
+}   // anonymous namespace
+
+
+
+Deconvolver::Deconvolver(size_t period)
+    : fft_(period)
+    , inRe_(period / 2 + 1)
+    , inIm_(period / 2 + 1)
+    , outRe_(period / 2 + 1)
+    , outIm_(period / 2 + 1)
+    , scratch_(period)
+{
+}
+
+void Deconvolver::transfer(const float *in, const float *out, float *hRe, float *hIm)
+{
+    fft_.forwardReal2(in, out, inRe_.data(), inIm_.data(), outRe_.data(), outIm_.data());
+
+    for (size_t k = 0; k < inRe_.size(); k++)
+    {
+        // In double, so that weak input bins keep their precision
+        const double inRe = inRe_[k];
+        const double inIm = inIm_[k];
+        const double mag2 = inRe * inRe + inIm * inIm;
+        if (mag2 > 0)
+        {
+            hRe[k] = static_cast<float>((outRe_[k] * inRe + outIm_[k] * inIm) / mag2);
+            hIm[k] = static_cast<float>((outIm_[k] * inRe - outRe_[k] * inIm) / mag2);
+        }
+        else
+        {
+            hRe[k] = 0;
+            hIm[k] = 0;
+        }
+    }
+}
+
+void Deconvolver::impulseResponse(const float *hRe, const float *hIm, float *h)
+{
+    const size_t period = fft_.size();
+    const size_t numBins = period / 2 + 1;
+    std::copy(hRe, hRe + numBins, h);
+    std::copy(hIm, hIm + numBins, scratch_.begin());
+    for (size_t k = numBins; k < period; k++)
+    {
+        h[k] = h[period - k];
+        scratch_[k] = -scratch_[period - k];
+    }
+    fft_.inverse(h, scratch_.data());
+}
+
+size_t findPeak(const float *h, size_t size)
+{
+    size_t idx = 0;
+    for (size_t k = 1; k < size; k++)
+    {
+        if (std::abs(h[k]) > std::abs(h[idx]))
+        {
+            idx = k;
+        }
+    }
+    return idx;
+}
+
+double interpolatePeak(const float *h, size_t size, size_t peak)
+{
+    const float a = std::abs(h[(peak + size - 1) % size]);
+    const float b = std::abs(h[peak]);
+    const float c = std::abs(h[(peak + 1) % size]);
+    const float denom = a - 2 * b + c;
+    if (denom >= 0)
+    {
+        return static_cast<double>(peak);
+    }
+    return peak + 0.5 * (a - c) / denom;
+}
+
+double phaseSlopeDelay(const float *hRe, const float *hIm, size_t period, double delay, float polarity)
+{
+    constexpr double twoPI = 6.283185307179586;
+    const auto d0 = static_cast<long long>(std::llround(delay));
+    const auto shift = static_cast<size_t>(((d0 % static_cast<long long>(period)) + period) % period);
+
+    const double sign = (polarity < 0) ? -1.0 : 1.0;
+    double num = 0;
+    double den = 0;
+    for (size_t k = 1; k <= period / 4; k++)
+    {
+        // G = sign * H * exp(+i 2 pi k d0 / N), phase reduced modulo N for accuracy
+        const double angle = twoPI * static_cast<double>((k * shift) % period) / static_cast<double>(period);
+        const double c = sign * std::cos(angle);
+        const double s = sign * std::sin(angle);
+        const double gr = hRe[k] * c - hIm[k] * s;
+        const double gi = hRe[k] * s + hIm[k] * c;
+        const double w = gr * gr + gi * gi;
+        const double phi = std::atan2(gi, gr);
+        num += w * static_cast<double>(k) * phi;
+        den += w * static_cast<double>(k) * static_cast<double>(k);
+    }
+    if (den <= 0)
+    {
+        return static_cast<double>(d0);
+    }
+    return static_cast<double>(d0) - (num / den) * static_cast<double>(period) / twoPI;
+}
+
+double relativePeakDelay(const float *h0, const float *h1, size_t period, size_t &delay)
+{
+    const size_t peak0 = findPeak(h0, period);
+    const size_t peak1 = findPeak(h1, period);
+    delay = (peak1 + period - peak0) % period;
+
+    double fractional = interpolatePeak(h1, period, peak1) - interpolatePeak(h0, period, peak0);
+    fractional = std::fmod(fractional, static_cast<double>(period));
+    return (fractional < 0) ? (fractional + static_cast<double>(period)) : fractional;
+}
+
+DriftEstimator::DriftEstimator(size_t period)
+    : period_{period}
+{
+}
+
+void DriftEstimator::add(double delay)
+{
+    if (count_ > 0)
+    {
+        const double half = 0.5 * static_cast<double>(period_);
+        while (delay - last_ > half)
+        {
+            delay -= static_cast<double>(period_);
+        }
+        while (delay - last_ < -half)
+        {
+            delay += static_cast<double>(period_);
+        }
+    }
+    last_ = delay;
+
+    // Welford-style update of means and co-moments
+    const double x = static_cast<double>(count_++);
+    const double dx = x - meanX_;
+    meanX_ += dx / count_;
+    meanY_ += (delay - meanY_) / count_;
+    cxx_ += dx * (x - meanX_);
+    cxy_ += dx * (delay - meanY_);
+}
+
+void DriftEstimator::reset()
+{
+    count_ = 0;
+    last_ = meanX_ = meanY_ = cxx_ = cxy_ = 0;
+}
+
+double DriftEstimator::ppm() const
+{
+    if ((count_ < 2) || (cxx_ <= 0))
+    {
+        return 0;
+    }
+    return (cxy_ / cxx_) / static_cast<double>(period_) * 1e6;
+}
+
+LatencyAnalyzer::LatencyAnalyzer(size_t period, double sampleRate, size_t numChannels, size_t skipPeriods)
+    : deconvolver_(std::make_unique<Deconvolver>(period))
+    , period_{period}
+    , sampleRate_{sampleRate}
+    , numChannels_{numChannels}
+    , skipFrames_{skipPeriods * period}
+    , in_(period)
+    , out_(period)
+    , hRe_(period / 2 + 1)
+    , hIm_(period / 2 + 1)
+    , h_(period)
+    , drift_(period)
+    , sumRe_(period / 2 + 1, 0.0)
+    , sumIm_(period / 2 + 1, 0.0)
+    , peakLevels_(numChannels, 0.0f)
+{
+    if (numChannels_ < 2)
+    {
+        throw std::invalid_argument("LatencyAnalyzer: at least two channels required");
+    }
+}
+
+LatencyAnalyzer::LatencyAnalyzer(const StimulusSignal& stimulus, double sampleRate, size_t numChannels, size_t skipPeriods)
+    : correlator_(std::make_unique<StimulusCorrelator>(stimulus))
+    , period_{stimulus.size()}
+    , sampleRate_{sampleRate}
+    , numChannels_{numChannels}
+    , skipFrames_{skipPeriods * stimulus.size()}
+    , in_(stimulus.size())
+    , out_(stimulus.size())
+    , h_(stimulus.size())
+    , drift_(stimulus.size())
+    , sumRe_(stimulus.size(), 0.0)
+    , sumIm_(stimulus.size(), 0.0)
+    , peakLevels_(numChannels, 0.0f)
+{
+    if (numChannels_ < 2)
+    {
+        throw std::invalid_argument("LatencyAnalyzer: at least two channels required");
+    }
+    hRe_.resize(period_);
+    hIm_.resize(period_);
+}
+
+void LatencyAnalyzer::addSamples(const float *samples, size_t numFrames)
+{
+    for (size_t k = 0; k < numFrames; k++)
+    {
+        const float *frame = samples + k * numChannels_;
+        for (size_t ch = 0; ch < numChannels_; ch++)
+        {
+            peakLevels_[ch] = std::max(peakLevels_[ch], std::abs(frame[ch]));
+        }
+    }
+
+    const size_t skip = std::min(skipFrames_, numFrames);
+    skipFrames_ -= skip;
+    samples += skip * numChannels_;
+    numFrames -= skip;
+
+    while (numFrames > 0)
+    {
+        const size_t count = std::min(numFrames, period_ - fill_);
+        for (size_t k = 0; k < count; k++)
+        {
+            in_[fill_ + k] = samples[0];
+            out_[fill_ + k] = samples[1];
+            samples += numChannels_;
+        }
+        fill_ += count;
+        numFrames -= count;
+
+        if (fill_ == period_)
+        {
+            if (discard_)
+            {
+                discard_ = false;
+            }
+            else if (correlator_)
+            {
+                addKnownBlock();
+            }
+            else
+            {
+                addBlock();
+            }
+            fill_ = 0;
+        }
+    }
+}
+
+void LatencyAnalyzer::markDropout()
+{
+    // A gap in the warm-up only moves the stimulus, which the first block then defines
+    discard_ = discard_ || (skipFrames_ == 0);
+    realign_ = true;
+}
+
+void LatencyAnalyzer::addBlock()
+{
+    // H of both channels does not depend on where the period grid cuts the stimulus
+    realign_ = false;
+    deconvolver_->transfer(in_.data(), out_.data(), hRe_.data(), hIm_.data());
+    for (size_t k = 0; k < sumRe_.size(); k++)
+    {
+        sumRe_[k] += hRe_[k];
+        sumIm_[k] += hIm_[k];
+    }
+
+    // Only the first block needs the impulse response to locate the peak;
+    // later blocks refine around the previous block's delay.
+    if (numBlocks_ == 0)
+    {
+        deconvolver_->impulseResponse(hRe_.data(), hIm_.data(), h_.data());
+        const size_t peak = findPeak(h_.data(), period_);
+        blockDelay_ = static_cast<double>(peak);
+        blockPolarity_ = h_[peak];
+    }
+    blockDelay_ = phaseSlopeDelay(hRe_.data(), hIm_.data(), period_, blockDelay_, blockPolarity_);
+    drift_.add(blockDelay_);
+    numBlocks_++;
+}
+
+void LatencyAnalyzer::addKnownBlock()
+{
+    // hRe_ and hIm_ hold the impulse responses of channel 0 and 1
+    correlator_->impulseResponse(in_.data(), 1, hRe_.data());
+    correlator_->impulseResponse(out_.data(), 1, hIm_.data());
+    if (numBlocks_ == 0)
+    {
+        referencePeak_ = findPeak(hRe_.data(), period_);
+    }
+    else if (realign_)
+    {
+        rotation_ = (findPeak(hRe_.data(), period_) + period_ - referencePeak_) % period_;
+    }
+    realign_ = false;
+    for (size_t k = 0; k < period_; k++)
+    {
+        const size_t n = (k + rotation_) % period_;
+        sumRe_[k] += hRe_[n];
+        sumIm_[k] += hIm_[n];
+    }
+
+    size_t delay;
+    blockDelay_ = relativePeakDelay(hRe_.data(), hIm_.data(), period_, delay);
+    drift_.add(blockDelay_);
+    numBlocks_++;
+}
+
+LatencyResult LatencyAnalyzer::result()
+{
+    LatencyResult result;
+    result.numBlocks = numBlocks_;
+    result.peakLevels = peakLevels_;
+    if (numBlocks_ == 0)
+    {
+        return result;
+    }
+
+    if (correlator_)
+    {
+        const double scale = 1.0 / static_cast<double>(numBlocks_);
+        std::vector<float> h0(period_);
+        result.impulseResponse.resize(period_);
+        for (size_t k = 0; k < period_; k++)
+        {
+            h0[k] = static_cast<float>(sumRe_[k] * scale);
+            result.impulseResponse[k] = static_cast<float>(sumIm_[k] * scale);
+        }
+        result.fractionalDelay = relativePeakDelay(h0.data(), result.impulseResponse.data(), period_, result.delay);
+        result.delayMs = result.delay * 1000.0 / sampleRate_;
+        result.fractionalDelayMs = result.fractionalDelay * 1000.0 / sampleRate_;
+        result.driftPpm = drift_.ppm();
+        return result;
+    }
+
+    // mean(real(ifft(H))) == real(ifft(mean(H)))
+    const double scale = 1.0 / static_cast<double>(numBlocks_);
+    std::vector<float> meanRe(sumRe_.size()), meanIm(sumIm_.size());
+    for (size_t k = 0; k < sumRe_.size(); k++)
+    {
+        meanRe[k] = static_cast<float>(sumRe_[k] * scale);
+        meanIm[k] = static_cast<float>(sumIm_[k] * scale);
+    }
+    result.impulseResponse.resize(period_);
+    deconvolver_->impulseResponse(meanRe.data(), meanIm.data(), result.impulseResponse.data());
+
+    result.delay = findPeak(result.impulseResponse.data(), period_);
+    result.delayMs = result.delay * 1000.0 / sampleRate_;
+    result.fractionalDelay = phaseSlopeDelay(meanRe.data(), meanIm.data(), period_, static_cast<double>(result.delay),
+                                             result.impulseResponse[result.delay]);
+    result.fractionalDelayMs = result.fractionalDelay * 1000.0 / sampleRate_;
+    result.driftPpm = drift_.ppm();
+    return result;
+}
+
+LatencyMatrixAnalyzer::LatencyMatrixAnalyzer(const StimulusSignal& stimulus, size_t numInputs, size_t numOutputs, size_t skipPeriods)
+    : stimulus_(stimulus)
+    , period_{stimulus.size()}
+    , numInputs_{numInputs}
+    , numOutputs_{numOutputs}
+    , skipFrames_{skipPeriods * stimulus.size()}
+    , current_(stimulus.size() * numInputs)
+    , sum_(stimulus.size() * numInputs, 0.0)
+{
+    if ((numInputs_ == 0) || (numOutputs_ == 0) || (matrixOutputShift(period_, numOutputs_) < 2))
+    {
+        throw std::invalid_argument("LatencyMatrixAnalyzer: invalid channel counts");
+    }
+    if (stimulus_.validLags() < period_)
+    {
+        throw std::invalid_argument("LatencyMatrixAnalyzer: stimulus does not cover the whole period");
+    }
+}
+
+void LatencyMatrixAnalyzer::addSamples(const float *samples, size_t numFrames)
+{
+    if (dropout_)
+    {
+        return;
+    }
+
+    const size_t skip = std::min(skipFrames_, numFrames);
+    skipFrames_ -= skip;
+    samples += skip * numInputs_;
+    numFrames -= skip;
+
+    while (numFrames > 0)
+    {
+        const size_t count = std::min(numFrames, period_ - fill_);
+        std::copy(samples, samples + count * numInputs_, current_.begin() + fill_ * numInputs_);
+        samples += count * numInputs_;
+        fill_ += count;
+        numFrames -= count;
+
+        if (fill_ == period_)
+        {
+            for (size_t k = 0; k < sum_.size(); k++)
+            {
+                sum_[k] += current_[k];
+            }
+            numBlocks_++;
+            fill_ = 0;
+        }
+    }
+}
+
+LatencyMatrixResult LatencyMatrixAnalyzer::result() const
+{
+    // Minimum peak-to-RMS ratio of the impulse response for a connected pair
+    constexpr double kMinPeakToRms = 8.0;
+
+    LatencyMatrixResult result;
+    result.numBlocks = numBlocks_;
+    result.numInputs = numInputs_;
+    result.numOutputs = numOutputs_;
+    result.delays.assign(numInputs_ * numOutputs_, std::numeric_limits<double>::quiet_NaN());
+    if (numBlocks_ == 0)
+    {
+        return result;
+    }
+
+    const size_t shift = matrixOutputShift(period_, numOutputs_);
+    StimulusCorrelator correlator(stimulus_);
+    std::vector<float> mean(period_), h(period_);
+    const double scale = 1.0 / static_cast<double>(numBlocks_);
+
+    for (size_t in = 0; in < numInputs_; in++)
+    {
+        for (size_t k = 0; k < period_; k++)
+        {
+            mean[k] = static_cast<float>(sum_[k * numInputs_ + in] * scale);
+        }
+        correlator.impulseResponse(mean.data(), 1, h.data());
+
+        double energy = 0;
+        for (auto x : h)
+        {
+            energy += double(x) * x;
+        }
+        const double rms = std::sqrt(energy / period_);
+
+        for (size_t out = 0; out < numOutputs_; out++)
+        {
+            const size_t start = out * shift;
+            const size_t peak = start + findPeak(h.data() + start, shift);
+            if ((rms > 0) && (std::abs(h[peak]) >= kMinPeakToRms * rms))
+            {
+                result.delays[out * numInputs_ + in] = interpolatePeak(h.data(), period_, peak) - static_cast<double>(start);
+            }
+        }
+    }
+    return result;
+}
+
+LatencyResult analyzeRecording(const std::filesystem::path& filename)
+{
+    RecordingReader reader(filename);
+    const auto &info = reader.info();
+    if (info.stimulus != StimulusType::Chirp)
+    {
+        LatencyAnalyzer analyzer(StimulusSignal::get(info.stimulus, nominalStimulusPeriod(info.stimulus, info.period)), info.sampleRate, info.numChannels);
+        addRecording(reader, analyzer);
+        return analyzer.result();
+    }
+
+    LatencyAnalyzer analyzer(info.period, info.sampleRate, info.numChannels);
+    addRecording(reader, analyzer);
+    return analyzer.result();
+}
+
+LatencyMatrixResult analyzeMatrixRecording(const std::filesystem::path& filename)
+{
+    RecordingReader reader(filename);
+    const auto &info = reader.info();
+    LatencyMatrixAnalyzer analyzer(StimulusSignal::get(info.stimulus, nominalStimulusPeriod(info.stimulus, info.period)), info.numChannels, info.numOutputs);
+    addRecording(reader, analyzer);
+    return analyzer.result();
+}
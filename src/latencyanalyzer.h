@@ -0,0 +1,261 @@
+#ifndef LATENCYANALYZER_H
+#define LATENCYANALYZER_H
+
+#include "fft.h"
+#include "stimulus.h"
+
+#include <memory>
+#include <vector>
+#include <filesystem>
+#include <cstddef>
+
+
+struct LatencyResult
+{
+    size_t numBlocks{0};
+    size_t delay{0};                        ///< argmax(|h|) in samples
+    double delayMs{0};
+    double fractionalDelay{0};              ///< Sub-sample delay from the phase slope of H or the interpolated peaks
+    double fractionalDelayMs{0};
+    double driftPpm{0};                     ///< Delay change per elapsed sample across blocks
+    std::vector<float> impulseResponse;     ///< h averaged over all blocks, against the stimulus if known
+    std::vector<float> peakLevels;          ///< max(|x|) per channel
+};
+
+
+/**
+ * @brief Deconvolve one period of looped-back output by its reference input
+ */
+class Deconvolver
+{
+public:
+    explicit Deconvolver(size_t period);
+
+    size_t period() const {return fft_.size();}
+
+    /**
+     * @brief H = Out / In on the first period/2 + 1 bins
+     * @param in
+     * @param out
+     * @param hRe
+     * @param hIm
+     */
+    void transfer(const float *in, const float *out, float *hRe, float *hIm);
+
+    /**
+     * @brief h = real(ifft(H)) from the first period/2 + 1 bins of a Hermitian H
+     * @param hRe
+     * @param hIm
+     * @param h Output of period samples
+     */
+    void impulseResponse(const float *hRe, const float *hIm, float *h);
+
+private:
+    FFT fft_;
+    std::vector<float> inRe_, inIm_, outRe_, outIm_;
+    std::vector<float> scratch_;
+};
+
+/**
+ * @brief Index of max(|h|)
+ */
+size_t findPeak(const float *h, size_t size);
+
+/**
+ * @brief Parabolic interpolation of |h| around a peak
+ * @param h
+ * @param size
+ * @param peak Index returned by findPeak()
+ * @return Fractional peak position in samples
+ */
+double interpolatePeak(const float *h, size_t size, size_t peak);
+
+/**
+ * @brief Fractional delay from the phase slope of H
+ *
+ * H is first compensated by the rounded delay and the polarity of the peak, then
+ * the residual phase is fitted by a magnitude-weighted line through the origin
+ * over the lower half of the band. Without the polarity, an inverted loopback
+ * wraps the residual phase by pi and biases the fit. Falls back to the integer
+ * delay if H carries no energy there.
+ * @param hRe H on the first period/2 + 1 bins
+ * @param hIm
+ * @param period
+ * @param delay Delay estimate within +-1 sample
+ * @param polarity Sign of the impulse response at the peak, -1 for an inverted path
+ * @return Refined delay in samples
+ */
+double phaseSlopeDelay(const float *hRe, const float *hIm, size_t period, double delay, float polarity = 1.0f);
+
+/**
+ * @brief Delay between two impulse responses measured against the same known stimulus
+ * @param h0 Response of the reference input
+ * @param h1 Response of the looped-back output
+ * @param period
+ * @param delay Integer delay of the peaks, modulo period
+ * @return Fractional delay from the interpolated peaks, in [0, period)
+ */
+double relativePeakDelay(const float *h0, const float *h1, size_t period, size_t &delay);
+
+/**
+ * @brief Running linear fit of the delay across periods
+ *
+ * Observations are one period apart; the slope in samples per elapsed sample is
+ * the relative clock offset between input and output.
+ */
+class DriftEstimator
+{
+public:
+    explicit DriftEstimator(size_t period);
+
+    /**
+     * @brief Add the delay of the next period, unwrapped across the period boundary
+     * @param delay
+     */
+    void add(double delay);
+    void reset();
+
+    size_t count() const {return count_;}
+    double ppm() const;
+
+private:
+    const size_t period_;
+    size_t count_{0};
+    double last_{0};
+    double meanX_{0};
+    double meanY_{0};
+    double cxx_{0};
+    double cxy_{0};
+};
+
+/**
+ * @brief Estimate the in-to-out delay from a periodic stimulus recording
+ *
+ * Channel 0 is the reference input and channel 1 the looped-back output. After
+ * skipping the warm-up, every full period is transformed, H = Out / In is
+ * accumulated and the averaged impulse response real(ifft(H)) is searched for
+ * its peak. Memory use is bounded by a few periods regardless of the
+ * recording length.
+ *
+ * Given a known stimulus instead, both channels are deconvolved by it and the
+ * delay is the distance between the peaks of their averaged impulse responses.
+ * This works for periods that are not a power of two, such as an MLS.
+ *
+ * A period with a dropout in it is left out. As a gap shifts the stimulus
+ * against the period grid, the impulse responses of the periods after it are
+ * rotated to put the peak of channel 0 where it was in the first period.
+ */
+class LatencyAnalyzer
+{
+public:
+    LatencyAnalyzer(size_t period, double sampleRate, size_t numChannels = 2, size_t skipPeriods = 2);
+    LatencyAnalyzer(const StimulusSignal& stimulus, double sampleRate, size_t numChannels = 2, size_t skipPeriods = 2);
+
+    /**
+     * @brief Feed interleaved samples, any number of frames at a time
+     * @param samples
+     * @param numFrames
+     */
+    void addSamples(const float *samples, size_t numFrames);
+
+    /**
+     * @brief Samples were dropped just before the next ones fed; the period in progress is left out
+     */
+    void markDropout();
+
+    size_t numBlocks() const {return numBlocks_;}
+
+    LatencyResult result();
+
+private:
+    void addBlock();
+    void addKnownBlock();
+
+    std::unique_ptr<Deconvolver> deconvolver_;
+    std::unique_ptr<StimulusCorrelator> correlator_;
+    const size_t period_;
+    const double sampleRate_;
+    const size_t numChannels_;
+    size_t skipFrames_;
+    size_t fill_{0};
+    size_t numBlocks_{0};
+    std::vector<float> in_;
+    std::vector<float> out_;
+    std::vector<float> hRe_, hIm_, h_;
+    double blockDelay_{0};
+    float blockPolarity_{1.0f};     ///< Sign of h at the peak of the first block
+    bool discard_{false};           ///< The period in progress has a dropout
+    bool realign_{false};           ///< A dropout since the last block
+    size_t referencePeak_{0};       ///< Peak of channel 0 in the first block against a known stimulus
+    size_t rotation_{0};            ///< Of the blocks since the last dropout against a known stimulus
+    DriftEstimator drift_;
+    std::vector<double> sumRe_;     ///< Sum of H, or of h of channel 0 against a known stimulus
+    std::vector<double> sumIm_;     ///< Sum of h of channel 1 against a known stimulus
+    std::vector<float> peakLevels_;
+};
+
+struct LatencyMatrixResult
+{
+    size_t numBlocks{0};
+    size_t numInputs{0};
+    size_t numOutputs{0};
+    std::vector<double> delays;     ///< Fractional delay in samples, [output * numInputs + input], NaN if not connected
+
+    double delay(size_t output, size_t input) const {return delays[output * numInputs + input];}
+};
+
+
+/**
+ * @brief Output-to-input latency matrix from a matrix layout recording
+ *
+ * Each input is averaged over whole periods in the time domain, then deconvolved
+ * once by the known stimulus. Output j's contribution appears in the window
+ * [j * shift, (j + 1) * shift) of the impulse response, so the stimulus must
+ * give exact impulse responses over the whole period (not Golay). Without a
+ * reference channel the periods cannot be realigned after a dropout, so the
+ * average stops at the first one.
+ */
+class LatencyMatrixAnalyzer
+{
+public:
+    LatencyMatrixAnalyzer(const StimulusSignal& stimulus, size_t numInputs, size_t numOutputs, size_t skipPeriods = 2);
+
+    void addSamples(const float *samples, size_t numFrames);
+
+    /**
+     * @brief Samples were dropped just before the next ones fed; ignore all that follow
+     */
+    void markDropout() {dropout_ = true;}
+
+    size_t numBlocks() const {return numBlocks_;}
+
+    LatencyMatrixResult result() const;
+
+private:
+    const StimulusSignal &stimulus_;
+    const size_t period_;
+    const size_t numInputs_;
+    const size_t numOutputs_;
+    size_t skipFrames_;
+    size_t fill_{0};
+    size_t numBlocks_{0};
+    bool dropout_{false};
+    std::vector<float> current_;    ///< Period being filled, interleaved
+    std::vector<double> sum_;       ///< Interleaved per-input sum of all complete periods
+};
+
+/**
+ * @brief Analyse a recording file chunk by chunk through its memory mapping, marking its dropouts
+ * @param filename
+ * @return
+ */
+LatencyResult analyzeRecording(const std::filesystem::path& filename);
+
+/**
+ * @brief Analyse a matrix layout recording file
+ * @param filename
+ * @return
+ */
+LatencyMatrixResult analyzeMatrixRecording(const std::filesystem::path& filename);
+
+#endif // LATENCYANALYZER_H
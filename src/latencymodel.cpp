@@ -0,0 +1,46 @@
+#include "latencymodel.h"
+
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+
+std::string LatencyModel::report(double ioSpan, double measured) const
+{
+    const double toMs = (sampleRate > 0) ? (1e3 / sampleRate) : 0.0;
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(1);
+
+    auto row = [&ss](const char *name, double in, double out) {
+        ss << "  " << std::left << std::setw(16) << name << std::right
+           << std::setw(10) << in << std::setw(10) << out << std::setw(10) << (in + out) << "\n";
+    };
+    ss << "  " << std::left << std::setw(16) << "frames" << std::right
+       << std::setw(10) << "input" << std::setw(10) << "output" << std::setw(10) << "total" << "\n";
+    row("device", input.device, output.device);
+    row("stream", input.stream, output.stream);
+    row("safety offset", input.safetyOffset, output.safetyOffset);
+    row("buffer", input.buffering(false), output.buffering(true));
+    row("reported", input.total(false), output.total(true));
+    ss << "  I/O cycle usage " << std::setprecision(2) << output.ioCycleUsage << std::setprecision(1) << "\n";
+
+    const double reported = reportedRoundTrip();
+    ss << "Reported round trip:   " << reported << " frames, " << std::setprecision(3) << reported * toMs << " ms" << std::setprecision(1) << "\n";
+    if (std::isfinite(ioSpan))
+    {
+        const double predicted = timestampRoundTrip(ioSpan);
+        ss << "Timestamp round trip:  " << predicted << " frames, " << std::setprecision(3) << predicted * toMs << " ms"
+           << std::setprecision(1) << " (output - input sample time " << ioSpan << ")\n";
+    }
+    if (std::isfinite(measured))
+    {
+        ss << "Measured round trip:   " << measured << " frames, " << std::setprecision(3) << measured * toMs << " ms" << std::setprecision(1) << "\n";
+        ss << "Unexplained:           " << (measured - reported) << " frames against reported";
+        if (std::isfinite(ioSpan))
+        {
+            ss << ", " << (measured - timestampRoundTrip(ioSpan)) << " frames against timestamps";
+        }
+        ss << "\n";
+    }
+    return ss.str();
+}
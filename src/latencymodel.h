@@ -0,0 +1,59 @@
+#ifndef LATENCYMODEL_H
+#define LATENCYMODEL_H
+
+#include <string>
+#include <cstdint>
+
+
+/**
+ * @brief Reported latency of one direction of a device, in frames
+ */
+struct LatencyComponents
+{
+    uint32_t device{0};         ///< kAudioDevicePropertyLatency
+    uint32_t stream{0};         ///< kAudioStreamPropertyLatency, largest over the streams
+    uint32_t safetyOffset{0};   ///< kAudioDevicePropertySafetyOffset
+    uint32_t bufferFrames{0};   ///< kAudioDevicePropertyBufferFrameSize
+    double ioCycleUsage{1.0};   ///< Fraction of the buffer period before output is due (output only)
+
+    double buffering(bool output) const {return output ? (bufferFrames * ioCycleUsage) : bufferFrames;}
+    double total(bool output) const {return device + stream + safetyOffset + buffering(output);}
+};
+
+
+/**
+ * @brief Expected round trip of an output-to-input loopback
+ *
+ * The reported round trip adds up all components of both directions: the input
+ * side waits for a full buffer, the output side for the part of the buffer
+ * period given by the I/O cycle usage. The timestamp prediction starts from the
+ * span between the output and input sample times of the I/O cycles, which
+ * already covers buffering and safety offsets, and adds the device and stream
+ * latencies the HAL does not include in its timestamps.
+ */
+struct LatencyModel
+{
+    double sampleRate{0};
+    LatencyComponents input;
+    LatencyComponents output;
+
+    double reportedRoundTrip() const {return input.total(false) + output.total(true);}
+
+    /**
+     * @param ioSpan Mean output minus input sample time of the I/O cycles
+     */
+    double timestampRoundTrip(double ioSpan) const
+    {
+        return ioSpan + input.device + input.stream + output.device + output.stream;
+    }
+
+    /**
+     * @brief Table of the components and predicted against measured round trip
+     * @param ioSpan Mean output minus input sample time, NaN if unknown
+     * @param measured Measured round trip in frames, NaN if unknown
+     * @return Multi-line text
+     */
+    std::string report(double ioSpan, double measured) const;
+};
+
+#endif // LATENCYMODEL_H
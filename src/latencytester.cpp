@@ -0,0 +1,176 @@
+#include "latencytester.h"
+#include "chirp.h"
+
+#include <QDebug>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <stdexcept>
+
+
+LatencyTester::LatencyTester(const RecordingInfo& info, const std::string& resultPath, LatencyTracker::Callback onEstimate,
+                             WorkerPool *pool, const SoakConfig *soak)
+    : signal_(StimulusSignal::get(info.stimulus, info.period))
+    , sampleRate_(info.sampleRate)
+    , numInputs_(info.numChannels)
+    , numOutputs_(info.numOutputs)
+    , layout_(info.layout)
+    , tap_(info.numChannels, info.numOutputs, signal_.size())
+{
+    if ((layout_ == StimulusLayout::Passthrough) && ((numInputs_ < 2) || (numOutputs_ < 2)))
+    {
+        throw std::invalid_argument("LatencyTester: passthrough needs at least two inputs and outputs");
+    }
+    if ((numInputs_ == 0) || (numOutputs_ == 0))
+    {
+        throw std::invalid_argument("LatencyTester: no channels");
+    }
+    if ((layout_ == StimulusLayout::Matrix) && (signal_.validLags() < signal_.size()))
+    {
+        throw std::invalid_argument("LatencyTester: the matrix layout needs a stimulus covering the whole period");
+    }
+
+    // The estimates also feed the live view and, in soak mode, flag anomalies
+    onEstimate = [this, next = std::move(onEstimate)](const LatencyEstimate& e) {
+        const auto &h = tracker_->impulseResponse();
+        tap_.addResponse(h.data(), h.size(), e);
+        if (soak_ != nullptr)
+        {
+            soak_->addEstimate(e);
+        }
+        if (next)
+        {
+            next(e);
+        }
+    };
+
+    // The chirp keeps the reference-free deconvolution of the loopback by input 0
+    if (info.stimulus == StimulusType::Chirp)
+    {
+        tracker_ = std::make_unique<LatencyTracker>(info.period, info.sampleRate, info.numChannels, std::move(onEstimate));
+    }
+    else
+    {
+        tracker_ = std::make_unique<LatencyTracker>(signal_, info.sampleRate, info.numChannels, std::move(onEstimate));
+    }
+
+    const size_t period = signal_.size();
+    if (layout_ == StimulusLayout::Matrix)
+    {
+        // Output j plays the stimulus delayed by j * shift
+        const size_t shift = matrixOutputShift(period, numOutputs_);
+        matrix_.resize(period * numOutputs_);
+        for (size_t n = 0; n < period; n++)
+        {
+            for (size_t ch = 0; ch < numOutputs_; ch++)
+            {
+                matrix_[n * numOutputs_ + ch] = signal_.data()[(n + period - (ch * shift) % period) % period];
+            }
+        }
+    }
+    stimulus_.signal = signal_.data();
+    stimulus_.table = matrix_.data();
+    stimulus_.period = period;
+
+    RecordingInfo recordingInfo = info;
+    recordingInfo.period = period;
+    recordingInfo.startTime = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+
+    auto recordingFilename = std::filesystem::absolute(resultPath) / (soak ? "soak.tcal" : "recording.tcal");
+    RecordingWriter::Listener listener;
+    if (layout_ == StimulusLayout::Passthrough)
+    {
+        listener = [this](const float *samples, size_t count) {
+            tracker_->addSamples(samples, count);
+        };
+    }
+    if (soak != nullptr)
+    {
+        auto recorder = std::make_unique<SoakRecorder>(recordingFilename.parent_path(), recordingInfo, *soak, std::move(listener));
+        soak_ = recorder.get();
+        writer_ = std::make_unique<RecordingWriter>(std::move(recorder), RecordingWriter::Listener(), 1 << 20, pool);
+    }
+    else
+    {
+        writer_ = std::make_unique<RecordingWriter>(recordingFilename, recordingInfo, std::move(listener), 1 << 20, pool);
+    }
+
+    qDebug() << "###############################################################";
+    qDebug() << "Write recording to " << QString::fromStdString(recordingFilename);
+    qDebug() << "Selected device sample rate: " << sampleRate_;
+    qDebug() << "Stimulus: " << stimulusName(signal_.type()) << ", period " << signal_.size();
+    qDebug() << "Channels: " << numInputs_ << " in, " << numOutputs_ << " out";
+}
+
+LatencyTester::~LatencyTester()
+{
+    close();
+}
+
+void LatencyTester::close()
+{
+    if (writer_)
+    {
+        writer_->close();
+        qDebug() << "Recorded samples: " << writer_->writtenSamples();
+        qDebug() << "Recording overruns: " << writer_->overruns() << " (" << writer_->droppedSamples() << " samples dropped)";
+        overruns_ = writer_->overruns();
+        if (writer_->failed())
+        {
+            qDebug() << "Writing the recording failed, it is incomplete";
+        }
+        if (soak_ != nullptr)
+        {
+            qDebug() << "Soak periods: " << soak_->numPeriods() << ", anomalies: " << soak_->numAnomalies()
+                     << ", stored: " << soak_->storedPeriods() << " (" << soak_->storedBytes() << " bytes)";
+            soak_ = nullptr;
+        }
+        writer_.reset();
+    }
+}
+
+void LatencyTester::prepare(size_t maxFrames, size_t inChannels, size_t outChannels, const LatencyModel& latency)
+{
+    (void)maxFrames;
+    if ((inChannels != numInputs_) || (outChannels != numOutputs_))
+    {
+        qDebug() << "Device channels " << inChannels << " in, " << outChannels << " out do not match the recording";
+        kernel_ = nullptr;
+        return;
+    }
+    // Output j's response must arrive before output j + 1's copy of the stimulus starts
+    const size_t shift = matrixOutputShift(signal_.size(), numOutputs_);
+    const auto roundTrip = static_cast<size_t>(std::ceil(latency.reportedRoundTrip()));
+    if ((layout_ == StimulusLayout::Matrix) && (shift <= roundTrip))
+    {
+        kernel_ = nullptr;
+        throw std::runtime_error("Matrix layout: the reported round trip of " + std::to_string(roundTrip)
+                                 + " frames exceeds the output shift of " + std::to_string(shift) + " frames, use a period longer than "
+                                 + std::to_string(numOutputs_ * roundTrip));
+    }
+    kernel_ = selectStimulusKernel(layout_, outChannels);
+    stimulus_.pos = 0;
+    load_.prepare(sampleRate_);
+    tap_.prepare(sampleRate_);
+}
+
+void LatencyTester::process(size_t numSamples, const float *inSamples, size_t inChannels, float *outSamples, size_t outChannels)
+{
+    if ((inChannels != numInputs_) || (outChannels != numOutputs_) || (inSamples == NULL) || (outSamples == NULL) || !writer_ || !kernel_)
+    {
+        // A direct output buffer is passed through as the device handed it over, so play silence rather than what it holds
+        if (outSamples != NULL)
+        {
+            std::fill(outSamples, outSamples + numSamples * outChannels, 0.0f);
+        }
+        return;
+    }
+
+    kernel_(stimulus_, numSamples, inSamples, inChannels, outSamples, outChannels);
+    writer_->write(inSamples, numSamples * inChannels);
+    tap_.addLevels(inSamples, outSamples, numSamples);
+    load_.run(numSamples);
+}
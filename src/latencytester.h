@@ -0,0 +1,103 @@
+#ifndef LATENCYTESTER_H
+#define LATENCYTESTER_H
+
+#include "audiobackend.h"
+#include "recordingwriter.h"
+#include "soakrecorder.h"
+#include "latencytracker.h"
+#include "livetap.h"
+#include "loadinjector.h"
+#include "stimulus.h"
+#include "stimuluskernel.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+
+/**
+ * @brief Play a periodic stimulus and record all inputs
+ *
+ * The stimulus is chosen by RecordingInfo::stimulus, the chirp by default.
+ * In the passthrough layout, output 0 plays it and output 1 echoes input 0;
+ * the recording is also tracked period by period on the writer thread and
+ * onEstimate is called there for every completed period. In the matrix layout,
+ * every output plays its own delayed copy of the stimulus so all output-to-input
+ * latencies can be separated offline from a single run.
+ *
+ * The playback kernel specialised for the layout and channel count is chosen in
+ * prepare(), so process() does nothing until a backend has been started. After
+ * the stimulus, process() feeds the levels of tap() and runs the synthetic load
+ * of load(), none by default.
+ */
+class LatencyTester : public AudioProcessor
+{
+public:
+    /**
+     * @brief Constructor
+     * @param info Stream description stored in the recording header; startTime is filled in and
+     *             period is replaced by the actual stimulus period
+     * @param resultPath Directory of recording.tcal
+     * @param onEstimate
+     * @param pool Shared pool for recording and analysis, or nullptr for a writer thread of its own
+     * @param soak Record in soak mode (soak.tcal and summary.csv) instead of recording.tcal, or nullptr
+     */
+    LatencyTester(const RecordingInfo& info, const std::string& resultPath, LatencyTracker::Callback onEstimate = LatencyTracker::Callback(),
+                  WorkerPool *pool = nullptr, const SoakConfig *soak = nullptr);
+    ~LatencyTester();
+
+    /**
+     * @brief Select the playback kernel
+     *
+     * Throws std::runtime_error in the matrix layout if the reported round trip
+     * does not fit into the shift between adjacent outputs, as every response
+     * would then be attributed to the wrong output.
+     */
+    void prepare(size_t maxFrames, size_t inChannels, size_t outChannels, const LatencyModel& latency) override;
+    void process(size_t numSamples, const float *inSamples, size_t inChannels, float *outSamples, size_t outChannels) override;
+
+    /**
+     * @brief Flush the recording, must be called after the backend has stopped
+     */
+    void close();
+
+    /**
+     * @brief Most recent online estimate (not real-time safe)
+     */
+    LatencyEstimate latestEstimate() const {return tracker_->latest();}
+
+    const StimulusSignal& stimulus() const {return signal_;}
+
+    /**
+     * @brief Synthetic DSP load of the callback, adjustable while running
+     */
+    LoadInjector& load() {return load_;}
+
+    /**
+     * @brief Levels and impulse responses for a live display, see LiveTap
+     */
+    LiveTap& tap() {return tap_;}
+
+    /**
+     * @brief Recording queue overruns so far, kept after close()
+     */
+    uint64_t overruns() const {return writer_ ? writer_->overruns() : overruns_;}
+
+private:
+    const StimulusSignal &signal_;
+    std::unique_ptr<LatencyTracker> tracker_;
+    std::unique_ptr<RecordingWriter> writer_;
+    SoakRecorder *soak_{nullptr};   ///< Sink of writer_ in soak mode
+    double sampleRate_{0};
+    const size_t numInputs_;
+    const size_t numOutputs_;
+    const StimulusLayout layout_;
+    std::vector<float> matrix_;     ///< Interleaved matrix stimulus, one period
+    StimulusState stimulus_;
+    StimulusKernel kernel_{nullptr};
+    LoadInjector load_;
+    LiveTap tap_;
+    uint64_t overruns_{0};
+};
+
+#endif // LATENCYTESTER_H
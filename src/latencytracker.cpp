@@ -0,0 +1,177 @@
+#include "latencytracker.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+namespace {
+
+constexpr double kTolerance = 2.0;  ///< Delays within this many samples count as the same
+constexpr double kSmoothing = 0.2;  ///< Weight of the newest period in the running confidence
+
+/**
+ * Circular distance between two delays within one period
+ */
+double delayDistance(size_t a, size_t b, size_t period)
+{
+    const size_t d = (a > b) ? (a - b) : (b - a);
+    return static_cast<double>(std::min(d, period - d));
+}
+
+}   // anonymous namespace
+
+
+LatencyTracker::LatencyTracker(size_t period, double sampleRate, size_t numChannels, Callback callback)
+    : deconvolver_(std::make_unique<Deconvolver>(period))
+    , period_{period}
+    , sampleRate_{sampleRate}
+    , numChannels_{numChannels}
+    , callback_{std::move(callback)}
+    , skipSamples_{kSettlePeriods * period * numChannels}
+    , in_(period)
+    , out_(period)
+    , hRe_(period / 2 + 1)
+    , hIm_(period / 2 + 1)
+    , h_(period)
+    , drift_(period)
+{
+}
+
+LatencyTracker::LatencyTracker(const StimulusSignal& stimulus, double sampleRate, size_t numChannels, Callback callback)
+    : correlator_(std::make_unique<StimulusCorrelator>(stimulus))
+    , period_{stimulus.size()}
+    , sampleRate_{sampleRate}
+    , numChannels_{numChannels}
+    , callback_{std::move(callback)}
+    , skipSamples_{kSettlePeriods * stimulus.size() * numChannels}
+    , in_(stimulus.size())
+    , out_(stimulus.size())
+    , h_(stimulus.size())
+    , h0_(stimulus.size())
+    , drift_(stimulus.size())
+{
+}
+
+void LatencyTracker::addSamples(const float *samples, size_t count)
+{
+    const size_t skip = std::min(skipSamples_, count);
+    skipSamples_ -= skip;
+    samples += skip;
+    count -= skip;
+
+    for (size_t k = 0; k < count; k++)
+    {
+        if (channel_ == 0)
+        {
+            in_[fill_] = samples[k];
+        }
+        else if (channel_ == 1)
+        {
+            out_[fill_] = samples[k];
+        }
+
+        if (++channel_ == numChannels_)
+        {
+            channel_ = 0;
+            if (++fill_ == period_)
+            {
+                analysePeriod();
+                fill_ = 0;
+            }
+        }
+    }
+}
+
+LatencyEstimate LatencyTracker::latest() const
+{
+    std::scoped_lock<std::mutex> lock(mutex_);
+    return latest_;
+}
+
+void LatencyTracker::analysePeriod()
+{
+    size_t peak;
+    double fractionalDelay;
+    if (correlator_)
+    {
+        correlator_->impulseResponse(in_.data(), 1, h0_.data());
+        correlator_->impulseResponse(out_.data(), 1, h_.data());
+        fractionalDelay = relativePeakDelay(h0_.data(), h_.data(), period_, peak);
+    }
+    else
+    {
+        deconvolver_->transfer(in_.data(), out_.data(), hRe_.data(), hIm_.data());
+        deconvolver_->impulseResponse(hRe_.data(), hIm_.data(), h_.data());
+        peak = findPeak(h_.data(), period_);
+        fractionalDelay = phaseSlopeDelay(hRe_.data(), hIm_.data(), period_, static_cast<double>(peak), h_[peak]);
+    }
+    const float peakLevel = std::abs(h_[correlator_ ? findPeak(h_.data(), period_) : peak]);
+
+    double energy = 0;
+    for (auto x : h_)
+    {
+        energy += double(x) * x;
+    }
+    const double rms = std::sqrt(energy / period_);
+    const double peakToRms = (rms > 0) ? (peakLevel / rms) : 0.0;
+
+    LatencyEstimate e = estimate_;
+    e.period = numPeriods_++;
+    e.periodDelay = peak;
+    e.fractionalDelay = fractionalDelay;
+    e.periodConfidence = (peakToRms > 1.0) ? (1.0 - 1.0 / peakToRms) : 0.0;
+    e.stepChange = false;
+
+    double agreement = 0;
+    if (!locked_)
+    {
+        locked_ = true;
+        e.delay = peak;
+        agreement = e.periodConfidence;
+        e.confidence = agreement;
+    }
+    else if (delayDistance(peak, e.delay, period_) <= kTolerance)
+    {
+        // Follow slow clock drift
+        candidateValid_ = false;
+        e.delay = peak;
+        agreement = e.periodConfidence;
+    }
+    else if (candidateValid_ && (delayDistance(peak, candidate_, period_) <= kTolerance))
+    {
+        // Two consecutive periods agree on a new delay
+        candidateValid_ = false;
+        e.delay = peak;
+        e.stepChange = true;
+        e.confidence = e.periodConfidence;
+        agreement = e.periodConfidence;
+    }
+    else
+    {
+        candidateValid_ = true;
+        candidate_ = peak;
+    }
+
+    e.confidence += kSmoothing * (agreement - e.confidence);
+
+    if (e.stepChange)
+    {
+        drift_.reset();
+    }
+    if (agreement > 0)
+    {
+        drift_.add(e.fractionalDelay);
+    }
+    e.driftPpm = drift_.ppm();
+    e.delayMs = e.delay * 1000.0 / sampleRate_;
+    estimate_ = e;
+
+    {
+        std::scoped_lock<std::mutex> lock(mutex_);
+        latest_ = e;
+    }
+    if (callback_)
+    {
+        callback_(e);
+    }
+}
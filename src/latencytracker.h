@@ -0,0 +1,101 @@
+#ifndef LATENCYTRACKER_H
+#define LATENCYTRACKER_H
+
+#include "latencyanalyzer.h"
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+
+
+struct LatencyEstimate
+{
+    uint64_t period{0};         ///< Index of the analysed period
+    size_t delay{0};            ///< Tracked delay in samples
+    double delayMs{0};
+    size_t periodDelay{0};      ///< Raw delay of this period alone
+    double fractionalDelay{0};  ///< Sub-sample delay of this period
+    double driftPpm{0};         ///< Input/output clock drift since the last step change
+    double periodConfidence{0}; ///< Peak-to-RMS based quality of this period, 0..1
+    double confidence{0};       ///< Running confidence of the tracked delay, 0..1
+    bool stepChange{false};     ///< The tracked delay jumped at this period
+};
+
+
+/**
+ * @brief Incremental per-period latency estimation
+ *
+ * Consumes interleaved samples (channel 0 reference, channel 1 loopback) as they
+ * are drained from the recording queue, never on the audio I/O thread. Every
+ * completed period is deconvolved on its own. A delay that differs from the
+ * tracked one is confirmed as a step change once the following period agrees
+ * with it, so a renegotiated device buffer shows up within two periods. Smaller
+ * moves are followed as clock drift and fitted across periods in ppm.
+ *
+ * Constructed with a known stimulus, each period of both channels is
+ * deconvolved by the stimulus instead and the delay is the distance between
+ * the two impulse response peaks; see LatencyAnalyzer.
+ */
+class LatencyTracker
+{
+public:
+    using Callback = std::function<void(const LatencyEstimate&)>;
+
+    /**
+     * @brief Periods skipped while the device settles; LatencyEstimate::period counts from the next one
+     */
+    static constexpr size_t kSettlePeriods = 2;
+
+    LatencyTracker(size_t period, double sampleRate, size_t numChannels = 2, Callback callback = Callback());
+    LatencyTracker(const StimulusSignal& stimulus, double sampleRate, size_t numChannels = 2, Callback callback = Callback());
+
+    /**
+     * @brief Feed interleaved samples; need not be frame aligned
+     * @param samples
+     * @param count Number of samples (not frames)
+     */
+    void addSamples(const float *samples, size_t count);
+
+    /**
+     * @brief Thread-safe copy of the last estimate
+     */
+    LatencyEstimate latest() const;
+
+    /**
+     * @brief Impulse response of the last analysed period, only valid in the callback
+     *
+     * Against a known stimulus, the response of the loopback channel.
+     */
+    const std::vector<float>& impulseResponse() const {return h_;}
+
+private:
+    void analysePeriod();
+
+    std::unique_ptr<Deconvolver> deconvolver_;
+    std::unique_ptr<StimulusCorrelator> correlator_;
+    const size_t period_;
+    const double sampleRate_;
+    const size_t numChannels_;
+    Callback callback_;
+
+    size_t skipSamples_;
+    size_t channel_{0};
+    size_t fill_{0};
+    std::vector<float> in_, out_;
+    std::vector<float> hRe_, hIm_, h_;
+    std::vector<float> h0_;     ///< Response of channel 0 to a known stimulus
+
+    uint64_t numPeriods_{0};
+    bool locked_{false};
+    bool candidateValid_{false};
+    size_t candidate_{0};
+    DriftEstimator drift_;
+    LatencyEstimate estimate_;
+
+    mutable std::mutex mutex_;
+    LatencyEstimate latest_;
+};
+
+#endif // LATENCYTRACKER_H
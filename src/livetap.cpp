@@ -0,0 +1,147 @@
+#include "livetap.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+namespace {
+
+LiveLevels emptyLevels(size_t numInputs, size_t numOutputs)
+{
+    LiveLevels levels;
+    levels.inPeak.assign(numInputs, 0.0f);
+    levels.outPeak.assign(numOutputs, 0.0f);
+    return levels;
+}
+
+LiveResponse emptyResponse(size_t period)
+{
+    LiveResponse response;
+    response.period = period;
+    response.h.assign(std::min(period, LiveTap::kResponsePoints), 0.0f);
+    return response;
+}
+
+}   // anonymous namespace
+
+
+LiveTap::LiveTap(size_t numInputs, size_t numOutputs, size_t period)
+    : numInputs_(numInputs)
+    , numOutputs_(numOutputs)
+    , inPeak_(numInputs, 0.0f)
+    , outPeak_(numOutputs, 0.0f)
+    , levels_(emptyLevels(numInputs, numOutputs))
+    , response_(emptyResponse(period))
+{
+}
+
+void LiveTap::prepare(double sampleRate)
+{
+    interval_ = std::max<size_t>(1, static_cast<size_t>(sampleRate / kLevelRate));
+    pending_ = 0;
+    frames_ = 0;
+    std::fill(inPeak_.begin(), inPeak_.end(), 0.0f);
+    std::fill(outPeak_.begin(), outPeak_.end(), 0.0f);
+}
+
+void LiveTap::addLevels(const float *inSamples, const float *outSamples, size_t numFrames)
+{
+    for (size_t n = 0; n < numFrames; n++)
+    {
+        for (size_t ch = 0; ch < numInputs_; ch++)
+        {
+            inPeak_[ch] = std::max(inPeak_[ch], std::abs(inSamples[n * numInputs_ + ch]));
+        }
+        for (size_t ch = 0; ch < numOutputs_; ch++)
+        {
+            outPeak_[ch] = std::max(outPeak_[ch], std::abs(outSamples[n * numOutputs_ + ch]));
+        }
+    }
+    frames_ += numFrames;
+    pending_ += numFrames;
+    if (pending_ < interval_)
+    {
+        return;
+    }
+
+    auto &levels = levels_.back();
+    levels.frames = frames_;
+    std::copy(inPeak_.begin(), inPeak_.end(), levels.inPeak.begin());
+    std::copy(outPeak_.begin(), outPeak_.end(), levels.outPeak.begin());
+    levels_.publish();
+
+    std::fill(inPeak_.begin(), inPeak_.end(), 0.0f);
+    std::fill(outPeak_.begin(), outPeak_.end(), 0.0f);
+    pending_ = 0;
+}
+
+void LiveTap::addResponse(const float *h, size_t size, const LatencyEstimate& estimate)
+{
+    auto &response = response_.back();
+    if (size != response.period)
+    {
+        return;
+    }
+
+    // Keep the sample of largest magnitude of every bin so the peak survives
+    const size_t points = response.h.size();
+    for (size_t k = 0; k < points; k++)
+    {
+        const size_t begin = k * size / points;
+        const size_t end = (k + 1) * size / points;
+        float value = h[begin];
+        for (size_t n = begin + 1; n < end; n++)
+        {
+            if (std::abs(h[n]) > std::abs(value))
+            {
+                value = h[n];
+            }
+        }
+        response.h[k] = value;
+    }
+    response.estimate = estimate;
+    response.valid = true;
+    response_.publish();
+}
+
+bool LiveTap::readLevels(LiveLevels& levels)
+{
+    if (!levels_.update())
+    {
+        return false;
+    }
+    levels = levels_.front();
+    return true;
+}
+
+bool LiveTap::readResponse(LiveResponse& response)
+{
+    if (!response_.update())
+    {
+        return false;
+    }
+    response = response_.front();
+    return true;
+}
+
+
+LiveViewData::LiveViewData(LiveTap& tap, double sampleRate)
+    : tap_(tap)
+    , sampleRate_(sampleRate)
+{
+}
+
+bool LiveViewData::poll()
+{
+    bool changed = tap_.readLevels(levels_);
+    if (tap_.readResponse(response_))
+    {
+        trend_.push_back(response_.estimate.fractionalDelay * 1000.0 / sampleRate_);
+        while (trend_.size() > kTrendLength)
+        {
+            trend_.pop_front();
+        }
+        changed = true;
+    }
+    return changed;
+}
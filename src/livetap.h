@@ -0,0 +1,125 @@
+#ifndef LIVETAP_H
+#define LIVETAP_H
+
+#include "latencytracker.h"
+#include "snapshotbuffer.h"
+
+#include <deque>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+
+struct LiveLevels
+{
+    uint64_t frames{0};             ///< Frames processed up to this snapshot
+    std::vector<float> inPeak;      ///< max(|x|) per input since the previous snapshot
+    std::vector<float> outPeak;     ///< max(|x|) per output since the previous snapshot
+};
+
+struct LiveResponse
+{
+    bool valid{false};
+    size_t period{0};               ///< Length of the full impulse response
+    LatencyEstimate estimate;
+    std::vector<float> h;           ///< Impulse response decimated to at most kResponsePoints
+};
+
+
+/**
+ * @brief Decimated snapshots of a running test for a live display
+ *
+ * addLevels() runs in process() on the audio I/O thread and publishes the
+ * input and output peak levels a few dozen times per second. addResponse()
+ * runs on the tracker's thread once per period. A display polls
+ * readLevels() and readResponse() at its own rate. Snapshots are exchanged
+ * through SnapshotBuffers, so the display never blocks the audio thread and
+ * only ever sees the most recent values.
+ */
+class LiveTap
+{
+public:
+    static constexpr size_t kResponsePoints = 512;
+    static constexpr double kLevelRate = 60.0;     ///< Level snapshots per second
+
+    LiveTap(size_t numInputs, size_t numOutputs, size_t period);
+
+    /**
+     * @brief Set the level decimation and restart counting, not while process() runs
+     * @param sampleRate
+     */
+    void prepare(double sampleRate);
+
+    /**
+     * @brief Accumulate peak levels of one callback (real-time safe)
+     */
+    void addLevels(const float *inSamples, const float *outSamples, size_t numFrames);
+
+    /**
+     * @brief Publish the impulse response of a period, decimated by max(|h|) per bin
+     * @param h
+     * @param size
+     * @param estimate
+     */
+    void addResponse(const float *h, size_t size, const LatencyEstimate& estimate);
+
+    /**
+     * @brief Copy the latest level snapshot (display side)
+     * @return false if there was none since the last call
+     */
+    bool readLevels(LiveLevels& levels);
+
+    /**
+     * @brief Copy the latest impulse response (display side)
+     * @return false if there was none since the last call
+     */
+    bool readResponse(LiveResponse& response);
+
+private:
+    const size_t numInputs_;
+    const size_t numOutputs_;
+    size_t interval_{1};            ///< Frames per level snapshot
+    size_t pending_{0};             ///< Frames since the last level snapshot
+    uint64_t frames_{0};
+    std::vector<float> inPeak_, outPeak_;
+    SnapshotBuffer<LiveLevels> levels_;
+    SnapshotBuffer<LiveResponse> response_;
+};
+
+
+/**
+ * @brief Display side of a LiveTap: latest snapshots and the latency trend
+ *
+ * This is everything LiveView does off the paint path. It needs no widget, so
+ * the view's data path can also run without a GUI.
+ */
+class LiveViewData
+{
+public:
+    static constexpr size_t kTrendLength = 600;     ///< Periods kept in the latency trend
+
+    /**
+     * @param tap Must outlive this
+     * @param sampleRate
+     */
+    LiveViewData(LiveTap& tap, double sampleRate);
+
+    /**
+     * @brief Fetch the latest snapshots
+     * @return true if any of them changed
+     */
+    bool poll();
+
+    const LiveLevels& levels() const {return levels_;}
+    const LiveResponse& response() const {return response_;}
+    const std::deque<double>& trend() const {return trend_;}   ///< Delay of the last periods in msec
+
+private:
+    LiveTap &tap_;
+    const double sampleRate_;
+    LiveLevels levels_;
+    LiveResponse response_;
+    std::deque<double> trend_;
+};
+
+#endif // LIVETAP_H
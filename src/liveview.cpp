@@ -0,0 +1,194 @@
+#include "liveview.h"
+
+#include <QFontMetricsF>
+#include <QPainter>
+#include <QPen>
+#include <QPolygonF>
+
+#include <algorithm>
+#include <cmath>
+
+
+namespace {
+
+constexpr qreal kMargin = 6;
+constexpr double kMinLevelDb = -60;
+
+const QColor kBackground(24, 24, 28);
+const QColor kFrame(70, 70, 78);
+const QColor kTrace(90, 200, 255);
+const QColor kMarker(255, 90, 90);
+const QColor kText(220, 220, 220);
+
+/**
+ * Frame of a plot with its caption in the top left corner
+ */
+void paintFrame(QPainter& painter, const QRectF& rect, const QString& caption)
+{
+    painter.setPen(kFrame);
+    painter.setBrush(Qt::NoBrush);
+    painter.drawRect(rect);
+    painter.setPen(kText);
+    painter.drawText(rect.adjusted(kMargin, 0, -kMargin, 0), Qt::AlignLeft | Qt::AlignTop, caption);
+}
+
+QColor levelColour(double db)
+{
+    if (db >= -1)
+    {
+        return QColor(255, 70, 70);
+    }
+    return (db >= -6) ? QColor(255, 200, 60) : QColor(80, 210, 110);
+}
+
+}   // anonymous namespace
+
+
+LiveView::LiveView(LiveTap& tap, const QString& title, double sampleRate, double maxFps, QWidget *parent)
+    : QWidget(parent)
+    , title_(title)
+    , sampleRate_(sampleRate)
+    , data_(tap, sampleRate)
+{
+    setMinimumSize(480, 320);
+    timer_.setInterval(static_cast<int>(std::ceil(1000.0 / std::max(1.0, maxFps))));
+    connect(&timer_, &QTimer::timeout, this, &LiveView::poll);
+    timer_.start();
+}
+
+void LiveView::poll()
+{
+    // update() coalesces, so the timer caps the frame rate
+    if (data_.poll())
+    {
+        update();
+    }
+}
+
+void LiveView::paintEvent(QPaintEvent *event)
+{
+    (void)event;
+    QPainter painter(this);
+    painter.fillRect(rect(), kBackground);
+
+    QString text = title_;
+    if (data_.response().valid)
+    {
+        const auto &e = data_.response().estimate;
+        text += QString("    delay %1 samples, %2 msec    drift %3 ppm    confidence %4")
+            .arg(e.fractionalDelay, 0, 'f', 2)
+            .arg(e.fractionalDelay * 1000.0 / sampleRate_, 0, 'f', 3)
+            .arg(e.driftPpm, 0, 'f', 1)
+            .arg(e.confidence, 0, 'f', 2);
+    }
+    const qreal line = QFontMetricsF(font()).height();
+    painter.setPen(kText);
+    painter.drawText(QRectF(kMargin, kMargin, width() - 2 * kMargin, line), Qt::AlignLeft | Qt::AlignVCenter, text);
+
+    // Impulse response on top, latency trend below it, levels at the bottom
+    const QRectF area = QRectF(rect()).adjusted(kMargin, line + 2 * kMargin, -kMargin, -kMargin);
+    const auto &levels = data_.levels();
+    const qreal levelsHeight = std::min(area.height() * 0.3, line * 1.2 * std::max(levels.inPeak.size(), levels.outPeak.size()));
+    const qreal plotHeight = (area.height() - levelsHeight - 2 * kMargin) / 2;
+    painter.setRenderHint(QPainter::Antialiasing);
+    paintResponse(painter, QRectF(area.left(), area.top(), area.width(), plotHeight));
+    paintTrend(painter, QRectF(area.left(), area.top() + plotHeight + kMargin, area.width(), plotHeight));
+    paintLevels(painter, QRectF(area.left(), area.bottom() - levelsHeight, area.width(), levelsHeight));
+}
+
+void LiveView::paintResponse(QPainter& painter, const QRectF& rect) const
+{
+    paintFrame(painter, rect, "Impulse response");
+    const auto &response = data_.response();
+    if (!response.valid || response.h.empty())
+    {
+        return;
+    }
+
+    float scale = 0;
+    for (auto x : response.h)
+    {
+        scale = std::max(scale, std::abs(x));
+    }
+    if (scale <= 0)
+    {
+        return;
+    }
+
+    const size_t points = response.h.size();
+    const qreal centre = rect.center().y();
+    const qreal halfHeight = 0.45 * rect.height();
+    QPolygonF trace;
+    trace.reserve(static_cast<int>(points));
+    for (size_t k = 0; k < points; k++)
+    {
+        const qreal x = rect.left() + rect.width() * k / std::max<size_t>(1, points - 1);
+        trace << QPointF(x, centre - halfHeight * response.h[k] / scale);
+    }
+    painter.setPen(kTrace);
+    painter.drawPolyline(trace);
+
+    const qreal peak = rect.left() + rect.width() * response.estimate.periodDelay / response.period;
+    painter.setPen(QPen(kMarker, 1, Qt::DashLine));
+    painter.drawLine(QPointF(peak, rect.top()), QPointF(peak, rect.bottom()));
+}
+
+void LiveView::paintTrend(QPainter& painter, const QRectF& rect) const
+{
+    const auto &trend = data_.trend();
+    if (trend.empty())
+    {
+        paintFrame(painter, rect, "Latency");
+        return;
+    }
+
+    const auto [low, high] = std::minmax_element(trend.begin(), trend.end());
+    const double mid = 0.5 * (*low + *high);
+    const double range = std::max(*high - *low, 0.01);
+    paintFrame(painter, rect, QString("Latency, last %1 periods: %2 .. %3 msec")
+                                  .arg(trend.size()).arg(*low, 0, 'f', 3).arg(*high, 0, 'f', 3));
+
+    QPolygonF trace;
+    trace.reserve(static_cast<int>(trend.size()));
+    for (size_t k = 0; k < trend.size(); k++)
+    {
+        const qreal x = rect.left() + rect.width() * k / (LiveViewData::kTrendLength - 1);
+        trace << QPointF(x, rect.center().y() - 0.8 * rect.height() * (trend[k] - mid) / range);
+    }
+    painter.setPen(kTrace);
+    painter.drawPolyline(trace);
+}
+
+void LiveView::paintLevels(QPainter& painter, const QRectF& rect) const
+{
+    // Inputs in the left half, outputs in the right half, one bar per channel
+    const std::vector<float>* columns[] = {&data_.levels().inPeak, &data_.levels().outPeak};
+    const char *names[] = {"in", "out"};
+    const qreal columnWidth = (rect.width() - kMargin) / 2;
+    const qreal labelWidth = 4 * QFontMetricsF(painter.font()).averageCharWidth() + kMargin;
+    for (size_t c = 0; c < 2; c++)
+    {
+        const auto &peaks = *columns[c];
+        if (peaks.empty())
+        {
+            continue;
+        }
+        const qreal left = rect.left() + c * (columnWidth + kMargin);
+        const qreal barHeight = rect.height() / peaks.size();
+        for (size_t ch = 0; ch < peaks.size(); ch++)
+        {
+            const QRectF row(left, rect.top() + ch * barHeight, columnWidth, barHeight);
+            painter.setPen(kText);
+            painter.drawText(QRectF(row.left(), row.top(), labelWidth, row.height()), Qt::AlignLeft | Qt::AlignVCenter,
+                             QString("%1%2").arg(names[c]).arg(ch));
+
+            const double db = 20 * std::log10(std::max(peaks[ch], 1e-6f));
+            const double fill = std::clamp((db - kMinLevelDb) / -kMinLevelDb, 0.0, 1.0);
+            const QRectF bar = row.adjusted(labelWidth, 1, 0, -1);
+            painter.fillRect(QRectF(bar.left(), bar.top(), bar.width() * fill, bar.height()), levelColour(db));
+            painter.setPen(kFrame);
+            painter.setBrush(Qt::NoBrush);
+            painter.drawRect(bar);
+        }
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef LIVEVIEW_H
+#define LIVEVIEW_H
+
+#include "livetap.h"
+
+#include <QTimer>
+#include <QWidget>
+
+#include <cstdint>
+
+
+class QPainter;
+class QRectF;
+
+/**
+ * @brief Live impulse response, levels and latency trend of one running tester
+ *
+ * Polls the tester's LiveTap from a timer on the GUI thread and repaints at
+ * most maxFps times per second, and only if a new snapshot arrived. Painting
+ * works on the copies kept by LiveViewData, so it never touches state shared
+ * with process().
+ */
+class LiveView : public QWidget
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @param tap Must outlive the view
+     * @param title
+     * @param sampleRate
+     * @param maxFps
+     * @param parent
+     */
+    LiveView(LiveTap& tap, const QString& title, double sampleRate, double maxFps = 30, QWidget *parent = nullptr);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+
+private:
+    void poll();
+    void paintResponse(QPainter& painter, const QRectF& rect) const;
+    void paintTrend(QPainter& painter, const QRectF& rect) const;
+    void paintLevels(QPainter& painter, const QRectF& rect) const;
+
+    const QString title_;
+    const double sampleRate_;
+    QTimer timer_;
+    LiveViewData data_;
+};
+
+#endif // LIVEVIEW_H
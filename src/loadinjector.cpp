@@ -0,0 +1,81 @@
+#include "loadinjector.h"
+
+#include <algorithm>
+#include <chrono>
+
+
+LoadInjector::LoadInjector()
+    : unitsPerUs_(unitsPerMicrosecond())
+{
+}
+
+void LoadInjector::prepare(double sampleRate)
+{
+    sampleRate_ = sampleRate;
+    cycle_ = 0;
+}
+
+void LoadInjector::setSpikes(double spikePercent, size_t interval)
+{
+    spikePercent_.store(spikePercent, std::memory_order_relaxed);
+    spikeInterval_.store(interval, std::memory_order_relaxed);
+}
+
+void LoadInjector::run(size_t numFrames)
+{
+    const size_t interval = spikeInterval_.load(std::memory_order_relaxed);
+    double percent = percent_.load(std::memory_order_relaxed);
+    if ((interval > 0) && (++cycle_ % interval == 0))
+    {
+        percent = spikePercent_.load(std::memory_order_relaxed);
+    }
+    if ((percent <= 0) || (sampleRate_ <= 0))
+    {
+        return;
+    }
+
+    const double us = 1e6 * static_cast<double>(numFrames) / sampleRate_ * percent / 100.0;
+    sink_ = work(static_cast<uint64_t>(us * unitsPerUs_), sink_);
+}
+
+float LoadInjector::work(uint64_t units, float seed)
+{
+    // Each unit is 64 dependent multiply-adds; x stays bounded near 1
+    float x = seed + 1.0f;
+    for (uint64_t k = 0; k < units; k++)
+    {
+        for (int j = 0; j < 64; j++)
+        {
+            x = x * 0.999f + 0.001f;
+        }
+    }
+    return x - 1.0f;
+}
+
+double LoadInjector::unitsPerMicrosecond()
+{
+    // Thread-safe static init; best of several 2 ms runs to skip preemptions
+    static const double rate = [] {
+        using Clock = std::chrono::steady_clock;
+        uint64_t units = 1024;
+        double best = 0;
+        volatile float sink = 0;
+        for (int run = 0; run < 5; run++)
+        {
+            while (true)
+            {
+                const auto start = Clock::now();
+                sink = work(units, sink);
+                const double us = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+                if (us >= 2000.0)
+                {
+                    best = std::max(best, static_cast<double>(units) / us);
+                    break;
+                }
+                units *= 2;
+            }
+        }
+        return best;
+    }();
+    return rate;
+}
@@ -0,0 +1,61 @@
+#ifndef LOADINJECTOR_H
+#define LOADINJECTOR_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+
+/**
+ * @brief Synthetic DSP load in the audio callback
+ *
+ * run() burns CPU for a given percentage of the buffer period, optionally with
+ * a higher load every spikeInterval callbacks. The busy work is a dependent
+ * multiply-add chain, so it neither vectorises nor touches memory; its rate is
+ * calibrated once per process. The load can be changed from any thread while
+ * the device runs; run() itself is real-time safe.
+ */
+class LoadInjector
+{
+public:
+    LoadInjector();
+
+    /**
+     * @brief Sample rate for the buffer period, before the device starts
+     */
+    void prepare(double sampleRate);
+
+    /**
+     * @param percent Busy time per callback in percent of the buffer period
+     */
+    void setLoad(double percent) {percent_.store(percent, std::memory_order_relaxed);}
+    double load() const {return percent_.load(std::memory_order_relaxed);}
+
+    /**
+     * @brief Use spikePercent instead of the load on every interval-th callback, 0 for no spikes
+     */
+    void setSpikes(double spikePercent, size_t interval);
+
+    /**
+     * @brief Burn the configured share of numFrames on the calling thread
+     */
+    void run(size_t numFrames);
+
+    /**
+     * @brief Work units per microsecond, measured on first use
+     */
+    static double unitsPerMicrosecond();
+
+private:
+    static float work(uint64_t units, float seed);
+
+    std::atomic<double> percent_{0};
+    std::atomic<double> spikePercent_{0};
+    std::atomic<size_t> spikeInterval_{0};
+    double unitsPerUs_;
+    double sampleRate_{0};
+    uint64_t cycle_{0};
+    float sink_{0};         ///< Keeps the work from being optimised away
+};
+
+#endif // LOADINJECTOR_H
@@ -1,110 +1,145 @@
 #include "mainwindow.h"
+#include "buffersizestore.h"
+#include "liveview.h"
+#include "multidevicetester.h"
+#include "simulateddevice.h"
+#ifdef __APPLE__
 #include "coreaudioqt.h"
-
-#include <nlohmann/json.hpp>
+#endif
 
 #include <QDebug>
 #include <QMessageBox>
+#include <QCoreApplication>
+#include <QVBoxLayout>
 
+#include <algorithm>
 #include <sstream>
-#include <fstream>
-#include <mutex>
-#include <array>
-#include <filesystem>
 
-#include "chirp.inc"
 
+namespace {
 
-class LatencyTester : public CoreAudioQt
+/**
+ * @brief Value of a "<name> <number>" command line argument
+ */
+size_t sizeArgument(const QString& name, size_t defaultValue)
 {
-public:
-    LatencyTester(AudioObjectID deviceId, double sampleRate, QObject *parent, const std::string& resultPath)
-        : CoreAudioQt(deviceId, sampleRate, parent)
-        , sampleRate_(sampleRate)
+    const auto args = QCoreApplication::arguments();
+    const auto idx = args.indexOf(name);
+    if ((idx >= 0) && (idx + 1 < args.size()))
     {
-        auto recordingFilename = std::filesystem::absolute(resultPath) / "recording.bin";
-        file_.open(recordingFilename, std::ios::binary);
-        if (!file_.is_open())
+        bool ok = false;
+        const auto value = args[idx + 1].toULong(&ok);
+        if (ok)
         {
-            emit error("Cannot open recording file");
+            return value;
         }
-
-        nlohmann::json json;
-        json["sample_rate"] = sampleRate_;
-        json["period"] = chirp_signal.size();
-        std::ofstream jsonFile(std::filesystem::absolute(resultPath) / "config.json");
-        jsonFile << json;
-
-        qDebug() << "###############################################################";
-        qDebug() << "Write recording to " << QString::fromStdString(recordingFilename);
-        qDebug() << "Selected device ID: " << deviceId;
-        qDebug() << "Selected device sample rate: " << sampleRate_;
     }
+    return defaultValue;
+}
 
-    void process(size_t numSamples, const float *inSamples, size_t inChannels, float *outSamples, size_t outChannels) override
+/**
+ * @brief Value of a "<name> <text>" command line argument
+ */
+QString stringArgument(const QString& name, const QString& defaultValue)
+{
+    const auto args = QCoreApplication::arguments();
+    const auto idx = args.indexOf(name);
+    if ((idx >= 0) && (idx + 1 < args.size()))
     {
-        std::scoped_lock<std::mutex> lock(mutex_);
-
-        if ((inChannels != 2) || (outChannels != 2) || (inSamples == NULL) || (outSamples == NULL))
-        {
-            return;
-        }
-
-#if 0
-        constexpr double twoPI = 6.283185307179586;
-        const double step1 = twoPI * 440.0 / sampleRate_;
-        const double step2 = twoPI * 1e3 / sampleRate_;
-        float *ptr = outSamples;
-        for (size_t k = 0; k < numSamples; k++)
-        {
-            *ptr++ = 1e-1 * std::sin(angle1_);
-            *ptr++ = 1e-1 * std::sin(angle2_);
-            angle1_ += step1;
-            angle2_ += step2;
-        }
-        angle1_ = std::fmod(angle1_, twoPI);
-        angle2_ = std::fmod(angle2_, twoPI);
-#else
-        float *dst = outSamples;
-        const float *src = inSamples;
-        for (size_t k = 0; k < numSamples; k++)
-        {
-            *dst++ = chirp_signal[pos_++];
-            *dst++ = *src;
-            src += 2;
-            if (pos_ >= chirp_signal.size())
-            {
-                pos_ = 0;
-            }
-        }
-
-#endif
-
-        file_.write(reinterpret_cast<const char*>(inSamples), numSamples * inChannels * sizeof(float));
+        return args[idx + 1];
     }
+    return defaultValue;
+}
 
-private:
-    std::ofstream file_;
-    std::mutex mutex_;
-    double sampleRate_{0};
-    double angle1_{0};
-    double angle2_{0};
-    size_t pos_{0};
-};
+}   // anonymous namespace
 
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
 {
 
+    const std::string resultPath = "../../../../TestCoreAudioLatency/python";
+    const double sampleRate = 48e3;
+    const size_t period = sizeArgument("--period", kDefaultChirpPeriod);
+    const double maxFps = static_cast<double>(sizeArgument("--fps", 30));
+    const auto layout = QCoreApplication::arguments().contains("--matrix") ? StimulusLayout::Matrix : StimulusLayout::Passthrough;
+    const auto stimulusArg = stringArgument("--stimulus", stimulusName(StimulusType::Chirp));
+    const auto deviceUIDs = stringArgument("--devices", QString()).split(',', Qt::SkipEmptyParts);
+    const bool soakMode = QCoreApplication::arguments().contains("--soak") || QCoreApplication::arguments().contains("--soak-all");
+    SoakConfig soak;
+    soak.keepAll = QCoreApplication::arguments().contains("--soak-all");
+    const BufferSizeStore bufferSizes;
+#ifdef __APPLE__
+    const bool simulate = QCoreApplication::arguments().contains("--simulate");
+#else
+    const bool simulate = true;
+#endif
+
+    // --buffer overrides the size tuned for the device, 32 frames if it was never tuned
+    auto bufferSize = [&bufferSizes, sampleRate](const std::string& uid) {
+        const size_t tuned = bufferSizes.find(uid, sampleRate);
+        const size_t size = sizeArgument("--buffer", (tuned > 0) ? tuned : 32);
+        qDebug() << QString::fromStdString(uid) << "buffer size:" << size << ((tuned > 0) ? "(tuned" : "(not tuned")
+                 << "at" << sampleRate << "Hz)";
+        return size;
+    };
+
+    auto logEstimate = [](const std::string& uid) {
+        return [uid = QString::fromStdString(uid)](const LatencyEstimate& e) {
+            if (e.stepChange)
+            {
+                qDebug() << uid << "latency step change at period" << e.period;
+            }
+            qDebug() << uid << "delay:" << e.fractionalDelay << "samples," << e.delayMs << "msec, drift" << e.driftPpm << "ppm, confidence" << e.confidence;
+        };
+    };
+
     try
     {
+        const auto stimulus = parseStimulusType(stimulusArg.toStdString());
+        tester = std::make_unique<MultiDeviceTester>(resultPath, sizeArgument("--threads", 0));
+        auto addDevice = [&](const RecordingInfo& info, const MultiDeviceTester::BackendFactory& factory) {
+            auto &backend = tester->addDevice(info, factory, logEstimate(info.deviceUID), soakMode ? &soak : nullptr);
+            connect(&backend, &AudioBackend::error, this, &MainWindow::error);
+            connect(&backend, &AudioBackend::status, this, [](const QString& msg) {qDebug().noquote() << msg;});
+        };
+
+        if (simulate)
+        {
+            qDebug() << "Using simulated loopback device";
+            SimulatedDeviceConfig config;
+            config.sampleRate = sampleRate;
+            config.inChannels = config.outChannels = sizeArgument("--channels", 2);
+
+            RecordingInfo info;
+            info.sampleRate = sampleRate;
+            info.numChannels = config.inChannels;
+            info.numOutputs = config.outChannels;
+            info.layout = layout;
+            info.stimulus = stimulus;
+            info.period = period;
+            for (const auto &uid : deviceUIDs.isEmpty() ? QStringList{"simulated"} : deviceUIDs)
+            {
+                info.deviceUID = uid.toStdString();
+                config.bufferSize = bufferSize(info.deviceUID);
+                config.loopbackDelay = std::max(config.loopbackDelay, static_cast<double>(config.bufferSize));
+                info.bufferSize = config.bufferSize;
+                addDevice(info, [config](AudioProcessor& processor, const RecordingInfo&) {
+                    return std::make_unique<SimulatedDevice>(processor, config);
+                });
+            }
+            showLiveViews(sampleRate, maxFps);
+            tester->start();
+            return;
+        }
+
+#ifdef __APPLE__
         auto devices = getDevices();
         qDebug() << "Default input device ID:" << getDefaultInputDeviceID();
         qDebug() << "Default output device ID:" << getDefaultOutputDeviceID();
         qDebug() << devices.size() << " device(s) available:";
-        const DeviceInfo *selectedDevice = nullptr;
-        const auto selectedID = getDefaultInputDeviceID();
+        std::vector<const DeviceInfo*> selectedDevices;
+        const auto defaultID = getDefaultInputDeviceID();
         for (const auto &dev : devices)
         {
             qDebug() << "-----------------------------------------------------";
@@ -129,18 +164,59 @@ MainWindow::MainWindow(QWidget *parent)
             }
             qDebug() << "Available sample rates:" << QString::fromStdString(ss.str());
 
-            if (dev.id == selectedID)
+            if (deviceUIDs.isEmpty() && (dev.id == defaultID))
             {
-                selectedDevice = &dev;
+                selectedDevices.push_back(&dev);
             }
         }
 
-        // Create tester
-        tester = new LatencyTester(selectedDevice->id, 48e3, this, "../../../../TestCoreAudioLatency/python");
-        connect(tester, &CoreAudioQt::error, this, &MainWindow::error);
+        // Explicitly selected devices in command line order
+        for (const auto &uid : deviceUIDs)
+        {
+            auto it = std::find_if(devices.begin(), devices.end(), [&uid](const DeviceInfo& dev) {return dev.deviceUID == uid;});
+            if (it == devices.end())
+            {
+                throw std::runtime_error("Device not found: " + uid.toStdString());
+            }
+            selectedDevices.push_back(&*it);
+        }
+        if (selectedDevices.empty())
+        {
+            throw std::runtime_error("Default input device not found");
+        }
+
+        // Create testers
+        const auto physicalFormatArg = stringArgument("--physical-format", QString());
+        const bool setPhysicalFormat = !physicalFormatArg.isEmpty();
+        const auto physicalFormat = setPhysicalFormat ? parseSampleFormat(physicalFormatArg.toStdString()) : SampleFormat::Float32;
+        for (const auto *selectedDevice : selectedDevices)
+        {
+            qDebug() << "Selected device ID: " << selectedDevice->id;
+            RecordingInfo info;
+            info.sampleRate = sampleRate;
+            info.numChannels = selectedDevice->numInputs;
+            info.numOutputs = selectedDevice->numOutputs;
+            info.layout = layout;
+            info.stimulus = stimulus;
+            info.period = period;
+            info.deviceUID = selectedDevice->deviceUID.toStdString();
+            info.bufferSize = bufferSize(info.deviceUID);   // As set by CoreAudioQt::Start()
+            const auto id = selectedDevice->id;
+            const auto frames = static_cast<UInt32>(info.bufferSize);
+            addDevice(info, [id, sampleRate, frames, setPhysicalFormat, physicalFormat](AudioProcessor& processor, const RecordingInfo&) {
+                auto backend = std::make_unique<CoreAudioQt>(processor, id, sampleRate, frames);
+                if (setPhysicalFormat)
+                {
+                    backend->setPhysicalFormat(physicalFormat);
+                }
+                return backend;
+            });
+        }
 
         // Done
-        tester->Start();
+        showLiveViews(sampleRate, maxFps);
+        tester->start();
+#endif
     }
     catch(const std::exception& e)
     {
@@ -150,10 +226,48 @@ MainWindow::MainWindow(QWidget *parent)
 
 MainWindow::~MainWindow()
 {
+    // The views poll the taps of the testers
+    delete takeCentralWidget();
+    if (tester)
+    {
+        tester->stop();
+        std::ostringstream ss;
+        const auto reports = tester->reports();
+        for (const auto &r : reports)
+        {
+            ss << r.deviceUID << " callbacks: " << r.stats.summary() << "\n"
+               << "Latency:\n" << r.latencyReport << "\n";
+        }
+        MultiDeviceTester::printReport(ss, reports);
+        qDebug().noquote() << QString::fromStdString(ss.str());
+    }
+    tester.reset();
+}
+
+void MainWindow::showLiveViews(double sampleRate, double maxFps)
+{
+    auto *views = new QWidget(this);
+    auto *layout = new QVBoxLayout(views);
+    for (size_t k = 0; k < tester->numDevices(); k++)
+    {
+        layout->addWidget(new LiveView(tester->tester(k).tap(), QString::fromStdString(tester->deviceUID(k)), sampleRate, maxFps));
+    }
+    setCentralWidget(views);
 }
 
 void MainWindow::error(const QString& msg)
 {
+    // The message box runs a nested event loop, in which the backends keep pumping
+    if (failed_)
+    {
+        qDebug() << "ERROR:" << msg;
+        return;
+    }
+    failed_ = true;
+    if (tester)
+    {
+        tester->stop();
+    }
     QMessageBox::critical(this, "ERROR", msg);
     close();
 }
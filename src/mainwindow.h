@@ -3,8 +3,10 @@
 
 #include <QMainWindow>
 
+#include <memory>
 
-class LatencyTester;    // forward declaration
+
+class MultiDeviceTester;    // forward declaration
 
 class MainWindow : public QMainWindow
 {
@@ -17,6 +19,12 @@ public:
 private:
     void error(const QString& msg);
 
-    LatencyTester *tester{nullptr};
+    /**
+     * @brief One LiveView per device as the central widget
+     */
+    void showLiveViews(double sampleRate, double maxFps);
+
+    std::unique_ptr<MultiDeviceTester> tester;
+    bool failed_{false};    ///< An error is shown, the window is closing
 };
 #endif // MAINWINDOW_H
@@ -0,0 +1,176 @@
+#include "multidevicetester.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <stdexcept>
+
+
+namespace {
+
+/**
+ * Directory name for a device UID
+ */
+std::string sanitise(const std::string& uid)
+{
+    std::string name = uid.empty() ? "device" : uid;
+    for (auto &c : name)
+    {
+        if (!std::isalnum(static_cast<unsigned char>(c)) && (c != '-') && (c != '.'))
+        {
+            c = '_';
+        }
+    }
+    return name;
+}
+
+}   // anonymous namespace
+
+
+MultiDeviceTester::MultiDeviceTester(const std::filesystem::path& resultPath, size_t numThreads)
+    : resultPath_(resultPath)
+    , pool_(numThreads)
+{
+}
+
+MultiDeviceTester::~MultiDeviceTester()
+{
+    stop();
+}
+
+AudioBackend& MultiDeviceTester::addDevice(const RecordingInfo& info, const BackendFactory& factory, LatencyTracker::Callback onEstimate,
+                                           const SoakConfig *soak)
+{
+    for (const auto &dev : devices_)
+    {
+        if (dev->uid == info.deviceUID)
+        {
+            throw std::invalid_argument("MultiDeviceTester: device added twice: " + info.deviceUID);
+        }
+    }
+
+    auto dev = std::make_unique<Device>();
+    dev->uid = info.deviceUID;
+    const auto path = resultPath_ / sanitise(info.deviceUID);
+    std::filesystem::create_directories(path);
+    dev->tester = std::make_unique<LatencyTester>(info, path.string(), std::move(onEstimate), &pool_, soak);
+    dev->backend = factory(*dev->tester, info);
+    if (!dev->backend)
+    {
+        throw std::runtime_error("MultiDeviceTester: no backend for " + info.deviceUID);
+    }
+
+    auto raw = dev.get();
+    QObject::connect(raw->backend.get(), &AudioBackend::error, [raw](const QString& msg) {
+        if (raw->error.empty())
+        {
+            raw->error = msg.toStdString();
+        }
+    });
+    devices_.push_back(std::move(dev));
+    return *raw->backend;
+}
+
+void MultiDeviceTester::start()
+{
+    stopped_ = false;
+    for (auto &dev : devices_)
+    {
+        dev->backend->Start();
+    }
+}
+
+void MultiDeviceTester::stop()
+{
+    if (stopped_)
+    {
+        return;
+    }
+    stopped_ = true;
+
+    // Stop all devices first so none keeps recording while the others flush
+    for (auto &dev : devices_)
+    {
+        dev->backend->Stop();
+        dev->backend->pumpEvents();
+    }
+    for (auto &dev : devices_)
+    {
+        dev->tester->close();
+    }
+}
+
+std::vector<DeviceReport> MultiDeviceTester::reports() const
+{
+    std::vector<DeviceReport> reports;
+    for (const auto &dev : devices_)
+    {
+        DeviceReport r;
+        r.deviceUID = dev->uid;
+        r.estimate = dev->tester->latestEstimate();
+        r.stats = dev->backend->callbackStats();
+        const auto model = dev->backend->latencyModel();
+        const double measured = (r.estimate.confidence > 0) ? r.estimate.fractionalDelay : std::numeric_limits<double>::quiet_NaN();
+        r.reportedDelay = model.reportedRoundTrip();
+        r.latencyReport = model.report(r.stats.ioSpan, measured);
+        r.dropouts = dev->tester->overruns();
+        r.error = dev->error;
+        reports.push_back(r);
+    }
+    return reports;
+}
+
+void MultiDeviceTester::printReport(std::ostream& os, const std::vector<DeviceReport>& reports)
+{
+    os << std::left << std::setw(32) << "device" << std::right
+       << std::setw(9) << "periods"
+       << std::setw(12) << "samples"
+       << std::setw(10) << "msec"
+       << std::setw(10) << "reported"
+       << std::setw(11) << "drift ppm"
+       << std::setw(7) << "conf"
+       << std::setw(10) << "dropouts"
+       << std::setw(7) << "xruns"
+       << std::setw(8) << "misses"
+       << "  status" << std::endl;
+
+    double minMs = std::numeric_limits<double>::infinity();
+    double maxMs = -std::numeric_limits<double>::infinity();
+    double sumMs = 0;
+    size_t numMeasured = 0;
+    for (const auto& r : reports)
+    {
+        const bool measured = (r.estimate.confidence > 0);
+        const double sampleRate = r.stats.sampleRate;
+        const double ms = ((sampleRate > 0) && measured) ? (r.estimate.fractionalDelay * 1e3 / sampleRate) : 0.0;
+        os << std::left << std::setw(32) << r.deviceUID << std::right << std::fixed
+           << std::setw(9) << (measured ? (r.estimate.period + 1) : 0)
+           << std::setw(12) << std::setprecision(2) << r.estimate.fractionalDelay
+           << std::setw(10) << std::setprecision(3) << ms
+           << std::setw(10) << std::setprecision(1) << r.reportedDelay
+           << std::setw(11) << std::setprecision(2) << r.estimate.driftPpm
+           << std::setw(7) << std::setprecision(2) << r.estimate.confidence
+           << std::setw(10) << r.dropouts
+           << std::setw(7) << r.stats.discontinuities
+           << std::setw(8) << r.stats.deadlineMisses
+           << "  " << (!r.error.empty() ? r.error : (measured ? "ok" : "no estimate")) << std::endl;
+
+        if (measured && (sampleRate > 0))
+        {
+            minMs = std::min(minMs, ms);
+            maxMs = std::max(maxMs, ms);
+            sumMs += ms;
+            numMeasured++;
+        }
+    }
+
+    os << numMeasured << " of " << reports.size() << " device(s) measured";
+    if (numMeasured > 0)
+    {
+        os << std::fixed << std::setprecision(3) << ", latency " << minMs << " to " << maxMs
+           << " msec, mean " << (sumMs / numMeasured) << " msec";
+    }
+    os << std::endl;
+}
@@ -0,0 +1,98 @@
+#ifndef MULTIDEVICETESTER_H
+#define MULTIDEVICETESTER_H
+
+#include "audiobackend.h"
+#include "latencytester.h"
+#include "workerpool.h"
+
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+
+struct DeviceReport
+{
+    std::string deviceUID;
+    LatencyEstimate estimate;       ///< Latest online estimate, period 0 and confidence 0 if none
+    CallbackStats::Snapshot stats;
+    double reportedDelay{0};        ///< Round trip from the reported latency components
+    std::string latencyReport;      ///< LatencyModel::report() of the device
+    uint64_t dropouts{0};           ///< Recording overruns
+    std::string error;              ///< First backend error, empty if none
+};
+
+
+/**
+ * @brief Run LatencyTesters on several devices at the same time
+ *
+ * Every device has its own backend (and so its own I/O proc), tester and
+ * recording in <resultPath>/<device UID>/. Recording and online analysis of all
+ * devices share one WorkerPool instead of one writer thread per device. The
+ * testers and backends are owned here and must be used from the thread that
+ * created this object.
+ */
+class MultiDeviceTester
+{
+public:
+    using BackendFactory = std::function<std::unique_ptr<AudioBackend>(AudioProcessor& processor, const RecordingInfo& info)>;
+
+    /**
+     * @param resultPath
+     * @param numThreads Size of the shared pool, 0 for one per hardware thread
+     */
+    explicit MultiDeviceTester(const std::filesystem::path& resultPath, size_t numThreads = 0);
+    ~MultiDeviceTester();
+
+    MultiDeviceTester(const MultiDeviceTester&) = delete;
+    MultiDeviceTester& operator=(const MultiDeviceTester&) = delete;
+
+    /**
+     * @brief Create the tester and backend of one more device
+     * @param info Recording description, deviceUID names the result directory
+     * @param factory
+     * @param onEstimate Called on a pool thread for every tracked period
+     * @param soak Record in soak mode, or nullptr
+     * @return The new backend, e.g. to connect its signals
+     */
+    AudioBackend& addDevice(const RecordingInfo& info, const BackendFactory& factory,
+                            LatencyTracker::Callback onEstimate = LatencyTracker::Callback(), const SoakConfig *soak = nullptr);
+
+    size_t numDevices() const {return devices_.size();}
+    const std::string& deviceUID(size_t idx) const {return devices_[idx]->uid;}
+    LatencyTester& tester(size_t idx) {return *devices_[idx]->tester;}
+    size_t numThreads() const {return pool_.numThreads();}
+
+    void start();
+
+    /**
+     * @brief Stop all backends and flush all recordings
+     */
+    void stop();
+
+    std::vector<DeviceReport> reports() const;
+
+    /**
+     * @brief One row per device and the spread of the latency across devices
+     */
+    static void printReport(std::ostream& os, const std::vector<DeviceReport>& reports);
+
+private:
+    struct Device
+    {
+        std::string uid;
+        std::unique_ptr<LatencyTester> tester;
+        std::unique_ptr<AudioBackend> backend;
+        std::string error;
+    };
+
+    const std::filesystem::path resultPath_;
+    WorkerPool pool_;       ///< Outlives the testers polling it
+    std::vector<std::unique_ptr<Device>> devices_;
+    bool stopped_{false};
+};
+
+#endif // MULTIDEVICETESTER_H
@@ -0,0 +1,376 @@
+#include "parallelanalyzer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+
+namespace {
+
+/**
+ * Partial sums and delays of one chunk of periods
+ */
+struct ChunkResult
+{
+    std::vector<double> sumRe;      ///< Sum of H, or of h of channel 0 against a known stimulus
+    std::vector<double> sumIm;      ///< Sum of h of channel 1 against a known stimulus
+    std::vector<double> delays;     ///< Delay of every period, in order
+    std::vector<float> peakLevels;
+};
+
+/**
+ * Rotation of the impulse responses from a period on, see LatencyAnalyzer
+ */
+struct Alignment
+{
+    uint64_t period;
+    size_t rotation;
+};
+
+/**
+ * Alignments of the analysed periods [firstPeriod, endPeriod), starting with the unrotated first one
+ */
+std::vector<Alignment> findAlignments(const RecordingReader& reader, const StimulusSignal *stimulus, uint64_t firstPeriod, uint64_t endPeriod)
+{
+    const size_t period = reader.info().period;
+    std::vector<Alignment> alignments{{firstPeriod, 0}};
+    const auto &dropouts = reader.dropouts();
+    if ((stimulus == nullptr) || (std::lower_bound(dropouts.begin(), dropouts.end(), firstPeriod * period) == dropouts.end()))
+    {
+        return alignments;
+    }
+
+    StimulusCorrelator correlator(*stimulus);
+    std::vector<float> h(period);
+    const auto peak = [&](uint64_t idx) {
+        correlator.impulseResponse(reader.period(idx), reader.info().numChannels, h.data());
+        return findPeak(h.data(), period);
+    };
+
+    bool first = true;
+    bool realign = false;
+    size_t referencePeak = 0;
+    for (uint64_t idx = firstPeriod; idx < endPeriod; idx++)
+    {
+        if (reader.periodHasDropout(idx))
+        {
+            realign = true;
+        }
+        else if (first)
+        {
+            referencePeak = peak(idx);
+            first = false;
+            realign = false;
+        }
+        else if (realign)
+        {
+            alignments.push_back({idx, (peak(idx) + period - referencePeak) % period});
+            realign = false;
+        }
+    }
+    return alignments;
+}
+
+void updatePeaks(const float *frames, uint64_t numFrames, size_t numChannels, std::vector<float>& peaks)
+{
+    for (uint64_t n = 0; n < numFrames; n++)
+    {
+        for (size_t ch = 0; ch < numChannels; ch++)
+        {
+            peaks[ch] = std::max(peaks[ch], std::abs(frames[n * numChannels + ch]));
+        }
+    }
+}
+
+/**
+ * Transform and scratch buffers of one worker thread
+ */
+class ChunkWorker
+{
+public:
+    ChunkWorker(const RecordingInfo& info, const StimulusSignal *stimulus)
+        : period_(info.period)
+        , numChannels_(info.numChannels)
+        , h_(info.period)
+    {
+        if (stimulus)
+        {
+            correlator_ = std::make_unique<StimulusCorrelator>(*stimulus);
+            hRe_.resize(period_);
+            hIm_.resize(period_);
+        }
+        else
+        {
+            deconvolver_ = std::make_unique<Deconvolver>(period_);
+            in_.resize(period_);
+            out_.resize(period_);
+            hRe_.resize(period_ / 2 + 1);
+            hIm_.resize(period_ / 2 + 1);
+        }
+    }
+
+    void run(const RecordingReader& reader, const std::vector<Alignment>& alignments, uint64_t firstPeriod, uint64_t numPeriods,
+             ChunkResult& result)
+    {
+        result.sumRe.assign(hRe_.size(), 0.0);
+        result.sumIm.assign(hIm_.size(), 0.0);
+        result.delays.clear();
+        result.delays.reserve(numPeriods);
+        result.peakLevels.assign(numChannels_, 0.0f);
+
+        for (uint64_t k = 0; k < numPeriods; k++)
+        {
+            const uint64_t idx = firstPeriod + k;
+            const float *frames = reader.period(idx);
+            updatePeaks(frames, period_, numChannels_, result.peakLevels);
+            if (reader.periodHasDropout(idx))
+            {
+                continue;
+            }
+            if (correlator_)
+            {
+                const auto it = std::upper_bound(alignments.begin(), alignments.end(), idx,
+                                                 [](uint64_t p, const Alignment &a) {return p < a.period;});
+                addKnownBlock(frames, std::prev(it)->rotation, result);
+            }
+            else
+            {
+                addBlock(frames, result);
+            }
+        }
+    }
+
+private:
+    void addBlock(const float *frames, ChunkResult& result)
+    {
+        for (size_t n = 0; n < period_; n++)
+        {
+            in_[n] = frames[n * numChannels_];
+            out_[n] = frames[n * numChannels_ + 1];
+        }
+        deconvolver_->transfer(in_.data(), out_.data(), hRe_.data(), hIm_.data());
+        for (size_t k = 0; k < hRe_.size(); k++)
+        {
+            result.sumRe[k] += hRe_[k];
+            result.sumIm[k] += hIm_[k];
+        }
+
+        // As in LatencyAnalyzer, the first block of the chunk locates the peak
+        double delay;
+        if (result.delays.empty())
+        {
+            deconvolver_->impulseResponse(hRe_.data(), hIm_.data(), h_.data());
+            const size_t peak = findPeak(h_.data(), period_);
+            delay = static_cast<double>(peak);
+            polarity_ = h_[peak];
+        }
+        else
+        {
+            delay = result.delays.back();
+        }
+        result.delays.push_back(phaseSlopeDelay(hRe_.data(), hIm_.data(), period_, delay, polarity_));
+    }
+
+    void addKnownBlock(const float *frames, size_t rotation, ChunkResult& result)
+    {
+        correlator_->impulseResponse(frames, numChannels_, hRe_.data());
+        correlator_->impulseResponse(frames + 1, numChannels_, hIm_.data());
+        for (size_t k = 0; k < period_; k++)
+        {
+            const size_t n = (k + rotation) % period_;
+            result.sumRe[k] += hRe_[n];
+            result.sumIm[k] += hIm_[n];
+        }
+
+        size_t delay;
+        result.delays.push_back(relativePeakDelay(hRe_.data(), hIm_.data(), period_, delay));
+    }
+
+    const size_t period_;
+    const size_t numChannels_;
+    std::unique_ptr<Deconvolver> deconvolver_;
+    std::unique_ptr<StimulusCorrelator> correlator_;
+    std::vector<float> in_, out_;
+    std::vector<float> hRe_, hIm_, h_;
+    float polarity_{1.0f};      ///< Sign of h at the peak of the chunk's first block
+};
+
+}   // anonymous namespace
+
+
+ParallelLatencyAnalyzer::ParallelLatencyAnalyzer(size_t numThreads, size_t skipPeriods)
+    : numThreads_{(numThreads > 0) ? numThreads : std::max<size_t>(1, std::thread::hardware_concurrency())}
+    , skipPeriods_{skipPeriods}
+{
+}
+
+size_t ParallelLatencyAnalyzer::chunkPeriods(uint64_t numPeriods)
+{
+    return std::max<size_t>(kMinChunkPeriods, static_cast<size_t>((numPeriods + kMaxChunks - 1) / kMaxChunks));
+}
+
+LatencyResult ParallelLatencyAnalyzer::analyze(const RecordingReader& reader) const
+{
+    const auto &info = reader.info();
+    if (info.numChannels < 2)
+    {
+        throw std::invalid_argument("ParallelLatencyAnalyzer: at least two channels required");
+    }
+    const size_t period = info.period;
+    const uint64_t firstPeriod = std::min<uint64_t>(skipPeriods_, reader.numPeriods());
+    const uint64_t numPeriods = reader.numPeriods() - firstPeriod;
+    const size_t chunkSize = chunkPeriods(numPeriods);
+    const size_t numChunks = static_cast<size_t>((numPeriods + chunkSize - 1) / chunkSize);
+
+    const StimulusSignal *stimulus = nullptr;
+    if (info.stimulus != StimulusType::Chirp)
+    {
+        stimulus = &StimulusSignal::get(info.stimulus, nominalStimulusPeriod(info.stimulus, period));
+    }
+    const auto alignments = findAlignments(reader, stimulus, firstPeriod, firstPeriod + numPeriods);
+
+    // Workers are set up here so a bad period throws before any thread starts
+    std::vector<std::unique_ptr<ChunkWorker>> workers;
+    const size_t numWorkers = std::max<size_t>(1, std::min(numThreads_, numChunks));
+    for (size_t k = 0; k < numWorkers; k++)
+    {
+        workers.push_back(std::make_unique<ChunkWorker>(info, stimulus));
+    }
+
+    std::vector<ChunkResult> chunks(numChunks);
+    std::atomic<size_t> nextChunk{0};
+    std::mutex errorMutex;
+    std::exception_ptr error;
+    const auto work = [&](ChunkWorker &worker) {
+        try
+        {
+            for (size_t c = nextChunk++; c < numChunks; c = nextChunk++)
+            {
+                const uint64_t begin = firstPeriod + c * chunkSize;
+                worker.run(reader, alignments, begin, std::min<uint64_t>(chunkSize, firstPeriod + numPeriods - begin), chunks[c]);
+            }
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!error)
+            {
+                error = std::current_exception();
+            }
+            nextChunk = numChunks;
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t k = 1; k < workers.size(); k++)
+    {
+        threads.emplace_back(work, std::ref(*workers[k]));
+    }
+    work(*workers[0]);
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+
+    // Warm-up and the partial last period only count for the peak levels
+    LatencyResult result;
+    result.peakLevels.assign(info.numChannels, 0.0f);
+    {
+        const uint64_t begin = firstPeriod * period;
+        const uint64_t end = (firstPeriod + numPeriods) * period;
+        uint64_t chunkFirst = 0;
+        for (size_t k = 0; k < reader.numChunks(); k++)
+        {
+            const float *data = reader.chunkData(k);
+            const uint64_t chunkEnd = chunkFirst + reader.chunkFrames(k);
+            if (chunkFirst < begin)
+            {
+                updatePeaks(data, std::min(chunkEnd, begin) - chunkFirst, info.numChannels, result.peakLevels);
+            }
+            if (chunkEnd > end)
+            {
+                const uint64_t from = std::max(chunkFirst, end);
+                updatePeaks(data + (from - chunkFirst) * info.numChannels, chunkEnd - from, info.numChannels, result.peakLevels);
+            }
+            chunkFirst = chunkEnd;
+        }
+    }
+    if (chunks.empty())
+    {
+        return result;
+    }
+
+    // Merge in chunk order
+    std::vector<double> sumRe(chunks[0].sumRe.size(), 0.0);
+    std::vector<double> sumIm(chunks[0].sumIm.size(), 0.0);
+    DriftEstimator drift(period);
+    for (const auto &chunk : chunks)
+    {
+        for (size_t k = 0; k < sumRe.size(); k++)
+        {
+            sumRe[k] += chunk.sumRe[k];
+            sumIm[k] += chunk.sumIm[k];
+        }
+        for (auto delay : chunk.delays)
+        {
+            drift.add(delay);
+        }
+        for (size_t ch = 0; ch < info.numChannels; ch++)
+        {
+            result.peakLevels[ch] = std::max(result.peakLevels[ch], chunk.peakLevels[ch]);
+        }
+        result.numBlocks += chunk.delays.size();
+    }
+    result.driftPpm = drift.ppm();
+    if (result.numBlocks == 0)
+    {
+        return result;
+    }
+
+    const double scale = 1.0 / static_cast<double>(result.numBlocks);
+    if (stimulus)
+    {
+        std::vector<float> h0(period);
+        result.impulseResponse.resize(period);
+        for (size_t k = 0; k < period; k++)
+        {
+            h0[k] = static_cast<float>(sumRe[k] * scale);
+            result.impulseResponse[k] = static_cast<float>(sumIm[k] * scale);
+        }
+        result.fractionalDelay = relativePeakDelay(h0.data(), result.impulseResponse.data(), period, result.delay);
+    }
+    else
+    {
+        std::vector<float> meanRe(sumRe.size()), meanIm(sumIm.size());
+        for (size_t k = 0; k < sumRe.size(); k++)
+        {
+            meanRe[k] = static_cast<float>(sumRe[k] * scale);
+            meanIm[k] = static_cast<float>(sumIm[k] * scale);
+        }
+        result.impulseResponse.resize(period);
+        Deconvolver(period).impulseResponse(meanRe.data(), meanIm.data(), result.impulseResponse.data());
+        result.delay = findPeak(result.impulseResponse.data(), period);
+        result.fractionalDelay = phaseSlopeDelay(meanRe.data(), meanIm.data(), period, static_cast<double>(result.delay),
+                                                 result.impulseResponse[result.delay]);
+    }
+    result.delayMs = result.delay * 1000.0 / info.sampleRate;
+    result.fractionalDelayMs = result.fractionalDelay * 1000.0 / info.sampleRate;
+    return result;
+}
+
+LatencyResult analyzeRecordingParallel(const std::filesystem::path& filename, size_t numThreads)
+{
+    RecordingReader reader(filename);
+    return ParallelLatencyAnalyzer(numThreads).analyze(reader);
+}
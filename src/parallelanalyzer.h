@@ -0,0 +1,69 @@
+#ifndef PARALLELANALYZER_H
+#define PARALLELANALYZER_H
+
+#include "latencyanalyzer.h"
+#include "recordingfile.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+
+/**
+ * @brief LatencyAnalyzer spread over several threads for long recordings
+ *
+ * The periods after the warm-up are split into chunks of consecutive periods
+ * which the worker threads claim one at a time. Every worker owns its
+ * Deconvolver or StimulusCorrelator and scratch buffers and reads the periods
+ * straight from the memory mapping. Per chunk it sums H (or the two impulse
+ * responses against a known stimulus) in double and keeps the delay of every
+ * period.
+ *
+ * The chunk size only depends on the number of periods, and the partial sums
+ * and delays are merged in chunk order, so the result does not depend on the
+ * number of threads. It matches LatencyAnalyzer up to rounding.
+ *
+ * Like LatencyAnalyzer, it leaves out the periods with a dropout. Against a
+ * known stimulus, the rotation that realigns the periods after each dropout is
+ * found before the workers start, from the first period that follows it.
+ */
+class ParallelLatencyAnalyzer
+{
+public:
+    static constexpr size_t kMaxChunks = 64;        ///< Bounds the memory of the partial sums
+    static constexpr size_t kMinChunkPeriods = 8;
+
+    /**
+     * @param numThreads 0 for one per hardware thread
+     * @param skipPeriods Warm-up periods to ignore
+     */
+    explicit ParallelLatencyAnalyzer(size_t numThreads = 0, size_t skipPeriods = 2);
+
+    size_t numThreads() const {return numThreads_;}
+
+    /**
+     * @brief Periods per chunk for a recording of numPeriods analysed periods
+     */
+    static size_t chunkPeriods(uint64_t numPeriods);
+
+    /**
+     * @brief Analyse a passthrough layout recording
+     * @param reader
+     * @return
+     */
+    LatencyResult analyze(const RecordingReader& reader) const;
+
+private:
+    const size_t numThreads_;
+    const size_t skipPeriods_;
+};
+
+/**
+ * @brief analyzeRecording() on several threads
+ * @param filename
+ * @param numThreads 0 for one per hardware thread
+ * @return
+ */
+LatencyResult analyzeRecordingParallel(const std::filesystem::path& filename, size_t numThreads = 0);
+
+#endif // PARALLELANALYZER_H
@@ -0,0 +1,379 @@
+#include "periodcodec.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+
+namespace {
+
+constexpr double kInt24Scale = 8388608.0;   // 2^23
+constexpr unsigned kZeroBlock = 63;         ///< Rice parameter code of an all-zero block
+constexpr unsigned kMaxRice = 62;
+constexpr unsigned kEscape = 32;            ///< Unary length introducing a raw 64-bit value
+
+enum Predictor : unsigned
+{
+    None = 0,
+    Sample = 1,         ///< v[n-1]
+    Period = 2,         ///< r[n]
+    PeriodSlope = 3,    ///< r[n] + v[n-1] - r[n-1]
+};
+
+uint32_t floatBits(float x)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    return bits;
+}
+
+float bitsFloat(uint32_t bits)
+{
+    float x;
+    std::memcpy(&x, &bits, sizeof(x));
+    return x;
+}
+
+/**
+ * Float bit pattern as an integer that increases with the value, -0 just below +0
+ */
+int64_t toOrdered(float x)
+{
+    const uint32_t bits = floatBits(x);
+    const int64_t magnitude = bits & 0x7fffffffu;
+    return (bits & 0x80000000u) ? (-magnitude - 1) : magnitude;
+}
+
+float fromOrdered(int64_t v)
+{
+    const uint32_t bits = (v >= 0) ? static_cast<uint32_t>(v) : (0x80000000u | static_cast<uint32_t>(-(v + 1)));
+    return bitsFloat(bits);
+}
+
+/**
+ * True if x is k / 2^23 for an integer k, so it survives fromInt24(toInt24(x))
+ */
+bool isInt24(float x)
+{
+    if (!(std::abs(x) <= 1.0f) || ((x == 0.0f) && std::signbit(x)))
+    {
+        return false;
+    }
+    const double v = static_cast<double>(x) * kInt24Scale;
+    return v == std::floor(v);
+}
+
+int64_t toInt24(float x)
+{
+    return static_cast<int64_t>(static_cast<double>(x) * kInt24Scale);
+}
+
+float fromInt24(int64_t v)
+{
+    return static_cast<float>(static_cast<double>(v) / kInt24Scale);
+}
+
+uint64_t zigzag(int64_t v)
+{
+    return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+}
+
+int64_t unzigzag(uint64_t u)
+{
+    return static_cast<int64_t>(u >> 1) ^ -static_cast<int64_t>(u & 1);
+}
+
+int64_t predict(unsigned predictor, const int64_t *v, const int64_t *r, size_t n)
+{
+    const int64_t previous = (n > 0) ? v[n - 1] : 0;
+    switch (predictor)
+    {
+    case Sample:        return previous;
+    case Period:        return r[n];
+    case PeriodSlope:   return r[n] + ((n > 0) ? (previous - r[n - 1]) : 0);
+    default:            return 0;
+    }
+}
+
+
+/**
+ * MSB-first bit packing into a byte vector
+ */
+class BitWriter
+{
+public:
+    explicit BitWriter(std::vector<uint8_t>& out) : out_(out) {}
+    ~BitWriter() {flush();}
+
+    void put(uint64_t value, unsigned count)
+    {
+        if (count > 32)
+        {
+            put(value >> 32, count - 32);
+            count = 32;
+        }
+        acc_ = (acc_ << count) | (value & ((uint64_t(1) << count) - 1));
+        bits_ += count;
+        while (bits_ >= 8)
+        {
+            bits_ -= 8;
+            out_.push_back(static_cast<uint8_t>(acc_ >> bits_));
+        }
+        acc_ &= (uint64_t(1) << bits_) - 1;
+    }
+
+    void putRice(uint64_t value, unsigned k)
+    {
+        const uint64_t q = value >> k;
+        if (q >= kEscape)
+        {
+            putOnes(kEscape);
+            put(value, 64);
+            return;
+        }
+        putOnes(static_cast<unsigned>(q));
+        put(0, 1);
+        put(value, k);
+    }
+
+    void flush()
+    {
+        if (bits_ > 0)
+        {
+            put(0, 8 - bits_);
+        }
+    }
+
+private:
+    void putOnes(unsigned count)
+    {
+        while (count > 0)
+        {
+            const unsigned n = std::min(count, 32u);
+            put((uint64_t(1) << n) - 1, n);
+            count -= n;
+        }
+    }
+
+    std::vector<uint8_t>& out_;
+    uint64_t acc_{0};
+    unsigned bits_{0};
+};
+
+
+class BitReader
+{
+public:
+    BitReader(const uint8_t *data, size_t size) : data_(data), size_(size) {}
+
+    bool ok() const {return ok_;}
+
+    uint64_t get(unsigned count)
+    {
+        if (count > 32)
+        {
+            const uint64_t high = get(count - 32);
+            return (high << 32) | get(32);
+        }
+        uint64_t value = 0;
+        for (unsigned k = 0; k < count; k++)
+        {
+            value = (value << 1) | bit();
+        }
+        return value;
+    }
+
+    uint64_t getRice(unsigned k)
+    {
+        unsigned q = 0;
+        while ((q < kEscape) && bit())
+        {
+            q++;
+        }
+        if (q == kEscape)
+        {
+            return get(64);
+        }
+        return (uint64_t(q) << k) | get(k);
+    }
+
+private:
+    unsigned bit()
+    {
+        if (pos_ >= 8 * size_)
+        {
+            ok_ = false;
+            return 0;
+        }
+        const unsigned b = (data_[pos_ / 8] >> (7 - pos_ % 8)) & 1;
+        pos_++;
+        return b;
+    }
+
+    const uint8_t *data_;
+    size_t size_;
+    size_t pos_{0};
+    bool ok_{true};
+};
+
+
+/**
+ * Rice parameter and coded size of a block of zigzagged residuals
+ */
+std::pair<unsigned, uint64_t> chooseRice(const uint64_t *u, size_t count)
+{
+    uint64_t sum = 0;
+    uint64_t maxValue = 0;
+    for (size_t n = 0; n < count; n++)
+    {
+        sum += std::min<uint64_t>(u[n], uint64_t(1) << 40);
+        maxValue = std::max(maxValue, u[n]);
+    }
+    if (maxValue == 0)
+    {
+        return {kZeroBlock, 0};
+    }
+
+    const double mean = static_cast<double>(sum) / static_cast<double>(count);
+    const int guess = (mean >= 1.0) ? static_cast<int>(std::log2(mean)) : 0;
+    unsigned best = 0;
+    uint64_t bestBits = std::numeric_limits<uint64_t>::max();
+    for (int k = std::max(0, guess - 1); k <= std::min<int>(kMaxRice, guess + 1); k++)
+    {
+        uint64_t bits = 0;
+        for (size_t n = 0; n < count; n++)
+        {
+            const uint64_t q = u[n] >> k;
+            bits += (q >= kEscape) ? (kEscape + 64) : (q + 1 + k);
+        }
+        if (bits < bestBits)
+        {
+            best = static_cast<unsigned>(k);
+            bestBits = bits;
+        }
+    }
+    return {best, bestBits};
+}
+
+}   // anonymous namespace
+
+
+PeriodCodec::PeriodCodec(size_t numChannels, size_t period)
+    : numChannels_(numChannels)
+    , period_(period)
+    , reference_(numChannels * period)
+    , value_(period)
+    , prev_(period)
+    , residual_(kBlockSize)
+{
+    if ((numChannels == 0) || (period == 0))
+    {
+        throw std::invalid_argument("PeriodCodec: invalid layout");
+    }
+}
+
+void PeriodCodec::encode(const float *frames, std::vector<uint8_t>& out)
+{
+    BitWriter writer(out);
+    for (size_t ch = 0; ch < numChannels_; ch++)
+    {
+        bool integer = true;
+        for (size_t n = 0; (n < period_) && integer; n++)
+        {
+            integer = isInt24(frames[n * numChannels_ + ch])
+                && (!haveReference_ || isInt24(reference_[n * numChannels_ + ch]));
+        }
+        for (size_t n = 0; n < period_; n++)
+        {
+            const float x = frames[n * numChannels_ + ch];
+            const float r = reference_[n * numChannels_ + ch];
+            value_[n] = integer ? toInt24(x) : toOrdered(x);
+            prev_[n] = integer ? toInt24(r) : toOrdered(r);
+        }
+        writer.put(integer ? 1 : 0, 1);
+
+        const unsigned numPredictors = haveReference_ ? 4 : 2;
+        for (size_t start = 0; start < period_; start += kBlockSize)
+        {
+            const size_t count = std::min(kBlockSize, period_ - start);
+            unsigned bestPredictor = None;
+            unsigned bestRice = 0;
+            uint64_t bestBits = std::numeric_limits<uint64_t>::max();
+            for (unsigned p = 0; p < numPredictors; p++)
+            {
+                for (size_t n = 0; n < count; n++)
+                {
+                    residual_[n] = zigzag(value_[start + n] - predict(p, value_.data(), prev_.data(), start + n));
+                }
+                const auto [rice, bits] = chooseRice(residual_.data(), count);
+                if (bits < bestBits)
+                {
+                    bestPredictor = p;
+                    bestRice = rice;
+                    bestBits = bits;
+                }
+            }
+
+            writer.put(bestPredictor, 2);
+            writer.put(bestRice, 6);
+            if (bestRice == kZeroBlock)
+            {
+                continue;
+            }
+            for (size_t n = 0; n < count; n++)
+            {
+                const int64_t v = value_[start + n] - predict(bestPredictor, value_.data(), prev_.data(), start + n);
+                writer.putRice(zigzag(v), bestRice);
+            }
+        }
+    }
+    writer.flush();
+
+    std::copy(frames, frames + reference_.size(), reference_.begin());
+    haveReference_ = true;
+}
+
+bool PeriodCodec::decode(const uint8_t *data, size_t size, float *frames)
+{
+    BitReader reader(data, size);
+    for (size_t ch = 0; ch < numChannels_; ch++)
+    {
+        const bool integer = (reader.get(1) != 0);
+        for (size_t n = 0; n < period_; n++)
+        {
+            const float r = reference_[n * numChannels_ + ch];
+            prev_[n] = integer ? (isInt24(r) ? toInt24(r) : 0) : toOrdered(r);
+        }
+
+        for (size_t start = 0; start < period_; start += kBlockSize)
+        {
+            const size_t count = std::min(kBlockSize, period_ - start);
+            const auto predictor = static_cast<unsigned>(reader.get(2));
+            const auto rice = static_cast<unsigned>(reader.get(6));
+            if (!reader.ok() || (!haveReference_ && (predictor >= Period)))
+            {
+                return false;
+            }
+            for (size_t n = start; n < start + count; n++)
+            {
+                const int64_t residual = (rice == kZeroBlock) ? 0 : unzigzag(reader.getRice(rice));
+                value_[n] = predict(predictor, value_.data(), prev_.data(), n) + residual;
+            }
+        }
+        if (!reader.ok())
+        {
+            return false;
+        }
+
+        for (size_t n = 0; n < period_; n++)
+        {
+            frames[n * numChannels_ + ch] = integer ? fromInt24(value_[n]) : fromOrdered(value_[n]);
+        }
+    }
+
+    std::copy(frames, frames + reference_.size(), reference_.begin());
+    haveReference_ = true;
+    return true;
+}
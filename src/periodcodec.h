@@ -0,0 +1,64 @@
+#ifndef PERIODCODEC_H
+#define PERIODCODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+/**
+ * @brief Lossless compression of interleaved float32 periods of a periodic recording
+ *
+ * Each channel of a period is coded in blocks of kBlockSize samples. A block
+ * picks the best of four predictors: none, the previous sample, the same sample
+ * one period earlier, or that plus the sample-to-sample change of the previous
+ * period. The residuals are Rice coded with a per-block parameter; a block of
+ * zero residuals costs one byte. Samples are predicted as 24-bit integers when
+ * the channel (and its previous period) holds exact 24-bit values, as converter
+ * data does, and otherwise as their float bit patterns mapped to ordered
+ * integers, so every float, NaN and -0 included, round-trips bit exact.
+ *
+ * Encoder and decoder keep the previous period as reference; after reset(), or
+ * for the first period, it is coded on its own.
+ */
+class PeriodCodec
+{
+public:
+    static constexpr size_t kBlockSize = 256;
+
+    PeriodCodec(size_t numChannels, size_t period);
+
+    /**
+     * @brief Code the next period without reference to the previous one
+     */
+    void reset() {haveReference_ = false;}
+
+    /**
+     * @brief Append one coded period
+     * @param frames Interleaved, period * numChannels samples
+     * @param out
+     */
+    void encode(const float *frames, std::vector<uint8_t>& out);
+
+    /**
+     * @brief Decode one period
+     * @param data
+     * @param size
+     * @param frames Interleaved, period * numChannels samples
+     * @return false if the data is truncated or corrupt
+     */
+    bool decode(const uint8_t *data, size_t size, float *frames);
+
+    size_t numChannels() const {return numChannels_;}
+    size_t period() const {return period_;}
+
+private:
+    const size_t numChannels_;
+    const size_t period_;
+    std::vector<float> reference_;      ///< Previous period, interleaved
+    bool haveReference_{false};
+    std::vector<int64_t> value_, prev_; ///< One channel of the current and previous period
+    std::vector<uint64_t> residual_;
+};
+
+#endif // PERIODCODEC_H
@@ -0,0 +1,348 @@
+#include "recordingfile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+namespace {
+
+uint64_t padToPage(uint64_t size)
+{
+    return (size + recording::kPageSize - 1) / recording::kPageSize * recording::kPageSize;
+}
+
+void writePadded(std::ofstream& file, const void *data, size_t size)
+{
+    static const char zeros[recording::kPageSize] = {};
+    file.write(reinterpret_cast<const char*>(data), size);
+    size_t padding = padToPage(size) - size;
+    while (padding > 0)
+    {
+        const size_t count = std::min(padding, sizeof(zeros));
+        file.write(zeros, count);
+        padding -= count;
+    }
+}
+
+}   // anonymous namespace
+
+
+recording::FileHeader recording::makeHeader(const RecordingInfo& info, const char (&magic)[8])
+{
+    FileHeader header{};
+    std::memcpy(header.magic, magic, sizeof(header.magic));
+    header.version = kVersion;
+    header.numChannels = static_cast<uint32_t>(info.numChannels);
+    header.sampleRate = info.sampleRate;
+    header.period = static_cast<uint32_t>(info.period);
+    header.bufferSize = static_cast<uint32_t>(info.bufferSize);
+    header.numOutputs = static_cast<uint32_t>(info.numOutputs);
+    header.layout = static_cast<uint32_t>(info.layout);
+    header.stimulus = static_cast<uint32_t>(info.stimulus);
+    header.startTime = info.startTime;
+    std::strncpy(header.deviceUID, info.deviceUID.c_str(), sizeof(header.deviceUID) - 1);
+    return header;
+}
+
+RecordingInfo recording::headerInfo(const FileHeader& header)
+{
+    RecordingInfo info;
+    info.sampleRate = header.sampleRate;
+    info.numChannels = header.numChannels;
+    info.numOutputs = header.numOutputs;
+    info.layout = static_cast<StimulusLayout>(header.layout);
+    info.stimulus = static_cast<StimulusType>(header.stimulus);
+    info.period = header.period;
+    info.bufferSize = header.bufferSize;
+    info.startTime = header.startTime;
+    info.deviceUID.assign(header.deviceUID, strnlen(header.deviceUID, sizeof(header.deviceUID)));
+    return info;
+}
+
+
+RecordingFileWriter::RecordingFileWriter(const std::filesystem::path& filename, const RecordingInfo& info, size_t periodsPerChunk)
+{
+    if ((info.numChannels == 0) || (info.period == 0) || (periodsPerChunk == 0) || (periodsPerChunk > recording::kMaxChunkDropouts))
+    {
+        throw std::invalid_argument("RecordingFileWriter: invalid layout");
+    }
+
+    header_ = recording::makeHeader(info, recording::kFileMagic);
+    header_.chunkFrames = static_cast<uint32_t>(info.period * periodsPerChunk);
+
+    file_.open(filename, std::ios::binary | std::ios::trunc);
+    if (!file_.is_open())
+    {
+        throw std::runtime_error("Cannot open recording file");
+    }
+    writePadded(file_, &header_, sizeof(header_));
+    if (file_.fail())
+    {
+        throw std::runtime_error("Cannot write recording file");
+    }
+
+    chunk_.resize(static_cast<size_t>(header_.chunkFrames) * info.numChannels);
+    dropouts_.reserve(periodsPerChunk);
+}
+
+RecordingFileWriter::~RecordingFileWriter()
+{
+    close();
+}
+
+void RecordingFileWriter::write(const float *samples, size_t count)
+{
+    while (count > 0)
+    {
+        const size_t n = std::min(count, chunk_.size() - fill_);
+        std::copy(samples, samples + n, chunk_.begin() + fill_);
+        fill_ += n;
+        samples += n;
+        count -= n;
+
+        if (fill_ == chunk_.size())
+        {
+            writeChunk();
+        }
+    }
+}
+
+void RecordingFileWriter::markDropout()
+{
+    const auto frame = static_cast<uint32_t>(fill_ / header_.numChannels);
+    if (dropouts_.empty() || (dropouts_.back() / header_.period != frame / header_.period))
+    {
+        dropouts_.push_back(frame);
+    }
+}
+
+void RecordingFileWriter::writeChunk()
+{
+    const uint64_t numFrames = fill_ / header_.numChannels;
+    fill_ = 0;
+    if ((numFrames == 0) || failed_)
+    {
+        dropouts_.clear();
+        return;
+    }
+
+    const auto offset = static_cast<uint64_t>(file_.tellp());
+
+    recording::ChunkHeader chunk{};
+    chunk.magic = recording::kChunkMagic;
+    chunk.index = header_.numChunks;
+    chunk.firstFrame = header_.numFrames;
+    chunk.numFrames = numFrames;
+    // A dropout after the last samples of the recording has nothing to mark
+    if (!dropouts_.empty() && (dropouts_.back() >= numFrames))
+    {
+        dropouts_.pop_back();
+    }
+    chunk.numDropouts = static_cast<uint32_t>(dropouts_.size());
+    std::copy(dropouts_.begin(), dropouts_.end(), chunk.dropouts);
+    dropouts_.clear();
+    writePadded(file_, &chunk, sizeof(chunk));
+    writePadded(file_, chunk_.data(), numFrames * header_.numChannels * sizeof(float));
+
+    // Hand complete chunks to the OS so a crash loses at most the chunk in progress
+    file_.flush();
+    if (file_.fail())
+    {
+        // e.g. the disk is full; keep the index consistent with the chunks written so far
+        failed_ = true;
+        return;
+    }
+
+    offsets_.push_back(offset);
+    header_.numChunks++;
+    header_.numFrames += numFrames;
+}
+
+void RecordingFileWriter::close()
+{
+    if (!file_.is_open())
+    {
+        return;
+    }
+
+    writeChunk();
+
+    // After a failed chunk the reader recovers the chunks by scanning instead of an index
+    if (!failed_)
+    {
+        recording::IndexHeader index{};
+        index.magic = recording::kIndexMagic;
+        index.numChunks = offsets_.size();
+        header_.indexOffset = static_cast<uint64_t>(file_.tellp());
+        file_.write(reinterpret_cast<const char*>(&index), sizeof(index));
+        file_.write(reinterpret_cast<const char*>(offsets_.data()), offsets_.size() * sizeof(uint64_t));
+        file_.flush();
+        if (file_.fail())
+        {
+            failed_ = true;
+            header_.indexOffset = 0;
+        }
+    }
+
+    // Rewrite the header even so, as its chunk count covers what was written
+    file_.clear();
+    file_.seekp(0);
+    file_.write(reinterpret_cast<const char*>(&header_), sizeof(header_));
+    file_.flush();
+    failed_ = failed_ || file_.fail();
+    file_.close();
+}
+
+
+RecordingReader::RecordingReader(const std::filesystem::path& filename)
+{
+    const int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw std::runtime_error("Cannot open recording file");
+    }
+    struct stat st;
+    if ((::fstat(fd, &st) != 0) || (static_cast<size_t>(st.st_size) < recording::kPageSize))
+    {
+        ::close(fd);
+        throw std::runtime_error("Recording file is too short");
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    void *ptr = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (ptr == MAP_FAILED)
+    {
+        throw std::runtime_error("Cannot map recording file");
+    }
+    data_ = static_cast<const uint8_t*>(ptr);
+
+    recording::FileHeader header;
+    std::memcpy(&header, data_, sizeof(header));
+    if ((std::memcmp(header.magic, recording::kFileMagic, sizeof(header.magic)) != 0) || (header.version != recording::kVersion)
+        || (header.numChannels == 0) || (header.period == 0) || (header.chunkFrames % header.period != 0))
+    {
+        ::munmap(const_cast<uint8_t*>(data_), size_);
+        throw std::runtime_error("Not a recording file");
+    }
+
+    info_ = recording::headerInfo(header);
+    chunkFrames_ = header.chunkFrames;
+
+    if (!readIndex(header))
+    {
+        recovered_ = true;
+        chunks_.clear();
+        dropouts_.clear();
+        numFrames_ = 0;
+        scanChunks(header);
+    }
+}
+
+RecordingReader::~RecordingReader()
+{
+    if (data_ != nullptr)
+    {
+        ::munmap(const_cast<uint8_t*>(data_), size_);
+    }
+}
+
+const float* RecordingReader::period(uint64_t idx) const
+{
+    const uint64_t frame = idx * info_.period;
+    if (frame + info_.period > numFrames_)
+    {
+        throw std::out_of_range("RecordingReader: period out of range");
+    }
+    // All chunks but the last are full
+    const auto &chunk = chunks_[frame / chunkFrames_];
+    return chunk.data + (frame - chunk.firstFrame) * info_.numChannels;
+}
+
+bool RecordingReader::periodHasDropout(uint64_t idx) const
+{
+    const auto it = std::lower_bound(dropouts_.begin(), dropouts_.end(), idx * info_.period);
+    return (it != dropouts_.end()) && (*it < (idx + 1) * info_.period);
+}
+
+bool RecordingReader::readIndex(const recording::FileHeader& header)
+{
+    const uint64_t offset = header.indexOffset;
+    if ((offset == 0) || (offset + sizeof(recording::IndexHeader) > size_))
+    {
+        return false;
+    }
+    recording::IndexHeader index;
+    std::memcpy(&index, data_ + offset, sizeof(index));
+    if ((index.magic != recording::kIndexMagic) || (index.numChunks != header.numChunks)
+        || (offset + sizeof(index) + index.numChunks * sizeof(uint64_t) > size_))
+    {
+        return false;
+    }
+
+    for (uint64_t k = 0; k < index.numChunks; k++)
+    {
+        uint64_t chunkOffset;
+        std::memcpy(&chunkOffset, data_ + offset + sizeof(index) + k * sizeof(uint64_t), sizeof(chunkOffset));
+        if (!addChunk(chunkOffset, header))
+        {
+            return false;
+        }
+    }
+    return numFrames_ == header.numFrames;
+}
+
+void RecordingReader::scanChunks(const recording::FileHeader& header)
+{
+    uint64_t offset = recording::kPageSize;
+    while (addChunk(offset, header))
+    {
+        offset += recording::kPageSize + padToPage(chunks_.back().numFrames * header.numChannels * sizeof(float));
+    }
+}
+
+bool RecordingReader::addChunk(uint64_t offset, const recording::FileHeader& header)
+{
+    if ((offset % recording::kPageSize != 0) || (offset + recording::kPageSize > size_))
+    {
+        return false;
+    }
+    recording::ChunkHeader chunk;
+    std::memcpy(&chunk, data_ + offset, sizeof(chunk));
+    const uint64_t payloadSize = chunk.numFrames * header.numChannels * sizeof(float);
+    if ((chunk.magic != recording::kChunkMagic) || (chunk.index != chunks_.size()) || (chunk.firstFrame != numFrames_)
+        || (chunk.numFrames == 0) || (chunk.numFrames > header.chunkFrames)
+        || (offset + recording::kPageSize + payloadSize > size_))
+    {
+        return false;
+    }
+    // Only the last chunk may be partial
+    if (!chunks_.empty() && (chunks_.back().numFrames != header.chunkFrames))
+    {
+        return false;
+    }
+    if (chunk.numDropouts > recording::kMaxChunkDropouts)
+    {
+        return false;
+    }
+    for (uint32_t k = 0; k < chunk.numDropouts; k++)
+    {
+        if ((chunk.dropouts[k] >= chunk.numFrames) || ((k > 0) && (chunk.dropouts[k] <= chunk.dropouts[k - 1])))
+        {
+            return false;
+        }
+    }
+    for (uint32_t k = 0; k < chunk.numDropouts; k++)
+    {
+        dropouts_.push_back(chunk.firstFrame + chunk.dropouts[k]);
+    }
+
+    chunks_.push_back({reinterpret_cast<const float*>(data_ + offset + recording::kPageSize), chunk.firstFrame, chunk.numFrames});
+    numFrames_ += chunk.numFrames;
+    return true;
+}
@@ -0,0 +1,276 @@
+#ifndef RECORDINGFILE_H
+#define RECORDINGFILE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+
+/**
+ * Chunked recording container
+ *
+ * [FileHeader page][ChunkHeader page][payload, padded to page]...[IndexHeader][offsets]
+ *
+ * Every chunk holds a whole number of stimulus periods of interleaved float32
+ * frames, so a period never straddles two chunks and can be addressed in place
+ * once the file is mapped. Chunks are written complete, header first. The file
+ * header points to the chunk offset index when the file is closed cleanly; if it
+ * does not, readers recover by walking the chunk headers. The chunk header also
+ * lists where recorded samples were dropped, at most once per period, so the
+ * list survives recovery.
+ */
+namespace recording {
+
+constexpr size_t kPageSize = 4096;
+constexpr char kFileMagic[8] = {'T', 'C', 'A', 'L', 'R', 'E', 'C', '1'};
+constexpr uint32_t kChunkMagic = 0x4b4e4843;    // "CHNK"
+constexpr uint32_t kIndexMagic = 0x58444e49;    // "INDX"
+constexpr uint32_t kVersion = 2;                // 2 added numOutputs, layout and stimulus
+constexpr size_t kMaxChunkDropouts = 1016;      ///< Fills the chunk header page, bounds the periods per chunk
+
+struct FileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t numChannels;
+    double sampleRate;
+    uint32_t period;
+    uint32_t bufferSize;
+    uint32_t chunkFrames;       ///< Frames per full chunk, a multiple of period
+    uint32_t numOutputs;        ///< Output channels driven with the stimulus
+    uint32_t layout;            ///< StimulusLayout
+    uint32_t stimulus;          ///< StimulusType
+    uint64_t startTime;         ///< Nanoseconds since the Unix epoch
+    uint64_t indexOffset;       ///< 0 until the file is closed
+    uint64_t numChunks;
+    uint64_t numFrames;
+    char deviceUID[256];
+};
+
+struct ChunkHeader
+{
+    uint32_t magic;
+    uint32_t numDropouts;       ///< Was reserved and zero, so older files read without dropouts
+    uint64_t index;
+    uint64_t firstFrame;
+    uint64_t numFrames;
+    uint32_t dropouts[kMaxChunkDropouts];   ///< Ascending frame offsets into the chunk
+};
+
+struct IndexHeader
+{
+    uint32_t magic;
+    uint32_t reserved;
+    uint64_t numChunks;
+};
+
+static_assert(sizeof(FileHeader) <= kPageSize, "FileHeader must fit in one page");
+static_assert(sizeof(ChunkHeader) <= kPageSize, "ChunkHeader must fit in one page");
+
+}   // namespace recording
+
+
+/**
+ * @brief How the stimulus is routed to the outputs
+ */
+enum class StimulusLayout : uint32_t
+{
+    Passthrough = 0,    ///< Output 0 plays the stimulus, output 1 echoes input 0
+    Matrix = 1,         ///< Output j plays the stimulus delayed by j * matrixOutputShift()
+};
+
+/**
+ * @brief Periodic stimulus signal, see StimulusSignal
+ */
+enum class StimulusType : uint32_t
+{
+    Chirp = 0,          ///< Linear chirp with a flat spectrum
+    Mls = 1,            ///< Maximum-length sequence of period - 1 samples
+    Golay = 2,          ///< Golay complementary pair, each followed by a gap of its length
+    LogSweep = 3,       ///< Exponential sine sweep
+};
+
+
+struct RecordingInfo
+{
+    double sampleRate{0};
+    size_t numChannels{2};      ///< Recorded input channels
+    size_t numOutputs{2};
+    StimulusLayout layout{StimulusLayout::Passthrough};
+    StimulusType stimulus{StimulusType::Chirp};
+    size_t period{0};           ///< Stimulus period in frames
+    size_t bufferSize{0};
+    std::string deviceUID;
+    uint64_t startTime{0};
+};
+
+namespace recording {
+
+/**
+ * @brief File header describing info, without the chunk layout and counters
+ */
+FileHeader makeHeader(const RecordingInfo& info, const char (&magic)[8]);
+RecordingInfo headerInfo(const FileHeader& header);
+
+}   // namespace recording
+
+
+/**
+ * @brief Destination of recorded samples on the writer thread
+ */
+class RecordingSink
+{
+public:
+    virtual ~RecordingSink() = default;
+
+    /**
+     * @brief Append interleaved samples; need not be frame aligned
+     */
+    virtual void write(const float *samples, size_t count) = 0;
+
+    /**
+     * @brief Samples were dropped just before the next ones written
+     */
+    virtual void markDropout() {}
+
+    virtual void close() = 0;
+
+    /**
+     * @brief True if a write to the destination failed; samples after that are lost
+     */
+    virtual bool failed() const {return false;}
+};
+
+
+/**
+ * @brief Sequential writer of the chunked recording container
+ */
+class RecordingFileWriter : public RecordingSink
+{
+public:
+    /**
+     * @brief Create the file and write the header, throwing std::runtime_error if it cannot
+     * @param filename
+     * @param info
+     * @param periodsPerChunk At most kMaxChunkDropouts
+     */
+    RecordingFileWriter(const std::filesystem::path& filename, const RecordingInfo& info, size_t periodsPerChunk = 16);
+    ~RecordingFileWriter() override;
+
+    /**
+     * @brief Append interleaved samples; need not be frame aligned
+     * @param samples
+     * @param count Number of samples (not frames)
+     */
+    void write(const float *samples, size_t count) override;
+
+    /**
+     * @brief Note the dropout in the header of the chunk in progress
+     *
+     * Only the first dropout of every period is kept, as readers skip the whole
+     * period either way.
+     */
+    void markDropout() override;
+
+    /**
+     * @brief Write the last partial chunk and the index, finalize the header
+     */
+    void close() override;
+
+    /**
+     * @brief A chunk, the index or the final header could not be written
+     *
+     * Runs on the writer thread, so failures are flagged rather than thrown.
+     * Chunks are not written after the first failure; the reader can still
+     * recover the ones before it by scanning.
+     */
+    bool failed() const override {return failed_;}
+
+private:
+    void writeChunk();
+
+    std::ofstream file_;
+    recording::FileHeader header_{};
+    std::vector<float> chunk_;
+    size_t fill_{0};
+    std::vector<uint32_t> dropouts_;    ///< Frame offsets into the chunk in progress
+    std::vector<uint64_t> offsets_;
+    bool failed_{false};
+};
+
+
+/**
+ * @brief Memory-mapped, zero-copy reader
+ */
+class RecordingReader
+{
+public:
+    explicit RecordingReader(const std::filesystem::path& filename);
+    ~RecordingReader();
+
+    RecordingReader(const RecordingReader&) = delete;
+    RecordingReader& operator=(const RecordingReader&) = delete;
+
+    const RecordingInfo& info() const {return info_;}
+
+    /**
+     * @brief True if the index was missing and the chunks were recovered by scanning
+     */
+    bool recovered() const {return recovered_;}
+
+    uint64_t numFrames() const {return numFrames_;}
+    size_t numChunks() const {return chunks_.size();}
+    uint64_t numPeriods() const {return numFrames_ / info_.period;}
+
+    /**
+     * @brief Interleaved frames of one chunk
+     */
+    const float* chunkData(size_t idx) const {return chunks_[idx].data;}
+    uint64_t chunkFrames(size_t idx) const {return chunks_[idx].numFrames;}
+
+    /**
+     * @brief Interleaved frames of one full period, pointing into the mapping
+     * @param idx
+     * @return
+     */
+    const float* period(uint64_t idx) const;
+
+    /**
+     * @brief Ascending frame positions where recorded samples were dropped
+     *
+     * The frame at a position follows the gap. Only the first dropout of
+     * every period is stored.
+     */
+    const std::vector<uint64_t>& dropouts() const {return dropouts_;}
+
+    /**
+     * @brief A dropout lies in the period or at its first frame, so its frames are not contiguous
+     */
+    bool periodHasDropout(uint64_t idx) const;
+
+private:
+    struct Chunk
+    {
+        const float *data{nullptr};
+        uint64_t firstFrame{0};
+        uint64_t numFrames{0};
+    };
+
+    bool readIndex(const recording::FileHeader& header);
+    void scanChunks(const recording::FileHeader& header);
+    bool addChunk(uint64_t offset, const recording::FileHeader& header);
+
+    const uint8_t *data_{nullptr};
+    size_t size_{0};
+    RecordingInfo info_;
+    uint64_t chunkFrames_{0};
+    uint64_t numFrames_{0};
+    bool recovered_{false};
+    std::vector<Chunk> chunks_;
+    std::vector<uint64_t> dropouts_;
+};
+
+#endif // RECORDINGFILE_H
@@ -0,0 +1,131 @@
+#include "recordingwriter.h"
+
+#include <algorithm>
+#include <chrono>
+
+
+RecordingWriter::RecordingWriter(const std::filesystem::path& filename, const RecordingInfo& info, Listener listener,
+                                 size_t capacity, WorkerPool *pool)
+    : RecordingWriter(std::make_unique<RecordingFileWriter>(filename, info), std::move(listener), capacity, pool)
+{
+}
+
+RecordingWriter::RecordingWriter(std::unique_ptr<RecordingSink> sink, Listener listener, size_t capacity, WorkerPool *pool)
+    : sink_(std::move(sink))
+    , listener_(std::move(listener))
+    , ring_(capacity)
+    , batch_(ring_.capacity() / 4)
+    , pool_(pool)
+    , gaps_(std::max<size_t>(ring_.capacity() / 16, 16))
+{
+    if (pool_ != nullptr)
+    {
+        poller_ = pool_->addPoller([this] {return drain() > 0;});
+    }
+    else
+    {
+        thread_ = std::thread(&RecordingWriter::run, this);
+    }
+}
+
+RecordingWriter::~RecordingWriter()
+{
+    close();
+}
+
+bool RecordingWriter::write(const float *samples, size_t count)
+{
+    if (!ring_.push(samples, count))
+    {
+        // Queued before any later block, so the writer sees the gap before the samples after it
+        if ((pushedSamples_ != lastGap_) && gaps_.push(&pushedSamples_, 1))
+        {
+            lastGap_ = pushedSamples_;
+        }
+        overruns_.fetch_add(1, std::memory_order_relaxed);
+        droppedSamples_.fetch_add(count, std::memory_order_relaxed);
+        return false;
+    }
+    pushedSamples_ += count;
+    return true;
+}
+
+void RecordingWriter::close()
+{
+    if (thread_.joinable())
+    {
+        running_.store(false, std::memory_order_release);
+        thread_.join();
+        sink_->close();
+    }
+    else if (poller_ != 0)
+    {
+        pool_->removePoller(poller_);
+        poller_ = 0;
+        while (drain() != 0)
+        {
+        }
+        sink_->close();
+    }
+}
+
+void RecordingWriter::run()
+{
+    // Poll rather than wait on a condition variable: the producer is a real-time
+    // thread and must not be asked to signal anything.
+    constexpr auto kPollInterval = std::chrono::milliseconds(5);
+
+    while (running_.load(std::memory_order_acquire))
+    {
+        if (drain() == 0)
+        {
+            std::this_thread::sleep_for(kPollInterval);
+        }
+    }
+
+    while (drain() != 0)
+    {
+    }
+}
+
+size_t RecordingWriter::drain()
+{
+    size_t total = 0;
+    while (true)
+    {
+        // A queued gap follows samples that are already in the ring buffer
+        if (!gapPending_)
+        {
+            gapPending_ = (gaps_.pop(&nextGap_, 1) == 1);
+        }
+        if (gapPending_ && (nextGap_ == poppedSamples_))
+        {
+            sink_->markDropout();
+            gapPending_ = false;
+            continue;
+        }
+
+        const size_t available = ring_.readAvailable();
+        if ((available == 0) || ((available < batch_.size()) && (total > 0)))
+        {
+            break;
+        }
+
+        // End the batch at the next gap so its mark lands right there
+        size_t count = std::min(available, batch_.size());
+        if (gapPending_)
+        {
+            count = static_cast<size_t>(std::min<uint64_t>(count, nextGap_ - poppedSamples_));
+        }
+        count = ring_.pop(batch_.data(), count);
+        poppedSamples_ += count;
+        sink_->write(batch_.data(), count);
+        writtenSamples_.fetch_add(count, std::memory_order_relaxed);
+        if (listener_)
+        {
+            listener_(batch_.data(), count);
+        }
+        total += count;
+    }
+    return total;
+}
@@ -0,0 +1,94 @@
+#ifndef RECORDINGWRITER_H
+#define RECORDINGWRITER_H
+
+#include "spscringbuffer.h"
+#include "recordingfile.h"
+#include "workerpool.h"
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+
+/**
+ * @brief Stream samples from the audio I/O thread to disk
+ *
+ * write() only copies into a lock-free ring buffer; a dedicated writer thread
+ * drains it in large batches into a chunked recording file or another RecordingSink. If the ring buffer is
+ * full, the block is dropped and counted instead of blocking the caller. The position of the gap is queued
+ * alongside, and the writer splits its batches there, so the sink's markDropout() comes exactly between the
+ * samples before and after the gap. The gap queue holds one entry per 16 samples of ring capacity, enough
+ * for any backlog of blocks of 16 samples or more. An optional listener sees every
+ * drained batch on the writer thread, e.g. for online analysis.
+ *
+ * Given a WorkerPool, the writer has no thread of its own: the pool polls it
+ * along with the writers of other devices.
+ */
+class RecordingWriter
+{
+public:
+    using Listener = std::function<void(const float *samples, size_t count)>;
+
+    RecordingWriter(const std::filesystem::path& filename, const RecordingInfo& info, Listener listener = Listener(),
+                    size_t capacity = 1 << 20, WorkerPool *pool = nullptr);
+
+    /**
+     * @brief Write into another sink than a chunked recording file
+     */
+    RecordingWriter(std::unique_ptr<RecordingSink> sink, Listener listener = Listener(),
+                    size_t capacity = 1 << 20, WorkerPool *pool = nullptr);
+    ~RecordingWriter();
+
+    RecordingWriter(const RecordingWriter&) = delete;
+    RecordingWriter& operator=(const RecordingWriter&) = delete;
+
+    /**
+     * @brief Queue a block of samples (real-time safe)
+     * @param samples
+     * @param count
+     * @return false if the block was dropped
+     */
+    bool write(const float *samples, size_t count);
+
+    /**
+     * @brief Drain the queue, flush and stop the writer thread
+     */
+    void close();
+
+    uint64_t overruns() const {return overruns_.load(std::memory_order_relaxed);}
+    uint64_t droppedSamples() const {return droppedSamples_.load(std::memory_order_relaxed);}
+    uint64_t writtenSamples() const {return writtenSamples_.load(std::memory_order_relaxed);}
+
+    /**
+     * @brief The sink failed to store samples, e.g. on a full disk; valid after close()
+     */
+    bool failed() const {return sink_->failed();}
+
+private:
+    void run();
+    size_t drain();
+
+    std::unique_ptr<RecordingSink> sink_;
+    Listener listener_;
+    SpscRingBuffer<float> ring_;
+    std::vector<float> batch_;
+    std::thread thread_;
+    WorkerPool *pool_{nullptr};
+    WorkerPool::PollerToken poller_{0};
+    std::atomic<bool> running_{true};
+    std::atomic<uint64_t> overruns_{0};
+    std::atomic<uint64_t> droppedSamples_{0};
+    std::atomic<uint64_t> writtenSamples_{0};
+    SpscRingBuffer<uint64_t> gaps_;     ///< Accepted-sample positions of dropped blocks
+    uint64_t pushedSamples_{0};         ///< Producer only
+    uint64_t lastGap_{UINT64_MAX};      ///< Producer only, consecutive drops are one gap
+    uint64_t poppedSamples_{0};         ///< Writer thread only
+    uint64_t nextGap_{0};               ///< Writer thread only, valid if gapPending_
+    bool gapPending_{false};
+};
+
+#endif // RECORDINGWRITER_H
@@ -0,0 +1,405 @@
+#include "rtcheck.h"
+
+#if defined(TCAL_RT_CHECK) && defined(__linux__)
+#define RTCHECK_INTERPOSE 1
+#endif
+
+#ifdef RTCHECK_INTERPOSE
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdarg>
+#include <cstdlib>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <map>
+#include <tuple>
+
+
+const char* rtCheckKindName(RtCheck::Kind kind)
+{
+    switch (kind)
+    {
+    case RtCheck::Kind::Allocation: return "allocation";
+    case RtCheck::Kind::Lock:       return "lock";
+    case RtCheck::Kind::SystemCall: return "system call";
+    default:                        return "unknown";
+    }
+}
+
+
+#ifdef RTCHECK_INTERPOSE
+
+namespace {
+
+constexpr size_t kNumKinds = 3;
+
+struct Record
+{
+    std::atomic<bool> ready{false};
+    RtCheck::Kind kind{RtCheck::Kind::Allocation};
+    const char *function{nullptr};
+    int depth{0};
+    void *frames[RtCheck::kMaxFrames];
+};
+
+// Plain static storage, so recording needs neither the heap nor a lock
+std::array<Record, RtCheck::kMaxViolations> records;
+std::atomic<size_t> numRecords{0};
+std::array<std::atomic<uint64_t>, kNumKinds> counts{};
+
+__attribute__((tls_model("initial-exec"))) thread_local int scopeDepth = 0;
+__attribute__((tls_model("initial-exec"))) thread_local bool inHook = false;
+
+// The first backtrace() loads the unwinder, which allocates and locks
+const int warmUp = [] {
+    void *frame[1];
+    return backtrace(frame, 1);
+}();
+
+void violation(RtCheck::Kind kind, const char *function)
+{
+    if ((scopeDepth == 0) || inHook)
+    {
+        return;
+    }
+    inHook = true;
+    counts[static_cast<size_t>(kind)].fetch_add(1, std::memory_order_relaxed);
+    const size_t slot = numRecords.fetch_add(1, std::memory_order_relaxed);
+    if (slot < records.size())
+    {
+        auto &r = records[slot];
+        r.kind = kind;
+        r.function = function;
+        r.depth = backtrace(r.frames, static_cast<int>(RtCheck::kMaxFrames));
+        r.ready.store(true, std::memory_order_release);
+    }
+    inHook = false;
+}
+
+/**
+ * Next definition of an interposed function, resolved on first use
+ *
+ * The hooks keep it in a constant-initialised pointer: a static initialised
+ * by a call would need a guard, which may itself lock.
+ */
+template<typename F>
+F next(F &fn, const char *name)
+{
+    if (fn == nullptr)
+    {
+        fn = reinterpret_cast<F>(dlsym(RTLD_NEXT, name));
+    }
+    return fn;
+}
+
+/**
+ * Frame of backtrace_symbols() as "function+offset" with the function demangled
+ */
+std::string symbolize(const char *symbol)
+{
+    std::string text = symbol;
+    const auto open = text.find('(');
+    const auto plus = text.find('+', open);
+    const auto close = text.find(')', plus);
+    if ((open == std::string::npos) || (plus == std::string::npos) || (close == std::string::npos) || (plus == open + 1))
+    {
+        return text;
+    }
+    const std::string mangled = text.substr(open + 1, plus - open - 1);
+    int status = 0;
+    char *demangled = abi::__cxa_demangle(mangled.c_str(), nullptr, nullptr, &status);
+    if ((status == 0) && (demangled != nullptr))
+    {
+        text = demangled + text.substr(plus, close - plus) + text.substr(close + 1);
+    }
+    std::free(demangled);
+    return text;
+}
+
+/**
+ * open() and openat() take a mode argument only with these flags. O_TMPFILE
+ * includes the O_DIRECTORY bit, so it must match as a whole.
+ */
+bool hasModeArgument(int flags)
+{
+    return (flags & O_CREAT) || ((flags & O_TMPFILE) == O_TMPFILE);
+}
+
+}   // anonymous namespace
+
+
+extern "C" {
+
+void *__libc_malloc(size_t size);
+void __libc_free(void *ptr);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+
+void *malloc(size_t size)
+{
+    violation(RtCheck::Kind::Allocation, "malloc");
+    return __libc_malloc(size);
+}
+
+void free(void *ptr)
+{
+    if (ptr != nullptr)
+    {
+        violation(RtCheck::Kind::Allocation, "free");
+    }
+    __libc_free(ptr);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    violation(RtCheck::Kind::Allocation, "calloc");
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    violation(RtCheck::Kind::Allocation, "realloc");
+    return __libc_realloc(ptr, size);
+}
+
+void *memalign(size_t alignment, size_t size)
+{
+    violation(RtCheck::Kind::Allocation, "memalign");
+    return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+    violation(RtCheck::Kind::Allocation, "aligned_alloc");
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **ptr, size_t alignment, size_t size)
+{
+    violation(RtCheck::Kind::Allocation, "posix_memalign");
+    if ((alignment < sizeof(void*)) || ((alignment & (alignment - 1)) != 0))
+    {
+        return EINVAL;
+    }
+    void *p = __libc_memalign(alignment, size);
+    if (p == nullptr)
+    {
+        return ENOMEM;
+    }
+    *ptr = p;
+    return 0;
+}
+
+// Blocking locks and waits; the try variants never block and are allowed
+
+#define RTCHECK_FORWARD(kind, ret, name, params, args)          \
+    ret name params                                             \
+    {                                                           \
+        static ret (*real) params = nullptr;                    \
+        violation(RtCheck::Kind::kind, #name);                  \
+        return next(real, #name) args;                          \
+    }
+
+RTCHECK_FORWARD(Lock, int, pthread_mutex_lock, (pthread_mutex_t *mutex), (mutex))
+RTCHECK_FORWARD(Lock, int, pthread_mutex_timedlock, (pthread_mutex_t *mutex, const struct timespec *timeout), (mutex, timeout))
+RTCHECK_FORWARD(Lock, int, pthread_rwlock_rdlock, (pthread_rwlock_t *lock), (lock))
+RTCHECK_FORWARD(Lock, int, pthread_rwlock_wrlock, (pthread_rwlock_t *lock), (lock))
+RTCHECK_FORWARD(Lock, int, pthread_spin_lock, (pthread_spinlock_t *lock), (lock))
+RTCHECK_FORWARD(Lock, int, pthread_cond_wait, (pthread_cond_t *cond, pthread_mutex_t *mutex), (cond, mutex))
+RTCHECK_FORWARD(Lock, int, pthread_cond_timedwait, (pthread_cond_t *cond, pthread_mutex_t *mutex, const struct timespec *timeout), (cond, mutex, timeout))
+RTCHECK_FORWARD(Lock, int, pthread_join, (pthread_t thread, void **result), (thread, result))
+RTCHECK_FORWARD(Lock, int, sem_wait, (sem_t *sem), (sem))
+
+RTCHECK_FORWARD(SystemCall, ssize_t, read, (int fd, void *buf, size_t count), (fd, buf, count))
+RTCHECK_FORWARD(SystemCall, ssize_t, write, (int fd, const void *buf, size_t count), (fd, buf, count))
+RTCHECK_FORWARD(SystemCall, ssize_t, pread, (int fd, void *buf, size_t count, off_t offset), (fd, buf, count, offset))
+RTCHECK_FORWARD(SystemCall, ssize_t, pwrite, (int fd, const void *buf, size_t count, off_t offset), (fd, buf, count, offset))
+RTCHECK_FORWARD(SystemCall, int, close, (int fd), (fd))
+RTCHECK_FORWARD(SystemCall, int, fsync, (int fd), (fd))
+RTCHECK_FORWARD(SystemCall, int, fdatasync, (int fd), (fd))
+RTCHECK_FORWARD(SystemCall, int, msync, (void *addr, size_t length, int flags), (addr, length, flags))
+RTCHECK_FORWARD(SystemCall, int, munmap, (void *addr, size_t length), (addr, length))
+RTCHECK_FORWARD(SystemCall, void*, mmap, (void *addr, size_t length, int prot, int flags, int fd, off_t offset), (addr, length, prot, flags, fd, offset))
+RTCHECK_FORWARD(SystemCall, int, nanosleep, (const struct timespec *duration, struct timespec *remaining), (duration, remaining))
+RTCHECK_FORWARD(SystemCall, int, clock_nanosleep, (clockid_t clock, int flags, const struct timespec *duration, struct timespec *remaining), (clock, flags, duration, remaining))
+RTCHECK_FORWARD(SystemCall, int, usleep, (useconds_t usec), (usec))
+RTCHECK_FORWARD(SystemCall, int, sched_yield, (void), ())
+
+#undef RTCHECK_FORWARD
+
+int open(const char *path, int flags, ...)
+{
+    static int (*real)(const char*, int, ...) = nullptr;
+    violation(RtCheck::Kind::SystemCall, "open");
+    mode_t mode = 0;
+    if (hasModeArgument(flags))
+    {
+        va_list args;
+        va_start(args, flags);
+        mode = static_cast<mode_t>(va_arg(args, int));
+        va_end(args);
+    }
+    return next(real, "open")(path, flags, mode);
+}
+
+int openat(int dirfd, const char *path, int flags, ...)
+{
+    static int (*real)(int, const char*, int, ...) = nullptr;
+    violation(RtCheck::Kind::SystemCall, "openat");
+    mode_t mode = 0;
+    if (hasModeArgument(flags))
+    {
+        va_list args;
+        va_start(args, flags);
+        mode = static_cast<mode_t>(va_arg(args, int));
+        va_end(args);
+    }
+    return next(real, "openat")(dirfd, path, flags, mode);
+}
+
+}   // extern "C"
+
+
+RtCheck::Scope::Scope()
+{
+    scopeDepth++;
+}
+
+RtCheck::Scope::~Scope()
+{
+    scopeDepth--;
+}
+
+bool RtCheck::available()
+{
+    return warmUp >= 0;
+}
+
+uint64_t RtCheck::count()
+{
+    uint64_t total = 0;
+    for (const auto &c : counts)
+    {
+        total += c.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+uint64_t RtCheck::count(Kind kind)
+{
+    return counts[static_cast<size_t>(kind)].load(std::memory_order_relaxed);
+}
+
+void RtCheck::reset()
+{
+    for (auto &r : records)
+    {
+        r.ready.store(false, std::memory_order_relaxed);
+    }
+    for (auto &c : counts)
+    {
+        c.store(0, std::memory_order_relaxed);
+    }
+    numRecords.store(0, std::memory_order_release);
+}
+
+std::vector<RtCheck::Violation> RtCheck::violations()
+{
+    // Group identical call stacks, in order of their first occurrence
+    using Key = std::tuple<Kind, const char*, std::vector<void*>>;
+    std::map<Key, size_t> index;
+    std::vector<Violation> result;
+    std::vector<const Record*> firsts;
+
+    const size_t n = std::min(numRecords.load(std::memory_order_acquire), records.size());
+    for (size_t k = 0; k < n; k++)
+    {
+        const auto &r = records[k];
+        if (!r.ready.load(std::memory_order_acquire))
+        {
+            continue;
+        }
+        Key key{r.kind, r.function, std::vector<void*>(r.frames, r.frames + r.depth)};
+        const auto it = index.find(key);
+        if (it != index.end())
+        {
+            result[it->second].count++;
+            continue;
+        }
+        index.emplace(std::move(key), result.size());
+        Violation v;
+        v.kind = r.kind;
+        v.function = r.function;
+        v.count = 1;
+        result.push_back(std::move(v));
+        firsts.push_back(&r);
+    }
+
+    for (size_t k = 0; k < result.size(); k++)
+    {
+        const auto &r = *firsts[k];
+        char **symbols = backtrace_symbols(r.frames, r.depth);
+        if (symbols == nullptr)
+        {
+            continue;
+        }
+        // Skip violation() and the hook itself
+        for (int f = std::min(2, r.depth); f < r.depth; f++)
+        {
+            result[k].backtrace.push_back(symbolize(symbols[f]));
+        }
+        std::free(symbols);
+    }
+    return result;
+}
+
+#else
+
+RtCheck::Scope::Scope()
+{
+}
+
+RtCheck::Scope::~Scope()
+{
+}
+
+bool RtCheck::available()
+{
+    return false;
+}
+
+uint64_t RtCheck::count()
+{
+    return 0;
+}
+
+uint64_t RtCheck::count(Kind kind)
+{
+    (void)kind;
+    return 0;
+}
+
+void RtCheck::reset()
+{
+}
+
+std::vector<RtCheck::Violation> RtCheck::violations()
+{
+    return {};
+}
+
+#endif
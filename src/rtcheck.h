@@ -0,0 +1,78 @@
+#ifndef RTCHECK_H
+#define RTCHECK_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+
+/**
+ * @brief Record heap allocation, blocking locks and system calls on the audio I/O thread
+ *
+ * Built with TCAL_RT_CHECK on Linux, malloc and friends, the blocking pthread
+ * lock and wait functions and the common I/O and sleep system calls are
+ * interposed. Inside a Scope, which AudioBackend::process() opens around every
+ * cycle, each call is counted as a violation and the first kMaxViolations are
+ * kept with their raw backtrace. The hooks always forward to the real function
+ * and only record inside a Scope; recording a violation neither allocates nor
+ * locks.
+ *
+ * Without TCAL_RT_CHECK, or on other platforms, nothing is interposed and
+ * available() is false.
+ */
+class RtCheck
+{
+public:
+    enum class Kind : uint8_t
+    {
+        Allocation,
+        Lock,
+        SystemCall,
+    };
+
+    struct Violation
+    {
+        Kind kind;
+        const char *function;           ///< Interposed function that was called
+        size_t count{0};                ///< Identical violations (same function and call stack)
+        std::vector<std::string> backtrace;
+    };
+
+    static constexpr size_t kMaxViolations = 256;
+    static constexpr size_t kMaxFrames = 24;
+
+    /**
+     * @brief Marks the calling thread as real-time while it lives, may be nested
+     */
+    class Scope
+    {
+    public:
+        Scope();
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+
+    static bool available();
+
+    /**
+     * @brief Violations since start or the last reset()
+     */
+    static uint64_t count();
+    static uint64_t count(Kind kind);
+
+    /**
+     * @brief Forget all violations, not while a Scope is open on another thread
+     */
+    static void reset();
+
+    /**
+     * @brief Kept violations, grouped by function and call stack and symbolized (not real-time safe)
+     */
+    static std::vector<Violation> violations();
+};
+
+const char* rtCheckKindName(RtCheck::Kind kind);
+
+#endif // RTCHECK_H
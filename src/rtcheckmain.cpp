@@ -0,0 +1,247 @@
+#include "latencytester.h"
+#include "rtcheck.h"
+#include "simulateddevice.h"
+#include "workerpool.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+namespace {
+
+struct Scenario
+{
+    const char *name;
+    StimulusLayout layout;
+    StimulusType stimulus;
+    size_t channels;
+    bool pool;              ///< Record through a shared WorkerPool instead of a writer thread
+    bool soak;
+    double loadPercent;
+};
+
+struct ScenarioResult
+{
+    std::string name;
+    uint64_t cycles{0};
+    uint64_t allocations{0};
+    uint64_t locks{0};
+    uint64_t systemCalls{0};
+};
+
+/**
+ * Run one tester on the simulated device in real time, with a live display
+ * polling its tap from another thread as the GUI would, recording to resultPath
+ */
+ScenarioResult run(const Scenario& scenario, const std::filesystem::path& resultPath, double seconds)
+{
+    RecordingInfo info;
+    info.sampleRate = 48e3;
+    info.numChannels = info.numOutputs = scenario.channels;
+    info.layout = scenario.layout;
+    info.stimulus = scenario.stimulus;
+    info.period = 4096;
+    info.bufferSize = 32;
+    info.deviceUID = scenario.name;
+
+    SimulatedDeviceConfig sim;
+    sim.sampleRate = info.sampleRate;
+    sim.bufferSize = info.bufferSize;
+    sim.inChannels = sim.outChannels = scenario.channels;
+    sim.loopbackDelay = 2.0 * sim.bufferSize + 64.5;
+
+    std::unique_ptr<WorkerPool> pool;
+    if (scenario.pool)
+    {
+        pool = std::make_unique<WorkerPool>(2);
+    }
+    SoakConfig soak;
+    LatencyTester tester(info, resultPath.string(), LatencyTracker::Callback(), pool.get(),
+                         scenario.soak ? &soak : nullptr);
+    tester.load().setLoad(scenario.loadPercent);
+    SimulatedDevice device(tester, sim);
+
+    std::atomic<bool> polling{true};
+    std::thread display([&] {
+        LiveLevels levels;
+        LiveResponse response;
+        while (polling.load())
+        {
+            tester.tap().readLevels(levels);
+            tester.tap().readResponse(response);
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    });
+
+    RtCheck::reset();
+    device.Start();
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    device.Stop();
+
+    ScenarioResult result;
+    result.name = scenario.name;
+    result.cycles = device.callbackStats().numCycles;
+    result.allocations = RtCheck::count(RtCheck::Kind::Allocation);
+    result.locks = RtCheck::count(RtCheck::Kind::Lock);
+    result.systemCalls = RtCheck::count(RtCheck::Kind::SystemCall);
+
+    polling.store(false);
+    display.join();
+    tester.close();
+    device.pumpEvents();
+    return result;
+}
+
+/**
+ * Allocate and lock a mutex inside a Scope on purpose, so that a build whose
+ * hooks are not reached, e.g. through static linking, cannot pass as clean
+ */
+ScenarioResult canary()
+{
+    RtCheck::reset();
+    {
+        RtCheck::Scope scope;
+        // volatile, so the compiler cannot drop the allocation
+        void * volatile block = std::malloc(64);
+        std::free(block);
+        std::mutex mutex;
+        mutex.lock();
+        mutex.unlock();
+    }
+    ScenarioResult result;
+    result.name = "canary";
+    result.allocations = RtCheck::count(RtCheck::Kind::Allocation);
+    result.locks = RtCheck::count(RtCheck::Kind::Lock);
+    result.systemCalls = RtCheck::count(RtCheck::Kind::SystemCall);
+    RtCheck::reset();
+    return result;
+}
+
+void printViolations(std::ostream& os)
+{
+    for (const auto &v : RtCheck::violations())
+    {
+        os << rtCheckKindName(v.kind) << ": " << v.function << ", " << v.count << " time(s)" << std::endl;
+        for (const auto &frame : v.backtrace)
+        {
+            os << "    " << frame << std::endl;
+        }
+    }
+}
+
+}   // anonymous namespace
+
+
+/**
+ * Check the real-time path for heap allocation, blocking locks and system calls
+ *
+ * Usage: TestCoreAudioLatencyRtCheck [--seconds <s>] [--work <dir>]
+ *
+ * Runs LatencyTester on the simulated device in every layout and recording
+ * mode for the given time each (default 2 s) and counts what RtCheck saw inside
+ * AudioBackend::process(). The violations of every failing scenario are
+ * listed with their call stacks. Exits with 1 if anything was found and with 2
+ * if the build lacks TCAL_RT_CHECK or its hooks miss the canary's deliberate
+ * allocation and lock.
+ */
+int main(int argc, char *argv[])
+{
+    double seconds = 2.0;
+    auto workPath = std::filesystem::temp_directory_path() / "tcal_rtcheck";
+
+    try
+    {
+        for (int k = 1; k < argc; k++)
+        {
+            const std::string arg = argv[k];
+            const bool hasValue = (k + 1 < argc);
+            if ((arg == "--seconds") && hasValue)
+            {
+                seconds = std::stod(argv[++k]);
+            }
+            else if ((arg == "--work") && hasValue)
+            {
+                workPath = argv[++k];
+            }
+            else
+            {
+                throw std::invalid_argument("Unknown argument: " + arg);
+            }
+        }
+        if (!RtCheck::available())
+        {
+            std::cerr << "ERROR: built without TCAL_RT_CHECK, or not on Linux" << std::endl;
+            return 2;
+        }
+        // Only what is created here is removed again, so an existing --work directory keeps its contents
+        std::vector<std::filesystem::path> created;
+        if (std::filesystem::create_directories(workPath))
+        {
+            created.push_back(workPath);
+        }
+
+        const Scenario scenarios[] = {
+            {"passthrough", StimulusLayout::Passthrough, StimulusType::Chirp, 2, false, false, 0},
+            {"passthrough_pool", StimulusLayout::Passthrough, StimulusType::Mls, 2, true, false, 0},
+            {"matrix", StimulusLayout::Matrix, StimulusType::LogSweep, 4, false, false, 0},
+            {"soak", StimulusLayout::Passthrough, StimulusType::Chirp, 2, true, true, 0},
+            {"load", StimulusLayout::Passthrough, StimulusType::Golay, 8, false, false, 20},
+        };
+
+        std::cout << std::left << std::setw(20) << "scenario"
+                  << std::right << std::setw(10) << "cycles"
+                  << std::setw(14) << "allocations"
+                  << std::setw(8) << "locks"
+                  << std::setw(14) << "system calls" << std::endl;
+
+        const auto c = canary();
+        std::cout << std::left << std::setw(20) << c.name
+                  << std::right << std::setw(10) << "-"
+                  << std::setw(14) << c.allocations
+                  << std::setw(8) << c.locks
+                  << std::setw(14) << c.systemCalls << std::endl;
+        if ((c.allocations == 0) || (c.locks == 0))
+        {
+            std::cerr << "ERROR: the hooks missed the canary's allocation or lock" << std::endl;
+            return 2;
+        }
+        bool clean = true;
+        for (const auto &scenario : scenarios)
+        {
+            const auto resultPath = workPath / scenario.name;
+            if (std::filesystem::create_directories(resultPath))
+            {
+                created.push_back(resultPath);
+            }
+            const auto r = run(scenario, resultPath, seconds);
+            std::cout << std::left << std::setw(20) << r.name
+                      << std::right << std::setw(10) << r.cycles
+                      << std::setw(14) << r.allocations
+                      << std::setw(8) << r.locks
+                      << std::setw(14) << r.systemCalls << std::endl;
+            if (r.allocations + r.locks + r.systemCalls > 0)
+            {
+                clean = false;
+                printViolations(std::cout);
+            }
+        }
+        for (auto it = created.rbegin(); it != created.rend(); ++it)
+        {
+            std::filesystem::remove_all(*it);
+        }
+        return clean ? 0 : 1;
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << "ERROR: " << e.what() << std::endl;
+        return 1;
+    }
+}
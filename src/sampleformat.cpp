@@ -0,0 +1,261 @@
+#include "sampleformat.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+
+namespace {
+
+// Largest float below 2^31, so that clipped int32 samples never overflow
+constexpr float kInt32Max = 2147483520.0f;
+
+inline int32_t loadWord(const uint8_t *p)
+{
+    int32_t x;
+    std::memcpy(&x, p, sizeof(x));
+    return x;
+}
+
+/**
+ * Four packed little-endian 24-bit samples to int32 lanes
+ *
+ * Word loads stay within the 12 bytes: samples 1 to 3 are read with the
+ * preceding byte below them, sample 0 with the following one above it.
+ */
+inline void unpackInt24(const uint8_t *src, int32_t *dst)
+{
+    dst[0] = static_cast<int32_t>(static_cast<uint32_t>(loadWord(src)) << 8) >> 8;
+    dst[1] = loadWord(src + 2) >> 8;
+    dst[2] = loadWord(src + 5) >> 8;
+    dst[3] = loadWord(src + 8) >> 8;
+}
+
+inline void packInt24(const int32_t *src, uint8_t *dst)
+{
+    for (size_t k = 0; k < simd::kWidth; k++)
+    {
+        const uint32_t x = static_cast<uint32_t>(src[k]);
+        uint8_t *p = dst + 3 * k;
+        p[0] = static_cast<uint8_t>(x);
+        p[1] = static_cast<uint8_t>(x >> 8);
+        p[2] = static_cast<uint8_t>(x >> 16);
+    }
+}
+
+inline simd::Vec4 loadLanes(SampleFormat format, const uint8_t *src)
+{
+    switch (format)
+    {
+    case SampleFormat::Int16:
+        return simd::loadInt16(reinterpret_cast<const int16_t*>(src));
+    case SampleFormat::Int24:
+    {
+        int32_t lanes[simd::kWidth];
+        unpackInt24(src, lanes);
+        return simd::loadInt32(lanes);
+    }
+    case SampleFormat::Int32:
+        return simd::loadInt32(reinterpret_cast<const int32_t*>(src));
+    default:
+        return simd::load(reinterpret_cast<const float*>(src));
+    }
+}
+
+inline void storeLanes(SampleFormat format, simd::Vec4 v, uint8_t *dst)
+{
+    switch (format)
+    {
+    case SampleFormat::Int16:
+        simd::storeInt16(reinterpret_cast<int16_t*>(dst), v);
+        break;
+    case SampleFormat::Int24:
+    {
+        int32_t lanes[simd::kWidth];
+        simd::storeInt32(lanes, v);
+        packInt24(lanes, dst);
+        break;
+    }
+    case SampleFormat::Int32:
+        simd::storeInt32(reinterpret_cast<int32_t*>(dst), v);
+        break;
+    default:
+        simd::store(reinterpret_cast<float*>(dst), v);
+        break;
+    }
+}
+
+/**
+ * Full scale and clip limits of an integer format
+ */
+struct Scale
+{
+    float toFloat;
+    float fromFloat;
+    float low;
+    float high;
+};
+
+Scale integerScale(SampleFormat format)
+{
+    switch (format)
+    {
+    case SampleFormat::Int16:   return {1.0f / 32768.0f, 32768.0f, -32768.0f, 32767.0f};
+    case SampleFormat::Int24:   return {1.0f / 8388608.0f, 8388608.0f, -8388608.0f, 8388607.0f};
+    default:                    return {1.0f / 2147483648.0f, 2147483648.0f, -2147483648.0f, kInt32Max};
+    }
+}
+
+}   // anonymous namespace
+
+
+const char* sampleFormatName(SampleFormat format)
+{
+    switch (format)
+    {
+    case SampleFormat::Float32: return "float32";
+    case SampleFormat::Int16:   return "int16";
+    case SampleFormat::Int24:   return "int24";
+    case SampleFormat::Int32:   return "int32";
+    default:                    return "unknown";
+    }
+}
+
+SampleFormat parseSampleFormat(const std::string& name)
+{
+    for (auto format : {SampleFormat::Float32, SampleFormat::Int16, SampleFormat::Int24, SampleFormat::Int32})
+    {
+        if (name == sampleFormatName(format))
+        {
+            return format;
+        }
+    }
+    throw std::invalid_argument("Unknown sample format: " + name);
+}
+
+size_t sampleFormatBytes(SampleFormat format)
+{
+    switch (format)
+    {
+    case SampleFormat::Int16:   return 2;
+    case SampleFormat::Int24:   return 3;
+    default:                    return 4;
+    }
+}
+
+bool sampleFormatFromDescription(const AudioStreamBasicDescription& desc, SampleFormat& format)
+{
+    if ((desc.mFormatID != kAudioFormatLinearPCM) || (desc.mFramesPerPacket != 1) || (desc.mChannelsPerFrame == 0) ||
+        (desc.mFormatFlags & (kAudioFormatFlagIsBigEndian | kAudioFormatFlagIsNonInterleaved)))
+    {
+        return false;
+    }
+    const UInt32 bytesPerSample = desc.mBytesPerFrame / desc.mChannelsPerFrame;
+    if (bytesPerSample * desc.mChannelsPerFrame != desc.mBytesPerFrame)
+    {
+        return false;
+    }
+
+    if (desc.mFormatFlags & kAudioFormatFlagIsFloat)
+    {
+        format = SampleFormat::Float32;
+        return (desc.mBitsPerChannel == 32) && (bytesPerSample == 4);
+    }
+    if ((desc.mFormatFlags & kAudioFormatFlagIsSignedInteger) == 0)
+    {
+        return false;
+    }
+
+    switch (bytesPerSample)
+    {
+    case 2:
+        format = SampleFormat::Int16;
+        return desc.mBitsPerChannel == 16;
+    case 3:
+        format = SampleFormat::Int24;
+        return desc.mBitsPerChannel == 24;
+    case 4:
+        // Fewer valid bits aligned high read exactly like full int32
+        format = SampleFormat::Int32;
+        return (desc.mBitsPerChannel == 32) ||
+               ((desc.mBitsPerChannel == 24) && (desc.mFormatFlags & kAudioFormatFlagIsAlignedHigh));
+    default:
+        return false;
+    }
+}
+
+AudioStreamBasicDescription makeStreamDescription(SampleFormat format, double sampleRate, size_t numChannels)
+{
+    const UInt32 bytes = static_cast<UInt32>(sampleFormatBytes(format));
+    AudioStreamBasicDescription desc;
+    std::memset(&desc, 0, sizeof(desc));
+    desc.mSampleRate = sampleRate;
+    desc.mFormatID = kAudioFormatLinearPCM;
+    desc.mFormatFlags = kAudioFormatFlagIsPacked |
+                        ((format == SampleFormat::Float32) ? kAudioFormatFlagIsFloat : kAudioFormatFlagIsSignedInteger);
+    desc.mFramesPerPacket = 1;
+    desc.mChannelsPerFrame = static_cast<UInt32>(numChannels);
+    desc.mBytesPerFrame = bytes * desc.mChannelsPerFrame;
+    desc.mBytesPerPacket = desc.mBytesPerFrame;
+    desc.mBitsPerChannel = 8 * bytes;
+    return desc;
+}
+
+void convertToFloat(SampleFormat format, const void *src, float *dst, size_t count)
+{
+    if (format == SampleFormat::Float32)
+    {
+        std::memcpy(dst, src, count * sizeof(float));
+        return;
+    }
+
+    const auto *in = static_cast<const uint8_t*>(src);
+    const size_t bytes = sampleFormatBytes(format);
+    const auto scale = simd::set1(integerScale(format).toFloat);
+    size_t k = 0;
+    for (; k + simd::kWidth <= count; k += simd::kWidth)
+    {
+        simd::store(dst + k, simd::mul(loadLanes(format, in + k * bytes), scale));
+    }
+    if (k < count)
+    {
+        // Pad the tail so it takes the same path as full groups
+        uint8_t tail[simd::kWidth * 4] = {};
+        float out[simd::kWidth];
+        std::memcpy(tail, in + k * bytes, (count - k) * bytes);
+        simd::store(out, simd::mul(loadLanes(format, tail), scale));
+        std::copy(out, out + (count - k), dst + k);
+    }
+}
+
+void convertFromFloat(SampleFormat format, const float *src, void *dst, size_t count)
+{
+    if (format == SampleFormat::Float32)
+    {
+        std::memcpy(dst, src, count * sizeof(float));
+        return;
+    }
+
+    auto *out = static_cast<uint8_t*>(dst);
+    const size_t bytes = sampleFormatBytes(format);
+    const Scale s = integerScale(format);
+    const auto scale = simd::set1(s.fromFloat);
+    const auto low = simd::set1(s.low);
+    const auto high = simd::set1(s.high);
+    size_t k = 0;
+    for (; k + simd::kWidth <= count; k += simd::kWidth)
+    {
+        const auto x = simd::mul(simd::load(src + k), scale);
+        storeLanes(format, simd::min(simd::max(x, low), high), out + k * bytes);
+    }
+    if (k < count)
+    {
+        float in[simd::kWidth] = {};
+        uint8_t tail[simd::kWidth * 4];
+        std::copy(src + k, src + count, in);
+        const auto x = simd::mul(simd::load(in), scale);
+        storeLanes(format, simd::min(simd::max(x, low), high), tail);
+        std::memcpy(out + k * bytes, tail, (count - k) * bytes);
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef SAMPLEFORMAT_H
+#define SAMPLEFORMAT_H
+
+#include "audiotypes.h"
+
+#include <string>
+#include <cstddef>
+
+
+/**
+ * Interleaved linear PCM sample formats of device streams
+ *
+ * Integer formats are little-endian and signed. Int24 is packed into three
+ * bytes per sample; 24-bit samples aligned high in four bytes are Int32.
+ */
+enum class SampleFormat
+{
+    Float32,
+    Int16,
+    Int24,
+    Int32,
+};
+
+const char* sampleFormatName(SampleFormat format);
+
+/**
+ * @brief Parse "float32", "int16", "int24" or "int32"
+ */
+SampleFormat parseSampleFormat(const std::string& name);
+
+size_t sampleFormatBytes(SampleFormat format);
+
+/**
+ * @brief Classify a stream description
+ * @param desc
+ * @param format
+ * @return false if the description is not one of the supported formats
+ */
+bool sampleFormatFromDescription(const AudioStreamBasicDescription& desc, SampleFormat& format);
+
+/**
+ * @brief Interleaved stream description of a sample format
+ * @param format
+ * @param sampleRate
+ * @param numChannels
+ */
+AudioStreamBasicDescription makeStreamDescription(SampleFormat format, double sampleRate, size_t numChannels);
+
+/**
+ * @brief Convert count samples to float in [-1, 1) (real-time safe)
+ * @param format Format of src
+ * @param src
+ * @param dst
+ * @param count
+ */
+void convertToFloat(SampleFormat format, const void *src, float *dst, size_t count);
+
+/**
+ * @brief Convert count float samples, clipping and rounding to nearest (real-time safe)
+ * @param format Format of dst
+ * @param src
+ * @param dst
+ * @param count
+ */
+void convertFromFloat(SampleFormat format, const float *src, void *dst, size_t count);
+
+#endif // SAMPLEFORMAT_H
@@ -0,0 +1,141 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SIMD_SSE2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define SIMD_NEON 1
+#endif
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+
+/**
+ * Minimal 4-lane float vector wrapper over SSE2/NEON with a scalar fallback
+ *
+ * Integer loads convert exactly; integer stores round to nearest and expect
+ * lanes already clamped to the target range.
+ */
+namespace simd {
+
+constexpr size_t kWidth = 4;
+
+#if defined(SIMD_SSE2)
+
+using Vec4 = __m128;
+
+inline Vec4 load(const float *p) {return _mm_loadu_ps(p);}
+inline void store(float *p, Vec4 v) {_mm_storeu_ps(p, v);}
+inline Vec4 set1(float x) {return _mm_set1_ps(x);}
+inline Vec4 add(Vec4 a, Vec4 b) {return _mm_add_ps(a, b);}
+inline Vec4 sub(Vec4 a, Vec4 b) {return _mm_sub_ps(a, b);}
+inline Vec4 mul(Vec4 a, Vec4 b) {return _mm_mul_ps(a, b);}
+inline Vec4 min(Vec4 a, Vec4 b) {return _mm_min_ps(a, b);}
+inline Vec4 max(Vec4 a, Vec4 b) {return _mm_max_ps(a, b);}
+inline void transpose4(Vec4 &a, Vec4 &b, Vec4 &c, Vec4 &d) {_MM_TRANSPOSE4_PS(a, b, c, d);}
+
+inline Vec4 loadInt32(const int32_t *p) {return _mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));}
+inline void storeInt32(int32_t *p, Vec4 v) {_mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm_cvtps_epi32(v));}
+inline Vec4 loadInt16(const int16_t *p)
+{
+    const __m128i x = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p));
+    return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16));
+}
+inline void storeInt16(int16_t *p, Vec4 v)
+{
+    const __m128i x = _mm_cvtps_epi32(v);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(p), _mm_packs_epi32(x, x));
+}
+
+#elif defined(SIMD_NEON)
+
+using Vec4 = float32x4_t;
+
+inline Vec4 load(const float *p) {return vld1q_f32(p);}
+inline void store(float *p, Vec4 v) {vst1q_f32(p, v);}
+inline Vec4 set1(float x) {return vdupq_n_f32(x);}
+inline Vec4 add(Vec4 a, Vec4 b) {return vaddq_f32(a, b);}
+inline Vec4 sub(Vec4 a, Vec4 b) {return vsubq_f32(a, b);}
+inline Vec4 mul(Vec4 a, Vec4 b) {return vmulq_f32(a, b);}
+inline Vec4 min(Vec4 a, Vec4 b) {return vminq_f32(a, b);}
+inline Vec4 max(Vec4 a, Vec4 b) {return vmaxq_f32(a, b);}
+inline void transpose4(Vec4 &a, Vec4 &b, Vec4 &c, Vec4 &d)
+{
+    const float32x4x2_t ab = vtrnq_f32(a, b);
+    const float32x4x2_t cd = vtrnq_f32(c, d);
+    a = vcombine_f32(vget_low_f32(ab.val[0]), vget_low_f32(cd.val[0]));
+    b = vcombine_f32(vget_low_f32(ab.val[1]), vget_low_f32(cd.val[1]));
+    c = vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0]));
+    d = vcombine_f32(vget_high_f32(ab.val[1]), vget_high_f32(cd.val[1]));
+}
+
+inline int32x4_t roundInt32(Vec4 v)
+{
+#if defined(__aarch64__)
+    return vcvtnq_s32_f32(v);
+#else
+    const uint32x4_t negative = vcltq_f32(v, vdupq_n_f32(0.0f));
+    return vcvtq_s32_f32(vaddq_f32(v, vbslq_f32(negative, vdupq_n_f32(-0.5f), vdupq_n_f32(0.5f))));
+#endif
+}
+inline Vec4 loadInt32(const int32_t *p) {return vcvtq_f32_s32(vld1q_s32(p));}
+inline void storeInt32(int32_t *p, Vec4 v) {vst1q_s32(p, roundInt32(v));}
+inline Vec4 loadInt16(const int16_t *p) {return vcvtq_f32_s32(vmovl_s16(vld1_s16(p)));}
+inline void storeInt16(int16_t *p, Vec4 v) {vst1_s16(p, vqmovn_s32(roundInt32(v)));}
+
+#else
+
+struct Vec4
+{
+    float v[4];
+};
+
+inline Vec4 load(const float *p) {return {{p[0], p[1], p[2], p[3]}};}
+inline void store(float *p, Vec4 a) {p[0] = a.v[0]; p[1] = a.v[1]; p[2] = a.v[2]; p[3] = a.v[3];}
+inline Vec4 set1(float x) {return {{x, x, x, x}};}
+inline Vec4 add(Vec4 a, Vec4 b) {return {{a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3]}};}
+inline Vec4 sub(Vec4 a, Vec4 b) {return {{a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3]}};}
+inline Vec4 mul(Vec4 a, Vec4 b) {return {{a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3]}};}
+inline Vec4 min(Vec4 a, Vec4 b) {return {{a.v[0] < b.v[0] ? a.v[0] : b.v[0], a.v[1] < b.v[1] ? a.v[1] : b.v[1], a.v[2] < b.v[2] ? a.v[2] : b.v[2], a.v[3] < b.v[3] ? a.v[3] : b.v[3]}};}
+inline Vec4 max(Vec4 a, Vec4 b) {return {{a.v[0] > b.v[0] ? a.v[0] : b.v[0], a.v[1] > b.v[1] ? a.v[1] : b.v[1], a.v[2] > b.v[2] ? a.v[2] : b.v[2], a.v[3] > b.v[3] ? a.v[3] : b.v[3]}};}
+inline void transpose4(Vec4 &a, Vec4 &b, Vec4 &c, Vec4 &d)
+{
+    const Vec4 a0 = a, b0 = b, c0 = c, d0 = d;
+    a = {{a0.v[0], b0.v[0], c0.v[0], d0.v[0]}};
+    b = {{a0.v[1], b0.v[1], c0.v[1], d0.v[1]}};
+    c = {{a0.v[2], b0.v[2], c0.v[2], d0.v[2]}};
+    d = {{a0.v[3], b0.v[3], c0.v[3], d0.v[3]}};
+}
+
+inline Vec4 loadInt32(const int32_t *p)
+{
+    return {{static_cast<float>(p[0]), static_cast<float>(p[1]), static_cast<float>(p[2]), static_cast<float>(p[3])}};
+}
+inline void storeInt32(int32_t *p, Vec4 v)
+{
+    for (int k = 0; k < 4; k++)
+    {
+        p[k] = static_cast<int32_t>(std::nearbyint(v.v[k]));
+    }
+}
+inline Vec4 loadInt16(const int16_t *p)
+{
+    return {{static_cast<float>(p[0]), static_cast<float>(p[1]), static_cast<float>(p[2]), static_cast<float>(p[3])}};
+}
+inline void storeInt16(int16_t *p, Vec4 v)
+{
+    for (int k = 0; k < 4; k++)
+    {
+        p[k] = static_cast<int16_t>(std::nearbyint(v.v[k]));
+    }
+}
+
+#endif
+
+}   // namespace simd
+
+#endif // SIMD_H
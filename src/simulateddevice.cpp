@@ -0,0 +1,192 @@
+#include "simulateddevice.h"
+
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <algorithm>
+
+
+SimulatedDevice::SimulatedDevice(AudioProcessor &processor, const SimulatedDeviceConfig &config, QObject *parent)
+    : AudioBackend(processor, parent)
+    , config_{config}
+{
+    if ((config_.sampleRate <= 0) || (config_.bufferSize == 0))
+    {
+        throw std::invalid_argument("SimulatedDevice: invalid sample rate or buffer size");
+    }
+    if (config_.loopbackDelay < static_cast<double>(config_.bufferSize))
+    {
+        throw std::invalid_argument("SimulatedDevice: loopback delay must be at least one buffer");
+    }
+    if ((config_.drift != 0) && (config_.driftSeconds <= 0))
+    {
+        throw std::invalid_argument("SimulatedDevice: drift needs a positive drift time");
+    }
+
+    inBuffer_.resize(config_.bufferSize * config_.inChannels);
+    outBuffer_.resize(config_.bufferSize * config_.outChannels);
+
+    maxSlip_ = std::abs(config_.drift) * 1e-6 * config_.driftSeconds * config_.sampleRate;
+    size_t historyLength = 1;
+    while (historyLength < static_cast<size_t>(std::ceil(config_.loopbackDelay + maxSlip_)) + config_.bufferSize + 2)
+    {
+        historyLength <<= 1;
+    }
+    delayLine_.resize(historyLength * config_.outChannels);
+    delayMask_ = historyLength - 1;
+}
+
+SimulatedDevice::~SimulatedDevice()
+{
+    Stop();
+}
+
+void SimulatedDevice::Start()
+{
+    if (running_.load())
+    {
+        emit error("Audio processing already started");
+        return;
+    }
+
+    std::fill(delayLine_.begin(), delayLine_.end(), 0.0f);
+    try
+    {
+        processor_.prepare(config_.bufferSize, config_.inChannels, config_.outChannels, latencyModel());
+    }
+    catch (const std::exception& e)
+    {
+        emit error(e.what());
+        return;
+    }
+    stats_.reset(config_.sampleRate);
+    running_.store(true);
+    thread_ = std::thread(&SimulatedDevice::run, this);
+}
+
+void SimulatedDevice::Stop()
+{
+    running_.store(false);
+    if (thread_.joinable())
+    {
+        thread_.join();
+    }
+}
+
+LatencyModel SimulatedDevice::latencyModel() const
+{
+    LatencyModel model;
+    model.sampleRate = config_.sampleRate;
+    model.input.bufferFrames = static_cast<uint32_t>(config_.bufferSize);
+    model.output.device = static_cast<uint32_t>(std::lround(config_.loopbackDelay)) - model.input.bufferFrames;
+    model.output.ioCycleUsage = 0.0;
+    return model;
+}
+
+void SimulatedDevice::run()
+{
+    using Clock = std::chrono::steady_clock;
+    const auto period = std::chrono::duration<double>(config_.bufferSize / config_.sampleRate);
+
+    std::mt19937 rng(12345);
+    std::uniform_real_distribution<double> jitter(0.0, config_.jitter);
+    std::normal_distribution<float> noise(0.0f, static_cast<float>(config_.noiseLevel));
+
+    const auto start = Clock::now();
+    size_t frameTime = 0;
+    for (size_t cycle = 0; running_.load(std::memory_order_relaxed); cycle++)
+    {
+        if (config_.realTime)
+        {
+            // A cycle woken a whole period late has missed its slot: the
+            // hardware played and captured those frames without us
+            const auto nominal = start + std::chrono::duration_cast<Clock::duration>(period * cycle);
+            const auto late = std::chrono::duration<double>(Clock::now() - nominal);
+            if (config_.skipLateCycles && (late >= period))
+            {
+                const auto skipped = static_cast<size_t>(late / period);
+                for (size_t k = 0; k < skipped * config_.bufferSize; k++)
+                {
+                    std::fill_n(&delayLine_[((frameTime + k) & delayMask_) * config_.outChannels], config_.outChannels, 0.0f);
+                }
+                cycle += skipped;
+                frameTime += skipped * config_.bufferSize;
+            }
+
+            auto deadline = start + std::chrono::duration_cast<Clock::duration>(period * cycle);
+            if (config_.jitter > 0)
+            {
+                deadline += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(jitter(rng)));
+            }
+            std::this_thread::sleep_until(deadline);
+        }
+
+        loopback(frameTime, inBuffer_.data());
+        if (config_.noiseLevel > 0)
+        {
+            for (auto &x : inBuffer_)
+            {
+                x += noise(rng);
+            }
+        }
+
+        IOCycleTime time;
+        time.hostTime = CallbackStats::now();
+        time.nowSampleTime = static_cast<double>(frameTime + config_.bufferSize);
+        time.inputSampleTime = static_cast<double>(frameTime);
+        time.outputSampleTime = static_cast<double>(frameTime + config_.bufferSize);
+
+        std::fill(outBuffer_.begin(), outBuffer_.end(), 0.0f);
+        process(config_.bufferSize,
+                config_.inChannels ? inBuffer_.data() : nullptr, config_.inChannels,
+                config_.outChannels ? outBuffer_.data() : nullptr, config_.outChannels,
+                time);
+
+        // Append the produced output to the history
+        const size_t outChannels = config_.outChannels;
+        for (size_t k = 0; k < config_.bufferSize; k++)
+        {
+            auto dst = &delayLine_[((frameTime + k) & delayMask_) * outChannels];
+            std::copy_n(&outBuffer_[k * outChannels], outChannels, dst);
+        }
+        frameTime += config_.bufferSize;
+    }
+}
+
+void SimulatedDevice::loopback(size_t frameTime, float *inSamples)
+{
+    // in[t] = out[t - delay], linearly interpolated for fractional delays
+    const size_t inChannels = config_.inChannels;
+    const size_t outChannels = config_.outChannels;
+    const size_t numLooped = std::min(inChannels, outChannels);
+
+    for (size_t k = 0; k < config_.bufferSize; k++)
+    {
+        const size_t t = frameTime + k;
+        double delay = config_.loopbackDelay;
+        if (config_.drift != 0)
+        {
+            // Monotonic, so a drift estimate never sees the delay jump
+            const double slip = std::min(static_cast<double>(t) * std::abs(config_.drift) * 1e-6, maxSlip_);
+            delay += (config_.drift > 0) ? slip : (maxSlip_ - slip);
+        }
+        const auto intDelay = static_cast<size_t>(std::floor(delay));
+        const auto frac = static_cast<float>(delay - intDelay);
+
+        float *dst = inSamples + k * inChannels;
+        if (t < intDelay + 1)
+        {
+            std::fill(dst, dst + inChannels, 0.0f);
+            continue;
+        }
+
+        const float *a = &delayLine_[((t - intDelay) & delayMask_) * outChannels];
+        const float *b = &delayLine_[((t - intDelay - 1) & delayMask_) * outChannels];
+        for (size_t ch = 0; ch < numLooped; ch++)
+        {
+            dst[ch] = (1.0f - frac) * a[ch] + frac * b[ch];
+        }
+        std::fill(dst + numLooped, dst + inChannels, 0.0f);
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef SIMULATEDDEVICE_H
+#define SIMULATEDDEVICE_H
+
+#include "audiobackend.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+
+struct SimulatedDeviceConfig
+{
+    double sampleRate{48e3};
+    size_t bufferSize{32};
+    size_t inChannels{2};
+    size_t outChannels{2};
+    double loopbackDelay{256};  ///< Output-to-input delay in frames, may be fractional, must be >= bufferSize
+    double drift{0};            ///< Input clock offset against the output clock in ppm
+    double driftSeconds{600};   ///< Time over which the drift accumulates, sizes the delay line
+    double jitter{0};           ///< Maximum random callback wake-up delay in seconds
+    double noiseLevel{0};       ///< RMS of white noise added to the inputs
+    bool realTime{true};        ///< Pace callbacks by the sample clock; free-run if false
+    bool skipLateCycles{false}; ///< In real time, drop the cycles a late callback missed
+};
+
+
+/**
+ * @brief Clock-driven loopback device
+ *
+ * Calls process() from its own thread every bufferSize frames. Input channel k
+ * receives output channel k delayed by loopbackDelay frames, plus noise. Channels
+ * without a matching output are silent apart from the noise. A non-zero drift
+ * moves the delay steadily, without a step, for driftSeconds and then holds
+ * it: a positive drift grows it from loopbackDelay, a negative one shrinks it
+ * to loopbackDelay from as far above. With
+ * skipLateCycles, a callback that returns more than a buffer period late makes
+ * the device skip the cycles it missed, as hardware would, which shows up as a
+ * sample time discontinuity; otherwise late cycles are caught up.
+ *
+ * For the latency model, the input side holds one buffer and the output is
+ * presented at once; the rest of loopbackDelay is reported as output device
+ * latency and the cycle timestamps are set to match.
+ */
+class SimulatedDevice : public AudioBackend
+{
+    Q_OBJECT
+public:
+    SimulatedDevice(AudioProcessor &processor, const SimulatedDeviceConfig &config, QObject *parent = nullptr);
+    ~SimulatedDevice();
+    void Start() override;
+    void Stop() override;
+
+    const SimulatedDeviceConfig& config() const {return config_;}
+    LatencyModel latencyModel() const override;
+
+private:
+    void run();
+    void loopback(size_t frameTime, float *inSamples);
+
+    const SimulatedDeviceConfig config_;
+    std::vector<float> inBuffer_;
+    std::vector<float> outBuffer_;
+    std::vector<float> delayLine_;  ///< Interleaved output history
+    size_t delayMask_{0};
+    double maxSlip_{0};             ///< Frames the drift moves the delay by in driftSeconds
+    std::thread thread_;
+    std::atomic<bool> running_{false};
+};
+
+#endif // SIMULATEDDEVICE_H
@@ -0,0 +1,78 @@
+#ifndef SNAPSHOTBUFFER_H
+#define SNAPSHOTBUFFER_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+
+/**
+ * @brief Wait-free single-producer/single-consumer exchange of the latest value
+ *
+ * Triple buffer: the producer fills back() and publish()es it, the consumer
+ * calls update() and reads front(). Neither side ever waits for the other, and
+ * a slow consumer only skips values. No call allocates, so the producer may be
+ * the audio I/O thread as long as T is copied into without allocation, e.g.
+ * vectors sized up front.
+ */
+template<typename T>
+class SnapshotBuffer
+{
+public:
+    explicit SnapshotBuffer(const T& initial = T())
+        : slots_{initial, initial, initial}
+    {
+    }
+
+    SnapshotBuffer(const SnapshotBuffer&) = delete;
+    SnapshotBuffer& operator=(const SnapshotBuffer&) = delete;
+
+    /**
+     * @brief Slot to fill before publish() (producer side)
+     */
+    T& back()
+    {
+        return slots_[back_];
+    }
+
+    /**
+     * @brief Make back() the latest value and get a new back() (producer side)
+     */
+    void publish()
+    {
+        back_ = middle_.exchange(static_cast<uint8_t>(back_ | kFresh), std::memory_order_acq_rel) & kIndex;
+    }
+
+    /**
+     * @brief Move front() to the latest published value (consumer side)
+     * @return false if nothing was published since the last update
+     */
+    bool update()
+    {
+        if ((middle_.load(std::memory_order_relaxed) & kFresh) == 0)
+        {
+            return false;
+        }
+        front_ = middle_.exchange(front_, std::memory_order_acq_rel) & kIndex;
+        return true;
+    }
+
+    /**
+     * @brief Value taken by the last update() (consumer side)
+     */
+    const T& front() const
+    {
+        return slots_[front_];
+    }
+
+private:
+    static constexpr uint8_t kIndex = 3;
+    static constexpr uint8_t kFresh = 4;    ///< The middle slot holds an unread value
+
+    std::array<T, 3> slots_;
+    uint8_t back_{0};                       ///< Producer only
+    alignas(64) std::atomic<uint8_t> middle_{1};
+    alignas(64) uint8_t front_{2};          ///< Consumer only
+};
+
+#endif // SNAPSHOTBUFFER_H
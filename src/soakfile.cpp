@@ -0,0 +1,174 @@
+#include "soakfile.h"
+
+#include <cstring>
+#include <stdexcept>
+
+
+std::string soakAnomalyNames(uint32_t flags)
+{
+    static const std::pair<uint32_t, const char*> names[] = {
+        {kSoakStepChange, "step"}, {kSoakLowConfidence, "lowconf"}, {kSoakClipping, "clip"},
+        {kSoakSilence, "silence"}, {kSoakDropout, "dropout"},
+    };
+    std::string text;
+    for (const auto &[bit, name] : names)
+    {
+        if (flags & bit)
+        {
+            if (!text.empty())
+            {
+                text += '|';
+            }
+            text += name;
+        }
+    }
+    return text;
+}
+
+
+SoakFileWriter::SoakFileWriter(const std::filesystem::path& filename, const RecordingInfo& info)
+    : header_(recording::makeHeader(info, recording::kSoakMagic))
+    , codec_(info.numChannels, info.period)
+{
+    header_.chunkFrames = static_cast<uint32_t>(info.period);
+
+    file_.open(filename, std::ios::binary | std::ios::trunc);
+    if (!file_.is_open())
+    {
+        throw std::runtime_error("Cannot open soak recording file");
+    }
+    static const char zeros[recording::kPageSize] = {};
+    file_.write(reinterpret_cast<const char*>(&header_), sizeof(header_));
+    file_.write(zeros, recording::kPageSize - sizeof(header_));
+    if (file_.fail())
+    {
+        throw std::runtime_error("Cannot write soak recording file");
+    }
+}
+
+SoakFileWriter::~SoakFileWriter()
+{
+    close();
+}
+
+void SoakFileWriter::writePeriod(uint64_t index, uint32_t flags, const float *frames)
+{
+    if (failed_)
+    {
+        return;
+    }
+    if ((header_.numChunks == 0) || (index != nextIndex_))
+    {
+        codec_.reset();
+    }
+    nextIndex_ = index + 1;
+
+    coded_.clear();
+    codec_.encode(frames, coded_);
+
+    recording::PeriodRecord record{};
+    record.magic = recording::kPeriodMagic;
+    record.flags = flags;
+    record.index = index;
+    record.numBytes = static_cast<uint32_t>(coded_.size());
+    file_.write(reinterpret_cast<const char*>(&record), sizeof(record));
+    file_.write(reinterpret_cast<const char*>(coded_.data()), coded_.size());
+    file_.flush();
+    if (file_.fail())
+    {
+        // e.g. the disk is full; the header only counts the periods written completely
+        failed_ = true;
+        return;
+    }
+
+    header_.numChunks++;
+    storedBytes_ += sizeof(record) + coded_.size();
+}
+
+void SoakFileWriter::close()
+{
+    if (!file_.is_open())
+    {
+        return;
+    }
+    file_.clear();
+    file_.seekp(0);
+    file_.write(reinterpret_cast<const char*>(&header_), sizeof(header_));
+    file_.flush();
+    failed_ = failed_ || file_.fail();
+    file_.close();
+}
+
+
+SoakReader::SoakReader(const std::filesystem::path& filename)
+    : filename_(filename)
+{
+    std::ifstream file(filename, std::ios::binary);
+    recording::FileHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))
+        || (std::memcmp(header.magic, recording::kSoakMagic, sizeof(header.magic)) != 0)
+        || (header.version != recording::kVersion) || (header.numChannels == 0) || (header.period == 0))
+    {
+        throw std::runtime_error("Not a soak recording file");
+    }
+    info_ = recording::headerInfo(header);
+    recordedFrames_ = header.numFrames;
+
+    // Walk the records; a truncated last one is ignored
+    const uint64_t fileSize = std::filesystem::file_size(filename);
+    uint64_t offset = recording::kPageSize;
+    file.seekg(static_cast<std::streamoff>(offset));
+    recording::PeriodRecord record;
+    while (file.read(reinterpret_cast<char*>(&record), sizeof(record)) && (record.magic == recording::kPeriodMagic))
+    {
+        offset += sizeof(record);
+        if (offset + record.numBytes > fileSize)
+        {
+            break;
+        }
+
+        if (entries_.empty() || (record.index != entries_.back().index + 1))
+        {
+            segmentStart_.push_back(entries_.size());
+            segments_.push_back({record.index, 0, 0});
+        }
+        segments_.back().numPeriods++;
+        segments_.back().flags |= record.flags;
+        entries_.push_back({record.index, record.flags, offset, record.numBytes});
+        offset += record.numBytes;
+        file.seekg(static_cast<std::streamoff>(offset));
+    }
+}
+
+bool SoakReader::isSoakFile(const std::filesystem::path& filename)
+{
+    std::ifstream file(filename, std::ios::binary);
+    char magic[sizeof(recording::kSoakMagic)];
+    return file.read(magic, sizeof(magic)) && (std::memcmp(magic, recording::kSoakMagic, sizeof(magic)) == 0);
+}
+
+void SoakReader::decode(size_t segment, const Visitor& visit) const
+{
+    if (segment >= segments_.size())
+    {
+        throw std::out_of_range("SoakReader: segment out of range");
+    }
+
+    std::ifstream file(filename_, std::ios::binary);
+    PeriodCodec codec(info_.numChannels, info_.period);
+    std::vector<uint8_t> coded;
+    std::vector<float> frames(info_.numChannels * info_.period);
+    const size_t first = segmentStart_[segment];
+    for (size_t k = first; k < first + segments_[segment].numPeriods; k++)
+    {
+        const auto &entry = entries_[k];
+        coded.resize(entry.numBytes);
+        file.seekg(static_cast<std::streamoff>(entry.offset));
+        if (!file.read(reinterpret_cast<char*>(coded.data()), coded.size())
+            || !codec.decode(coded.data(), coded.size(), frames.data()))
+        {
+            throw std::runtime_error("Corrupt soak recording at period " + std::to_string(entry.index));
+        }
+        visit(entry.index, entry.flags, frames.data());
+    }
+}
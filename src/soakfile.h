@@ -0,0 +1,164 @@
+#ifndef SOAKFILE_H
+#define SOAKFILE_H
+
+#include "periodcodec.h"
+#include "recordingfile.h"
+
+#include <cstdint>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+
+/**
+ * Compressed soak recording
+ *
+ * [FileHeader page][PeriodRecord][coded period][PeriodRecord][coded period]...
+ *
+ * Only selected periods are stored, each coded with PeriodCodec. Consecutive
+ * periods form a segment and are coded against their predecessor; the first
+ * period of a segment is coded on its own, so segments decode independently.
+ * Records are appended complete; the header counters are only final after a
+ * clean close, readers walk the records instead.
+ */
+namespace recording {
+
+constexpr char kSoakMagic[8] = {'T', 'C', 'A', 'L', 'S', 'O', 'A', 'K'};
+constexpr uint32_t kPeriodMagic = 0x44524550;   // "PERD"
+
+struct PeriodRecord
+{
+    uint32_t magic;
+    uint32_t flags;             ///< SoakAnomaly bits of this period
+    uint64_t index;             ///< Period index from the start of the recording
+    uint32_t numBytes;          ///< Coded period following the record
+    uint32_t reserved;
+};
+
+}   // namespace recording
+
+
+/**
+ * @brief Reasons for keeping periods of a soak recording
+ */
+enum SoakAnomaly : uint32_t
+{
+    kSoakStepChange = 1,        ///< The tracked latency jumped
+    kSoakLowConfidence = 2,     ///< The period gave no clear impulse response
+    kSoakClipping = 4,          ///< An input reached the clip level
+    kSoakSilence = 8,           ///< Input 0 carried no stimulus
+    kSoakDropout = 16,          ///< Recorded samples were dropped
+};
+
+/**
+ * @brief "step|clip" style list of the set SoakAnomaly bits, empty for none
+ */
+std::string soakAnomalyNames(uint32_t flags);
+
+
+/**
+ * @brief Sequential writer of the soak container
+ */
+class SoakFileWriter
+{
+public:
+    /**
+     * @brief Create the file and write the header, throwing std::runtime_error if it cannot
+     */
+    SoakFileWriter(const std::filesystem::path& filename, const RecordingInfo& info);
+    ~SoakFileWriter();
+
+    /**
+     * @brief Code and append one period; a gap in the index starts a new segment
+     * @param index
+     * @param flags
+     * @param frames Interleaved, one period
+     */
+    void writePeriod(uint64_t index, uint32_t flags, const float *frames);
+
+    /**
+     * @brief Total frames recorded, stored or not, for the header
+     */
+    void setRecordedFrames(uint64_t numFrames) {header_.numFrames = numFrames;}
+
+    uint64_t storedPeriods() const {return header_.numChunks;}
+    uint64_t storedBytes() const {return storedBytes_;}
+
+    void close();
+
+    /**
+     * @brief A period or the final header could not be written
+     *
+     * As in RecordingFileWriter, no period is written after the first failure,
+     * so the file ends with at most one truncated record, which readers ignore.
+     */
+    bool failed() const {return failed_;}
+
+private:
+    std::ofstream file_;
+    recording::FileHeader header_{};
+    PeriodCodec codec_;
+    std::vector<uint8_t> coded_;
+    uint64_t nextIndex_{0};
+    uint64_t storedBytes_{0};
+    bool failed_{false};
+};
+
+
+/**
+ * @brief Reader of the soak container
+ */
+class SoakReader
+{
+public:
+    struct Segment
+    {
+        uint64_t firstPeriod{0};
+        uint64_t numPeriods{0};
+        uint32_t flags{0};          ///< Union of the flags of its periods
+    };
+
+    using Visitor = std::function<void(uint64_t index, uint32_t flags, const float *frames)>;
+
+    explicit SoakReader(const std::filesystem::path& filename);
+
+    /**
+     * @brief True if the file starts with the soak magic
+     */
+    static bool isSoakFile(const std::filesystem::path& filename);
+
+    const RecordingInfo& info() const {return info_;}
+
+    /**
+     * @brief Frames recorded in total, 0 if the file was not closed cleanly
+     */
+    uint64_t recordedFrames() const {return recordedFrames_;}
+
+    const std::vector<Segment>& segments() const {return segments_;}
+
+    /**
+     * @brief Decode the periods of one segment in order
+     */
+    void decode(size_t segment, const Visitor& visit) const;
+
+private:
+    struct Entry
+    {
+        uint64_t index{0};
+        uint32_t flags{0};
+        uint64_t offset{0};
+        uint32_t numBytes{0};
+    };
+
+    std::filesystem::path filename_;
+    RecordingInfo info_;
+    uint64_t recordedFrames_{0};
+    std::vector<Entry> entries_;
+    std::vector<size_t> segmentStart_;  ///< First entry of each segment
+    std::vector<Segment> segments_;
+};
+
+#endif // SOAKFILE_H
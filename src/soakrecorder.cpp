@@ -0,0 +1,214 @@
+#include "soakrecorder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <stdexcept>
+
+
+SoakRecorder::SoakRecorder(const std::filesystem::path& resultPath, const RecordingInfo& info, const SoakConfig& config,
+                           std::function<void(const float *samples, size_t count)> listener)
+    : info_(info)
+    , config_(config)
+    , periodSeconds_(static_cast<double>(info.period) / info.sampleRate)
+    , listener_(std::move(listener))
+    , file_(resultPath / "soak.tcal", info)
+    , summary_(resultPath / "summary.csv")
+    , ring_(config.preRoll + 2)
+    , current_(info.period * info.numChannels)
+{
+    if (!summary_.is_open())
+    {
+        throw std::runtime_error("Cannot open soak summary file");
+    }
+    for (auto &entry : ring_)
+    {
+        entry.frames.resize(current_.size());
+        entry.peak.resize(info.numChannels);
+        entry.rms.resize(info.numChannels);
+    }
+
+    summary_ << "period,seconds,delay_samples,fractional_delay,confidence,period_confidence,drift_ppm";
+    for (size_t ch = 0; ch < info.numChannels; ch++)
+    {
+        summary_ << ",peak" << ch << ",rms" << ch;
+    }
+    summary_ << ",anomalies,stored" << std::endl;
+}
+
+SoakRecorder::~SoakRecorder()
+{
+    close();
+}
+
+void SoakRecorder::write(const float *samples, size_t count)
+{
+    while (count > 0)
+    {
+        const size_t n = std::min(count, current_.size() - fill_);
+        std::copy(samples, samples + n, current_.begin() + fill_);
+        fill_ += n;
+        if (fill_ == current_.size())
+        {
+            completePeriod();
+        }
+        if (listener_)
+        {
+            listener_(samples, n);
+        }
+        samples += n;
+        count -= n;
+    }
+}
+
+void SoakRecorder::markDropout()
+{
+    pendingFlags_ |= kSoakDropout;
+}
+
+void SoakRecorder::addEstimate(const LatencyEstimate& e)
+{
+    const uint64_t index = e.period + LatencyTracker::kSettlePeriods;
+    auto &entry = ring_[index % ring_.size()];
+    if (!entry.valid || (entry.index != index))
+    {
+        return;
+    }
+    entry.estimate = e;
+    entry.hasEstimate = true;
+
+    uint32_t flags = 0;
+    if (e.stepChange)
+    {
+        flags |= kSoakStepChange;
+    }
+    if (e.periodConfidence < config_.minConfidence)
+    {
+        flags |= kSoakLowConfidence;
+    }
+    flag(index, flags);
+}
+
+void SoakRecorder::completePeriod()
+{
+    const uint64_t index = numPeriods_++;
+    auto &entry = ring_[index % ring_.size()];
+    if (entry.valid)
+    {
+        retire(entry);
+    }
+
+    entry.index = index;
+    entry.valid = true;
+    entry.keep = config_.keepAll || (index < keepUntil_);
+    entry.hasEstimate = false;
+    entry.flags = 0;
+    entry.frames.swap(current_);
+    fill_ = 0;
+
+    const size_t numChannels = info_.numChannels;
+    uint32_t flags = pendingFlags_;
+    pendingFlags_ = 0;
+    for (size_t ch = 0; ch < numChannels; ch++)
+    {
+        float peak = 0;
+        double energy = 0;
+        for (size_t n = 0; n < info_.period; n++)
+        {
+            const float x = entry.frames[n * numChannels + ch];
+            peak = std::max(peak, std::abs(x));
+            energy += double(x) * x;
+        }
+        entry.peak[ch] = peak;
+        entry.rms[ch] = static_cast<float>(std::sqrt(energy / info_.period));
+        if (peak >= config_.clipLevel)
+        {
+            flags |= kSoakClipping;
+        }
+    }
+    if (entry.peak[0] < config_.silenceLevel)
+    {
+        flags |= kSoakSilence;
+    }
+    flag(index, flags);
+}
+
+void SoakRecorder::flag(uint64_t index, uint32_t flags)
+{
+    auto &entry = ring_[index % ring_.size()];
+    if ((flags == 0) || !entry.valid || (entry.index != index))
+    {
+        return;
+    }
+    if (entry.flags == 0)
+    {
+        numAnomalies_++;
+    }
+    entry.flags |= flags;
+
+    // Pre-roll from the periods still held, post-roll as they arrive
+    const uint64_t first = (index > config_.preRoll) ? (index - config_.preRoll) : 0;
+    for (auto &other : ring_)
+    {
+        if (other.valid && (other.index >= first))
+        {
+            other.keep = true;
+        }
+    }
+    keepUntil_ = std::max(keepUntil_, index + config_.postRoll + 1);
+}
+
+void SoakRecorder::retire(Entry& entry)
+{
+    if (entry.keep)
+    {
+        file_.writePeriod(entry.index, entry.flags, entry.frames.data());
+    }
+
+    summary_ << entry.index << ',' << std::fixed << std::setprecision(3) << (entry.index * periodSeconds_) << ',';
+    if (entry.hasEstimate)
+    {
+        const auto &e = entry.estimate;
+        summary_ << e.delay << ',' << std::setprecision(3) << e.fractionalDelay << ','
+                 << e.confidence << ',' << e.periodConfidence << ',' << std::setprecision(2) << e.driftPpm;
+    }
+    else
+    {
+        summary_ << ",,,,";
+    }
+    summary_ << std::defaultfloat << std::setprecision(4);
+    for (size_t ch = 0; ch < info_.numChannels; ch++)
+    {
+        summary_ << ',' << entry.peak[ch] << ',' << entry.rms[ch];
+    }
+    summary_ << ',' << soakAnomalyNames(entry.flags) << ',' << (entry.keep ? 1 : 0) << '\n';
+    if (entry.flags != 0)
+    {
+        summary_.flush();
+    }
+    entry.valid = false;
+}
+
+void SoakRecorder::close()
+{
+    if (!summary_.is_open())
+    {
+        return;
+    }
+
+    // Oldest first; a partial last period is dropped
+    const uint64_t first = (numPeriods_ > ring_.size()) ? (numPeriods_ - ring_.size()) : 0;
+    for (uint64_t index = first; index < numPeriods_; index++)
+    {
+        auto &entry = ring_[index % ring_.size()];
+        if (entry.valid)
+        {
+            retire(entry);
+        }
+    }
+    file_.setRecordedFrames(numPeriods_ * info_.period + fill_ / info_.numChannels);
+    file_.close();
+    summary_.flush();
+    summaryFailed_ = summary_.fail();
+    summary_.close();
+}
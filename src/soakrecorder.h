@@ -0,0 +1,106 @@
+#ifndef SOAKRECORDER_H
+#define SOAKRECORDER_H
+
+#include "latencytracker.h"
+#include "recordingfile.h"
+#include "soakfile.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <vector>
+
+
+struct SoakConfig
+{
+    size_t preRoll{4};              ///< Periods stored before an anomalous one
+    size_t postRoll{4};             ///< Periods stored after it
+    double minConfidence{0.5};      ///< Period confidence below which a period is anomalous
+    float clipLevel{0.999f};
+    float silenceLevel{1e-4f};      ///< Peak of input 0 below which the stimulus counts as lost
+    bool keepAll{false};            ///< Store every period, not only those around anomalies
+};
+
+
+/**
+ * @brief Recording sink for long stability runs with bounded disk usage
+ *
+ * Keeps the last few periods in memory and appends one row per period to
+ * summary.csv: input levels, the online estimate and the anomalies found. Only
+ * periods within preRoll/postRoll of an anomaly are stored, losslessly
+ * compressed, in soak.tcal (see SoakFileWriter). A period is anomalous if its
+ * estimate is a step change or below minConfidence, if an input clips, if
+ * input 0 is silent, or if samples were dropped during it.
+ *
+ * The listener, e.g. the online tracker, sees the samples split at period
+ * boundaries right after they were buffered, so an estimate passed back to
+ * addEstimate() arrives while its period is still held. write() and
+ * addEstimate() must be called from the same (writer) thread.
+ */
+class SoakRecorder : public RecordingSink
+{
+public:
+    /**
+     * @param resultPath Directory of soak.tcal and summary.csv
+     * @param info
+     * @param config
+     * @param listener
+     */
+    SoakRecorder(const std::filesystem::path& resultPath, const RecordingInfo& info, const SoakConfig& config,
+                 std::function<void(const float *samples, size_t count)> listener = {});
+    ~SoakRecorder() override;
+
+    void write(const float *samples, size_t count) override;
+    void markDropout() override;
+    void close() override;
+
+    /**
+     * @brief Storing a period in soak.tcal or a row of summary.csv failed; valid after close()
+     */
+    bool failed() const override {return file_.failed() || summaryFailed_;}
+
+    /**
+     * @brief Online estimate of an already written period
+     */
+    void addEstimate(const LatencyEstimate& e);
+
+    uint64_t numPeriods() const {return numPeriods_;}
+    uint64_t numAnomalies() const {return numAnomalies_;}
+    uint64_t storedPeriods() const {return file_.storedPeriods();}
+    uint64_t storedBytes() const {return file_.storedBytes();}
+
+private:
+    struct Entry
+    {
+        uint64_t index{0};
+        bool valid{false};
+        bool keep{false};
+        bool hasEstimate{false};
+        uint32_t flags{0};
+        LatencyEstimate estimate;
+        std::vector<float> frames;
+        std::vector<float> peak, rms;
+    };
+
+    void completePeriod();
+    void flag(uint64_t index, uint32_t flags);
+    void retire(Entry& entry);
+
+    const RecordingInfo info_;
+    const SoakConfig config_;
+    const double periodSeconds_;
+    std::function<void(const float *samples, size_t count)> listener_;
+    SoakFileWriter file_;
+    std::ofstream summary_;
+    std::vector<Entry> ring_;       ///< Period k in ring_[k % size]
+    std::vector<float> current_;    ///< Period being filled, interleaved
+    size_t fill_{0};
+    uint64_t numPeriods_{0};        ///< Completed periods
+    uint64_t keepUntil_{0};         ///< Periods before this are stored as post-roll
+    uint32_t pendingFlags_{0};      ///< For the period being filled
+    uint64_t numAnomalies_{0};
+    bool summaryFailed_{false};
+};
+
+#endif // SOAKRECORDER_H
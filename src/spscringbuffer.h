@@ -0,0 +1,114 @@
+#ifndef SPSCRINGBUFFER_H
+#define SPSCRINGBUFFER_H
+
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <cstddef>
+
+
+/**
+ * @brief Wait-free single-producer/single-consumer ring buffer
+ *
+ * One thread may call push(), one other thread may call pop(). Neither call
+ * blocks, allocates or makes system calls, so push() is safe on the audio I/O thread.
+ */
+template<typename T>
+class SpscRingBuffer
+{
+public:
+    /**
+     * @brief Constructor
+     * @param capacity Number of elements, rounded up to a power of two
+     */
+    explicit SpscRingBuffer(size_t capacity)
+    {
+        if (capacity == 0)
+        {
+            throw std::invalid_argument("SpscRingBuffer: zero capacity");
+        }
+        size_t size = 1;
+        while (size < capacity)
+        {
+            size <<= 1;
+        }
+        buffer_.resize(size);
+        mask_ = size - 1;
+    }
+
+    SpscRingBuffer(const SpscRingBuffer&) = delete;
+    SpscRingBuffer& operator=(const SpscRingBuffer&) = delete;
+
+    size_t capacity() const
+    {
+        return buffer_.size();
+    }
+
+    /**
+     * @brief Write all elements or none of them (producer side)
+     * @param data
+     * @param count
+     * @return false if there was not enough free space
+     */
+    bool push(const T *data, size_t count)
+    {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        const size_t tail = tail_.load(std::memory_order_acquire);
+        if ((buffer_.size() - (head - tail)) < count)
+        {
+            return false;
+        }
+
+        const size_t start = head & mask_;
+        const size_t first = std::min(count, buffer_.size() - start);
+        std::copy(data, data + first, buffer_.data() + start);
+        std::copy(data + first, data + count, buffer_.data());
+
+        head_.store(head + count, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Read up to maxCount elements (consumer side)
+     * @param data
+     * @param maxCount
+     * @return Number of elements read
+     */
+    size_t pop(T *data, size_t maxCount)
+    {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        const size_t head = head_.load(std::memory_order_acquire);
+        const size_t count = std::min(maxCount, head - tail);
+        if (count == 0)
+        {
+            return 0;
+        }
+
+        const size_t start = tail & mask_;
+        const size_t first = std::min(count, buffer_.size() - start);
+        std::copy(buffer_.data() + start, buffer_.data() + start + first, data);
+        std::copy(buffer_.data(), buffer_.data() + (count - first), data + first);
+
+        tail_.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    /**
+     * @brief Number of elements ready to be read (consumer side)
+     */
+    size_t readAvailable() const
+    {
+        return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_relaxed);
+    }
+
+private:
+    static constexpr size_t kCacheLine = 64;
+
+    std::vector<T> buffer_;
+    size_t mask_{0};
+    alignas(kCacheLine) std::atomic<size_t> head_{0};
+    alignas(kCacheLine) std::atomic<size_t> tail_{0};
+};
+
+#endif // SPSCRINGBUFFER_H
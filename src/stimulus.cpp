@@ -0,0 +1,361 @@
+#include "stimulus.h"
+#include "chirp.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+
+
+namespace {
+
+constexpr double twoPI = 6.283185307179586;
+
+/**
+ * Feedback taps (1-based stage numbers) of maximal-length Fibonacci LFSRs
+ */
+const std::vector<unsigned>& lfsrTaps(size_t order)
+{
+    static const std::map<size_t, std::vector<unsigned>> taps = {
+        {3, {3, 2}}, {4, {4, 3}}, {5, {5, 3}}, {6, {6, 5}}, {7, {7, 6}},
+        {8, {8, 6, 5, 4}}, {9, {9, 5}}, {10, {10, 7}}, {11, {11, 9}},
+        {12, {12, 6, 4, 1}}, {13, {13, 4, 3, 1}}, {14, {14, 5, 3, 1}},
+        {15, {15, 14}}, {16, {16, 15, 13, 4}}, {17, {17, 14}}, {18, {18, 11}},
+        {19, {19, 6, 2, 1}}, {20, {20, 17}},
+    };
+    const auto it = taps.find(order);
+    if (it == taps.end())
+    {
+        throw std::invalid_argument("StimulusSignal: MLS period must be 2^3 to 2^20");
+    }
+    return it->second;
+}
+
+/**
+ * In-place unnormalised Walsh-Hadamard transform of a power-of-two length
+ */
+void fastHadamard(float *x, size_t size)
+{
+    for (size_t half = 1; half < size; half <<= 1)
+    {
+        for (size_t i = 0; i < size; i += 2 * half)
+        {
+            for (size_t j = i; j < i + half; j++)
+            {
+                const float a = x[j];
+                const float b = x[j + half];
+                x[j] = a + b;
+                x[j + half] = a - b;
+            }
+        }
+    }
+}
+
+}   // anonymous namespace
+
+
+const char* stimulusName(StimulusType type)
+{
+    switch (type)
+    {
+    case StimulusType::Chirp:       return "chirp";
+    case StimulusType::Mls:         return "mls";
+    case StimulusType::Golay:       return "golay";
+    case StimulusType::LogSweep:    return "logsweep";
+    default:                        return "unknown";
+    }
+}
+
+StimulusType parseStimulusType(const std::string& name)
+{
+    for (auto type : {StimulusType::Chirp, StimulusType::Mls, StimulusType::Golay, StimulusType::LogSweep})
+    {
+        if (name == stimulusName(type))
+        {
+            return type;
+        }
+    }
+    throw std::invalid_argument("Unknown stimulus: " + name);
+}
+
+
+StimulusSignal::StimulusSignal(StimulusType type, size_t period)
+    : type_{type}
+{
+    // Validates the period and sets the playback level
+    const auto &chirp = ChirpSignal::get(period);
+    float amplitude = 0;
+    for (auto x : chirp.samples())
+    {
+        amplitude = std::max(amplitude, std::abs(x));
+    }
+
+    switch (type_)
+    {
+    case StimulusType::Chirp:
+        samples_ = chirp.samples();
+        validLags_ = period;
+        filterRe_ = chirp.spectrumRe();
+        filterIm_ = chirp.spectrumIm();
+        for (size_t k = 0; k < filterRe_.size(); k++)
+        {
+            // Unit magnitude, so the inverse is the conjugate
+            filterIm_[k] = -filterIm_[k];
+        }
+        break;
+
+    case StimulusType::Mls:
+    {
+        size_t order = 0;
+        while ((size_t(1) << order) < period)
+        {
+            order++;
+        }
+        generateMls(order, amplitude);
+        break;
+    }
+
+    case StimulusType::Golay:
+        samples_.resize(period);
+        generateGolay(amplitude);
+        computeFilter(false);
+        break;
+
+    case StimulusType::LogSweep:
+        samples_.resize(period);
+        generateLogSweep(amplitude);
+        computeFilter(true);
+        break;
+
+    default:
+        throw std::invalid_argument("StimulusSignal: unknown type");
+    }
+}
+
+const StimulusSignal& StimulusSignal::get(StimulusType type, size_t period)
+{
+    static std::mutex mutex;
+    static std::map<std::pair<StimulusType, size_t>, std::unique_ptr<StimulusSignal>> cache;
+
+    std::scoped_lock<std::mutex> lock(mutex);
+    auto &entry = cache[{type, period}];
+    if (!entry)
+    {
+        entry = std::make_unique<StimulusSignal>(type, period);
+    }
+    return *entry;
+}
+
+void StimulusSignal::generateMls(size_t order, float amplitude)
+{
+    const size_t length = (size_t(1) << order) - 1;
+    const auto &taps = lfsrTaps(order);
+
+    std::vector<uint8_t> bits(length);
+    uint32_t state = 1;
+    for (size_t n = 0; n < length; n++)
+    {
+        bits[n] = state & 1;
+        uint32_t feedback = 0;
+        for (auto tap : taps)
+        {
+            feedback ^= (state >> (order - tap)) & 1;
+        }
+        state = (state >> 1) | (feedback << (order - 1));
+    }
+
+    samples_.resize(length);
+    for (size_t n = 0; n < length; n++)
+    {
+        samples_[n] = bits[n] ? -amplitude : amplitude;
+    }
+    validLags_ = length;
+
+    // The +-1 circulant M[i][j] = s[j - i] factors into Hadamard entries
+    // H[tagL[i]][tagS[j]]: tagS[j] is the state window at j, tagL[i] the linear
+    // functional giving bit j - i from that window.
+    tagS_.assign(length, 0);
+    for (size_t j = 0; j < length; j++)
+    {
+        for (size_t k = 0; k < order; k++)
+        {
+            tagS_[j] |= static_cast<uint32_t>(bits[(j + k) % length]) << k;
+        }
+    }
+
+    std::vector<size_t> unit(order, length);
+    for (size_t j = 0; j < length; j++)
+    {
+        for (size_t k = 0; k < order; k++)
+        {
+            if (tagS_[j] == (uint32_t(1) << k))
+            {
+                unit[k] = j;
+            }
+        }
+    }
+    if (std::find(unit.begin(), unit.end(), length) != unit.end())
+    {
+        throw std::logic_error("StimulusSignal: LFSR is not maximal length");
+    }
+
+    tagL_.assign(length, 0);
+    for (size_t i = 0; i < length; i++)
+    {
+        for (size_t k = 0; k < order; k++)
+        {
+            tagL_[i] |= static_cast<uint32_t>(bits[(unit[k] + length - i) % length]) << k;
+        }
+    }
+}
+
+void StimulusSignal::generateGolay(float amplitude)
+{
+    const size_t period = samples_.size();
+    const size_t length = period / 4;
+    std::vector<float> a{1.0f};
+    std::vector<float> b{1.0f};
+    while (a.size() < length)
+    {
+        // (a, b) -> (a|b, a|-b) keeps the pair complementary
+        std::vector<float> nextA(a);
+        std::vector<float> nextB(a);
+        nextA.insert(nextA.end(), b.begin(), b.end());
+        for (auto x : b)
+        {
+            nextB.push_back(-x);
+        }
+        a = std::move(nextA);
+        b = std::move(nextB);
+    }
+
+    std::fill(samples_.begin(), samples_.end(), 0.0f);
+    for (size_t n = 0; n < length; n++)
+    {
+        samples_[n] = amplitude * a[n];
+        samples_[2 * length + n] = amplitude * b[n];
+    }
+    // The cross terms of A and B start at a lag of 2 * length - (length - 1)
+    validLags_ = length;
+}
+
+void StimulusSignal::generateLogSweep(float amplitude)
+{
+    // Normalised frequencies in cycles per sample
+    const size_t period = samples_.size();
+    const double f1 = 4.0 / static_cast<double>(period);
+    const double f2 = 0.45;
+    const size_t length = static_cast<size_t>(kDefaultChirpDutyCycle * static_cast<double>(period));
+    const size_t fade = std::min<size_t>(64, length / 8);
+    const double rate = static_cast<double>(length) / std::log(f2 / f1);
+
+    std::fill(samples_.begin(), samples_.end(), 0.0f);
+    for (size_t n = 0; n < length; n++)
+    {
+        const double phase = twoPI * f1 * rate * (std::exp(static_cast<double>(n) / rate) - 1.0);
+        double gain = 1.0;
+        const size_t edge = std::min(n, length - 1 - n);
+        if (edge < fade)
+        {
+            gain = 0.5 - 0.5 * std::cos(twoPI * 0.5 * static_cast<double>(edge) / static_cast<double>(fade));
+        }
+        samples_[n] = static_cast<float>(amplitude * gain * std::sin(phase));
+    }
+    validLags_ = period;
+}
+
+void StimulusSignal::computeFilter(bool regularise)
+{
+    // Relative floor of the regularised inverse, far below the in-band level
+    constexpr double kRegularisation = 1e-3;
+
+    const size_t period = samples_.size();
+    const size_t numBins = period / 2 + 1;
+    FFT fft(period);
+    std::vector<float> re(samples_), im(period, 0.0f);
+    fft.forward(re.data(), im.data());
+
+    double energy = 0;
+    double maxMag2 = 0;
+    for (size_t n = 0; n < period; n++)
+    {
+        energy += double(samples_[n]) * samples_[n];
+    }
+    for (size_t k = 0; k < numBins; k++)
+    {
+        maxMag2 = std::max(maxMag2, double(re[k]) * re[k] + double(im[k]) * im[k]);
+    }
+
+    // Correlation, normalised by the energy, or regularised inverse
+    filterRe_.resize(numBins);
+    filterIm_.resize(numBins);
+    for (size_t k = 0; k < numBins; k++)
+    {
+        const double mag2 = double(re[k]) * re[k] + double(im[k]) * im[k];
+        const double denom = regularise ? (mag2 + kRegularisation * maxMag2) : energy;
+        filterRe_[k] = static_cast<float>(re[k] / denom);
+        filterIm_[k] = static_cast<float>(-im[k] / denom);
+    }
+}
+
+
+StimulusCorrelator::StimulusCorrelator(const StimulusSignal& stimulus)
+    : stimulus_(stimulus)
+    , re_(stimulus.size() + 1)
+    , im_(stimulus.size() + 1)
+{
+    if (stimulus_.type() != StimulusType::Mls)
+    {
+        fft_ = std::make_unique<FFT>(stimulus_.size());
+    }
+}
+
+void StimulusCorrelator::impulseResponse(const float *y, size_t stride, float *h)
+{
+    const size_t period = stimulus_.size();
+
+    if (!fft_)
+    {
+        // Permute into Hadamard order, transform, permute the lags back out
+        const auto &tagS = stimulus_.tagS_;
+        const auto &tagL = stimulus_.tagL_;
+        re_[0] = 0;
+        for (size_t n = 0; n < period; n++)
+        {
+            re_[tagS[n]] = y[n * stride];
+        }
+        fastHadamard(re_.data(), period + 1);
+        const float scale = 1.0f / (static_cast<float>(period + 1) * std::abs(stimulus_.samples_[0]));
+        for (size_t n = 0; n < period; n++)
+        {
+            h[n] = re_[tagL[n]] * scale;
+        }
+        return;
+    }
+
+    const size_t numBins = period / 2 + 1;
+    const auto &gRe = stimulus_.filterRe_;
+    const auto &gIm = stimulus_.filterIm_;
+    for (size_t n = 0; n < period; n++)
+    {
+        re_[n] = y[n * stride];
+        im_[n] = 0;
+    }
+    fft_->forward(re_.data(), im_.data());
+    for (size_t k = 0; k < numBins; k++)
+    {
+        const float hr = re_[k] * gRe[k] - im_[k] * gIm[k];
+        const float hi = re_[k] * gIm[k] + im_[k] * gRe[k];
+        re_[k] = hr;
+        im_[k] = hi;
+    }
+    for (size_t k = numBins; k < period; k++)
+    {
+        re_[k] = re_[period - k];
+        im_[k] = -im_[period - k];
+    }
+    fft_->inverse(re_.data(), im_.data());
+    std::copy(re_.begin(), re_.begin() + period, h);
+}
@@ -0,0 +1,122 @@
+#ifndef STIMULUS_H
+#define STIMULUS_H
+
+#include "fft.h"
+#include "recordingfile.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+
+const char* stimulusName(StimulusType type);
+
+/**
+ * @brief Parse "chirp", "mls", "golay" or "logsweep"
+ */
+StimulusType parseStimulusType(const std::string& name);
+
+/**
+ * @brief Nominal period a stimulus of size samples was generated for
+ */
+inline size_t nominalStimulusPeriod(StimulusType type, size_t size)
+{
+    return (type == StimulusType::Mls) ? (size + 1) : size;
+}
+
+
+/**
+ * @brief One period of a periodic stimulus with its matched deconvolution
+ *
+ * All stimuli are scaled to the peak level of the chirp of the same nominal
+ * period, so switching between them does not change the playback level.
+ *
+ * - Chirp: ChirpSignal, deconvolved by its exact inverse spectrum.
+ * - Mls: maximum-length sequence of 2^N - 1 samples for a nominal period of
+ *   2^N, crest factor 1, correlated through the fast Hadamard transform.
+ * - Golay: [A, 0, B, 0] with a complementary pair A, B of period/4 samples.
+ *   The periodic autocorrelation is an impulse for lags below period/4, so the
+ *   impulse response is exact up to validLags().
+ * - LogSweep: exponential sine sweep over dutyCycle of the period, deconvolved
+ *   by its regularised inverse spectrum.
+ */
+class StimulusSignal
+{
+public:
+    /**
+     * @brief Generate a stimulus
+     * @param type
+     * @param period Nominal period, a power of two
+     */
+    StimulusSignal(StimulusType type, size_t period);
+
+    /**
+     * @brief Shared instance, generated on first use
+     */
+    static const StimulusSignal& get(StimulusType type, size_t period = 8192);
+
+    StimulusType type() const {return type_;}
+
+    /**
+     * @brief Actual period in samples, period - 1 for an MLS
+     */
+    size_t size() const {return samples_.size();}
+    const float* data() const {return samples_.data();}
+    const std::vector<float>& samples() const {return samples_;}
+
+    /**
+     * @brief Impulse responses are exact for delays below this many samples
+     */
+    size_t validLags() const {return validLags_;}
+
+private:
+    friend class StimulusCorrelator;
+
+    void generateMls(size_t order, float amplitude);
+    void generateGolay(float amplitude);
+    void generateLogSweep(float amplitude);
+    void computeFilter(bool regularise);
+
+    const StimulusType type_;
+    size_t validLags_{0};
+    std::vector<float> samples_;
+
+    // FFT-based types: H[k] = Y[k] * filter[k] on the first size()/2 + 1 bins
+    std::vector<float> filterRe_;
+    std::vector<float> filterIm_;
+
+    // Mls: Hadamard permutations of the samples and of the correlation lags
+    std::vector<uint32_t> tagS_;
+    std::vector<uint32_t> tagL_;
+};
+
+
+/**
+ * @brief Impulse response of one period of a response to a StimulusSignal
+ *
+ * Holds its own transform and scratch, so every thread needs its own instance.
+ */
+class StimulusCorrelator
+{
+public:
+    explicit StimulusCorrelator(const StimulusSignal& stimulus);
+
+    size_t period() const {return stimulus_.size();}
+
+    /**
+     * @brief Circular impulse response of one period
+     * @param y One period of the response, samples stride apart
+     * @param stride Distance between consecutive samples, e.g. the number of channels
+     * @param h Output of period() samples
+     */
+    void impulseResponse(const float *y, size_t stride, float *h);
+
+private:
+    const StimulusSignal &stimulus_;
+    std::unique_ptr<FFT> fft_;      ///< Null for an MLS
+    std::vector<float> re_, im_;
+};
+
+#endif // STIMULUS_H
@@ -0,0 +1,98 @@
+#ifndef STIMULUSKERNEL_H
+#define STIMULUSKERNEL_H
+
+#include "recordingfile.h"
+
+#include <algorithm>
+#include <cstddef>
+
+
+/**
+ * Stimulus playback kernels of LatencyTester
+ *
+ * The number of output channels and the stimulus layout are template parameters,
+ * so the interleaved stride is a constant the compiler can unroll and vectorise;
+ * NumOutputs == 0 instantiates the generic kernel with a runtime stride. The
+ * stimulus is copied in runs ending at its wrap-around, so the inner loops carry no
+ * per-sample branch. The matrix layout is played from a pre-interleaved table of
+ * one period, so every run is a single contiguous block copy.
+ */
+
+struct StimulusState
+{
+    const float *signal{nullptr};   ///< One period of the stimulus
+    const float *table{nullptr};    ///< Matrix layout: one period of interleaved output frames
+    size_t period{0};
+    size_t pos{0};                  ///< Next frame of the period
+};
+
+using StimulusKernel = void (*)(StimulusState &state, size_t numSamples,
+                                const float *inSamples, size_t inChannels, float *outSamples, size_t outChannels);
+
+
+template<StimulusLayout Layout, size_t NumOutputs>
+void stimulusKernel(StimulusState &state, size_t numSamples,
+                    const float *inSamples, size_t inChannels, float *outSamples, size_t outChannels)
+{
+    const size_t stride = (NumOutputs > 0) ? NumOutputs : outChannels;
+    size_t k = 0;
+    while (k < numSamples)
+    {
+        const size_t n = std::min(numSamples - k, state.period - state.pos);
+        float *dst = outSamples + k * stride;
+
+        if constexpr (Layout == StimulusLayout::Passthrough)
+        {
+            // Output 0 plays the stimulus, output 1 echoes input 0, the rest is silent
+            const float *signal = state.signal + state.pos;
+            const float *src = inSamples + k * inChannels;
+            if (stride > 2)
+            {
+                std::fill_n(dst, n * stride, 0.0f);
+            }
+            for (size_t i = 0; i < n; i++)
+            {
+                dst[i * stride] = signal[i];
+                dst[i * stride + 1] = src[i * inChannels];
+            }
+        }
+        else
+        {
+            std::copy_n(state.table + state.pos * stride, n * stride, dst);
+        }
+
+        k += n;
+        state.pos += n;
+        if (state.pos == state.period)
+        {
+            state.pos = 0;
+        }
+    }
+}
+
+/**
+ * @brief Pick the kernel instantiation for a layout and output count
+ */
+inline StimulusKernel selectStimulusKernel(StimulusLayout layout, size_t numOutputs)
+{
+    if (layout == StimulusLayout::Passthrough)
+    {
+        switch (numOutputs)
+        {
+        case 2: return &stimulusKernel<StimulusLayout::Passthrough, 2>;
+        case 4: return &stimulusKernel<StimulusLayout::Passthrough, 4>;
+        case 8: return &stimulusKernel<StimulusLayout::Passthrough, 8>;
+        default: return &stimulusKernel<StimulusLayout::Passthrough, 0>;
+        }
+    }
+    switch (numOutputs)
+    {
+    case 1: return &stimulusKernel<StimulusLayout::Matrix, 1>;
+    case 2: return &stimulusKernel<StimulusLayout::Matrix, 2>;
+    case 4: return &stimulusKernel<StimulusLayout::Matrix, 4>;
+    case 8: return &stimulusKernel<StimulusLayout::Matrix, 8>;
+    default: return &stimulusKernel<StimulusLayout::Matrix, 0>;
+    }
+}
+
+#endif // STIMULUSKERNEL_H
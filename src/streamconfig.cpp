@@ -0,0 +1,178 @@
+#include "streamconfig.h"
+
+#include <QDebug>
+
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+
+namespace {
+
+void printStreamConfig(const AudioStreamBasicDescription& desc)
+{
+    qDebug() << "Sample rate: " << desc.mSampleRate;
+    auto id = reinterpret_cast<const char*>(&desc.mFormatID);
+    qDebug() << "Format ID: " << id[0] << id[1] << id[2] << id[3];
+    qDebug() << "Format flags: " << desc.mFormatFlags;
+    qDebug() << "Bytes per packet: " << desc.mBytesPerPacket;
+    qDebug() << "Frames per packet: " << desc.mFramesPerPacket;
+    qDebug() << "Bytes per frame: " << desc.mBytesPerFrame;
+    qDebug() << "Channels per frame: " << desc.mChannelsPerFrame;
+    qDebug() << "Bits per channel: " << desc.mBitsPerChannel;
+}
+
+}   // anonymous namespace
+
+
+StreamConfigurator::StreamConfigurator(DeviceRegistry& registry, AudioObjectID deviceID)
+    : registry_(registry)
+    , deviceID_(deviceID)
+{
+}
+
+const StreamSetup& StreamConfigurator::apply(const StreamRequest& request)
+{
+    numWrites_ = 0;
+    const bool first = !configured_;
+    configured_ = false;
+
+    AudioObjectPropertyAddress addr{kAudioClockDevicePropertyNominalSampleRate, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain};
+    if (std::abs(registry_.get<Float64>(deviceID_, addr) - request.sampleRate) > 1e-3)
+    {
+        registry_.set(deviceID_, addr, request.sampleRate);
+        numWrites_++;
+        // The registry may not have seen the change notification yet
+        registry_.invalidate(deviceID_, addr.mSelector);
+        const auto sampleRate = registry_.get<Float64>(deviceID_, addr);
+        if (std::abs(sampleRate - request.sampleRate) > 1e-3)
+        {
+            qDebug() << "Sample rate: " << sampleRate;
+            throw std::runtime_error("Cannot set the sample rate");
+        }
+    }
+
+    addr.mSelector = kAudioDevicePropertyBufferFrameSize;
+    if (registry_.get<UInt32>(deviceID_, addr) != request.bufferSize)
+    {
+        registry_.set(deviceID_, addr, request.bufferSize);
+        numWrites_++;
+        registry_.invalidate(deviceID_, addr.mSelector);
+    }
+
+    if (request.selectPhysicalFormat)
+    {
+        for (auto scope : {kAudioObjectPropertyScopeInput, kAudioObjectPropertyScopeOutput})
+        {
+            if (!selectPhysicalFormat(scope, request.physicalFormat, request.sampleRate))
+            {
+                throw std::runtime_error(std::string("Physical format ") + sampleFormatName(request.physicalFormat) + " is not available");
+            }
+        }
+    }
+
+    // Formats and latencies follow the sample rate and physical format just set
+    if (numWrites_ > 0)
+    {
+        registry_.invalidate(deviceID_, kAudioDevicePropertyLatency);
+        registry_.invalidate(deviceID_, kAudioDevicePropertySafetyOffset);
+        for (auto scope : {kAudioObjectPropertyScopeInput, kAudioObjectPropertyScopeOutput})
+        {
+            for (auto id : registry_.streams(deviceID_, scope))
+            {
+                registry_.invalidate(id, kAudioStreamPropertyVirtualFormat);
+                registry_.invalidate(id, kAudioStreamPropertyPhysicalFormat);
+                registry_.invalidate(id, kAudioStreamPropertyLatency);
+            }
+        }
+    }
+
+    const bool verbose = first || (numWrites_ > 0);
+    setup_.inFormats = streamFormats(kAudioObjectPropertyScopeInput, verbose);
+    setup_.outFormats = streamFormats(kAudioObjectPropertyScopeOutput, verbose);
+    setup_.latencyModel = registry_.latencyModel(deviceID_);
+    if (verbose)
+    {
+        qDebug().noquote() << "Reported latency:\n" << QString::fromStdString(setup_.latencyModel.report(std::numeric_limits<double>::quiet_NaN(), std::numeric_limits<double>::quiet_NaN()));
+    }
+
+    addr.mSelector = kAudioDevicePropertyBufferFrameSizeRange;
+    setup_.maxFrames = static_cast<size_t>(registry_.get<AudioValueRange>(deviceID_, addr).mMaximum);
+    setup_.numInputs = registry_.numChannels(deviceID_, kAudioObjectPropertyScopeInput);
+    setup_.numOutputs = registry_.numChannels(deviceID_, kAudioObjectPropertyScopeOutput);
+    if (verbose)
+    {
+        qDebug() << "Input channels: " << setup_.numInputs << ", output channels: " << setup_.numOutputs;
+    }
+
+    configured_ = true;
+    return setup_;
+}
+
+bool StreamConfigurator::selectPhysicalFormat(AudioObjectPropertyScope scope, SampleFormat format, Float64 sampleRate)
+{
+    // Switch every stream of one direction to a physical format of the given type
+    const AudioObjectPropertyAddress current{kAudioStreamPropertyPhysicalFormat, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain};
+    const AudioObjectPropertyAddress available{kAudioStreamPropertyAvailablePhysicalFormats, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain};
+    for (auto id : registry_.streams(deviceID_, scope))
+    {
+        const auto desc = registry_.get<AudioStreamBasicDescription>(id, current);
+        SampleFormat currentFormat;
+        if (sampleFormatFromDescription(desc, currentFormat) && (currentFormat == format) &&
+            (std::abs(desc.mSampleRate - sampleRate) <= 1e-3))
+        {
+            continue;
+        }
+
+        bool found = false;
+        for (const auto &candidate : registry_.getArray<AudioStreamRangedDescription>(id, available))
+        {
+            SampleFormat candidateFormat;
+            if (sampleFormatFromDescription(candidate.mFormat, candidateFormat) && (candidateFormat == format) &&
+                (candidate.mFormat.mChannelsPerFrame == desc.mChannelsPerFrame) &&
+                (sampleRate >= candidate.mSampleRateRange.mMinimum) && (sampleRate <= candidate.mSampleRateRange.mMaximum))
+            {
+                auto selected = candidate.mFormat;
+                selected.mSampleRate = sampleRate;
+                registry_.set(id, current, selected);
+                numWrites_++;
+                found = true;
+                break;
+            }
+        }
+        if (!found)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::vector<SampleFormat> StreamConfigurator::streamFormats(AudioObjectPropertyScope scope, bool verbose)
+{
+    const auto virtualFormats = registry_.streamFormats(deviceID_, scope);
+    const auto physicalFormats = registry_.streamFormats(deviceID_, scope, true);
+    const char *direction = (scope == kAudioObjectPropertyScopeInput) ? "Input" : "Output";
+
+    std::vector<SampleFormat> formats;
+    for (size_t k = 0; k < virtualFormats.size(); k++)
+    {
+        SampleFormat format;
+        if (!sampleFormatFromDescription(virtualFormats[k], format))
+        {
+            qDebug() << direction << "stream" << k << "has an unsupported format";
+            printStreamConfig(virtualFormats[k]);
+            throw std::runtime_error("Unsupported stream format");
+        }
+        if (verbose)
+        {
+            SampleFormat physical;
+            const bool knownPhysical = sampleFormatFromDescription(physicalFormats[k], physical);
+            qDebug() << direction << "stream" << k << ":" << virtualFormats[k].mChannelsPerFrame << "channels,"
+                     << sampleFormatName(format) << "buffers," << (knownPhysical ? sampleFormatName(physical) : "other") << "on the hardware";
+        }
+        formats.push_back(format);
+    }
+    return formats;
+}
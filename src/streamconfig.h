@@ -0,0 +1,79 @@
+#ifndef STREAMCONFIG_H
+#define STREAMCONFIG_H
+
+#include "deviceregistry.h"
+#include "latencymodel.h"
+#include "sampleformat.h"
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+
+/**
+ * @brief Device configuration requested for a stream
+ */
+struct StreamRequest
+{
+    Float64 sampleRate{48e3};
+    UInt32 bufferSize{32};
+    bool selectPhysicalFormat{false};
+    SampleFormat physicalFormat{SampleFormat::Float32};
+};
+
+
+/**
+ * @brief Stream layout of a configured device, as the I/O cycle needs it
+ */
+struct StreamSetup
+{
+    std::vector<SampleFormat> inFormats;    ///< IOProc buffer format of every input stream
+    std::vector<SampleFormat> outFormats;
+    LatencyModel latencyModel;
+    size_t maxFrames{0};                    ///< Largest possible I/O cycle
+    size_t numInputs{0};                    ///< Channels over all streams
+    size_t numOutputs{0};
+};
+
+
+/**
+ * @brief Apply a StreamRequest to a device, writing only the properties that differ
+ *
+ * Every property is read through the DeviceRegistry, so on a restart with an
+ * unchanged device the current values come from its cache without a HAL call,
+ * and a property is only written if the device does not have the requested
+ * value already. After a write, the affected cached values are dropped at once
+ * rather than waiting for the change notification. The stream layout and the
+ * reported latency are logged on the first apply() and whenever one wrote.
+ *
+ * Not thread-safe; meant to be owned by one backend.
+ */
+class StreamConfigurator
+{
+public:
+    StreamConfigurator(DeviceRegistry& registry, AudioObjectID deviceID);
+
+    /**
+     * @brief Configure the device, throwing std::runtime_error if it cannot be
+     */
+    const StreamSetup& apply(const StreamRequest& request);
+
+    /**
+     * @brief Properties written by the last apply()
+     */
+    size_t numWrites() const {return numWrites_;}
+
+    const StreamSetup& setup() const {return setup_;}
+
+private:
+    bool selectPhysicalFormat(AudioObjectPropertyScope scope, SampleFormat format, Float64 sampleRate);
+    std::vector<SampleFormat> streamFormats(AudioObjectPropertyScope scope, bool verbose);
+
+    DeviceRegistry &registry_;
+    const AudioObjectID deviceID_;
+    StreamSetup setup_;
+    bool configured_{false};
+    size_t numWrites_{0};
+};
+
+#endif // STREAMCONFIG_H
@@ -0,0 +1,331 @@
+#include "sweeprunner.h"
+#include "buffersizestore.h"
+#include "simulateddevice.h"
+#include "stimulus.h"
+#ifdef __APPLE__
+#include "coreaudioqt.h"
+#endif
+
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <filesystem>
+
+
+namespace {
+
+/**
+ * @brief Parse a comma separated list of numbers
+ */
+template<typename T>
+std::vector<T> parseList(const std::string& text)
+{
+    std::vector<T> values;
+    std::istringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ','))
+    {
+        if (item.empty())
+        {
+            continue;
+        }
+        std::istringstream is(item);
+        T value{};
+        if (!(is >> value) || (value <= 0))
+        {
+            throw std::invalid_argument("Invalid list entry: " + item);
+        }
+        values.push_back(value);
+    }
+    return values;
+}
+
+}   // anonymous namespace
+
+
+/**
+ * Headless latency sweep over sample rates and buffer sizes
+ *
+ * Usage: TestCoreAudioLatencySweep [--simulate] [--fast] [--device <UID>] [--rates <r1,r2,..>]
+ *        [--buffers <b1,b2,..>] [--periods <n>] [--period <n>] [--stimulus <type>]
+ *        [--confidence <c>] [--load <l1,l2,..>] [--spikes <percent>:<interval>]
+ *        [--load-periods <n>] [--tune] [--tune-load <percent>] [--max-budget <percent>]
+ *        [--max-glitch-rate <per minute>] [--trial <s>] [--soak <s>] [--store <file>]
+ *        [--jitter <us>] [--out <dir>] [--csv <file>]
+ *
+ * Without --rates, all nominal rates of the device are swept. --fast runs the
+ * simulated device as fast as possible instead of in real time. --confidence
+ * ends a cell early once the running confidence reaches c (0..1). --load runs a
+ * load ramp per cell instead, with synthetic DSP load steps in percent of the
+ * buffer period, and reports the highest load without glitches. --tune searches
+ * the buffer sizes for the smallest one each rate sustains instead (see
+ * SweepRunner::tune()) and saves it for the device in the buffer size store,
+ * which the GUI reads. --jitter delays the simulated device's callbacks at random.
+ */
+int main(int argc, char *argv[])
+{
+    SweepConfig config;
+    config.resultPath = "sweep";
+    bool simulate = false;
+    bool fast = false;
+    bool tuneMode = false;
+    double jitterUs = 0;
+    std::filesystem::path storeFilename = BufferSizeStore::defaultPath();
+    [[maybe_unused]] bool ratesGiven = false;
+    std::filesystem::path csvFilename;
+
+    try
+    {
+        for (int k = 1; k < argc; k++)
+        {
+            const std::string arg = argv[k];
+            const bool hasValue = (k + 1 < argc);
+            if (arg == "--simulate")
+            {
+                simulate = true;
+            }
+            else if (arg == "--fast")
+            {
+                fast = true;
+            }
+            else if ((arg == "--device") && hasValue)
+            {
+                config.deviceUID = argv[++k];
+            }
+            else if ((arg == "--rates") && hasValue)
+            {
+                config.sampleRates = parseList<double>(argv[++k]);
+                ratesGiven = true;
+            }
+            else if ((arg == "--buffers") && hasValue)
+            {
+                config.bufferSizes = parseList<size_t>(argv[++k]);
+            }
+            else if ((arg == "--periods") && hasValue)
+            {
+                config.numPeriods = std::stoul(argv[++k]);
+            }
+            else if ((arg == "--period") && hasValue)
+            {
+                config.period = std::stoul(argv[++k]);
+            }
+            else if ((arg == "--stimulus") && hasValue)
+            {
+                config.stimulus = parseStimulusType(argv[++k]);
+            }
+            else if ((arg == "--confidence") && hasValue)
+            {
+                config.targetConfidence = std::stod(argv[++k]);
+            }
+            else if ((arg == "--load") && hasValue)
+            {
+                config.loadSteps = parseList<double>(argv[++k]);
+            }
+            else if ((arg == "--spikes") && hasValue)
+            {
+                // <percent>:<interval in callbacks>
+                const std::string spec = argv[++k];
+                const auto colon = spec.find(':');
+                if (colon == std::string::npos)
+                {
+                    throw std::invalid_argument("Invalid spikes, expected <percent>:<interval>: " + spec);
+                }
+                config.spikeLoad = std::stod(spec.substr(0, colon));
+                config.spikeInterval = std::stoul(spec.substr(colon + 1));
+            }
+            else if ((arg == "--load-periods") && hasValue)
+            {
+                config.periodsPerLoad = std::stoul(argv[++k]);
+            }
+            else if (arg == "--tune")
+            {
+                tuneMode = true;
+            }
+            else if ((arg == "--tune-load") && hasValue)
+            {
+                config.tuneLoad = std::stod(argv[++k]);
+            }
+            else if ((arg == "--max-budget") && hasValue)
+            {
+                config.maxBudget = std::stod(argv[++k]);
+            }
+            else if ((arg == "--max-glitch-rate") && hasValue)
+            {
+                config.maxGlitchRate = std::stod(argv[++k]);
+            }
+            else if ((arg == "--trial") && hasValue)
+            {
+                config.trialSeconds = std::stod(argv[++k]);
+            }
+            else if ((arg == "--soak") && hasValue)
+            {
+                config.soakSeconds = std::stod(argv[++k]);
+            }
+            else if ((arg == "--store") && hasValue)
+            {
+                storeFilename = argv[++k];
+            }
+            else if ((arg == "--jitter") && hasValue)
+            {
+                jitterUs = std::stod(argv[++k]);
+            }
+            else if ((arg == "--out") && hasValue)
+            {
+                config.resultPath = argv[++k];
+            }
+            else if ((arg == "--csv") && hasValue)
+            {
+                csvFilename = argv[++k];
+            }
+            else
+            {
+                throw std::invalid_argument("Unknown argument: " + arg);
+            }
+        }
+#ifndef __APPLE__
+        simulate = true;
+#endif
+
+        SweepRunner::BackendFactory factory;
+        if (simulate)
+        {
+            config.deviceUID = "simulated";
+            const bool overload = !config.loadSteps.empty() || tuneMode;
+            factory = [fast, overload, jitterUs](AudioProcessor& processor, double sampleRate, size_t bufferSize) -> std::unique_ptr<AudioBackend> {
+                SimulatedDeviceConfig sim;
+                sim.sampleRate = sampleRate;
+                sim.bufferSize = bufferSize;
+                // Input and output buffering plus a fixed converter delay
+                sim.loopbackDelay = 2.0 * bufferSize + 64.5;
+                sim.realTime = !fast;
+                sim.jitter = jitterUs * 1e-6;
+                // Let an overloaded callback glitch like a real device
+                sim.skipLateCycles = overload;
+                return std::make_unique<SimulatedDevice>(processor, sim);
+            };
+        }
+        else
+        {
+#ifdef __APPLE__
+            const auto devices = getDevices();
+            const DeviceInfo *selectedDevice = nullptr;
+            const auto defaultID = getDefaultInputDeviceID();
+            for (const auto &dev : devices)
+            {
+                if (config.deviceUID.empty() ? (dev.id == defaultID) : (dev.deviceUID.toStdString() == config.deviceUID))
+                {
+                    selectedDevice = &dev;
+                }
+            }
+            if (selectedDevice == nullptr)
+            {
+                throw std::runtime_error("Device not found");
+            }
+
+            config.deviceUID = selectedDevice->deviceUID.toStdString();
+            config.numInputs = selectedDevice->numInputs;
+            config.numOutputs = selectedDevice->numOutputs;
+            if (!ratesGiven)
+            {
+                config.sampleRates.clear();
+                for (const auto &range : selectedDevice->availSampleRates)
+                {
+                    if (range.mMinimum == range.mMaximum)
+                    {
+                        config.sampleRates.push_back(range.mMinimum);
+                    }
+                }
+            }
+
+            const auto deviceID = selectedDevice->id;
+            if (tuneMode)
+            {
+                // Only sizes the device accepts are candidates
+                AudioValueRange range{0, 0};
+                const AudioObjectPropertyAddress addr{kAudioDevicePropertyBufferFrameSizeRange, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain};
+                getCAProperty(deviceID, addr, range);
+                auto &sizes = config.bufferSizes;
+                sizes.erase(std::remove_if(sizes.begin(), sizes.end(), [&range](size_t size) {
+                    return (size < range.mMinimum) || (size > range.mMaximum);
+                }), sizes.end());
+            }
+            factory = [deviceID](AudioProcessor& processor, double sampleRate, size_t bufferSize) -> std::unique_ptr<AudioBackend> {
+                return std::make_unique<CoreAudioQt>(processor, deviceID, sampleRate, static_cast<UInt32>(bufferSize));
+            };
+#endif
+        }
+
+        std::cout << "Device: " << config.deviceUID << ", stimulus: " << stimulusName(config.stimulus) << std::endl;
+        SweepRunner runner(config, std::move(factory));
+        if (tuneMode)
+        {
+            const auto results = runner.runTuning();
+            SweepRunner::printTuneTable(std::cout, results);
+
+            if (!csvFilename.empty())
+            {
+                std::ofstream file(csvFilename);
+                SweepRunner::printTuneCsv(file, results);
+            }
+
+            BufferSizeStore store(storeFilename);
+            bool tuned = true;
+            for (const auto &r : results)
+            {
+                if (r.bufferSize > 0)
+                {
+                    store.set(config.deviceUID, r.sampleRate, r.bufferSize);
+                }
+                tuned = tuned && (r.bufferSize > 0);
+            }
+            store.save();
+            std::cout << "Saved to " << store.filename().string() << std::endl;
+            return tuned ? 0 : 2;
+        }
+        if (!config.loadSteps.empty())
+        {
+            const auto results = runner.runLoadRamps();
+            SweepRunner::printLoadTable(std::cout, results);
+
+            if (!csvFilename.empty())
+            {
+                std::ofstream file(csvFilename);
+                SweepRunner::printLoadCsv(file, results);
+            }
+
+            for (const auto &r : results)
+            {
+                if (!r.error.empty())
+                {
+                    return 2;
+                }
+            }
+            return 0;
+        }
+
+        const auto results = runner.run();
+        SweepRunner::printTable(std::cout, results);
+
+        if (!csvFilename.empty())
+        {
+            std::ofstream file(csvFilename);
+            SweepRunner::printCsv(file, results);
+        }
+
+        for (const auto &r : results)
+        {
+            if (!r.error.empty())
+            {
+                return 2;
+            }
+        }
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << "ERROR: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
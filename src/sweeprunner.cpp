@@ -0,0 +1,695 @@
+#include "sweeprunner.h"
+#include "latencytester.h"
+
+#include <QDebug>
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <iomanip>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+
+SweepRunner::SweepRunner(const SweepConfig& config, BackendFactory factory)
+    : config_(config)
+    , factory_(std::move(factory))
+{
+    if (!factory_)
+    {
+        throw std::invalid_argument("SweepRunner: no backend factory");
+    }
+}
+
+std::vector<SweepResult> SweepRunner::run()
+{
+    std::vector<SweepResult> results;
+    for (auto sampleRate : config_.sampleRates)
+    {
+        for (auto bufferSize : config_.bufferSizes)
+        {
+            qDebug() << "Sweep: sample rate" << sampleRate << ", buffer size" << bufferSize;
+            results.push_back(runCell(sampleRate, bufferSize));
+        }
+    }
+    return results;
+}
+
+SweepResult SweepRunner::runCell(double sampleRate, size_t bufferSize)
+{
+    SweepResult result;
+    result.sampleRate = sampleRate;
+    result.bufferSize = bufferSize;
+
+    std::mutex mutex;
+    std::condition_variable done;
+    std::vector<LatencyEstimate> estimates;
+    std::string error;
+
+    try
+    {
+        const auto path = cellPath(sampleRate, bufferSize, "");
+        const auto info = cellInfo(sampleRate, bufferSize);
+
+        // Called on the recording thread
+        auto onEstimate = [&](const LatencyEstimate& e) {
+            std::lock_guard<std::mutex> lock(mutex);
+            estimates.push_back(e);
+            done.notify_one();
+        };
+        LatencyTester tester(info, path.string(), onEstimate);
+
+        auto backend = factory_(tester, sampleRate, bufferSize);
+        if (!backend)
+        {
+            throw std::runtime_error("No backend for this configuration");
+        }
+        QObject::connect(backend.get(), &AudioBackend::error, [&](const QString& msg) {
+            std::lock_guard<std::mutex> lock(mutex);
+            error = msg.toStdString();
+            done.notify_one();
+        });
+
+        // Two extra periods are skipped by the tracker while the device settles
+        const auto expected = std::chrono::duration<double>((config_.numPeriods + 2) * config_.period / sampleRate);
+        const auto deadline = std::chrono::steady_clock::now() +
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(expected) + config_.timeout;
+
+        // There is no event loop here, so deliver the backend's events while waiting
+        const auto pumpInterval = std::chrono::milliseconds(AudioBackend::kPumpInterval);
+        const auto confident = [&] {
+            return (config_.targetConfidence > 0) && (estimates.size() >= config_.minPeriods)
+                && (estimates.back().confidence >= config_.targetConfidence);
+        };
+        const auto startTime = std::chrono::steady_clock::now();
+        backend->Start();
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            bool completed = false;
+            while (true)
+            {
+                completed = done.wait_until(lock, std::min(deadline, std::chrono::steady_clock::now() + pumpInterval), [&] {
+                    return (estimates.size() >= config_.numPeriods) || confident() || !error.empty();
+                });
+                if (completed || (std::chrono::steady_clock::now() >= deadline))
+                {
+                    break;
+                }
+                lock.unlock();
+                backend->pumpEvents();
+                lock.lock();
+            }
+            if (!completed)
+            {
+                error = "Timeout after " + std::to_string(estimates.size()) + " period(s)";
+            }
+            result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        }
+        backend->Stop();
+        backend->pumpEvents();
+        const auto stats = backend->callbackStats();
+        result.xruns = stats.discontinuities;
+        result.deadlineMisses = stats.deadlineMisses;
+        result.budgetP99 = stats.budget.percentile(0.99);
+        const auto model = backend->latencyModel();
+        result.reportedDelay = model.reportedRoundTrip();
+        result.timestampDelay = model.timestampRoundTrip(stats.ioSpan);
+        backend.reset();
+        tester.close();
+        result.dropouts = tester.overruns();
+    }
+    catch (const std::exception& e)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        error = e.what();
+    }
+
+    // The tester is gone, so no more callbacks
+    result.error = error;
+    result.numPeriods = std::min(estimates.size(), config_.numPeriods);
+    if (result.numPeriods > 0)
+    {
+        double sum = 0;
+        double sum2 = 0;
+        for (size_t k = 0; k < result.numPeriods; k++)
+        {
+            const auto& e = estimates[k];
+            sum += e.fractionalDelay;
+            sum2 += e.fractionalDelay * e.fractionalDelay;
+            if (e.stepChange)
+            {
+                result.stepChanges++;
+            }
+        }
+        const auto& last = estimates[result.numPeriods - 1];
+        const double n = static_cast<double>(result.numPeriods);
+        result.delay = sum / n;
+        result.delayMs = result.delay * 1e3 / sampleRate;
+        result.jitterUs = std::sqrt(std::max(0.0, sum2 / n - result.delay * result.delay)) * 1e6 / sampleRate;
+        result.driftPpm = last.driftPpm;
+        result.confidence = last.confidence;
+    }
+    return result;
+}
+
+std::vector<LoadRampResult> SweepRunner::runLoadRamps()
+{
+    std::vector<LoadRampResult> results;
+    for (auto sampleRate : config_.sampleRates)
+    {
+        for (auto bufferSize : config_.bufferSizes)
+        {
+            qDebug() << "Load ramp: sample rate" << sampleRate << ", buffer size" << bufferSize;
+            results.push_back(runLoadRamp(sampleRate, bufferSize));
+        }
+    }
+    return results;
+}
+
+LoadRampResult SweepRunner::runLoadRamp(double sampleRate, size_t bufferSize)
+{
+    LoadRampResult result;
+    result.sampleRate = sampleRate;
+    result.bufferSize = bufferSize;
+    result.maxSafeLoad = std::numeric_limits<double>::quiet_NaN();
+
+    std::mutex mutex;
+    std::condition_variable done;
+    std::vector<LatencyEstimate> estimates;
+    std::string error;
+
+    try
+    {
+        const auto path = cellPath(sampleRate, bufferSize, "_load");
+        const auto info = cellInfo(sampleRate, bufferSize);
+
+        // Called on the recording thread
+        auto onEstimate = [&](const LatencyEstimate& e) {
+            std::lock_guard<std::mutex> lock(mutex);
+            estimates.push_back(e);
+            done.notify_one();
+        };
+        LatencyTester tester(info, path.string(), onEstimate);
+
+        auto backend = factory_(tester, sampleRate, bufferSize);
+        if (!backend)
+        {
+            throw std::runtime_error("No backend for this configuration");
+        }
+        QObject::connect(backend.get(), &AudioBackend::error, [&](const QString& msg) {
+            std::lock_guard<std::mutex> lock(mutex);
+            error = msg.toStdString();
+            done.notify_one();
+        });
+
+        std::vector<double> loads{0.0};
+        loads.insert(loads.end(), config_.loadSteps.begin(), config_.loadSteps.end());
+        const auto pumpInterval = std::chrono::milliseconds(AudioBackend::kPumpInterval);
+        backend->Start();
+
+        for (size_t step = 0; step < loads.size(); step++)
+        {
+            LoadStepResult r;
+            r.load = loads[step];
+            tester.load().setLoad(r.load);
+            if (step == 1)
+            {
+                // The idle step is the reference, so spikes start with the load
+                tester.load().setSpikes(config_.spikeLoad, config_.spikeInterval);
+            }
+            const auto before = backend->callbackStats();
+            const uint64_t overrunsBefore = tester.overruns();
+
+            // The idle step also waits for the two periods the tracker skips
+            size_t first = 0;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                first = estimates.size() + 1;
+            }
+            const size_t last = first + config_.periodsPerLoad;
+            const auto expected = std::chrono::duration<double>((config_.periodsPerLoad + 3) * config_.period / sampleRate);
+            const auto deadline = std::chrono::steady_clock::now() +
+                std::chrono::duration_cast<std::chrono::steady_clock::duration>(expected) + config_.timeout;
+
+            // Give up on the step as soon as the device glitches
+            CallbackStats::Snapshot stats;
+            const auto glitched = [&] {
+                stats = backend->callbackStats().since(before);
+                r.dropouts = tester.overruns() - overrunsBefore;
+                return (stats.discontinuities > 0) || (stats.deadlineMisses > 0) || (r.dropouts > 0);
+            };
+            bool completed = false;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                while (true)
+                {
+                    completed = done.wait_until(lock, std::min(deadline, std::chrono::steady_clock::now() + pumpInterval), [&] {
+                        return (estimates.size() >= last) || !error.empty();
+                    });
+                    if (completed || (std::chrono::steady_clock::now() >= deadline))
+                    {
+                        break;
+                    }
+                    lock.unlock();
+                    backend->pumpEvents();
+                    const bool failed = glitched();
+                    lock.lock();
+                    if (failed)
+                    {
+                        break;
+                    }
+                }
+            }
+            glitched();
+            r.xruns = stats.discontinuities;
+            r.deadlineMisses = stats.deadlineMisses;
+            r.budgetP99 = stats.budget.percentile(0.99);
+
+            bool stepChange = false;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!error.empty())
+                {
+                    break;
+                }
+                double sum = 0;
+                double sum2 = 0;
+                for (size_t k = first; k < std::min(last, estimates.size()); k++)
+                {
+                    const auto& e = estimates[k];
+                    sum += e.fractionalDelay;
+                    sum2 += e.fractionalDelay * e.fractionalDelay;
+                    stepChange = stepChange || e.stepChange;
+                    r.numPeriods++;
+                }
+                if (r.numPeriods > 0)
+                {
+                    const double n = static_cast<double>(r.numPeriods);
+                    r.delay = sum / n;
+                    r.jitterUs = std::sqrt(std::max(0.0, sum2 / n - r.delay * r.delay)) * 1e6 / sampleRate;
+                }
+            }
+
+            if (step == 0)
+            {
+                result.idleDelay = r.delay;
+            }
+            r.ok = (r.numPeriods == config_.periodsPerLoad) && !stepChange
+                && (r.dropouts == 0) && (r.xruns == 0) && (r.deadlineMisses == 0)
+                && (std::abs(r.delay - result.idleDelay) <= config_.maxLatencyChange);
+            result.steps.push_back(r);
+            if (!r.ok)
+            {
+                break;
+            }
+            result.maxSafeLoad = r.load;
+        }
+
+        backend->Stop();
+        backend->pumpEvents();
+        backend.reset();
+        tester.close();
+    }
+    catch (const std::exception& e)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        error = e.what();
+    }
+
+    result.error = error;
+    return result;
+}
+
+std::vector<TuneResult> SweepRunner::runTuning()
+{
+    std::vector<TuneResult> results;
+    for (auto sampleRate : config_.sampleRates)
+    {
+        qDebug() << "Tuning: sample rate" << sampleRate;
+        results.push_back(tune(sampleRate));
+    }
+    return results;
+}
+
+TuneResult SweepRunner::tune(double sampleRate)
+{
+    TuneResult result;
+    result.sampleRate = sampleRate;
+
+    auto sizes = config_.bufferSizes;
+    std::sort(sizes.begin(), sizes.end());
+    sizes.erase(std::unique(sizes.begin(), sizes.end()), sizes.end());
+
+    // Smallest size passing a short trial, assuming larger sizes do no worse
+    size_t lo = 0;
+    size_t hi = sizes.size();
+    while (lo < hi)
+    {
+        const size_t mid = (lo + hi) / 2;
+        qDebug() << "Tuning: trial at buffer size" << sizes[mid];
+        result.trials.push_back(runTrial(sampleRate, sizes[mid], config_.trialSeconds));
+        if (result.trials.back().ok)
+        {
+            hi = mid;
+        }
+        else
+        {
+            lo = mid + 1;
+        }
+    }
+
+    // Confirm over the soak window, backing off one size at a time
+    for (size_t k = hi; k < sizes.size(); k++)
+    {
+        qDebug() << "Tuning: soak at buffer size" << sizes[k];
+        auto trial = runTrial(sampleRate, sizes[k], config_.soakSeconds);
+        trial.soak = true;
+        result.trials.push_back(trial);
+        if (trial.ok)
+        {
+            result.bufferSize = sizes[k];
+            break;
+        }
+    }
+    return result;
+}
+
+TuneTrial SweepRunner::runTrial(double sampleRate, size_t bufferSize, double seconds)
+{
+    TuneTrial result;
+    result.bufferSize = bufferSize;
+
+    std::mutex mutex;
+    std::string error;
+
+    try
+    {
+        const auto path = cellPath(sampleRate, bufferSize, "_tune");
+        const auto info = cellInfo(sampleRate, bufferSize);
+        LatencyTester tester(info, path.string(), LatencyTracker::Callback());
+        tester.load().setLoad(config_.tuneLoad);
+
+        auto backend = factory_(tester, sampleRate, bufferSize);
+        if (!backend)
+        {
+            throw std::runtime_error("No backend for this configuration");
+        }
+        QObject::connect(backend.get(), &AudioBackend::error, [&](const QString& msg) {
+            std::lock_guard<std::mutex> lock(mutex);
+            error = msg.toStdString();
+        });
+
+        // Glitches while the device starts up are not held against the size
+        const auto settle = std::chrono::milliseconds(200);
+        const auto pumpInterval = std::chrono::milliseconds(AudioBackend::kPumpInterval);
+        const auto allowed = static_cast<uint64_t>(std::floor(config_.maxGlitchRate * seconds / 60.0));
+        backend->Start();
+        std::this_thread::sleep_for(settle);
+        backend->pumpEvents();
+        const auto before = backend->callbackStats();
+        const uint64_t overrunsBefore = tester.overruns();
+        const auto startTime = std::chrono::steady_clock::now();
+        const auto deadline = startTime + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+
+        // Back off as soon as the size has glitched more than allowed
+        CallbackStats::Snapshot stats;
+        const auto glitches = [&] {
+            stats = backend->callbackStats().since(before);
+            result.dropouts = tester.overruns() - overrunsBefore;
+            return stats.discontinuities + stats.deadlineMisses + result.dropouts;
+        };
+        while (std::chrono::steady_clock::now() < deadline)
+        {
+            std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(pumpInterval, deadline - std::chrono::steady_clock::now()));
+            backend->pumpEvents();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!error.empty())
+                {
+                    break;
+                }
+            }
+            if (glitches() > allowed)
+            {
+                break;
+            }
+        }
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        glitches();
+        result.xruns = stats.discontinuities;
+        result.deadlineMisses = stats.deadlineMisses;
+        result.budgetP99 = stats.budget.percentile(0.99);
+
+        backend->Stop();
+        backend->pumpEvents();
+        backend.reset();
+        tester.close();
+        // Overruns still count until the writer has drained
+        result.dropouts = tester.overruns() - overrunsBefore;
+        result.ok = (result.xruns + result.deadlineMisses + result.dropouts <= allowed) && (result.budgetP99 <= config_.maxBudget);
+    }
+    catch (const std::exception& e)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        error = e.what();
+    }
+
+    result.error = error;
+    result.ok = result.ok && error.empty();
+    return result;
+}
+
+RecordingInfo SweepRunner::cellInfo(double sampleRate, size_t bufferSize) const
+{
+    RecordingInfo info;
+    info.sampleRate = sampleRate;
+    info.numChannels = config_.numInputs;
+    info.numOutputs = config_.numOutputs;
+    info.layout = StimulusLayout::Passthrough;
+    info.stimulus = config_.stimulus;
+    info.period = config_.period;
+    info.bufferSize = bufferSize;
+    info.deviceUID = config_.deviceUID;
+    return info;
+}
+
+std::filesystem::path SweepRunner::cellPath(double sampleRate, size_t bufferSize, const std::string& suffix) const
+{
+    const auto path = config_.resultPath /
+        ("sr" + std::to_string(static_cast<long>(sampleRate)) + "_buf" + std::to_string(bufferSize) + suffix);
+    std::filesystem::create_directories(path);
+    return path;
+}
+
+void SweepRunner::printTable(std::ostream& os, const std::vector<SweepResult>& results)
+{
+    os << std::setw(8) << "rate"
+       << std::setw(8) << "buffer"
+       << std::setw(9) << "periods"
+       << std::setw(8) << "secs"
+       << std::setw(12) << "samples"
+       << std::setw(10) << "reported"
+       << std::setw(10) << "tstamps"
+       << std::setw(10) << "msec"
+       << std::setw(12) << "jitter us"
+       << std::setw(11) << "drift ppm"
+       << std::setw(10) << "dropouts"
+       << std::setw(7) << "xruns"
+       << std::setw(8) << "misses"
+       << std::setw(10) << "budget %"
+       << std::setw(7) << "steps"
+       << std::setw(7) << "conf"
+       << "  status" << std::endl;
+    for (const auto& r : results)
+    {
+        os << std::fixed
+           << std::setw(8) << std::setprecision(0) << r.sampleRate
+           << std::setw(8) << r.bufferSize
+           << std::setw(9) << r.numPeriods
+           << std::setw(8) << std::setprecision(2) << r.seconds
+           << std::setw(12) << r.delay
+           << std::setw(10) << std::setprecision(1) << r.reportedDelay
+           << std::setw(10) << r.timestampDelay
+           << std::setw(10) << std::setprecision(3) << r.delayMs
+           << std::setw(12) << std::setprecision(2) << r.jitterUs
+           << std::setw(11) << std::setprecision(2) << r.driftPpm
+           << std::setw(10) << r.dropouts
+           << std::setw(7) << r.xruns
+           << std::setw(8) << r.deadlineMisses
+           << std::setw(10) << std::setprecision(1) << r.budgetP99
+           << std::setw(7) << r.stepChanges
+           << std::setw(7) << std::setprecision(2) << r.confidence
+           << "  " << (r.error.empty() ? "ok" : r.error) << std::endl;
+    }
+}
+
+void SweepRunner::printCsv(std::ostream& os, const std::vector<SweepResult>& results)
+{
+    os << "sample_rate,buffer_size,periods,seconds,delay_samples,delay_ms,reported_samples,timestamp_samples,jitter_us,drift_ppm,dropouts,xruns,deadline_misses,budget_p99,step_changes,confidence,error" << std::endl;
+    for (const auto& r : results)
+    {
+        std::string error = r.error;
+        std::replace(error.begin(), error.end(), ',', ';');
+        os << std::defaultfloat << std::setprecision(10)
+           << r.sampleRate << ','
+           << r.bufferSize << ','
+           << r.numPeriods << ','
+           << r.seconds << ','
+           << r.delay << ','
+           << r.delayMs << ','
+           << r.reportedDelay << ','
+           << r.timestampDelay << ','
+           << r.jitterUs << ','
+           << r.driftPpm << ','
+           << r.dropouts << ','
+           << r.xruns << ','
+           << r.deadlineMisses << ','
+           << r.budgetP99 << ','
+           << r.stepChanges << ','
+           << r.confidence << ','
+           << error << std::endl;
+    }
+}
+
+void SweepRunner::printLoadTable(std::ostream& os, const std::vector<LoadRampResult>& results)
+{
+    os << std::setw(8) << "rate"
+       << std::setw(8) << "buffer"
+       << std::setw(8) << "load %"
+       << std::setw(9) << "periods"
+       << std::setw(12) << "samples"
+       << std::setw(12) << "jitter us"
+       << std::setw(10) << "dropouts"
+       << std::setw(7) << "xruns"
+       << std::setw(8) << "misses"
+       << std::setw(10) << "budget %"
+       << "  status" << std::endl;
+    for (const auto& cell : results)
+    {
+        for (const auto& r : cell.steps)
+        {
+            os << std::fixed
+               << std::setw(8) << std::setprecision(0) << cell.sampleRate
+               << std::setw(8) << cell.bufferSize
+               << std::setw(8) << r.load
+               << std::setw(9) << r.numPeriods
+               << std::setw(12) << std::setprecision(2) << r.delay
+               << std::setw(12) << r.jitterUs
+               << std::setw(10) << r.dropouts
+               << std::setw(7) << r.xruns
+               << std::setw(8) << r.deadlineMisses
+               << std::setw(10) << std::setprecision(1) << r.budgetP99
+               << "  " << (r.ok ? "ok" : "FAIL") << std::endl;
+        }
+        os << std::fixed << std::setprecision(0)
+           << std::setw(8) << cell.sampleRate
+           << std::setw(8) << cell.bufferSize << "  max safe load: ";
+        if (std::isnan(cell.maxSafeLoad))
+        {
+            os << "none";
+        }
+        else
+        {
+            os << std::setprecision(1) << cell.maxSafeLoad << " %";
+        }
+        if (!cell.error.empty())
+        {
+            os << " (" << cell.error << ")";
+        }
+        os << std::endl;
+    }
+}
+
+void SweepRunner::printLoadCsv(std::ostream& os, const std::vector<LoadRampResult>& results)
+{
+    os << "sample_rate,buffer_size,load,periods,delay_samples,jitter_us,dropouts,xruns,deadline_misses,budget_p99,ok,max_safe_load,error" << std::endl;
+    for (const auto& cell : results)
+    {
+        std::string error = cell.error;
+        std::replace(error.begin(), error.end(), ',', ';');
+        for (const auto& r : cell.steps)
+        {
+            os << std::defaultfloat << std::setprecision(10)
+               << cell.sampleRate << ','
+               << cell.bufferSize << ','
+               << r.load << ','
+               << r.numPeriods << ','
+               << r.delay << ','
+               << r.jitterUs << ','
+               << r.dropouts << ','
+               << r.xruns << ','
+               << r.deadlineMisses << ','
+               << r.budgetP99 << ','
+               << (r.ok ? 1 : 0) << ','
+               << cell.maxSafeLoad << ','
+               << error << std::endl;
+        }
+    }
+}
+
+void SweepRunner::printTuneTable(std::ostream& os, const std::vector<TuneResult>& results)
+{
+    os << std::setw(8) << "rate"
+       << std::setw(8) << "buffer"
+       << std::setw(7) << "trial"
+       << std::setw(8) << "secs"
+       << std::setw(10) << "dropouts"
+       << std::setw(7) << "xruns"
+       << std::setw(8) << "misses"
+       << std::setw(10) << "budget %"
+       << "  status" << std::endl;
+    for (const auto& tuning : results)
+    {
+        for (const auto& r : tuning.trials)
+        {
+            os << std::fixed
+               << std::setw(8) << std::setprecision(0) << tuning.sampleRate
+               << std::setw(8) << r.bufferSize
+               << std::setw(7) << (r.soak ? "soak" : "search")
+               << std::setw(8) << std::setprecision(1) << r.seconds
+               << std::setw(10) << r.dropouts
+               << std::setw(7) << r.xruns
+               << std::setw(8) << r.deadlineMisses
+               << std::setw(10) << r.budgetP99
+               << "  " << (r.ok ? "ok" : (r.error.empty() ? "FAIL" : r.error)) << std::endl;
+        }
+        os << std::fixed << std::setprecision(0)
+           << std::setw(8) << tuning.sampleRate << "  tuned buffer size: ";
+        if (tuning.bufferSize == 0)
+        {
+            os << "none";
+        }
+        else
+        {
+            os << tuning.bufferSize;
+        }
+        os << std::endl;
+    }
+}
+
+void SweepRunner::printTuneCsv(std::ostream& os, const std::vector<TuneResult>& results)
+{
+    os << "sample_rate,buffer_size,soak,seconds,dropouts,xruns,deadline_misses,budget_p99,ok,tuned_buffer_size,error" << std::endl;
+    for (const auto& tuning : results)
+    {
+        for (const auto& r : tuning.trials)
+        {
+            std::string error = r.error;
+            std::replace(error.begin(), error.end(), ',', ';');
+            os << std::defaultfloat << std::setprecision(10)
+               << tuning.sampleRate << ','
+               << r.bufferSize << ','
+               << (r.soak ? 1 : 0) << ','
+               << r.seconds << ','
+               << r.dropouts << ','
+               << r.xruns << ','
+               << r.deadlineMisses << ','
+               << r.budgetP99 << ','
+               << (r.ok ? 1 : 0) << ','
+               << tuning.bufferSize << ','
+               << error << std::endl;
+        }
+    }
+}
@@ -0,0 +1,179 @@
+#ifndef SWEEPRUNNER_H
+#define SWEEPRUNNER_H
+
+#include "audiobackend.h"
+#include "chirp.h"
+#include "recordingfile.h"
+
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+
+struct SweepConfig
+{
+    std::vector<double> sampleRates{48e3};
+    std::vector<size_t> bufferSizes{16, 32, 64, 128, 256, 512};
+    size_t numPeriods{20};              ///< Analysed periods per cell, the maximum with auto-stop
+    size_t period{kDefaultChirpPeriod};
+    StimulusType stimulus{StimulusType::Chirp};
+    double targetConfidence{0};         ///< Stop a cell early once reached, 0 to always run numPeriods
+    size_t minPeriods{2};               ///< Periods needed before stopping early
+    size_t numInputs{2};
+    size_t numOutputs{2};
+    std::string deviceUID;
+    std::filesystem::path resultPath;   ///< Each cell records into its own subdirectory
+    std::chrono::milliseconds timeout{30000};   ///< Per cell, on top of the expected run time
+
+    // Load ramp, see SweepRunner::runLoadRamp()
+    std::vector<double> loadSteps;      ///< Synthetic DSP load in % of the buffer period, after an idle step
+    double spikeLoad{0};                ///< Load of every spikeInterval-th callback, 0 for no spikes
+    size_t spikeInterval{0};
+    size_t periodsPerLoad{4};           ///< Analysed periods per load step
+    double maxLatencyChange{1.0};       ///< Samples the delay may move away from the idle delay
+
+    // Buffer size tuning, see SweepRunner::tune()
+    double tuneLoad{0};                 ///< Synthetic DSP load during every trial in % of the buffer period
+    double maxBudget{100};              ///< Highest 99th percentile callback duration in % of the buffer period
+    double maxGlitchRate{0};            ///< Dropouts, xruns and deadline misses allowed per minute
+    double trialSeconds{2};             ///< Length of a search trial
+    double soakSeconds{60};             ///< Length of the confirming soak of the chosen size
+};
+
+
+struct SweepResult
+{
+    double sampleRate{0};
+    size_t bufferSize{0};
+    size_t numPeriods{0};       ///< Periods with an estimate
+    double seconds{0};          ///< From Start() until the cell had its estimates
+    double delay{0};            ///< Mean fractional delay in samples
+    double delayMs{0};
+    double jitterUs{0};         ///< Standard deviation of the per-period delay
+    double driftPpm{0};
+    double confidence{0};       ///< Running confidence at the last period
+    uint64_t dropouts{0};       ///< Recording overruns
+    uint64_t xruns{0};          ///< Device sample time discontinuities
+    uint64_t deadlineMisses{0}; ///< Callbacks longer than their buffer period
+    double budgetP99{0};        ///< 99th percentile of the callback duration in % of the buffer period
+    double reportedDelay{0};    ///< Round trip from the reported latency components
+    double timestampDelay{0};   ///< Round trip predicted from the I/O cycle timestamps, NaN if not reported
+    size_t stepChanges{0};
+    std::string error;          ///< Empty if the cell completed
+};
+
+
+struct LoadStepResult
+{
+    double load{0};             ///< In % of the buffer period
+    size_t numPeriods{0};
+    double delay{0};            ///< Mean fractional delay in samples
+    double jitterUs{0};
+    uint64_t dropouts{0};
+    uint64_t xruns{0};
+    uint64_t deadlineMisses{0};
+    double budgetP99{0};        ///< Measured, including the injected load
+    bool ok{false};
+};
+
+
+struct LoadRampResult
+{
+    double sampleRate{0};
+    size_t bufferSize{0};
+    double idleDelay{0};        ///< Delay of the idle step in samples
+    double maxSafeLoad{0};      ///< Highest load of the passing steps, NaN if the idle step failed
+    std::vector<LoadStepResult> steps;
+    std::string error;
+};
+
+
+struct TuneTrial
+{
+    size_t bufferSize{0};
+    bool soak{false};           ///< Confirmation over the soak window rather than a search trial
+    double seconds{0};          ///< Until the trial ended, early on too many glitches
+    uint64_t dropouts{0};
+    uint64_t xruns{0};
+    uint64_t deadlineMisses{0};
+    double budgetP99{0};        ///< Measured, including the injected load
+    bool ok{false};
+    std::string error;
+};
+
+
+struct TuneResult
+{
+    double sampleRate{0};
+    size_t bufferSize{0};       ///< Smallest size that passed its soak, 0 if none did
+    std::vector<TuneTrial> trials;
+};
+
+
+/**
+ * @brief Measure the loopback latency for every sample rate and buffer size combination
+ *
+ * Every cell gets a fresh backend from the factory and a passthrough LatencyTester;
+ * the cell ends once numPeriods periods were tracked, on a backend error or on
+ * timeout. With a target confidence, it also ends as soon as at least
+ * minPeriods periods were tracked and the running confidence reaches it. Cells run one after the other from the calling thread, which must not
+ * be needed to deliver the backend's error signal (a direct connection is used).
+ */
+class SweepRunner
+{
+public:
+    using BackendFactory = std::function<std::unique_ptr<AudioBackend>(AudioProcessor& processor, double sampleRate, size_t bufferSize)>;
+
+    SweepRunner(const SweepConfig& config, BackendFactory factory);
+
+    std::vector<SweepResult> run();
+    SweepResult runCell(double sampleRate, size_t bufferSize);
+
+    /**
+     * @brief Find the highest synthetic DSP load each cell sustains
+     *
+     * Runs one recording per cell, first idle and then at each of loadSteps in
+     * turn (with the configured spikes) for periodsPerLoad periods, skipping the
+     * period during which the load changed. A step passes without dropouts,
+     * xruns and deadline misses and with the delay within maxLatencyChange of
+     * the idle delay; the ramp ends at the first step that fails.
+     */
+    std::vector<LoadRampResult> runLoadRamps();
+    LoadRampResult runLoadRamp(double sampleRate, size_t bufferSize);
+
+    /**
+     * @brief Find the smallest buffer size each sample rate sustains
+     *
+     * The candidates are the configured buffer sizes. A binary search over them
+     * runs a trial of trialSeconds per probed size with tuneLoad injected; a
+     * trial passes without an error, with no more glitches (dropouts, xruns and
+     * deadline misses) than maxGlitchRate allows and with the 99th percentile
+     * callback duration within maxBudget. The smallest passing size is then run
+     * for soakSeconds; every failing soak backs off to the next larger size. A
+     * trial ends as soon as it has more glitches than allowed.
+     */
+    std::vector<TuneResult> runTuning();
+    TuneResult tune(double sampleRate);
+
+    static void printTable(std::ostream& os, const std::vector<SweepResult>& results);
+    static void printCsv(std::ostream& os, const std::vector<SweepResult>& results);
+    static void printLoadTable(std::ostream& os, const std::vector<LoadRampResult>& results);
+    static void printLoadCsv(std::ostream& os, const std::vector<LoadRampResult>& results);
+    static void printTuneTable(std::ostream& os, const std::vector<TuneResult>& results);
+    static void printTuneCsv(std::ostream& os, const std::vector<TuneResult>& results);
+
+private:
+    TuneTrial runTrial(double sampleRate, size_t bufferSize, double seconds);
+    RecordingInfo cellInfo(double sampleRate, size_t bufferSize) const;
+    std::filesystem::path cellPath(double sampleRate, size_t bufferSize, const std::string& suffix) const;
+
+    const SweepConfig config_;
+    const BackendFactory factory_;
+};
+
+#endif // SWEEPRUNNER_H
@@ -0,0 +1,129 @@
+#include "workerpool.h"
+
+#include <algorithm>
+#include <iterator>
+
+
+WorkerPool::WorkerPool(size_t numThreads)
+{
+    if (numThreads == 0)
+    {
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (size_t k = 0; k < numThreads; k++)
+    {
+        threads_.emplace_back(&WorkerPool::run, this);
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto &thread : threads_)
+    {
+        thread.join();
+    }
+}
+
+void WorkerPool::post(Task task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push_back(std::move(task));
+    }
+    wake_.notify_one();
+}
+
+WorkerPool::PollerToken WorkerPool::addPoller(Poller poller)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto token = nextToken_++;
+    pollers_.push_back({token, std::move(poller)});
+    generation_++;
+    return token;
+}
+
+void WorkerPool::removePoller(PollerToken token)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto it = std::find_if(pollers_.begin(), pollers_.end(), [token](const PollerEntry& e) {return e.token == token;});
+    if (it == pollers_.end())
+    {
+        return;
+    }
+    idle_.wait(lock, [&] {return !it->busy;});
+    pollers_.erase(it);
+    generation_++;
+}
+
+void WorkerPool::run()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_)
+    {
+        if (!tasks_.empty())
+        {
+            auto task = std::move(tasks_.front());
+            tasks_.pop_front();
+            lock.unlock();
+            task();
+            lock.lock();
+            continue;
+        }
+
+        lock.unlock();
+        const bool worked = pollOnce();
+        lock.lock();
+        if (!worked && tasks_.empty() && !stopping_)
+        {
+            wake_.wait_for(lock, kPollInterval);
+        }
+    }
+}
+
+bool WorkerPool::pollOnce()
+{
+    // One pass over all pollers not already running on another worker. List
+    // nodes stay valid while busy, since removePoller() waits for them.
+    bool worked = false;
+    std::unique_lock<std::mutex> lock(mutex_);
+    const size_t count = pollers_.size();
+    const uint64_t generation = generation_;
+    if (count == 0)
+    {
+        return false;
+    }
+    auto it = std::next(pollers_.begin(), static_cast<std::ptrdiff_t>(cursor_++ % count));
+    for (size_t k = 0; k < count; k++)
+    {
+        if (it == pollers_.end())
+        {
+            it = pollers_.begin();
+        }
+        auto &entry = *it;
+        ++it;
+        if (entry.busy)
+        {
+            continue;
+        }
+
+        entry.busy = true;
+        lock.unlock();
+        const bool found = entry.poller();
+        lock.lock();
+        entry.busy = false;
+        idle_.notify_all();
+        worked = worked || found;
+
+        // The next node may be gone if the list changed while unlocked
+        if (generation_ != generation)
+        {
+            break;
+        }
+    }
+    return worked;
+}
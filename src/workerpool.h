@@ -0,0 +1,77 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstdint>
+
+
+/**
+ * @brief Fixed set of threads shared by the non-real-time work of several devices
+ *
+ * Runs posted tasks and, in between, polls registered pollers. A poller returns
+ * true if it found work; pollers are used for queues fed by real-time threads,
+ * which must not signal anything. Every poller runs on at most one thread at a
+ * time, so it needs no locking of its own. Idle workers sleep kPollInterval.
+ */
+class WorkerPool
+{
+public:
+    using Task = std::function<void()>;
+    using Poller = std::function<bool()>;
+    using PollerToken = size_t;
+
+    static constexpr auto kPollInterval = std::chrono::milliseconds(5);
+
+    /**
+     * @param numThreads 0 for one per hardware thread
+     */
+    explicit WorkerPool(size_t numThreads = 0);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    size_t numThreads() const {return threads_.size();}
+
+    void post(Task task);
+
+    PollerToken addPoller(Poller poller);
+
+    /**
+     * @brief Unregister a poller, waiting for a running call of it to return
+     */
+    void removePoller(PollerToken token);
+
+private:
+    struct PollerEntry
+    {
+        PollerToken token;
+        Poller poller;
+        bool busy{false};
+    };
+
+    void run();
+    bool pollOnce();
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable idle_;      ///< A poller call returned
+    std::deque<Task> tasks_;
+    std::list<PollerEntry> pollers_;
+    PollerToken nextToken_{1};
+    uint64_t generation_{0};            ///< Bumped whenever pollers_ changes
+    size_t cursor_{0};                  ///< Round-robin start of the next poll pass
+    bool stopping_{false};
+    std::vector<std::thread> threads_;
+};
+
+#endif // WORKERPOOL_H